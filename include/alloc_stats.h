@@ -0,0 +1,78 @@
+/** @file
+    Allocation tracking by pipeline stage and decoder.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_ALLOC_STATS_H_
+#define INCLUDE_ALLOC_STATS_H_
+
+#include <stddef.h>
+
+struct r_device;
+struct data;
+
+/// Pipeline stages to attribute allocations to.
+enum alloc_stage {
+    ALLOC_STAGE_OTHER,  ///< main loop, network, reports, and setup
+    ALLOC_STAGE_DEMOD,  ///< input conversion, baseband, and pulse detection
+    ALLOC_STAGE_DECODE, ///< slicers and decoders, also counted for the decoder
+    ALLOC_STAGE_OUTPUT, ///< event processing and the outputs
+    ALLOC_STAGE_COUNT,
+};
+
+/// The stage and decoder to restore when leaving a stage.
+typedef struct alloc_scope {
+    int stage;
+    struct r_device *decoder;
+} alloc_scope_t;
+
+#ifdef ALLOC_STATS
+
+/// Count the allocations of the current thread for a stage and decoder until left.
+///
+/// @param stage the stage, one of enum alloc_stage
+/// @param decoder the decoder to count allocations for, may be NULL
+/// @return the previous scope, to be passed to alloc_stats_leave
+alloc_scope_t alloc_stats_enter(int stage, struct r_device *decoder);
+
+/// Restore the previous stage and decoder.
+void alloc_stats_leave(alloc_scope_t prev);
+
+/// Report the counts of all stages since the last reset.
+struct data *alloc_stats_data(void);
+
+/// Reset the counts of all stages, the decoder counts are reset with the decoder stats.
+void alloc_stats_reset(void);
+
+#else
+
+/// Allocations are only counted in builds with ENABLE_ALLOC_STATS.
+static inline alloc_scope_t alloc_stats_enter(int stage, struct r_device *decoder)
+{
+    alloc_scope_t prev = {stage, decoder};
+    return prev;
+}
+
+static inline void alloc_stats_leave(alloc_scope_t prev)
+{
+    (void)prev;
+}
+
+static inline struct data *alloc_stats_data(void)
+{
+    return NULL;
+}
+
+static inline void alloc_stats_reset(void)
+{
+}
+
+#endif
+
+#endif /* INCLUDE_ALLOC_STATS_H_ */
@@ -33,6 +33,22 @@ float magnitude_true_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len);
 float magnitude_est_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len);
 float magnitude_true_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len);
 
+/** Estimate the signal level from every step-th sample, without demodulating.
+
+    A cheap energy detection on the scale of envelope_detect(), or magnitude_est_cu8() with use_mag.
+    @param iq_buf input samples (I/Q samples in interleaved uint8)
+    @param len number of samples
+    @param step use every step-th sample
+    @param window number of used samples averaged for the peak level
+    @param use_mag estimate the magnitude instead of the amplitude
+    @param[out] peak_db the highest average level of a window in dB
+    @return the average level in dB
+*/
+float level_estimate_cu8(uint8_t const *iq_buf, uint32_t len, unsigned step, unsigned window, int use_mag, float *peak_db);
+
+/// Estimate the signal level from every step-th sample, on the scale of magnitude_est_cs16().
+float level_estimate_cs16(int16_t const *iq_buf, uint32_t len, unsigned step, unsigned window, float *peak_db);
+
 #define AMP_TO_DB(x) (10.0f * ((x) > 0 ? log10f(x) : 0) - 42.1442f)  // 10*log10f(16384.0f)
 #define MAG_TO_DB(x) (20.0f * ((x) > 0 ? log10f(x) : 0) - 84.2884f)  // 20*log10f(16384.0f)
 #ifdef __exp10f
@@ -130,8 +146,53 @@ void baseband_demod_FM(uint8_t const *x_buf, int16_t *y_buf, unsigned long num_s
 /// For evaluation.
 void baseband_demod_FM_cs16(int16_t const *x_buf, int16_t *y_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, demodfm_state_t *state);
 
-/** Initialize tables and constants.
-    Should be called once at startup.
+#define DECIMATOR_MAX_FACTOR 32
+#define DECIMATOR_MAX_TAPS (8 * DECIMATOR_MAX_FACTOR + 1)
+
+/// Decimator state buffer.
+typedef struct decimator_state {
+    unsigned factor; ///< Decimation factor, 1 is pass-through
+    unsigned taps;   ///< Number of FIR taps
+    unsigned phase;  ///< Input samples since last output sample
+    unsigned pos;    ///< Delay line write position
+    int16_t coef[DECIMATOR_MAX_TAPS];       ///< Low pass FIR coeffs, Q15
+    int16_t hist_i[2 * DECIMATOR_MAX_TAPS]; ///< Delay line, real part, stored twice
+    int16_t hist_q[2 * DECIMATOR_MAX_TAPS]; ///< Delay line, imag part, stored twice
+} decimator_state_t;
+
+/** Initialize a decimator.
+
+    Designs a windowed-sinc low pass with the cutoff at 80% of the new Nyquist frequency.
+    @param[out] state State to initialize
+    @param factor decimation factor, clamped to 1 .. DECIMATOR_MAX_FACTOR
+*/
+void baseband_decimator_init(decimator_state_t *state, unsigned factor);
+
+/** Low pass filter and decimate I/Q samples.
+
+    Function is stateful. Output can be the same buffer as the input.
+    @param x_buf input samples (I/Q samples in interleaved uint8)
+    @param[out] y_buf output samples (I/Q samples in interleaved uint8)
+    @param num_samples number of samples to process
+    @param[in,out] state State to store between chunk processing
+    @return number of output samples
+*/
+unsigned long baseband_decimate_cu8(uint8_t const *x_buf, uint8_t *y_buf, unsigned long num_samples, decimator_state_t *state);
+
+/// Convert CU8 I/Q samples to CF32.
+void baseband_convert_cu8_cf32(uint8_t const *x_buf, float *y_buf, unsigned long num_samples);
+
+/// Convert CS16 I/Q samples to CF32.
+void baseband_convert_cs16_cf32(int16_t const *x_buf, float *y_buf, unsigned long num_samples);
+
+/// Convert S16 AM or FM samples (Q0.15) to F32.
+void baseband_convert_s16_f32(int16_t const *x_buf, float *y_buf, unsigned long num_samples);
+
+/** Initialize tables and constants, register the kernel variants.
+    Only the first call has an effect, with threads support this is safe to call from any thread.
+
+    The envelope and magnitude estimators, the filters, and the converters
+    call the variant selected for the CPU, see kernels.h.
 */
 void baseband_init(void);
 
@@ -0,0 +1,51 @@
+/** @file
+    Checkpoints to resume batch decoding of input files.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_CHECKPOINT_H_
+#define INCLUDE_CHECKPOINT_H_
+
+#include <stdint.h>
+
+#define CHECKPOINT_DEFAULT_INTERVAL 10
+
+struct r_cfg;
+
+/// Position of a checkpoint in the list of input files.
+typedef struct checkpoint_pos {
+    unsigned file_index; ///< the input file to continue with, past the last file if all are done
+    uint64_t sample_pos; ///< the sample position to continue at, 0 for the file start
+    char *file;          ///< the input file name if the position is inside a file
+} checkpoint_pos_t;
+
+/// Atomically write the batch decoding progress to a checkpoint file.
+///
+/// Saves the input position, the pulse detector levels, the filter and
+/// FM demodulator state, and the decoder statistics.
+/// Inside a file a checkpoint is only taken between packages, so that
+/// a resumed run produces neither duplicate nor missing events.
+///
+/// @param cfg the config with the demod state
+/// @param path the checkpoint file
+/// @param pos the position to continue at, with the current file name
+/// @return 0 on success, 1 if a package is in progress, -1 on error
+int checkpoint_save(struct r_cfg *cfg, char const *path, checkpoint_pos_t const *pos);
+
+/// Read a checkpoint file and restore the demod state and the decoder statistics.
+///
+/// @param cfg the config with the demod state
+/// @param path the checkpoint file
+/// @param[out] pos the position to continue at, release with checkpoint_pos_clear
+/// @return 0 on success, 1 if there is no checkpoint file, -1 on error
+int checkpoint_load(struct r_cfg *cfg, char const *path, checkpoint_pos_t *pos);
+
+void checkpoint_pos_clear(checkpoint_pos_t *pos);
+
+#endif /* INCLUDE_CHECKPOINT_H_ */
@@ -33,6 +33,17 @@ typedef CONDITION_VARIABLE              pthread_cond_t;
 #define pthread_cond_signal(cp)         (WakeConditionVariable(cp))
 #define pthread_cond_broadcast(cp)      (WakeAllConditionVariable(cp))
 
+typedef INIT_ONCE                       pthread_once_t;
+#define PTHREAD_ONCE_INIT               INIT_ONCE_STATIC_INIT
+static BOOL CALLBACK compat_once_call(PINIT_ONCE once, PVOID fn, PVOID *ctx)
+{
+    (void)once;
+    (void)ctx;
+    ((void (*)(void))fn)();
+    return TRUE;
+}
+#define pthread_once(op, fn)            (InitOnceExecuteOnce(op, compat_once_call, (PVOID)(fn), NULL) ? 0 : -1)
+
 // #elif __GNUC__>3 || (__GNUC__==3 && __GNUC_MINOR__>3)
 #else
 
@@ -25,6 +25,12 @@
 */
 int timeval_subtract(struct timeval *result, struct timeval *x, struct timeval *y);
 
+/** Get the cpu time used by the process, user and system, in seconds.
+
+    @return the cpu time in seconds, 0 if not available
+*/
+double get_cpu_time(void);
+
 // platform-specific functions
 
 #ifdef _WIN32
@@ -141,6 +141,80 @@ R_API data_t *data_retain(data_t *data);
 /** Releases a structure object if retain is zero, decrement retain otherwise. */
 R_API void data_free(data_t *data);
 
+/** Replaces the key of a single element, in place if the new key is not longer.
+
+    @return 0 on success, -1 if there was a memory allocation error.
+*/
+R_API int data_set_key(data_t *data, char const *key);
+
+/** Replaces the format of a single element, in place if the new format is not longer.
+
+    @return 0 on success, -1 if there was a memory allocation error.
+*/
+R_API int data_set_format(data_t *data, char const *format);
+
+/** Releases the pool of reusable data elements of the calling thread. */
+R_API void data_pool_clear(void);
+
+/** A schema assigns dense field ids to a set of keys.
+
+    Field ids are the index of the key in the list given on creation,
+    duplicate keys keep the first id.
+*/
+typedef struct data_schema data_schema_t;
+
+/** A record of the top-level fields of a data_t, indexed by schema field id.
+
+    The values point into the data_t list, which stays the owner.
+    Keys not in the schema are skipped, for duplicate keys the first element wins.
+*/
+typedef struct data_record {
+    data_schema_t const *schema;
+    unsigned *present; /**< presence bitmap, one bit per field id */
+    data_t **values;   /**< values array indexed by field id, valid if present */
+} data_record_t;
+
+/** Constructs a schema from a list of keys, NULL keys are skipped.
+
+    @return The constructed schema or NULL if there was a memory allocation error.
+*/
+R_API data_schema_t *data_schema_create(char const *const *keys, int num_keys);
+
+/** Releases a schema. */
+R_API void data_schema_free(data_schema_t *schema);
+
+/** Returns the number of field ids in a schema. */
+R_API int data_schema_count(data_schema_t const *schema);
+
+/** Returns the field id of a key, -1 if the key is not in the schema. */
+R_API int data_schema_id(data_schema_t const *schema, char const *key);
+
+/** Returns the key of a field id. */
+R_API char const *data_schema_key(data_schema_t const *schema, int id);
+
+/** Sets up an empty record for a schema.
+
+    @return 0 on success, -1 if there was a memory allocation error.
+*/
+R_API int data_record_init(data_record_t *record, data_schema_t const *schema);
+
+/** Releases the arrays of a record, the data is not touched. */
+R_API void data_record_release(data_record_t *record);
+
+/** Fills a record from the top-level elements of a structured data object in one pass.
+
+    @return The number of fields found.
+*/
+R_API int data_record_fill(data_record_t *record, data_t *data);
+
+/** Returns the element for a field id from a filled record or NULL if not present. */
+static inline data_t *data_record_get(data_record_t const *record, int id)
+{
+    if (id < 0 || !(record->present[id / (8 * sizeof(unsigned))] & (1U << (id % (8 * sizeof(unsigned))))))
+        return NULL;
+    return record->values[id];
+}
+
 struct data_output;
 
 typedef struct data_output {
@@ -70,4 +70,22 @@ void decoder_logf_bitrow(r_device *decoder, int level, char const *func, uint8_t
 #endif
         ;
 
+/// Get the state of a partial frame, to collect a frame from multiple packages.
+///
+/// The state for @p key (e.g. a sensor id, or 0) is zeroed if it is new, or if
+/// there was no part for longer than the decoder's frame_ttl_ms. A few states are
+/// kept per decoder, the oldest is dropped when more are needed.
+/// Return DECODE_PARTIAL after storing a part, call decoder_frame_done() once
+/// the frame is complete.
+///
+/// @param decoder the decoder
+/// @param key the frame key
+/// @param size the state size, the same on each call, at most FRAME_STATE_MAX (256) bytes
+/// @param[out] found set to 1 if the state has earlier parts, may be NULL
+/// @return the state, NULL on error
+void *decoder_frame_state(r_device *decoder, uint64_t key, size_t size, int *found);
+
+/// Drop the state of a complete frame.
+void decoder_frame_done(r_device *decoder, uint64_t key);
+
 #endif /* INCLUDE_DECODER_UTIL_H_ */
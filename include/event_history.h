@@ -0,0 +1,65 @@
+/** @file
+    On-disk event history ring with a sparse time and sequence index.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_EVENT_HISTORY_H_
+#define INCLUDE_EVENT_HISTORY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define EVENT_HISTORY_DEFAULT_SIZE (64 * 1024 * 1024)
+
+typedef struct event_history event_history_t;
+
+/// Callback for each matching event, the json points into the mapped file.
+typedef void (*event_history_fn)(void *ctx, uint64_t seq, char const *json, size_t len);
+
+/// Open or create an event history file and map it into memory.
+///
+/// The file has a fixed size, the oldest events are dropped to make room.
+/// An existing file with a different size is reinitialized.
+/// Records are checksummed, a torn append after a crash is dropped on open.
+///
+/// @param path the history file
+/// @param size the size of the ring buffer in bytes
+/// @return the new history, NULL on error.
+///         You must release this object with event_history_close once you're done with it.
+event_history_t *event_history_open(char const *path, size_t size);
+
+/// Flush and unmap the history.
+void event_history_close(event_history_t *h);
+
+/// Append a serialized event.
+///
+/// @param h the history
+/// @param model the model name to filter on, may be NULL
+/// @param json the serialized event
+/// @param len the length of the serialized event
+/// @param time the receive time in seconds since the epoch
+/// @return the sequence number of the event, 0 on error
+uint64_t event_history_append(event_history_t *h, char const *model, char const *json, size_t len, double time);
+
+/// Find events, in order of the sequence numbers.
+///
+/// With a time or a sequence number the first events after that are returned,
+/// otherwise the most recent events.
+///
+/// @param h the history
+/// @param since only events received at or after this time, 0 for any
+/// @param after_seq only events with a sequence number greater than this, 0 for any
+/// @param model only events with this model name, NULL for any
+/// @param limit the maximum number of events
+/// @param cb the callback for each event
+/// @param ctx the callback context
+/// @return the number of events found
+unsigned event_history_query(event_history_t *h, double since, uint64_t after_seq, char const *model, unsigned limit, event_history_fn cb, void *ctx);
+
+#endif /* INCLUDE_EVENT_HISTORY_H_ */
@@ -117,6 +117,15 @@ void file_info_clear(file_info_t *info);
 /// @return the detected file format, 0 otherwise
 int file_info_parse_filename(file_info_t *info, const char *filename);
 
+/// Split an optional range suffix off a filename, e.g. "path/file.cu8:start=1h,end=1h5m".
+///
+/// The suffix starts at the first colon followed by one of the
+/// keys "start=", "end=", "preroll=", or "t0=" and is cut off in place.
+///
+/// @param[in,out] filename a file name with optional overrides and range suffix
+/// @return the range options (without the colon), NULL if there are none
+char *file_info_split_range(char *filename);
+
 /// Check if the format in this file info is supported for reading,
 /// print a warning and exit otherwise.
 ///
@@ -0,0 +1,64 @@
+/** @file
+    Bounded table of partial frames, keyed and dropped by age.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_FRAME_TABLE_H_
+#define INCLUDE_FRAME_TABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FRAME_TABLE_SLOTS    8    ///< partial frames kept per decoder
+#define FRAME_STATE_MAX      256  ///< maximum size of the state of a partial frame
+#define FRAME_DEFAULT_TTL_MS 2000 ///< partial frames are dropped after this time without a new part
+
+/// The outcome of a lookup.
+enum frame_lookup {
+    FRAME_FOUND   = 0, ///< the state of the earlier parts
+    FRAME_NEW     = 1, ///< a zeroed state, there are no earlier parts
+    FRAME_EXPIRED = 2, ///< a zeroed state, the earlier parts of this key were too old
+    FRAME_EVICTED = 3, ///< a zeroed state, the oldest partial frame of another key was dropped for it
+};
+
+typedef struct frame_table frame_table_t;
+
+/// Create a table of partial frames.
+///
+/// @param slots the number of partial frames to keep
+/// @param state_size the size of the state of each partial frame
+/// @return the new table, NULL on error.
+///         You must release this object with frame_table_free once you're done with it.
+frame_table_t *frame_table_create(unsigned slots, size_t state_size);
+
+void frame_table_free(frame_table_t *t);
+
+/// The size of the state of each partial frame.
+size_t frame_table_state_size(frame_table_t const *t);
+
+/// Get the state of the partial frame for a key, a zeroed state if there is none.
+///
+/// A state older than @p ttl_ms is zeroed, if the table is full the oldest
+/// state is reused. The age of the state is reset with each lookup.
+///
+/// @param t the table
+/// @param key the frame key, e.g. a sensor id
+/// @param now_ms the current time in ms, a time before the state counts as expired
+/// @param ttl_ms the maximum age in ms
+/// @param[out] lookup the outcome of the lookup, one of enum frame_lookup
+/// @return the state
+void *frame_table_get(frame_table_t *t, uint64_t key, uint64_t now_ms, unsigned ttl_ms, int *lookup);
+
+/// Drop the state of the partial frame for a key, e.g. once the frame is complete.
+void frame_table_remove(frame_table_t *t, uint64_t key);
+
+/// The number of partial frames kept.
+unsigned frame_table_count(frame_table_t const *t);
+
+#endif /* INCLUDE_FRAME_TABLE_H_ */
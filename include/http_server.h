@@ -17,6 +17,11 @@
 struct mg_mgr;
 struct r_cfg;
 
-struct data_output *data_output_http_create(struct mg_mgr *mgr, const char *host, const char *port, struct r_cfg *cfg);
+/// Create the HTTP API server output.
+///
+/// Options are "history=<file>" to keep events in an on-disk ring for "/events" queries,
+/// "history_size=<bytes>" to limit the size of the ring,
+/// and "iq_size=<bytes>" to keep an in-memory ring of IQ samples for "/iq" snapshots.
+struct data_output *data_output_http_create(struct mg_mgr *mgr, const char *host, const char *port, char *opts, struct r_cfg *cfg);
 
 #endif /* INCLUDE_HTTP_SERVER_H_ */
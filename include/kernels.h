@@ -0,0 +1,82 @@
+/** @file
+    Registry of kernel variants selected by CPU features.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_KERNELS_H_
+#define INCLUDE_KERNELS_H_
+
+/// CPU features a kernel variant can require.
+enum kernel_feature {
+    KERNEL_SSE2 = 1 << 0,
+    KERNEL_AVX2 = 1 << 1,
+    KERNEL_NEON = 1 << 2,
+};
+
+/// A generic kernel function, cast to the actual type to call it.
+typedef void (*kernel_fn)(void);
+
+#define KERNEL_MAX_VARIANTS 8
+
+/// Samples per benchmark run, a typical block size.
+#define KERNELS_BENCH_SAMPLES 16384
+
+/// An implementation of a kernel.
+typedef struct kernel_variant {
+    char const *name;
+    unsigned features; ///< required CPU features
+    kernel_fn fn;
+} kernel_variant_t;
+
+/// A hot function with multiple implementations.
+typedef struct kernel {
+    char const *name;
+    unsigned in_size;  ///< input bytes per sample
+    unsigned out_size; ///< output bytes per sample
+    /// Run a variant on a buffer of samples with fresh state, for the benchmark and check.
+    void (*run)(kernel_fn fn, void const *in, void *out, unsigned len);
+    /// Variants in order of preference, the reference first, terminated by a NULL name.
+    kernel_variant_t variants[KERNEL_MAX_VARIANTS];
+    kernel_fn fn;                    ///< the selected variant
+    int selected;                    ///< index of the selected variant
+    int forced;                      ///< selected by the user, not by features or benchmark
+    double ns[KERNEL_MAX_VARIANTS];  ///< benchmark result, ns per sample
+} kernel_t;
+
+/// Detect the CPU features (CPUID on x86, HWCAP on ARM).
+unsigned kernels_cpu_features(void);
+
+/// Register a kernel and select the preferred variant the CPU supports.
+///
+/// The kernel must outlive the registry. Registering again has no effect.
+/// The registry is not locked, register only from baseband_init().
+void kernels_register(kernel_t *k);
+
+/// Force a variant, e.g. to test for bit-exactness.
+///
+/// @param kernel the kernel name
+/// @param variant the variant name
+/// @return 0 on success, -1 if the kernel is unknown, -2 if the variant is unknown,
+///         -3 if the variant is not supported by this CPU
+int kernels_force(char const *kernel, char const *variant);
+
+/// Benchmark all supported variants and select the fastest, forced variants are kept.
+///
+/// @param len number of samples per run
+void kernels_bench(unsigned len);
+
+/// Compare the output of all supported variants to the reference.
+///
+/// @return the number of variants with a differing output
+int kernels_check(unsigned len);
+
+/// Print the CPU features, the variants, and the selection.
+void kernels_report(void);
+
+#endif /* INCLUDE_KERNELS_H_ */
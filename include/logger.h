@@ -40,6 +40,12 @@ typedef void (*r_logger_handler)(log_level_t level, char const *src, char const
 */
 void r_logger_set_log_handler(r_logger_handler const handler, void *userdata);
 
+/** Reset the log handler to the default, but only if it was set with this user data.
+
+    @param userdata user data the handler was set with
+*/
+void r_logger_reset_log_handler(void *userdata);
+
 /** Log a message string.
 
     @param level a log level
@@ -0,0 +1,41 @@
+/** @file
+    Time-window aggregation output stage for rtl_433 events.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_OUTPUT_AGGREGATE_H_
+#define INCLUDE_OUTPUT_AGGREGATE_H_
+
+#include "data.h"
+#include <time.h>
+
+/// Construct an aggregating data output wrapped around another output.
+///
+/// Device events are collected per (model, id, channel) and numeric fields
+/// are accumulated to count, min, max, mean, and last value.
+/// Once per time window a single summary event per device is passed on
+/// to the inner output. Events without a model (logs, stats) pass through.
+/// Windows follow the stream time given to data_output_aggregate_poll(),
+/// e.g. the file time on replay, the first poll opens the first window.
+///
+/// @param inner the wrapped output, ownership is transferred
+/// @param window_secs the aggregation window in seconds
+/// @return The initialized data output.
+///         You must release this object with data_output_free once you're done with it.
+struct data_output *data_output_aggregate_create(struct data_output *inner, int window_secs);
+
+/// Close the current window if it has expired, emitting all summaries.
+///
+/// Windows also close on the next event, at the time of the last poll.
+///
+/// @param output an aggregating output from data_output_aggregate_create()
+/// @param now the current stream time
+void data_output_aggregate_poll(struct data_output *output, time_t now);
+
+#endif /* INCLUDE_OUTPUT_AGGREGATE_H_ */
@@ -22,10 +22,11 @@ struct r_cfg;
 
     @param host the server host to bind
     @param port the server port to bind
+    @param opts server options: control, decimate=<n>, bits=<8|4|2>, compress
     @param cfg the r_api config to use
     @return The initialized rtltcp output instance.
             You must release this object with raw_output_free once you're done with it.
 */
-struct raw_output *raw_output_rtltcp_create(char const *host, char const *port, char const *opts, struct r_cfg *cfg);
+struct raw_output *raw_output_rtltcp_create(char const *host, char const *port, char *opts, struct r_cfg *cfg);
 
 #endif /* INCLUDE_OUTPUT_RTLTCP_H_ */
@@ -0,0 +1,80 @@
+/** @file
+    Rate-limited output stage with priority classes for rtl_433 events.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_OUTPUT_SCHED_H_
+#define INCLUDE_OUTPUT_SCHED_H_
+
+#include "data.h"
+#include "list.h"
+
+/// Priority classes, the lower value is sent first and dropped last.
+enum sched_priority {
+    SCHED_ALARM   = 0, ///< e.g. alarm, smoke, and security sensors
+    SCHED_HIGH    = 1, ///< the default for logs and reports
+    SCHED_NORMAL  = 2, ///< the default for device events
+    SCHED_LOW     = 3, ///< e.g. weather sensors
+    SCHED_CLASSES = 4,
+};
+
+#define SCHED_DEFAULT_BACKLOG 100 ///< events queued per output
+
+/// The priority class of a model, a trailing "*" matches any suffix.
+typedef struct sched_rule {
+    char *model;
+    int priority;
+} sched_rule_t;
+
+/// Parse a priority class name, "alarm", "high", "normal", "low", or a number.
+///
+/// @return the priority class, -1 on error
+int sched_priority_parse(char const *name);
+
+/// Add priority rules from a spec "<class>=<model>[,<model>...]".
+///
+/// Earlier rules take precedence.
+///
+/// @param rules a list of sched_rule_t, release with list_free_elems(rules, (list_elem_free_fn)sched_rule_free)
+/// @param spec the rule spec
+/// @return the number of models added, -1 on error
+int sched_rules_add(list_t *rules, char const *spec);
+
+void sched_rule_free(sched_rule_t *rule);
+
+/// Construct a rate-limited data output wrapped around another output.
+///
+/// Events are passed on while tokens are available, refilled at @p rate per
+/// second up to @p burst. Other events are queued by priority class. When the
+/// backlog is full the oldest event of the lowest class is dropped, or the new
+/// event if its class is lower than all queued events.
+///
+/// @param inner the wrapped output, ownership is transferred
+/// @param name a label for the stats, e.g. "mqtt"
+/// @param rate the sustained rate in events per second
+/// @param burst the bucket size in events, 0 for the default (one second of events)
+/// @param backlog the maximum number of queued events, 0 for the default
+/// @param rules the priority rules, must outlive the output
+/// @return The initialized data output.
+///         You must release this object with data_output_free once you're done with it.
+struct data_output *data_output_sched_create(struct data_output *inner, char const *name, double rate, unsigned burst, unsigned backlog, list_t const *rules);
+
+/// Send queued events as tokens become available, call this frequently.
+///
+/// @param output a rate-limited output from data_output_sched_create()
+void data_output_sched_poll(struct data_output *output);
+
+/// The rate limiter stats: sent, delayed, queued, and dropped events per class.
+///
+/// @param output a rate-limited output from data_output_sched_create()
+/// @param reset clear the counters after reporting
+/// @return the stats, NULL on error
+data_t *data_output_sched_stats(struct data_output *output, int reset);
+
+#endif /* INCLUDE_OUTPUT_SCHED_H_ */
@@ -13,8 +13,54 @@
 #define INCLUDE_PULSE_ANALYZER_H_
 
 #include "pulse_detect.h"
+#include "r_device.h"
+
+#include <stddef.h>
+
+#define MAX_HIST_BINS 16
+
+/// Histogram data for single bin
+typedef struct {
+    unsigned count;
+    int sum;
+    int mean;
+    int min;
+    int max;
+} hist_bin_t;
+
+/// Histogram data for all bins
+typedef struct {
+    unsigned bins_count;
+    hist_bin_t bins[MAX_HIST_BINS];
+} histogram_t;
+
+/// Generate a histogram (unsorted)
+void histogram_sum(histogram_t *hist, int const *data, unsigned len, float tolerance);
+
+/// Fuse histogram bins with means within tolerance
+void histogram_fuse_bins(histogram_t *hist, float tolerance);
+
+/// Sort histogram with mean value (order lowest to highest)
+void histogram_sort_mean(histogram_t *hist);
 
 /// Analyze and print result.
 void pulse_analyzer(pulse_data_t *data, int package_type);
 
+/// Guess the modulation and timings of a package without printing anything.
+///
+/// @param data the package to analyze
+/// @param package_type PULSE_DATA_OOK or PULSE_DATA_FSK
+/// @param[out] device the guessed modulation and timings, modulation is 0 if unknown
+/// @return a short description of the guess
+char const *pulse_analyzer_guess(pulse_data_t const *data, int package_type, r_device *device);
+
+/// Format a flex decoder spec for a guessed device.
+///
+/// @param device a device from pulse_analyzer_guess()
+/// @param name the decoder name to use in the spec
+/// @param[out] buf the output buffer
+/// @param size the output buffer size
+/// @return the length of the spec, 0 if the modulation is not supported by flex
+int pulse_analyzer_flex_spec(r_device const *device, char const *name, char *buf, size_t size);
+
 #endif /* INCLUDE_PULSE_ANALYZER_H_ */
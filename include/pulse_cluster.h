@@ -0,0 +1,59 @@
+/** @file
+    Background clustering of undecoded pulse packages.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_PULSE_CLUSTER_H_
+#define INCLUDE_PULSE_CLUSTER_H_
+
+#include "pulse_data.h"
+#include "data.h"
+#include <time.h>
+
+typedef struct pulse_cluster pulse_cluster_t;
+
+/// Callback for cluster summaries, the callback takes ownership of the data.
+typedef void (*pulse_cluster_report_fn)(void *ctx, data_t *data);
+
+/// Create a clusterer, with threads enabled a worker does the analysis in the background.
+///
+/// Packages are grouped by the timing signature of their pulse and gap histograms.
+/// Each cluster keeps counts, signal levels, and the package with the best SNR as exemplar.
+///
+/// @param interval_secs the report interval in seconds
+/// @return the new clusterer, NULL on error.
+///         You must release this object with pulse_cluster_free once you're done with it.
+pulse_cluster_t *pulse_cluster_create(int interval_secs);
+
+/// Stop the worker and release all clusters.
+void pulse_cluster_free(pulse_cluster_t *pc);
+
+/// Add an undecoded package, the data is copied.
+///
+/// With @p wait unset this never blocks, packages are dropped if the worker can't keep up.
+///
+/// @param pc the clusterer
+/// @param data the package
+/// @param package_type PULSE_DATA_OOK or PULSE_DATA_FSK
+/// @param wait wait for queue space instead of dropping, e.g. for input faster than real time
+void pulse_cluster_add(pulse_cluster_t *pc, pulse_data_t const *data, int package_type, int wait);
+
+/// Report all clusters with packages in the current interval if the interval has passed.
+///
+/// One summary per cluster is passed to the callback, with the timing signature,
+/// counts, signal levels, a suggested flex decoder, and the exemplar pulses.
+///
+/// @param pc the clusterer
+/// @param now the current time, 0 to report immediately after all queued packages are processed
+/// @param report the summary callback
+/// @param ctx the callback context
+/// @return the number of summaries reported
+int pulse_cluster_poll(pulse_cluster_t *pc, time_t now, pulse_cluster_report_fn report, void *ctx);
+
+#endif /* INCLUDE_PULSE_CLUSTER_H_ */
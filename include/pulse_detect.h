@@ -34,6 +34,13 @@ enum {
 
 typedef struct pulse_detect pulse_detect_t;
 
+/// Adaptive state of a pulse detector, to checkpoint and resume detection.
+typedef struct pulse_detect_levels {
+    int ook_low_estimate;  ///< Estimate for the OOK low level (base noise level)
+    int ook_high_estimate; ///< Estimate for the OOK high level
+    int lead_in_counter;   ///< Counter for allowing initial noise estimate to settle
+} pulse_detect_levels_t;
+
 pulse_detect_t *pulse_detect_create(void);
 
 void pulse_detect_free(pulse_detect_t *pulse_detect);
@@ -48,6 +55,16 @@ void pulse_detect_free(pulse_detect_t *pulse_detect);
 /// @param verbosity Debug output verbosity, 0=None, 1=Levels, 2=Histograms
 void pulse_detect_set_levels(pulse_detect_t *pulse_detect, int use_mag_est, float fixed_high_level, float min_high_level, float high_low_ratio, int verbosity);
 
+/// Get the adaptive levels of a pulse detector.
+///
+/// @param pulse_detect The pulse_detect instance
+/// @param[out] levels The current levels
+/// @return 1 if the detector is idle between packages, 0 if a package is in progress
+int pulse_detect_get_levels(pulse_detect_t const *pulse_detect, pulse_detect_levels_t *levels);
+
+/// Restore the adaptive levels of an idle pulse detector.
+void pulse_detect_put_levels(pulse_detect_t *pulse_detect, pulse_detect_levels_t const *levels);
+
 /// Demodulate On/Off Keying (OOK) and Frequency Shift Keying (FSK) from an envelope signal.
 ///
 /// Function is stateful and can be called with chunks of input data.
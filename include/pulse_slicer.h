@@ -74,6 +74,34 @@ int pulse_slicer_ppm(pulse_data_t const *pulses, r_device *device);
 /// @return number of events processed
 int pulse_slicer_pwm(pulse_data_t const *pulses, r_device *device);
 
+/// Shared slicing of one package for decoders with the same modulation and timings.
+typedef struct slice_batch slice_batch_t;
+
+slice_batch_t *slice_batch_create(void);
+
+void slice_batch_free(slice_batch_t *batch);
+
+/// Forget the slicing results, call before slicing a new package.
+void slice_batch_reset(slice_batch_t *batch);
+
+/// Demodulate a PCM, PPM, or PWM signal, sharing the work between decoders.
+///
+/// The bitbuffers sliced for one decoder are recorded in the batch and
+/// replayed to later decoders with the same timings in samples.
+/// The results are identical to pulse_slicer_pcm(), pulse_slicer_ppm(), pulse_slicer_pwm().
+///
+/// @param pulses the package to slice, the same for all calls until slice_batch_reset()
+/// @param device the decoder
+/// @param batch the slicing results of the package, may be NULL
+/// @return number of events processed
+int pulse_slicer_pcm_batch(pulse_data_t const *pulses, r_device *device, slice_batch_t *batch);
+
+/// @see pulse_slicer_pcm_batch()
+int pulse_slicer_ppm_batch(pulse_data_t const *pulses, r_device *device, slice_batch_t *batch);
+
+/// @see pulse_slicer_pcm_batch()
+int pulse_slicer_pwm_batch(pulse_data_t const *pulses, r_device *device, slice_batch_t *batch);
+
 /// Demodulate a Manchester encoded signal with a hardcoded zerobit in front.
 ///
 /// Demodulate a Manchester encoded signal where first rising edge is counted as a databit
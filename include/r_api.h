@@ -13,11 +13,13 @@
 #define INCLUDE_R_API_H_
 
 #include <stdint.h>
+#include <time.h>
 
 struct r_cfg;
 struct r_device;
 struct data;
 struct pulse_data;
+struct slice_batch;
 struct list;
 struct mg_mgr;
 
@@ -41,6 +43,18 @@ void unregister_protocol(struct r_cfg *cfg, struct r_device *r_dev);
 
 void register_all_protocols(struct r_cfg *cfg, unsigned disabled);
 
+/* hot reconfiguration, the decoder list is swapped and never changed in place */
+
+int enable_protocol(struct r_cfg *cfg, unsigned num, char *arg);
+
+int disable_protocol(struct r_cfg *cfg, unsigned num);
+
+int add_flex_protocol(struct r_cfg *cfg, char *spec);
+
+int remove_flex_protocol(struct r_cfg *cfg, char const *name);
+
+void reclaim_protocols(struct r_cfg *cfg);
+
 /* output helper */
 
 void calc_rssi_snr(struct r_cfg *cfg, struct pulse_data *pulse_data);
@@ -51,9 +65,11 @@ char const **well_known_output_fields(struct r_cfg *cfg);
 
 char const **determine_csv_fields(struct r_cfg *cfg, char const *const *well_known, int *num_fields);
 
-int run_ook_demods(struct list *r_devs, struct pulse_data *pulse_data);
+/// Run the OOK decoders on a package, decoders with the same modulation and timings share the slicing in slice_batch (may be NULL).
+int run_ook_demods(struct list *r_devs, struct pulse_data *pulse_data, struct slice_batch *slice_batch);
 
-int run_fsk_demods(struct list *r_devs, struct pulse_data *fsk_pulse_data);
+/// Run the FSK decoders on a package, decoders with the same modulation and timings share the slicing in slice_batch (may be NULL).
+int run_fsk_demods(struct list *r_devs, struct pulse_data *fsk_pulse_data, struct slice_batch *slice_batch);
 
 /* handlers */
 
@@ -93,6 +109,36 @@ void add_null_output(struct r_cfg *cfg, char *param);
 
 void add_rtltcp_output(struct r_cfg *cfg, char *param);
 
+/// Extract and remove a generic ",aggregate=<time>" option from output params, returns the window in seconds or 0.
+int aggregate_param(char *param);
+
+/// Wrap the most recently added output in a time-window aggregation stage.
+void add_aggregate_output(struct r_cfg *cfg, int window_secs);
+
+/// Extract and remove generic ",rate=<events/s>[:<burst>]" and ",backlog=<n>" options from output params, returns the rate or 0.
+double rate_param(char *param, unsigned *burst, unsigned *backlog);
+
+/// Wrap the most recently added output in a rate-limiting stage with priority classes.
+void add_sched_output(struct r_cfg *cfg, char const *name, double rate, unsigned burst, unsigned backlog);
+
+/// Add priority classes of models for the rate-limited outputs, "<class>=<model>[,<model>...]".
+void add_sched_rules(struct r_cfg *cfg, char const *spec);
+
+/// Send queued events of the rate-limited outputs as the rate allows.
+void poll_sched_outputs(struct r_cfg *cfg);
+
+/// Cluster undecoded packages in the background and report summaries every interval.
+void add_pulse_cluster(struct r_cfg *cfg, int interval_secs);
+
+/// Report the pulse cluster summaries if the interval has passed, 0 to report now.
+void poll_pulse_cluster(struct r_cfg *cfg, time_t now);
+
+/// Receive events from other receivers and merge the copies of each event, instead of an SDR.
+void add_rx_merge(struct r_cfg *cfg, char *param);
+
+/// Output the merged events whose time window has passed, 0 to output all now.
+void poll_rx_merge(struct r_cfg *cfg, uint64_t now_ms);
+
 void start_outputs(struct r_cfg *cfg, char const *const *well_known);
 
 void add_sr_dumper(struct r_cfg *cfg, char const *spec, int overwrite);
@@ -5,6 +5,8 @@
 #ifndef INCLUDE_R_DEVICE_H_
 #define INCLUDE_R_DEVICE_H_
 
+#include <stdint.h>
+
 /**
     Supported Modulation and Coding types.
 
@@ -49,10 +51,27 @@ enum decode_return_codes {
     /** Message Integrity Check failed: e.g. checksum/CRC doesn't validate. */
     DECODE_FAIL_MIC     = -3,
     DECODE_FAIL_SANITY  = -4,
+    /** A part of a frame was kept with decoder_frame_state(), the frame is not complete yet. */
+    DECODE_PARTIAL      = -5,
 };
 
 struct bitbuffer;
 struct data;
+struct frame_table;
+
+/** Decoder timings in samples, cached by the pulse slicers for one sample rate. */
+typedef struct r_device_timing {
+    unsigned sample_rate; ///< sample rate of the cached timings, 0 if not yet converted
+    int valid;            ///< no timing rounds to zero at this sample rate
+    int s_short;
+    int s_long;
+    int s_reset;
+    int s_gap;
+    int s_sync;
+    int s_tolerance;
+    float f_short; ///< reciprocal of the short width in samples, 0 if not set
+    float f_long;  ///< reciprocal of the long width in samples, 0 if not set
+} r_device_timing_t;
 
 /** Device protocol decoder struct. */
 typedef struct r_device {
@@ -72,6 +91,7 @@ typedef struct r_device {
     unsigned priority; ///< Run later and only if no previous events were produced
     unsigned disabled; ///< 0: default enabled, 1: default disabled, 2: disabled, 3: disabled and hidden
     char const *const *fields; ///< List of fields this decoder produces; required for CSV output. NULL-terminated.
+    unsigned frame_ttl_ms; ///< Partial frames are dropped after this time without a new part, 0 for the default (2 s)
 
     /* public for each decoder */
     int verbose;
@@ -83,11 +103,25 @@ typedef struct r_device {
     unsigned decode_events;
     unsigned decode_ok;
     unsigned decode_messages;
-    unsigned decode_fails[5];
+    unsigned decode_fails[6];
+    unsigned decode_allocs; ///< allocations while decoding, counted in builds with ENABLE_ALLOC_STATS
+    unsigned long decode_alloc_bytes;
+    unsigned frame_hits;    ///< parts added to a partial frame
+    unsigned frame_misses;  ///< parts starting a new partial frame
+    unsigned frame_expired; ///< partial frames dropped as too old
+    unsigned frame_evicted; ///< partial frames dropped as the table was full
+
+    /* private for the pulse slicers, the timings above are fixed once the decoder is registered */
+    r_device_timing_t timing;
+
+    /* private for the partial frame states, see decoder_frame_state() */
+    struct frame_table *frame_table;
+    uint64_t frame_time_ms; ///< stream time of the current package
 
     /* private for flex decoder and output callback */
     void *decode_ctx;
     void *output_ctx;
+    struct data_schema *schema; ///< field ids of the declared fields, assigned on registration
 } r_device;
 
 #endif /* INCLUDE_R_DEVICE_H_ */
@@ -50,15 +50,20 @@ struct dm_state {
     list_t dumper;
 
     /* Protocol states */
-    list_t r_devs;
+    list_t r_devs; ///< published decoder list, only ever swapped as a whole
+    list_t r_devs_retired; ///< decoders and lists swapped out, freed at the next quiescent point
 
     pulse_data_t    pulse_data;
     pulse_data_t    fsk_pulse_data;
+    struct slice_batch *slice_batch; ///< shared slicing of the current package, may be NULL
     unsigned frame_event_count;
     unsigned frame_start_ago;
     unsigned frame_end_ago;
     struct timeval now;
-    float sample_file_pos;
+    struct timeval buf_arrival; ///< receive time of the current buffer end, if known
+    double sample_file_pos;
+    double file_t0; ///< wall time of the input file start, events are timed by file position if set
+    double preroll_pos; ///< input file position before which packages only settle the levels
 };
 
 #endif /* INCLUDE_R_PRIVATE_H_ */
@@ -0,0 +1,120 @@
+/** @file
+    Embeddable streaming decoder API for rtl_433.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_R_STREAM_H_
+#define INCLUDE_R_STREAM_H_
+
+#include <stdint.h>
+
+struct data;
+struct pulse_data;
+
+/** A decoder instance.
+
+    Each instance owns all of its state, instances do not share anything
+    and can be used concurrently from different threads.
+    A single instance must not be used from multiple threads at once.
+
+    The first r_stream_create() also initializes the global tables, once.
+    With threads support this is safe from any thread, otherwise the
+    first creation must complete before instances are created concurrently.
+*/
+typedef struct r_stream r_stream_t;
+
+/// Sample formats for r_stream_push_iq().
+enum r_stream_format {
+    R_STREAM_CU8  = 2, ///< interleaved unsigned 8-bit I/Q samples
+    R_STREAM_CS16 = 4, ///< interleaved signed 16-bit I/Q samples
+};
+
+/// A decoded event.
+typedef struct r_stream_event {
+    uint64_t sample_pos;  ///< input sample position of the package start
+    char const *model;    ///< the "model" field, NULL for raw pulse data, valid while data is held
+    struct data *data;    ///< the full event data, owned by the event
+} r_stream_event_t;
+
+/** Callback for decoded events.
+
+    The data is only valid during the callback, use data_retain() to keep it.
+*/
+typedef void (*r_stream_event_fn)(void *ctx, r_stream_event_t const *event);
+
+/** Create a decoder instance with all default decoders enabled.
+
+    @param sample_rate the input sample rate in samples per second
+    @param format the input sample format
+    @return the new instance, NULL on error.
+            You must release this object with r_stream_free once you're done with it.
+*/
+r_stream_t *r_stream_create(uint32_t sample_rate, enum r_stream_format format);
+
+/// Release a decoder instance, pending events are released too.
+void r_stream_free(r_stream_t *stream);
+
+/** Enable or disable decoders, like the "-R" option.
+
+    @param stream the decoder instance
+    @param protocol_num a protocol number to enable, negative to disable, 0 to disable all
+    @param arg optional decoder arguments, may be NULL
+    @return 0 on success, -1 if the protocol number is invalid
+*/
+int r_stream_protocol(r_stream_t *stream, int protocol_num, char *arg);
+
+/** Add a flex decoder, like the "-X" option.
+
+    @param stream the decoder instance
+    @param spec the flex decoder specification
+    @return 0 on success, -1 on error
+*/
+int r_stream_flex(r_stream_t *stream, char *spec);
+
+/** Deliver events to a callback instead of queuing them for r_stream_pull().
+
+    @param stream the decoder instance
+    @param callback the event callback, NULL to queue events
+    @param ctx user context passed to the callback
+*/
+void r_stream_set_callback(r_stream_t *stream, r_stream_event_fn callback, void *ctx);
+
+/** Process I/Q samples.
+
+    The buffer is read in place, no copy is made.
+    Buffers of any length are processed in chunks.
+
+    @param stream the decoder instance
+    @param iq_buf the samples in the format of the instance
+    @param len the buffer length in bytes
+    @return the number of events decoded
+*/
+int r_stream_push_iq(r_stream_t *stream, void const *iq_buf, uint32_t len);
+
+/** Process a pulse train, e.g. from an external demodulator or a pulse file.
+
+    @param stream the decoder instance
+    @param pulses the pulse data, with sample_rate set
+    @param fsk nonzero to run the FSK decoders, the OOK decoders otherwise
+    @return the number of events decoded
+*/
+int r_stream_push_pulses(r_stream_t *stream, struct pulse_data *pulses, int fsk);
+
+/** Pull the next queued event.
+
+    @param stream the decoder instance
+    @param[out] event the event, release with r_stream_event_release()
+    @return 1 if an event was returned, 0 if the queue is empty
+*/
+int r_stream_pull(r_stream_t *stream, r_stream_event_t *event);
+
+/// Release the data of a pulled event.
+void r_stream_event_release(r_stream_event_t *event);
+
+#endif /* INCLUDE_R_STREAM_H_ */
@@ -12,6 +12,7 @@
 #ifndef INCLUDE_R_UTIL_H_
 #define INCLUDE_R_UTIL_H_
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <time.h>
@@ -67,7 +68,7 @@ char *usecs_time_str(char *buf, char const *format, int with_tz, struct timeval
     @param buf output buffer, long enough for "@0.000000s"
     @return buf pointer (for short hand use as operator)
 */
-char *sample_pos_str(float sample_file_pos, char *buf);
+char *sample_pos_str(double sample_file_pos, char *buf);
 
 /** Convert Celsius to Fahrenheit.
 
@@ -158,6 +159,19 @@ bool str_endswith(char const *restrict str, char const *restrict suffix);
 */
 char *str_replace(char const *orig, char const *rep, char const *with);
 
+/** Replace a pattern in a string, writing to a buffer.
+
+    Like str_replace() but does not allocate.
+
+    @param dst the output buffer
+    @param size the size of the output buffer
+    @param orig string to search for patterns
+    @param rep the pattern to replace
+    @param with the replacement pattern
+    @return the length of the result, -1 if the buffer is too small
+*/
+int str_replace_buf(char *dst, size_t size, char const *orig, char const *rep, char const *with);
+
 /** Make a nice printable string for a frequency.
 
     @param freq the frequency to convert to a string.
@@ -15,14 +15,19 @@
 #include <stdint.h>
 
 struct raw_output;
+struct data;
 
 typedef struct raw_output {
     void (*output_frame)(struct raw_output *output, uint8_t const *data, uint32_t len);
+    struct data *(*output_stats)(struct raw_output *output);
     void (*output_free)(struct raw_output *output);
 } raw_output_t;
 
 void raw_output_frame(struct raw_output *output, uint8_t const *data, uint32_t len);
 
+/// Report output statistics, e.g. per-client bandwidth, NULL if not supported.
+struct data *raw_output_stats(struct raw_output *output);
+
 void raw_output_free(struct raw_output *output);
 
 #endif /* INCLUDE_RAW_OUTPUT_H_ */
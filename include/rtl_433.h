@@ -17,10 +17,19 @@
 #define DEFAULT_BUF_LENGTH      (16 * 32 * 512) // librtlsdr default
 #define FSK_PULSE_DETECTOR_LIMIT 800000000
 
+#define LOW_LATENCY_ASYNC_BUF_NUMBER 64 // keep some buffering with small blocks
+#define LOW_LATENCY_BUF_MS      10 // block duration in low-latency mode
+
+#define LOW_POWER_BUF_MS        1000 // coalesced block duration in low-power mode
+#define LOW_POWER_POLL_MS       5000 // event loop and watchdog interval in low-power mode
+#define LOW_POWER_LEVEL_STEP    8 // level estimate from every n-th sample in low-power mode
+#define LOW_POWER_LEVEL_WINDOW  64 // level estimate samples per peak window in low-power mode
+
 #define MINIMAL_BUF_LENGTH      512
 #define MAXIMAL_BUF_LENGTH      (256 * 16384)
 #define SIGNAL_GRABBER_BUFFER   (12 * DEFAULT_BUF_LENGTH)
 #define MAX_FREQS               32
+#define LATENCY_HIST_BINS       1000 // 1 ms bins, the last bin collects everything above
 
 #define INPUT_LINE_MAX 8192 /**< enough for a complete textual bitbuffer (25*256) */
 
@@ -66,10 +75,20 @@ typedef struct r_cfg {
     char *settings_str;
     int ppm_error;
     uint32_t out_block_size;
+    int low_latency; ///< use small input blocks to reduce the event latency
+    int low_power; ///< coalesce input blocks and skip the demodulation of quiet blocks
+    uint8_t *coalesce_buf; ///< low-power mode input blocks, only used by the acquire thread
+    uint32_t coalesce_size; ///< low-power mode buffer size in bytes
+    uint32_t coalesce_target; ///< low-power mode coalesced block size in bytes
+    uint32_t coalesce_len; ///< low-power mode coalesced bytes
+    unsigned coalesce_blocks; ///< low-power mode coalesced input blocks
     char const *test_data;
     list_t in_files;
     char const *in_filename;
     int in_replay;
+    char *checkpoint_file; ///< batch decoding progress of the input files
+    int checkpoint_resume; ///< continue from the checkpoint file
+    int checkpoint_interval; ///< seconds between checkpoints
     volatile sig_atomic_t hop_now;
     volatile sig_atomic_t exit_async;
     volatile sig_atomic_t exit_code; ///< 0=no err, 1=params or cmd line err, 2=sdr device read error, 3=usb init error, 5=USB error (reset), other=other error
@@ -94,6 +113,7 @@ typedef struct r_cfg {
     int verbose_bits;
     conversion_mode_t conversion_mode;
     int report_meta;
+    int report_latency;
     int report_noise;
     int report_protocol;
     time_mode_t report_time;
@@ -110,7 +130,13 @@ typedef struct r_cfg {
     uint16_t num_r_devices;
     list_t data_tags;
     list_t output_handler;
+    list_t aggregate_outputs; ///< aggregating outputs (owned by output_handler) to poll for window ends
+    list_t sched_outputs; ///< rate-limited outputs (owned by output_handler) to poll for the backlog
+    list_t sched_rules; ///< priority classes of models for the rate-limited outputs
     list_t raw_handler;
+    struct pulse_cluster *pulse_cluster; ///< background clustering of undecoded packages
+    struct rx_merge *rx_merge; ///< merging of events from other receivers, instead of an SDR
+    struct spectrum *spectrum; ///< power spectrum telemetry
     int has_logout;
     struct dm_state *demod;
     char const *sr_filename;
@@ -121,6 +147,13 @@ typedef struct r_cfg {
     unsigned frames_count; ///< stats counter for interval
     unsigned frames_fsk; ///< stats counter for interval
     unsigned frames_events; ///< stats counter for interval
+    unsigned latency_count; ///< stats counter for interval
+    unsigned latency_hist[LATENCY_HIST_BINS]; ///< stats histogram for interval, air-to-output latency in ms
+    unsigned loop_wakeups; ///< stats counter for interval, event loop wake-ups
+    unsigned input_wakeups; ///< stats counter for interval, sample blocks delivered to the event loop
+    unsigned input_blocks; ///< stats counter for interval, input blocks read
+    unsigned frames_quiet; ///< stats counter for interval, sample blocks with only a level estimate
+    double cpu_since; ///< stats start, process cpu time in seconds
     struct mg_mgr *mgr;
 } r_cfg_t;
 
@@ -0,0 +1,79 @@
+/** @file
+    Merge the events of multiple receivers.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_RX_MERGE_H_
+#define INCLUDE_RX_MERGE_H_
+
+#include "data.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct rx_merge rx_merge_t;
+
+/// Callback for merged events, the callback takes ownership of the data.
+typedef void (*rx_merge_emit_fn)(void *ctx, data_t *data);
+
+/// Create a merger for the events of multiple receivers.
+///
+/// Copies of an event heard by several receivers are matched by a hash of
+/// the model, id, and payload fields within a time window from the first copy.
+/// The table is sharded, each shard has its own lock, receiving threads
+/// only contend when they insert into the same shard.
+///
+/// @param window_ms the time window to collect copies of an event
+/// @return the new merger, NULL on error.
+///         You must release this object with rx_merge_free once you're done with it.
+rx_merge_t *rx_merge_create(int window_ms);
+
+/// Stop the receiving threads and release all pending events.
+void rx_merge_free(rx_merge_t *m);
+
+/// Receive events on a UDP port, as sent by "-F syslog" or as JSON lines.
+///
+/// Only available if threads are enabled. With more than one thread each
+/// thread has its own socket on the port (needs SO_REUSEPORT).
+///
+/// @param m the merger
+/// @param host the address to bind to
+/// @param port the port to bind to
+/// @param threads the number of receiving threads
+/// @return 0 on success, -1 on error
+int rx_merge_listen(rx_merge_t *m, char const *host, char const *port, int threads);
+
+/// Add a message with one or more events, may be called from any thread.
+///
+/// The message is a JSON object per line, optionally with a RFC 5424 syslog header.
+/// Events without a model (logs, stats) are ignored.
+///
+/// @param m the merger
+/// @param msg the message, need not be terminated
+/// @param len the message length
+/// @param source the receiver name if there is no syslog hostname
+/// @param now_ms the arrival time in ms
+void rx_merge_ingest(rx_merge_t *m, char const *msg, size_t len, char const *source, uint64_t now_ms);
+
+/// Emit all events whose time window has passed.
+///
+/// Each merged event has the fields of the first copy, the earliest time,
+/// the RSSI and SNR of the receiver with the best SNR, and a list of all
+/// receivers with their RSSI, SNR, and time.
+///
+/// @param m the merger
+/// @param now_ms the current time in ms, 0 to emit all pending events
+/// @param emit the merged event callback
+/// @param ctx the callback context
+/// @return the number of merged events
+int rx_merge_poll(rx_merge_t *m, uint64_t now_ms, rx_merge_emit_fn emit, void *ctx);
+
+/// Report the counts of received, merged, late, and dropped events.
+data_t *rx_merge_stats(rx_merge_t *m);
+
+#endif /* INCLUDE_RX_MERGE_H_ */
@@ -37,4 +37,13 @@ void samp_grab_reset(samp_grab_t *g);
 /// grab_end is counted in samples from end of buf.
 void samp_grab_write(samp_grab_t *g, unsigned grab_len, unsigned grab_end);
 
+/// Copy a window of the ring, e.g. for a snapshot.
+///
+/// @param g the sample grabber
+/// @param buf the destination, at least len bytes
+/// @param len the window length in bytes
+/// @param end_len the window end in bytes back from the newest byte
+/// @return the number of bytes copied, less than len if the ring holds less
+unsigned samp_grab_copy(samp_grab_t *g, unsigned char *buf, unsigned len, unsigned end_len);
+
 #endif /* INCLUDE_SAMP_GRAB_H_ */
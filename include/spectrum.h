@@ -0,0 +1,54 @@
+/** @file
+    Spectrum and noise floor telemetry from the IQ input.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_SPECTRUM_H_
+#define INCLUDE_SPECTRUM_H_
+
+#include <stdint.h>
+
+#define SPECTRUM_FFT_SIZE 1024
+#define SPECTRUM_BINS     128
+#define SPECTRUM_DEFAULT_INTERVAL_MS 100
+
+struct timeval;
+struct data;
+
+typedef struct spectrum spectrum_t;
+
+/// Create a spectrum averager.
+///
+/// @param fft_size the FFT length, a power of two
+/// @param bins the number of output bins, a power of two not above the FFT length
+/// @param interval_ms the minimum time between two FFTs
+/// @return the new spectrum, NULL on error.
+///         You must release this object with spectrum_free once you're done with it.
+spectrum_t *spectrum_create(unsigned fft_size, unsigned bins, unsigned interval_ms);
+
+void spectrum_free(spectrum_t *spec);
+
+/// Feed an IQ block, an FFT is only computed if the interval has passed.
+///
+/// @param spec the spectrum
+/// @param iq_buf the IQ samples, CU8 or CS16
+/// @param n_samples the number of IQ samples
+/// @param sample_size 2 for CU8, 4 for CS16
+/// @param center_frequency the tuned frequency, a change restarts the average
+/// @param sample_rate the sample rate, a change restarts the average
+/// @param now the time of the block
+/// @return 1 if an FFT was computed, 0 otherwise
+int spectrum_push(spectrum_t *spec, uint8_t const *iq_buf, unsigned n_samples, int sample_size, uint32_t center_frequency, uint32_t sample_rate, struct timeval const *now);
+
+/// Report the averaged spectrum, the noise floor, the peak, and the measured FFT load.
+///
+/// @return the spectrum data, NULL if no FFT was computed yet
+struct data *spectrum_data(spectrum_t *spec);
+
+#endif /* INCLUDE_SPECTRUM_H_ */
@@ -0,0 +1,159 @@
+/** @file
+    Allocation tracking by pipeline stage and decoder.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+/*
+The build links with "-Wl,--wrap=malloc" (and calloc, realloc, free, strdup),
+the linker then resolves our calls to the allocator to the __wrap_ functions,
+which count and pass on to the __real_ functions. Sizes are the usable sizes
+reported by the allocator, so allocated and freed bytes match up.
+
+The stage and decoder are per thread, counts are atomic.
+*/
+
+#include "alloc_stats.h"
+
+#ifdef ALLOC_STATS
+
+#include "r_device.h"
+#include "data.h"
+
+#include <stddef.h>
+#include <malloc.h>
+
+typedef struct alloc_counts {
+    unsigned long allocs;
+    unsigned long frees;
+    unsigned long bytes;
+    unsigned long freed_bytes;
+} alloc_counts_t;
+
+static alloc_counts_t alloc_counts[ALLOC_STAGE_COUNT];
+
+static __thread int current_stage;
+static __thread r_device *current_decoder;
+
+alloc_scope_t alloc_stats_enter(int stage, r_device *decoder)
+{
+    alloc_scope_t prev = {current_stage, current_decoder};
+    current_stage      = stage;
+    current_decoder    = decoder;
+    return prev;
+}
+
+void alloc_stats_leave(alloc_scope_t prev)
+{
+    current_stage   = prev.stage;
+    current_decoder = prev.decoder;
+}
+
+static void count_alloc(void *ptr)
+{
+    if (!ptr)
+        return;
+    size_t size       = malloc_usable_size(ptr);
+    alloc_counts_t *c = &alloc_counts[current_stage];
+    __atomic_fetch_add(&c->allocs, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&c->bytes, size, __ATOMIC_RELAXED);
+    if (current_decoder) {
+        current_decoder->decode_allocs += 1;
+        current_decoder->decode_alloc_bytes += size;
+    }
+}
+
+static void count_free(size_t size)
+{
+    alloc_counts_t *c = &alloc_counts[current_stage];
+    __atomic_fetch_add(&c->frees, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&c->freed_bytes, size, __ATOMIC_RELAXED);
+}
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+char *__real_strdup(char const *s);
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t nmemb, size_t size);
+void *__wrap_realloc(void *ptr, size_t size);
+void __wrap_free(void *ptr);
+char *__wrap_strdup(char const *s);
+
+void *__wrap_malloc(size_t size)
+{
+    void *ptr = __real_malloc(size);
+    count_alloc(ptr);
+    return ptr;
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    void *ptr = __real_calloc(nmemb, size);
+    count_alloc(ptr);
+    return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    size_t old_size = ptr ? malloc_usable_size(ptr) : 0;
+    void *ret       = __real_realloc(ptr, size);
+    if (ptr && (ret || !size))
+        count_free(old_size);
+    count_alloc(ret);
+    return ret;
+}
+
+void __wrap_free(void *ptr)
+{
+    if (ptr)
+        count_free(malloc_usable_size(ptr));
+    __real_free(ptr);
+}
+
+char *__wrap_strdup(char const *s)
+{
+    char *ptr = __real_strdup(s);
+    count_alloc(ptr);
+    return ptr;
+}
+
+data_t *alloc_stats_data(void)
+{
+    static char const *const stage_names[ALLOC_STAGE_COUNT] = {"other", "demod", "decode", "output"};
+
+    data_t *data = NULL;
+    for (int i = 0; i < ALLOC_STAGE_COUNT; ++i) {
+        alloc_counts_t *c = &alloc_counts[i];
+        /* clang-format off */
+        data = data_append(data,
+                stage_names[i], "", DATA_DATA, data_make(
+                        "allocs",       "", DATA_INT, (int)__atomic_load_n(&c->allocs, __ATOMIC_RELAXED),
+                        "frees",        "", DATA_INT, (int)__atomic_load_n(&c->frees, __ATOMIC_RELAXED),
+                        "bytes",        "", DATA_INT, (int)__atomic_load_n(&c->bytes, __ATOMIC_RELAXED),
+                        "freed_bytes",  "", DATA_INT, (int)__atomic_load_n(&c->freed_bytes, __ATOMIC_RELAXED),
+                        NULL),
+                NULL);
+        /* clang-format on */
+    }
+    return data;
+}
+
+void alloc_stats_reset(void)
+{
+    for (int i = 0; i < ALLOC_STAGE_COUNT; ++i) {
+        alloc_counts_t *c = &alloc_counts[i];
+        __atomic_store_n(&c->allocs, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&c->frees, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&c->bytes, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&c->freed_bytes, 0, __ATOMIC_RELAXED);
+    }
+}
+
+#endif /* ALLOC_STATS */
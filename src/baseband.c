@@ -18,6 +18,30 @@
 
 #include "logger.h"
 #include "r_util.h"
+#include "kernels.h"
+#include "compat_pthread.h"
+
+// Kernel variants are the generic code compiled for a newer instruction set,
+// the compiler vectorizes the loops, the output is the same.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BASEBAND_AVX2 __attribute__((target("avx2")))
+#endif
+// NEON is not IEEE compliant, only the integer loops are vectorized.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 7 && defined(__arm__) && defined(__linux__) && !defined(__ARM_NEON)
+#define BASEBAND_NEON __attribute__((target("fpu=neon")))
+#endif
+
+#if defined(__GNUC__)
+#define KERNEL_BODY static inline __attribute__((always_inline))
+#else
+#define KERNEL_BODY static inline
+#endif
+
+typedef void (*demod_FM_fn)(uint8_t const *x_buf, int16_t *y_buf, unsigned long num_samples, demodfm_state_t *state);
+typedef void (*demod_FM_cs16_fn)(int16_t const *x_buf, int16_t *y_buf, unsigned long num_samples, demodfm_state_t *state);
+
+static kernel_t demod_FM_kernel;
+static kernel_t demod_FM_cs16_kernel;
 
 static uint16_t scaled_squares[256];
 
@@ -33,7 +57,7 @@ static void calc_squares(void)
 
 // This will give a noisy envelope of OOK/ASK signals.
 // Subtract the bias (-128) and get an envelope estimation.
-float envelope_detect(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+static float envelope_detect_lut(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
 {
     unsigned long i;
     uint32_t sum = 0;
@@ -44,10 +68,7 @@ float envelope_detect(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
     return len > 0 && sum >= len ? AMP_TO_DB((float)sum / len) : AMP_TO_DB(1);
 }
 
-/// This will give a noisy envelope of OOK/ASK signals.
-/// Subtracts the bias (-128) and calculates the norm (scaled by 16384).
-/// Using a LUT is slower for O1 and above.
-float envelope_detect_nolut(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+KERNEL_BODY float envelope_detect_body(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
 {
     unsigned long i;
     uint32_t sum = 0;
@@ -60,9 +81,17 @@ float envelope_detect_nolut(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len
     return len > 0 && sum >= len ? AMP_TO_DB((float)sum / len) : AMP_TO_DB(1);
 }
 
+/// This will give a noisy envelope of OOK/ASK signals.
+/// Subtracts the bias (-128) and calculates the norm (scaled by 16384).
+/// Using a LUT is slower for O1 and above.
+float envelope_detect_nolut(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    return envelope_detect_body(iq_buf, y_buf, len);
+}
+
 /// 122/128, 51/128 Magnitude Estimator for CU8 (SIMD has min/max).
 /// Note that magnitude emphasizes quiet signals / deemphasizes loud signals.
-float magnitude_est_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+KERNEL_BODY float magnitude_est_cu8_body(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
 {
     unsigned long i;
     uint32_t sum = 0;
@@ -78,6 +107,11 @@ float magnitude_est_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
     return len > 0 && sum >= len ? MAG_TO_DB((float)sum / len) : MAG_TO_DB(1);
 }
 
+static float magnitude_est_cu8_generic(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    return magnitude_est_cu8_body(iq_buf, y_buf, len);
+}
+
 /// True Magnitude for CU8 (sqrt can SIMD but float is slow).
 float magnitude_true_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
 {
@@ -93,7 +127,7 @@ float magnitude_true_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
 }
 
 /// 122/128, 51/128 Magnitude Estimator for CS16 (SIMD has min/max).
-float magnitude_est_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+KERNEL_BODY float magnitude_est_cs16_body(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
 {
     unsigned long i;
     uint32_t sum = 0;
@@ -109,6 +143,88 @@ float magnitude_est_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
     return len > 0 && sum >= len ? MAG_TO_DB((float)sum / len) : MAG_TO_DB(1);
 }
 
+static float magnitude_est_cs16_generic(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    return magnitude_est_cs16_body(iq_buf, y_buf, len);
+}
+
+/// The sum of the used samples and the highest sum of any full window.
+typedef struct level_sums {
+    uint64_t sum;
+    uint32_t count;
+    uint32_t peak;
+} level_sums_t;
+
+static void level_add(level_sums_t *s, uint32_t *win_sum, unsigned *win_count, unsigned window, uint32_t v)
+{
+    s->sum += v;
+    s->count++;
+    *win_sum += v;
+    if (++*win_count >= window) {
+        if (*win_sum > s->peak)
+            s->peak = *win_sum;
+        *win_sum   = 0;
+        *win_count = 0;
+    }
+}
+
+float level_estimate_cu8(uint8_t const *iq_buf, uint32_t len, unsigned step, unsigned window, int use_mag, float *peak_db)
+{
+    level_sums_t s = {0};
+    uint32_t win_sum   = 0;
+    unsigned win_count = 0;
+    if (step < 1)
+        step = 1;
+    if (window < 1)
+        window = 1;
+    for (uint32_t i = 0; i < len; i += step) {
+        if (use_mag) {
+            uint16_t x  = abs(iq_buf[2 * i] - 128);
+            uint16_t y  = abs(iq_buf[2 * i + 1] - 128);
+            uint16_t mi = x < y ? x : y;
+            uint16_t mx = x > y ? x : y;
+            level_add(&s, &win_sum, &win_count, window, 122 * mx + 51 * mi);
+        }
+        else {
+            int16_t x = 127 - iq_buf[2 * i];
+            int16_t y = 127 - iq_buf[2 * i + 1];
+            level_add(&s, &win_sum, &win_count, window, x * x + y * y);
+        }
+    }
+    // short blocks have no full window
+    float peak = s.peak ? (float)s.peak / window : s.count ? (float)s.sum / s.count : 0.0f;
+    float avg  = s.count ? (float)s.sum / s.count : 0.0f;
+    if (use_mag) {
+        *peak_db = peak >= 1.0f ? MAG_TO_DB(peak) : MAG_TO_DB(1);
+        return avg >= 1.0f ? MAG_TO_DB(avg) : MAG_TO_DB(1);
+    }
+    *peak_db = peak >= 1.0f ? AMP_TO_DB(peak) : AMP_TO_DB(1);
+    return avg >= 1.0f ? AMP_TO_DB(avg) : AMP_TO_DB(1);
+}
+
+float level_estimate_cs16(int16_t const *iq_buf, uint32_t len, unsigned step, unsigned window, float *peak_db)
+{
+    level_sums_t s = {0};
+    uint32_t win_sum   = 0;
+    unsigned win_count = 0;
+    if (step < 1)
+        step = 1;
+    if (window < 1)
+        window = 1;
+    for (uint32_t i = 0; i < len; i += step) {
+        uint32_t x  = abs(iq_buf[2 * i]);
+        uint32_t y  = abs(iq_buf[2 * i + 1]);
+        uint32_t mi = x < y ? x : y;
+        uint32_t mx = x > y ? x : y;
+        level_add(&s, &win_sum, &win_count, window, (122 * mx + 51 * mi) >> 8);
+    }
+    // short blocks have no full window
+    float peak = s.peak ? (float)s.peak / window : s.count ? (float)s.sum / s.count : 0.0f;
+    float avg  = s.count ? (float)s.sum / s.count : 0.0f;
+    *peak_db   = peak >= 1.0f ? MAG_TO_DB(peak) : MAG_TO_DB(1);
+    return avg >= 1.0f ? MAG_TO_DB(avg) : MAG_TO_DB(1);
+}
+
 /// True Magnitude for CS16 (sqrt can SIMD but float is slow).
 float magnitude_true_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
 {
@@ -138,7 +254,7 @@ float magnitude_true_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
     - but the b coeffs are small so it won't happen
     - Q15.14>>14 = Q15.0
 */
-void baseband_low_pass_filter(uint16_t const *x_buf, int16_t *y_buf, uint32_t len, filter_state_t *state)
+static void low_pass_filter_generic(uint16_t const *x_buf, int16_t *y_buf, uint32_t len, filter_state_t *state)
 {
     ///  [b,a] = butter(1, 0.01) -> 3x tau (95%) ~100 samples
     //static int const a[FILTER_ORDER + 1] = {FIX(1.00000) >> 1, FIX(0.96907) >> 1};
@@ -221,6 +337,12 @@ void baseband_demod_FM(uint8_t const *x_buf, int16_t *y_buf, unsigned long num_s
         state->blp_16[1] = FIX(gain);
         state->rate      = samp_rate;
     }
+    ((demod_FM_fn)demod_FM_kernel.fn)(x_buf, y_buf, num_samples, state);
+}
+
+/// Fast Instantaneous frequency and Low Pass filter, CU8 samples, the filter coeffs are set.
+static void demod_FM_generic(uint8_t const *x_buf, int16_t *y_buf, unsigned long num_samples, demodfm_state_t *state)
+{
     int32_t const *alp = state->alp_16;
     int32_t const *blp = state->blp_16;
 
@@ -314,6 +436,12 @@ void baseband_demod_FM_cs16(int16_t const *x_buf, int16_t *y_buf, unsigned long
         state->blp_32[1] = FIX32(gain);
         state->rate      = samp_rate;
     }
+    ((demod_FM_cs16_fn)demod_FM_cs16_kernel.fn)(x_buf, y_buf, num_samples, state);
+}
+
+/// Fast Instantaneous frequency and Low Pass filter, CS16 samples, the filter coeffs are set.
+static void demod_FM_cs16_generic(int16_t const *x_buf, int16_t *y_buf, unsigned long num_samples, demodfm_state_t *state)
+{
     int64_t const *alp = state->alp_32;
     int64_t const *blp = state->blp_32;
 
@@ -356,7 +484,415 @@ void baseband_demod_FM_cs16(int16_t const *x_buf, int16_t *y_buf, unsigned long
     state->yf = y0f;
 }
 
-void baseband_init(void)
+void baseband_decimator_init(decimator_state_t *state, unsigned factor)
+{
+    memset(state, 0, sizeof(*state));
+    if (factor < 1)
+        factor = 1;
+    if (factor > DECIMATOR_MAX_FACTOR)
+        factor = DECIMATOR_MAX_FACTOR;
+    state->factor = factor;
+    if (factor == 1)
+        return; // pass-through
+
+    // Hamming windowed sinc, cutoff at 0.8 of the output Nyquist frequency
+    unsigned taps = 8 * factor + 1;
+    double fc     = 0.4 / factor;
+    double h[DECIMATOR_MAX_TAPS];
+    double sum = 0.0;
+    for (unsigned n = 0; n < taps; ++n) {
+        double m = n - (taps - 1) / 2.0;
+        double s = m == 0.0 ? 2.0 * fc : sin(2.0 * M_PI * fc * m) / (M_PI * m);
+        double w = 0.54 - 0.46 * cos(2.0 * M_PI * n / (taps - 1));
+        h[n]     = s * w;
+        sum += h[n];
+    }
+    // normalize to unity gain at DC
+    for (unsigned n = 0; n < taps; ++n) {
+        state->coef[n] = (int16_t)lrint(h[n] / sum * 32768.0);
+    }
+    state->taps = taps;
+}
+
+unsigned long baseband_decimate_cu8(uint8_t const *x_buf, uint8_t *y_buf, unsigned long num_samples, decimator_state_t *state)
+{
+    unsigned const factor = state->factor;
+    unsigned const taps   = state->taps;
+    unsigned phase        = state->phase;
+    unsigned pos          = state->pos;
+    unsigned long out     = 0;
+
+    if (factor <= 1) {
+        if (y_buf != x_buf)
+            memmove(y_buf, x_buf, num_samples * 2);
+        return num_samples;
+    }
+
+    for (unsigned long i = 0; i < num_samples; ++i) {
+        // The delay line is stored twice to always have a contiguous window
+        int16_t xi = x_buf[2 * i] - 128;
+        int16_t xq = x_buf[2 * i + 1] - 128;
+        state->hist_i[pos] = state->hist_i[pos + taps] = xi;
+        state->hist_q[pos] = state->hist_q[pos + taps] = xq;
+        pos = pos + 1 < taps ? pos + 1 : 0;
+
+        if (++phase < factor)
+            continue;
+        phase = 0;
+
+        // the window, oldest first, starts at pos; the filter is symmetric
+        int16_t const *hi = &state->hist_i[pos];
+        int16_t const *hq = &state->hist_q[pos];
+        int32_t acc_i = 1 << 14; // rounding
+        int32_t acc_q = 1 << 14; // rounding
+        for (unsigned n = 0; n < taps; ++n) {
+            acc_i += state->coef[n] * hi[n];
+            acc_q += state->coef[n] * hq[n];
+        }
+        acc_i >>= 15;
+        acc_q >>= 15;
+        acc_i = acc_i < -128 ? -128 : acc_i > 127 ? 127 : acc_i;
+        acc_q = acc_q < -128 ? -128 : acc_q > 127 ? 127 : acc_q;
+        // output never overtakes input, in-place operation is safe
+        y_buf[2 * out]     = (uint8_t)(acc_i + 128);
+        y_buf[2 * out + 1] = (uint8_t)(acc_q + 128);
+        out++;
+    }
+
+    state->phase = phase;
+    state->pos   = pos;
+    return out;
+}
+
+KERNEL_BODY void convert_cu8_cf32_body(uint8_t const *x_buf, float *y_buf, unsigned long num_samples)
+{
+    for (unsigned long n = 0; n < num_samples * 2; ++n)
+        y_buf[n] = (x_buf[n] - 128) / 128.0f;
+}
+
+static void convert_cu8_cf32_generic(uint8_t const *x_buf, float *y_buf, unsigned long num_samples)
+{
+    convert_cu8_cf32_body(x_buf, y_buf, num_samples);
+}
+
+KERNEL_BODY void convert_cs16_cf32_body(int16_t const *x_buf, float *y_buf, unsigned long num_samples)
+{
+    for (unsigned long n = 0; n < num_samples * 2; ++n)
+        y_buf[n] = x_buf[n] / 32768.0f;
+}
+
+static void convert_cs16_cf32_generic(int16_t const *x_buf, float *y_buf, unsigned long num_samples)
+{
+    convert_cs16_cf32_body(x_buf, y_buf, num_samples);
+}
+
+KERNEL_BODY void convert_s16_f32_body(int16_t const *x_buf, float *y_buf, unsigned long num_samples)
+{
+    for (unsigned long n = 0; n < num_samples; ++n)
+        y_buf[n] = x_buf[n] * (1.0f / 0x8000); // scale from Q0.15
+}
+
+static void convert_s16_f32_generic(int16_t const *x_buf, float *y_buf, unsigned long num_samples)
+{
+    convert_s16_f32_body(x_buf, y_buf, num_samples);
+}
+
+/* Kernel variants */
+
+#ifdef BASEBAND_AVX2
+BASEBAND_AVX2 static float envelope_detect_avx2(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    return envelope_detect_body(iq_buf, y_buf, len);
+}
+
+BASEBAND_AVX2 static float magnitude_est_cu8_avx2(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    return magnitude_est_cu8_body(iq_buf, y_buf, len);
+}
+
+BASEBAND_AVX2 static float magnitude_est_cs16_avx2(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    return magnitude_est_cs16_body(iq_buf, y_buf, len);
+}
+
+BASEBAND_AVX2 static void convert_cu8_cf32_avx2(uint8_t const *x_buf, float *y_buf, unsigned long num_samples)
+{
+    convert_cu8_cf32_body(x_buf, y_buf, num_samples);
+}
+
+BASEBAND_AVX2 static void convert_cs16_cf32_avx2(int16_t const *x_buf, float *y_buf, unsigned long num_samples)
+{
+    convert_cs16_cf32_body(x_buf, y_buf, num_samples);
+}
+
+BASEBAND_AVX2 static void convert_s16_f32_avx2(int16_t const *x_buf, float *y_buf, unsigned long num_samples)
+{
+    convert_s16_f32_body(x_buf, y_buf, num_samples);
+}
+#endif
+
+#ifdef BASEBAND_NEON
+BASEBAND_NEON static float envelope_detect_neon(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    return envelope_detect_body(iq_buf, y_buf, len);
+}
+
+BASEBAND_NEON static float magnitude_est_cu8_neon(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    return magnitude_est_cu8_body(iq_buf, y_buf, len);
+}
+
+BASEBAND_NEON static float magnitude_est_cs16_neon(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    return magnitude_est_cs16_body(iq_buf, y_buf, len);
+}
+#endif
+
+/* Kernels, the run functions call a variant with fresh state for the benchmark and check */
+
+typedef float (*envelope_cu8_fn)(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len);
+typedef float (*envelope_cs16_fn)(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len);
+typedef void (*low_pass_filter_fn)(uint16_t const *x_buf, int16_t *y_buf, uint32_t len, filter_state_t *state);
+typedef void (*convert_cu8_fn)(uint8_t const *x_buf, float *y_buf, unsigned long num_samples);
+typedef void (*convert_s16_fn)(int16_t const *x_buf, float *y_buf, unsigned long num_samples);
+
+static void run_envelope_cu8(kernel_fn fn, void const *in, void *out, unsigned len)
+{
+    ((envelope_cu8_fn)fn)(in, out, len);
+}
+
+static void run_envelope_cs16(kernel_fn fn, void const *in, void *out, unsigned len)
+{
+    ((envelope_cs16_fn)fn)(in, out, len);
+}
+
+static void run_low_pass_filter(kernel_fn fn, void const *in, void *out, unsigned len)
+{
+    filter_state_t state = {{0}, {0}};
+    ((low_pass_filter_fn)fn)(in, out, len, &state);
+}
+
+static void run_demod_FM(kernel_fn fn, void const *in, void *out, unsigned len)
+{
+    // [b,a] = butter(1, 0.1), prescaled by div 2
+    demodfm_state_t state = {0};
+    state.alp_16[1] = FIX(0.36327);
+    state.blp_16[0] = state.blp_16[1] = FIX(0.068365);
+    ((demod_FM_fn)fn)(in, out, len, &state);
+}
+
+static void run_demod_FM_cs16(kernel_fn fn, void const *in, void *out, unsigned len)
+{
+    // [b,a] = butter(1, 0.1)
+    demodfm_state_t state = {0};
+    state.alp_32[1] = FIX32(0.72654);
+    state.blp_32[0] = state.blp_32[1] = FIX32(0.13673);
+    ((demod_FM_cs16_fn)fn)(in, out, len, &state);
+}
+
+static void run_convert_cu8(kernel_fn fn, void const *in, void *out, unsigned len)
+{
+    ((convert_cu8_fn)fn)(in, out, len);
+}
+
+static void run_convert_s16(kernel_fn fn, void const *in, void *out, unsigned len)
+{
+    ((convert_s16_fn)fn)(in, out, len);
+}
+
+static kernel_t envelope_detect_kernel = {
+        .name     = "envelope_detect",
+        .in_size  = 2,
+        .out_size = 2,
+        .run      = run_envelope_cu8,
+        .variants = {
+                {"lut", 0, (kernel_fn)envelope_detect_lut},
+                {"generic", 0, (kernel_fn)envelope_detect_nolut},
+#ifdef BASEBAND_AVX2
+                {"avx2", KERNEL_AVX2, (kernel_fn)envelope_detect_avx2},
+#endif
+#ifdef BASEBAND_NEON
+                {"neon", KERNEL_NEON, (kernel_fn)envelope_detect_neon},
+#endif
+        },
+        .fn = (kernel_fn)envelope_detect_lut,
+};
+
+static kernel_t magnitude_est_cu8_kernel = {
+        .name     = "magnitude_est_cu8",
+        .in_size  = 2,
+        .out_size = 2,
+        .run      = run_envelope_cu8,
+        .variants = {
+                {"generic", 0, (kernel_fn)magnitude_est_cu8_generic},
+#ifdef BASEBAND_AVX2
+                {"avx2", KERNEL_AVX2, (kernel_fn)magnitude_est_cu8_avx2},
+#endif
+#ifdef BASEBAND_NEON
+                {"neon", KERNEL_NEON, (kernel_fn)magnitude_est_cu8_neon},
+#endif
+        },
+        .fn = (kernel_fn)magnitude_est_cu8_generic,
+};
+
+static kernel_t magnitude_est_cs16_kernel = {
+        .name     = "magnitude_est_cs16",
+        .in_size  = 4,
+        .out_size = 2,
+        .run      = run_envelope_cs16,
+        .variants = {
+                {"generic", 0, (kernel_fn)magnitude_est_cs16_generic},
+#ifdef BASEBAND_AVX2
+                {"avx2", KERNEL_AVX2, (kernel_fn)magnitude_est_cs16_avx2},
+#endif
+#ifdef BASEBAND_NEON
+                {"neon", KERNEL_NEON, (kernel_fn)magnitude_est_cs16_neon},
+#endif
+        },
+        .fn = (kernel_fn)magnitude_est_cs16_generic,
+};
+
+// the IIR filters are recursive and have no vectorized variants yet
+static kernel_t low_pass_filter_kernel = {
+        .name     = "baseband_low_pass_filter",
+        .in_size  = 2,
+        .out_size = 2,
+        .run      = run_low_pass_filter,
+        .variants = {
+                {"generic", 0, (kernel_fn)low_pass_filter_generic},
+        },
+        .fn = (kernel_fn)low_pass_filter_generic,
+};
+
+static kernel_t demod_FM_kernel = {
+        .name     = "baseband_demod_FM",
+        .in_size  = 2,
+        .out_size = 2,
+        .run      = run_demod_FM,
+        .variants = {
+                {"generic", 0, (kernel_fn)demod_FM_generic},
+        },
+        .fn = (kernel_fn)demod_FM_generic,
+};
+
+static kernel_t demod_FM_cs16_kernel = {
+        .name     = "baseband_demod_FM_cs16",
+        .in_size  = 4,
+        .out_size = 2,
+        .run      = run_demod_FM_cs16,
+        .variants = {
+                {"generic", 0, (kernel_fn)demod_FM_cs16_generic},
+        },
+        .fn = (kernel_fn)demod_FM_cs16_generic,
+};
+
+static kernel_t convert_cu8_cf32_kernel = {
+        .name     = "baseband_convert_cu8_cf32",
+        .in_size  = 2,
+        .out_size = 8,
+        .run      = run_convert_cu8,
+        .variants = {
+                {"generic", 0, (kernel_fn)convert_cu8_cf32_generic},
+#ifdef BASEBAND_AVX2
+                {"avx2", KERNEL_AVX2, (kernel_fn)convert_cu8_cf32_avx2},
+#endif
+        },
+        .fn = (kernel_fn)convert_cu8_cf32_generic,
+};
+
+static kernel_t convert_cs16_cf32_kernel = {
+        .name     = "baseband_convert_cs16_cf32",
+        .in_size  = 4,
+        .out_size = 8,
+        .run      = run_convert_s16,
+        .variants = {
+                {"generic", 0, (kernel_fn)convert_cs16_cf32_generic},
+#ifdef BASEBAND_AVX2
+                {"avx2", KERNEL_AVX2, (kernel_fn)convert_cs16_cf32_avx2},
+#endif
+        },
+        .fn = (kernel_fn)convert_cs16_cf32_generic,
+};
+
+static kernel_t convert_s16_f32_kernel = {
+        .name     = "baseband_convert_s16_f32",
+        .in_size  = 2,
+        .out_size = 4,
+        .run      = run_convert_s16,
+        .variants = {
+                {"generic", 0, (kernel_fn)convert_s16_f32_generic},
+#ifdef BASEBAND_AVX2
+                {"avx2", KERNEL_AVX2, (kernel_fn)convert_s16_f32_avx2},
+#endif
+        },
+        .fn = (kernel_fn)convert_s16_f32_generic,
+};
+
+/* Public functions, calling the selected variant */
+
+float envelope_detect(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    return ((envelope_cu8_fn)envelope_detect_kernel.fn)(iq_buf, y_buf, len);
+}
+
+float magnitude_est_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    return ((envelope_cu8_fn)magnitude_est_cu8_kernel.fn)(iq_buf, y_buf, len);
+}
+
+float magnitude_est_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    return ((envelope_cs16_fn)magnitude_est_cs16_kernel.fn)(iq_buf, y_buf, len);
+}
+
+void baseband_low_pass_filter(uint16_t const *x_buf, int16_t *y_buf, uint32_t len, filter_state_t *state)
+{
+    ((low_pass_filter_fn)low_pass_filter_kernel.fn)(x_buf, y_buf, len, state);
+}
+
+void baseband_convert_cu8_cf32(uint8_t const *x_buf, float *y_buf, unsigned long num_samples)
+{
+    ((convert_cu8_fn)convert_cu8_cf32_kernel.fn)(x_buf, y_buf, num_samples);
+}
+
+void baseband_convert_cs16_cf32(int16_t const *x_buf, float *y_buf, unsigned long num_samples)
+{
+    ((convert_s16_fn)convert_cs16_cf32_kernel.fn)(x_buf, y_buf, num_samples);
+}
+
+void baseband_convert_s16_f32(int16_t const *x_buf, float *y_buf, unsigned long num_samples)
+{
+    ((convert_s16_fn)convert_s16_f32_kernel.fn)(x_buf, y_buf, num_samples);
+}
+
+static void baseband_init_once(void)
 {
     calc_squares();
+
+    kernels_register(&envelope_detect_kernel);
+    kernels_register(&magnitude_est_cu8_kernel);
+    kernels_register(&magnitude_est_cs16_kernel);
+    kernels_register(&low_pass_filter_kernel);
+    kernels_register(&demod_FM_kernel);
+    kernels_register(&demod_FM_cs16_kernel);
+    kernels_register(&convert_cu8_cf32_kernel);
+    kernels_register(&convert_cs16_cf32_kernel);
+    kernels_register(&convert_s16_f32_kernel);
+}
+
+#ifdef THREADS
+static pthread_once_t baseband_once = PTHREAD_ONCE_INIT;
+#endif
+
+void baseband_init(void)
+{
+#ifdef THREADS
+    pthread_once(&baseband_once, baseband_init_once);
+#else
+    static int initialized;
+    if (!initialized) {
+        initialized = 1;
+        baseband_init_once();
+    }
+#endif
 }
@@ -128,6 +128,34 @@ void bitbuffer_add_sync(bitbuffer_t *bits)
     bits->syncs_before_row[bits->num_rows - 1]++;
 }
 
+/// Load 8 bytes as a word, the first bit of the row is the MSB.
+static inline uint64_t load_be64(uint8_t const *p)
+{
+    return (uint64_t)p[0] << 56 | (uint64_t)p[1] << 48 | (uint64_t)p[2] << 40 | (uint64_t)p[3] << 32
+            | (uint64_t)p[4] << 24 | (uint64_t)p[5] << 16 | (uint64_t)p[6] << 8 | (uint64_t)p[7];
+}
+
+static inline void store_be64(uint8_t *p, uint64_t w)
+{
+    for (int i = 0; i < 8; ++i)
+        p[i] = (uint8_t)(w >> (56 - 8 * i));
+}
+
+/// Load the last n < 8 bytes of a row, missing bytes are zero.
+static inline uint64_t load_be64_tail(uint8_t const *p, unsigned n)
+{
+    uint64_t w = 0;
+    for (unsigned i = 0; i < n; ++i)
+        w |= (uint64_t)p[i] << (56 - 8 * i);
+    return w;
+}
+
+static inline void store_be64_tail(uint8_t *p, unsigned n, uint64_t w)
+{
+    for (unsigned i = 0; i < n; ++i)
+        p[i] = (uint8_t)(w >> (56 - 8 * i));
+}
+
 void bitbuffer_invert(bitbuffer_t *bits)
 {
     for (unsigned row = 0; row < bits->num_rows; ++row) {
@@ -136,7 +164,14 @@ void bitbuffer_invert(bitbuffer_t *bits)
 
             const unsigned last_col  = (bits->bits_per_row[row] - 1) / 8;
             const unsigned last_bits = ((bits->bits_per_row[row] - 1) % 8) + 1;
-            for (unsigned col = 0; col <= last_col; ++col) {
+            unsigned col = 0;
+            for (; col + 8 <= last_col + 1; col += 8) {
+                uint64_t w;
+                memcpy(&w, &b[col], 8);
+                w = ~w; // Invert, the byte order does not matter
+                memcpy(&b[col], &w, 8);
+            }
+            for (; col <= last_col; ++col) {
                 b[col] = ~b[col]; // Invert
             }
             b[last_col] ^= 0xFF >> last_bits; // Re-invert unused bits in last byte
@@ -144,22 +179,34 @@ void bitbuffer_invert(bitbuffer_t *bits)
     }
 }
 
+/// Differential decode, each bit is xor'ed with the previous bit (0 before the first bit), then with @p invert.
+///
+/// The previous bits are the row shifted right by one, so a word at a time
+/// is decoded with the last bit of the previous word carried in.
+static void bitrow_nrz_decode(uint8_t *b, unsigned bit_len, uint64_t invert)
+{
+    const unsigned bytes     = (bit_len + 7) / 8;
+    const unsigned last_bits = ((bit_len - 1) % 8) + 1;
+
+    uint64_t carry = 0; // last bit of the previous word, at the MSB
+    unsigned col   = 0;
+    for (; col + 8 <= bytes; col += 8) {
+        uint64_t w = load_be64(&b[col]);
+        store_be64(&b[col], w ^ (w >> 1 | carry) ^ invert);
+        carry = w << 63;
+    }
+    if (col < bytes) {
+        uint64_t w = load_be64_tail(&b[col], bytes - col);
+        store_be64_tail(&b[col], bytes - col, w ^ (w >> 1 | carry) ^ invert);
+    }
+    b[bytes - 1] &= 0xFF << (8 - last_bits); // Clear unused bits in last byte
+}
+
 void bitbuffer_nrzs_decode(bitbuffer_t *bits)
 {
     for (unsigned row = 0; row < bits->num_rows; ++row) {
         if (bits->bits_per_row[row] > 0) {
-            uint8_t *b = bits->bb[row];
-
-            const unsigned last_col  = (bits->bits_per_row[row] - 1) / 8;
-            const unsigned last_bits = ((bits->bits_per_row[row] - 1) % 8) + 1;
-
-            int prev = 0;
-            for (unsigned col = 0; col <= last_col; ++col) {
-                int mask = (prev << 7) | b[col] >> 1;
-                prev     = b[col];
-                b[col]   = b[col] ^ ~mask;
-            }
-            b[last_col] &= 0xFF << (8 - last_bits); // Clear unused bits in last byte
+            bitrow_nrz_decode(bits->bb[row], bits->bits_per_row[row], ~(uint64_t)0);
         }
     }
 }
@@ -168,18 +215,7 @@ void bitbuffer_nrzm_decode(bitbuffer_t *bits)
 {
     for (unsigned row = 0; row < bits->num_rows; ++row) {
         if (bits->bits_per_row[row] > 0) {
-            uint8_t *b = bits->bb[row];
-
-            const unsigned last_col  = (bits->bits_per_row[row] - 1) / 8;
-            const unsigned last_bits = ((bits->bits_per_row[row] - 1) % 8) + 1;
-
-            int prev = 0;
-            for (unsigned col = 0; col <= last_col; ++col) {
-                int mask = (prev << 7) | b[col] >> 1;
-                prev     = b[col];
-                b[col]   = b[col] ^ mask;
-            }
-            b[last_col] &= 0xFF << (8 - last_bits); // Clear unused bits in last byte
+            bitrow_nrz_decode(bits->bb[row], bits->bits_per_row[row], 0);
         }
     }
 }
@@ -468,22 +504,57 @@ void bitbuffer_parse(bitbuffer_t *bits, const char *code)
     }
 }
 
+/// Compare the first @p bit_len bits of two rows, a word at a time with a masked tail.
+static int bitrow_equal(uint8_t const *a, uint8_t const *b, unsigned bit_len)
+{
+    const unsigned bytes = bit_len / 8;
+    unsigned col = 0;
+    for (; col + 8 <= bytes; col += 8) {
+        uint64_t wa, wb;
+        memcpy(&wa, &a[col], 8);
+        memcpy(&wb, &b[col], 8);
+        if (wa != wb)
+            return 0;
+    }
+    for (; col < bytes; ++col) {
+        if (a[col] != b[col])
+            return 0;
+    }
+    if (bit_len & 7) {
+        uint8_t mask = 0xff00 >> (bit_len & 7); // mask off bottom bits
+        return (a[bytes] & mask) == (b[bytes] & mask);
+    }
+    return 1;
+}
+
+/// Hash the first @p bit_len bits of a row, rows that compare equal have the same hash.
+static uint64_t bitrow_hash(uint8_t const *b, unsigned bit_len)
+{
+    const unsigned bytes = bit_len / 8;
+    uint64_t h = bit_len;
+    unsigned col = 0;
+    for (; col + 8 <= bytes; col += 8) {
+        h = (h ^ load_be64(&b[col])) * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 29;
+    }
+    uint64_t tail = load_be64_tail(&b[col], bytes - col);
+    if (bit_len & 7)
+        tail |= (uint64_t)(b[bytes] & (0xff00 >> (bit_len & 7))) << (56 - 8 * (bytes - col));
+    h = (h ^ tail) * 0x9e3779b97f4a7c15ULL;
+    return h ^ h >> 29;
+}
+
 int bitbuffer_compare_rows(bitbuffer_t *bits, unsigned row_a, unsigned row_b, unsigned max_bits)
 {
-    if (max_bits == 0 || bits->bits_per_row[row_a] < max_bits || bits->bits_per_row[row_b] < max_bits) {
-        // full compare, no max_bits or rows too short
-        return (bits->bits_per_row[row_a] == bits->bits_per_row[row_b]
-                && !memcmp(bits->bb[row_a], bits->bb[row_b],
-                        (bits->bits_per_row[row_a] + 7) / 8));
+    unsigned len_a = bits->bits_per_row[row_a];
+    unsigned len_b = bits->bits_per_row[row_b];
+    if (max_bits == 0 || len_a < max_bits || len_b < max_bits) {
+        // full compare, no max_bits or rows too short, the whole last byte is compared
+        return len_a == len_b && bitrow_equal(bits->bb[row_a], bits->bb[row_b], (len_a + 7) / 8 * 8);
     }
     else {
         // prefix-only compare, both rows are at least max_bits long
-        uint8_t *a = bits->bb[row_a];
-        uint8_t *b = bits->bb[row_b];
-        unsigned last = (max_bits - 1) / 8; // max_bits is at least 1
-        unsigned mask = 0xff00 >> (max_bits & 7); // mask off bottom bits
-        return (!memcmp(bits->bb[row_a], bits->bb[row_b], max_bits / 8)
-                && (a[last] & mask) == (b[last] & mask));
+        return bitrow_equal(bits->bb[row_a], bits->bb[row_b], max_bits);
     }
 }
 
@@ -498,30 +569,53 @@ unsigned bitbuffer_count_repeats(bitbuffer_t *bits, unsigned row, unsigned max_b
     return cnt;
 }
 
-int bitbuffer_find_repeated_row(bitbuffer_t *bits, unsigned min_repeats, unsigned min_bits)
+/// Find the first row with at least @p min_bits bits and @p min_repeats matching rows.
+///
+/// Each row is hashed once, only rows with the same hash are compared.
+/// Rows shorter than @p min_bits never match a row with at least @p min_bits.
+static int find_repeated(bitbuffer_t *bits, unsigned min_repeats, unsigned min_bits, unsigned max_bits)
 {
+    uint64_t hash[BITBUF_ROWS];
     for (int i = 0; i < bits->num_rows; ++i) {
-        if (bits->bits_per_row[i] >= min_bits &&
-                bitbuffer_count_repeats(bits, i, 0) >= min_repeats) {
+        unsigned len = bits->bits_per_row[i];
+        if (len < min_bits)
+            hash[i] = 0; // never compared
+        else if (max_bits)
+            hash[i] = bitrow_hash(bits->bb[i], max_bits);
+        else
+            hash[i] = bitrow_hash(bits->bb[i], (len + 7) / 8 * 8) ^ len;
+    }
+
+    for (int i = 0; i < bits->num_rows; ++i) {
+        if (bits->bits_per_row[i] < min_bits)
+            continue;
+        unsigned cnt = 0;
+        for (int j = 0; j < bits->num_rows; ++j) {
+            if (bits->bits_per_row[j] >= min_bits && hash[j] == hash[i]
+                    && bitbuffer_compare_rows(bits, i, j, max_bits)) {
+                ++cnt;
+            }
+        }
+        if (cnt >= min_repeats) {
             return i;
         }
     }
     return -1;
 }
 
+int bitbuffer_find_repeated_row(bitbuffer_t *bits, unsigned min_repeats, unsigned min_bits)
+{
+    return find_repeated(bits, min_repeats, min_bits, 0);
+}
+
 int bitbuffer_find_repeated_prefix(bitbuffer_t *bits, unsigned min_repeats, unsigned min_bits)
 {
-    for (int i = 0; i < bits->num_rows; ++i) {
-        if (bits->bits_per_row[i] >= min_bits &&
-                bitbuffer_count_repeats(bits, i, min_bits) >= min_repeats) {
-            return i;
-        }
-    }
-    return -1;
+    return find_repeated(bits, min_repeats, min_bits, min_bits);
 }
 
 // Unit testing
 #ifdef _TEST
+#include <time.h>
 
 #define ASSERT(expr) \
     do { \
@@ -533,6 +627,94 @@ int bitbuffer_find_repeated_prefix(bitbuffer_t *bits, unsigned min_repeats, unsi
         } \
     } while (0)
 
+// Bit at a time reference implementations
+
+static void ref_nrz_decode(bitbuffer_t *bits, int invert)
+{
+    for (unsigned row = 0; row < bits->num_rows; ++row) {
+        uint8_t *b   = bits->bb[row];
+        unsigned len = bits->bits_per_row[row];
+        int prev     = 0;
+        for (unsigned i = 0; i < len; ++i) {
+            int bit = bitrow_get_bit(b, i);
+            int out = bit ^ prev ^ invert;
+            prev    = bit;
+            b[i / 8] = (uint8_t)((b[i / 8] & ~(0x80 >> (i % 8))) | out << (7 - i % 8));
+        }
+        if (len % 8)
+            b[len / 8] &= 0xFF << (8 - len % 8); // Clear unused bits in last byte
+    }
+}
+
+static int ref_compare_rows(bitbuffer_t *bits, unsigned row_a, unsigned row_b, unsigned max_bits)
+{
+    unsigned len_a = bits->bits_per_row[row_a];
+    unsigned len_b = bits->bits_per_row[row_b];
+    if (max_bits == 0 || len_a < max_bits || len_b < max_bits) {
+        if (len_a != len_b)
+            return 0;
+        max_bits = (len_a + 7) / 8 * 8;
+    }
+    for (unsigned i = 0; i < max_bits; ++i) {
+        if (bitrow_get_bit(bits->bb[row_a], i) != bitrow_get_bit(bits->bb[row_b], i))
+            return 0;
+    }
+    return 1;
+}
+
+static int ref_find_repeated(bitbuffer_t *bits, unsigned min_repeats, unsigned min_bits, unsigned max_bits)
+{
+    for (int i = 0; i < bits->num_rows; ++i) {
+        unsigned cnt = 0;
+        for (int j = 0; j < bits->num_rows; ++j) {
+            cnt += ref_compare_rows(bits, i, j, max_bits);
+        }
+        if (bits->bits_per_row[i] >= min_bits && cnt >= min_repeats) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static unsigned rand_seed = 1;
+
+static unsigned rand_next(void)
+{
+    rand_seed = rand_seed * 1103515245 + 12345;
+    return rand_seed >> 16;
+}
+
+/// Random rows, some are repeats of others, some only share a prefix.
+static void random_bitbuffer(bitbuffer_t *bits, unsigned rows, unsigned max_len)
+{
+    bitbuffer_clear(bits);
+    bits->num_rows = bits->free_row = (uint16_t)rows;
+    for (unsigned row = 0; row < rows; ++row) {
+        unsigned len = rand_next() % (max_len + 1);
+        if (row > 0 && rand_next() % 2) {
+            unsigned src = rand_next() % row;
+            len = bits->bits_per_row[src];
+            memcpy(bits->bb[row], bits->bb[src], (len + 7) / 8);
+            if (len && rand_next() % 2) {
+                unsigned flip = rand_next() % len;
+                bits->bb[row][flip / 8] ^= 0x80 >> (flip % 8);
+            }
+        }
+        else {
+            for (unsigned col = 0; col < (len + 7) / 8; ++col)
+                bits->bb[row][col] = (uint8_t)rand_next();
+            if (len % 8)
+                bits->bb[row][len / 8] &= 0xFF << (8 - len % 8);
+        }
+        bits->bits_per_row[row] = (uint16_t)len;
+    }
+}
+
+static double bench_ns(clock_t start, unsigned loops)
+{
+    return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / loops;
+}
+
 int main(void)
 {
     unsigned passed = 0;
@@ -597,6 +779,85 @@ int main(void)
     bitbuffer_add_bit(&bits, 1);
     bitbuffer_print(&bits);
 
+    fprintf(stderr, "TEST: bitbuffer:: nrzm_decode\n");
+    bitbuffer_clear(&bits);
+    bits.num_rows = 1;
+    bits.bb[0][0] = 0x74;
+    bits.bb[0][1] = 0x60;
+    bits.bits_per_row[0] = 12;
+    bitbuffer_nrzm_decode(&bits);
+    ASSERT(bits.bb[0][0] == 0x4E);
+    ASSERT(bits.bb[0][1] == 0x50);
+
+    fprintf(stderr, "TEST: bitbuffer:: word-wise operations match the bit-wise reference\n");
+    static bitbuffer_t ref;
+    unsigned mismatches = 0;
+    for (unsigned trial = 0; trial < 500; ++trial) {
+        unsigned max_len = trial % 5 == 0 ? BITBUF_COLS * 8 : 200;
+        random_bitbuffer(&bits, 1 + trial % BITBUF_ROWS / 2, max_len);
+
+        ref = bits;
+        bitbuffer_nrzs_decode(&bits);
+        ref_nrz_decode(&ref, 1);
+        mismatches += memcmp(&bits, &ref, sizeof(bits)) != 0;
+
+        bitbuffer_nrzm_decode(&bits);
+        ref_nrz_decode(&ref, 0);
+        mismatches += memcmp(&bits, &ref, sizeof(bits)) != 0;
+
+        bitbuffer_invert(&bits);
+        bitbuffer_invert(&bits);
+        mismatches += memcmp(&bits, &ref, sizeof(bits)) != 0;
+
+        unsigned max_bits = rand_next() % 80;
+        for (unsigned i = 0; i < bits.num_rows; ++i) {
+            for (unsigned j = 0; j < bits.num_rows; ++j) {
+                mismatches += !bitbuffer_compare_rows(&bits, i, j, max_bits) != !ref_compare_rows(&bits, i, j, max_bits);
+            }
+        }
+        for (unsigned repeats = 0; repeats < 4; ++repeats) {
+            mismatches += bitbuffer_find_repeated_row(&bits, repeats, max_bits) != ref_find_repeated(&bits, repeats, max_bits, 0);
+            mismatches += bitbuffer_find_repeated_prefix(&bits, repeats, max_bits) != ref_find_repeated(&bits, repeats, max_bits, max_bits);
+        }
+    }
+    ASSERT(mismatches == 0);
+
+    fprintf(stderr, "TEST: bitbuffer:: repeats\n");
+    bitbuffer_parse(&bits, "{24}abcdef/{24}abcdef/{24}abcd00/{24}abcdef/{16}abcd");
+    ASSERT(bitbuffer_count_repeats(&bits, 0, 0) == 3);
+    ASSERT(bitbuffer_count_repeats(&bits, 0, 16) == 5); // the short row has the prefix too
+    ASSERT(bitbuffer_find_repeated_row(&bits, 3, 24) == 0);
+    ASSERT(bitbuffer_find_repeated_row(&bits, 4, 24) == -1);
+    ASSERT(bitbuffer_find_repeated_prefix(&bits, 5, 16) == 0);
+    ASSERT(bitbuffer_find_repeated_prefix(&bits, 6, 16) == -1);
+    ASSERT(bitbuffer_find_repeated_row(&bits, 1, 0) == 0);
+
+    fprintf(stderr, "BENCH: bitbuffer:: %u rows of 200 bits, ns per call (reference, word-wise)\n", BITBUF_ROWS);
+    random_bitbuffer(&bits, BITBUF_ROWS, 200);
+    for (unsigned i = 0; i < BITBUF_ROWS; ++i) {
+        bits.bits_per_row[i] = 200; // no repeats, the worst case for the finder
+        bits.bb[i][0] = (uint8_t)i;
+    }
+    unsigned const loops = 200;
+    clock_t start = clock();
+    for (unsigned i = 0; i < loops; ++i)
+        ref_nrz_decode(&bits, 1);
+    double ns_ref = bench_ns(start, loops);
+    start = clock();
+    for (unsigned i = 0; i < loops; ++i)
+        bitbuffer_nrzs_decode(&bits);
+    fprintf(stderr, "  nrzs_decode          %10.0f %10.0f\n", ns_ref, bench_ns(start, loops));
+    int found = 0;
+    start = clock();
+    for (unsigned i = 0; i < loops; ++i)
+        found += ref_find_repeated(&bits, 2, 200, 0);
+    ns_ref = bench_ns(start, loops);
+    start = clock();
+    for (unsigned i = 0; i < loops; ++i)
+        found += bitbuffer_find_repeated_row(&bits, 2, 200);
+    fprintf(stderr, "  find_repeated_row    %10.0f %10.0f\n", ns_ref, bench_ns(start, loops));
+    ASSERT(found == -2 * (int)loops);
+
     fprintf(stderr, "bitbuffer:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
 
     return failed > 0 ? 1 : 0;
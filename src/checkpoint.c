@@ -0,0 +1,255 @@
+/** @file
+    Checkpoints to resume batch decoding of input files.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+/*
+The checkpoint is a small text file with one "key values..." line per item:
+
+    rtl_433-checkpoint 1
+    file_index 2
+    sample_pos 31457280
+    file g001_433.92M_250k.cu8
+    input_pos 83886080
+    levels 412 3296 1025
+    lowpass 118 97
+    demod_fm 12 -7 301 296
+    decode_fails 6
+    decoder 40 14 12 24 0 2 0 0 0 0 0 0 0 0 Acurite-Tower
+
+A decoder line has the protocol number, the decode counts, the decode_fails,
+the partial frame counts, and the name. The number of decode_fails is given
+before the decoder lines, a checkpoint with a different number is rejected.
+
+The file is written to a temporary name and renamed, a crash while writing
+leaves the previous checkpoint intact. The file is not synced to disk, just
+like the outputs, a checkpoint never claims events which were not written.
+*/
+
+#include "checkpoint.h"
+#include "rtl_433.h"
+#include "r_private.h"
+#include "r_device.h"
+#include "pulse_detect.h"
+#include "logger.h"
+#include "fatal.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+
+#define CHECKPOINT_MAGIC "rtl_433-checkpoint"
+#define CHECKPOINT_VERSION 1
+#define DECODE_FAILS_LEN (sizeof(((r_device *)0)->decode_fails) / sizeof(unsigned))
+
+int checkpoint_save(r_cfg_t *cfg, char const *path, checkpoint_pos_t const *pos)
+{
+    struct dm_state *demod = cfg->demod;
+
+    pulse_detect_levels_t levels;
+    int idle = pulse_detect_get_levels(demod->pulse_detect, &levels);
+    if (!idle && pos->sample_pos) {
+        return 1; // wait for the end of the package
+    }
+
+    size_t path_len = strlen(path);
+    char *tmp_path  = malloc(path_len + 5);
+    if (!tmp_path) {
+        WARN_MALLOC("checkpoint_save()");
+        return -1;
+    }
+    memcpy(tmp_path, path, path_len);
+    memcpy(tmp_path + path_len, ".tmp", 5);
+
+    FILE *fp = fopen(tmp_path, "w");
+    if (!fp) {
+        print_logf(LOG_ERROR, "Checkpoint", "Failed to write checkpoint \"%s\"", tmp_path);
+        free(tmp_path);
+        return -1;
+    }
+
+    fprintf(fp, "%s %d\n", CHECKPOINT_MAGIC, CHECKPOINT_VERSION);
+    fprintf(fp, "file_index %u\n", pos->file_index);
+    fprintf(fp, "sample_pos %" PRIu64 "\n", pos->sample_pos);
+    if (pos->sample_pos && pos->file) {
+        fprintf(fp, "file %s\n", pos->file);
+    }
+    fprintf(fp, "input_pos %" PRIu64 "\n", cfg->input_pos);
+    fprintf(fp, "levels %d %d %d\n", levels.ook_low_estimate, levels.ook_high_estimate, levels.lead_in_counter);
+    fprintf(fp, "lowpass %d %d\n", demod->lowpass_filter_state.y[0], demod->lowpass_filter_state.x[0]);
+    fprintf(fp, "demod_fm %d %d %d %d\n", demod->demod_FM_state.xr, demod->demod_FM_state.xi,
+            demod->demod_FM_state.xf, demod->demod_FM_state.yf);
+    fprintf(fp, "decode_fails %u\n", (unsigned)DECODE_FAILS_LEN);
+    for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        if (!r_dev->decode_events) {
+            continue;
+        }
+        fprintf(fp, "decoder %u %u %u %u", r_dev->protocol_num,
+                r_dev->decode_events, r_dev->decode_ok, r_dev->decode_messages);
+        for (unsigned i = 0; i < DECODE_FAILS_LEN; ++i) {
+            fprintf(fp, " %u", r_dev->decode_fails[i]);
+        }
+        fprintf(fp, " %u %u %u %u %s\n", r_dev->frame_hits, r_dev->frame_misses,
+                r_dev->frame_expired, r_dev->frame_evicted, r_dev->name);
+    }
+
+    int err = fflush(fp) != 0 || ferror(fp);
+    err |= fclose(fp) != 0;
+#ifdef _WIN32
+    remove(path); // rename does not replace on Windows
+#endif
+    if (err || rename(tmp_path, path) != 0) {
+        print_logf(LOG_ERROR, "Checkpoint", "Failed to write checkpoint \"%s\"", path);
+        remove(tmp_path);
+        free(tmp_path);
+        return -1;
+    }
+    free(tmp_path);
+    return 0;
+}
+
+static r_device *find_decoder(struct dm_state *demod, unsigned protocol_num, char const *name)
+{
+    for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        if (r_dev->protocol_num == protocol_num && !strcmp(r_dev->name, name)) {
+            return r_dev;
+        }
+    }
+    return NULL;
+}
+
+/// Parse space separated counts, returns the rest of the string after the counts or NULL.
+static char *parse_counts(char *p, unsigned *v, unsigned count)
+{
+    for (unsigned i = 0; i < count; ++i) {
+        char *end;
+        v[i] = (unsigned)strtoul(p, &end, 10);
+        if (end == p || *end != ' ') {
+            return NULL;
+        }
+        p = end + 1;
+    }
+    return p;
+}
+
+int checkpoint_load(r_cfg_t *cfg, char const *path, checkpoint_pos_t *pos)
+{
+    struct dm_state *demod = cfg->demod;
+    memset(pos, 0, sizeof(*pos));
+
+    FILE *fp = fopen(path, "r");
+    if (!fp && errno == ENOENT) {
+        return 1; // nothing to resume
+    }
+    if (!fp) {
+        print_logf(LOG_ERROR, "Checkpoint", "Failed to read checkpoint \"%s\"", path);
+        return -1;
+    }
+
+    char line[1024];
+    int version = 0;
+    if (!fgets(line, sizeof(line), fp)
+            || sscanf(line, CHECKPOINT_MAGIC " %d", &version) != 1
+            || version != CHECKPOINT_VERSION) {
+        print_logf(LOG_ERROR, "Checkpoint", "Not a checkpoint file \"%s\"", path);
+        fclose(fp);
+        return -1;
+    }
+
+    pulse_detect_levels_t levels = {0};
+    pulse_detect_get_levels(demod->pulse_detect, &levels);
+    unsigned fails_len = 0;
+    unsigned skipped   = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *val = strchr(line, ' ');
+        if (!val) {
+            continue;
+        }
+        *val++ = '\0';
+
+        if (!strcmp(line, "file_index")) {
+            pos->file_index = (unsigned)strtoul(val, NULL, 10);
+        }
+        else if (!strcmp(line, "sample_pos")) {
+            pos->sample_pos = strtoull(val, NULL, 10);
+        }
+        else if (!strcmp(line, "file")) {
+            free(pos->file);
+            pos->file = strdup(val);
+            if (!pos->file)
+                FATAL_STRDUP("checkpoint_load()");
+        }
+        else if (!strcmp(line, "input_pos")) {
+            cfg->input_pos = strtoull(val, NULL, 10);
+        }
+        else if (!strcmp(line, "levels")) {
+            sscanf(val, "%d %d %d", &levels.ook_low_estimate, &levels.ook_high_estimate, &levels.lead_in_counter);
+        }
+        else if (!strcmp(line, "lowpass")) {
+            int y = 0, x = 0;
+            sscanf(val, "%d %d", &y, &x);
+            demod->lowpass_filter_state.y[0] = (int16_t)y;
+            demod->lowpass_filter_state.x[0] = (int16_t)x;
+        }
+        else if (!strcmp(line, "demod_fm")) {
+            demodfm_state_t *fm = &demod->demod_FM_state;
+            sscanf(val, "%d %d %d %d", &fm->xr, &fm->xi, &fm->xf, &fm->yf);
+        }
+        else if (!strcmp(line, "decode_fails")) {
+            fails_len = (unsigned)strtoul(val, NULL, 10);
+        }
+        else if (!strcmp(line, "decoder")) {
+            if (fails_len != DECODE_FAILS_LEN) {
+                print_logf(LOG_ERROR, "Checkpoint", "Checkpoint \"%s\" has %u decode_fails, expected %u", path, fails_len, (unsigned)DECODE_FAILS_LEN);
+                fclose(fp);
+                checkpoint_pos_clear(pos);
+                return -1;
+            }
+            unsigned v[4 + DECODE_FAILS_LEN + 4];
+            char *name = parse_counts(val, v, 4 + DECODE_FAILS_LEN + 4);
+            if (!name || !*name) {
+                continue;
+            }
+            r_device *r_dev = find_decoder(demod, v[0], name);
+            if (!r_dev) {
+                skipped++;
+                continue;
+            }
+            r_dev->decode_events   = v[1];
+            r_dev->decode_ok       = v[2];
+            r_dev->decode_messages = v[3];
+            for (unsigned i = 0; i < DECODE_FAILS_LEN; ++i) {
+                r_dev->decode_fails[i] = v[4 + i];
+            }
+            unsigned *f = &v[4 + DECODE_FAILS_LEN];
+            r_dev->frame_hits    = f[0];
+            r_dev->frame_misses  = f[1];
+            r_dev->frame_expired = f[2];
+            r_dev->frame_evicted = f[3];
+        }
+    }
+    fclose(fp);
+
+    pulse_detect_put_levels(demod->pulse_detect, &levels);
+    if (skipped) {
+        print_logf(LOG_WARNING, "Checkpoint", "Statistics of %u decoders not restored, the decoders are not enabled", skipped);
+    }
+    return 0;
+}
+
+void checkpoint_pos_clear(checkpoint_pos_t *pos)
+{
+    free(pos->file);
+    memset(pos, 0, sizeof(*pos));
+}
@@ -33,6 +33,29 @@ int gettimeofday(struct timeval *tv, void *tz)
     return 0;
 }
 
+double get_cpu_time(void)
+{
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+        return 0.0;
+    unsigned __int64 k64 = (((unsigned __int64)kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+    unsigned __int64 u64 = (((unsigned __int64)user.dwHighDateTime) << 32) | user.dwLowDateTime;
+    return (k64 + u64) / 1e7; // 100 ns units
+}
+
+#else
+
+#include <sys/resource.h>
+
+double get_cpu_time(void)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage))
+        return 0.0;
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+            + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
 #endif // _WIN32
 
 int timeval_subtract(struct timeval *result, struct timeval *x, struct timeval *y)
@@ -151,18 +151,143 @@ alloc_error:
     return NULL;
 }
 
+/* data element pool */
+
+/*
+Each element is a fixed size node with room to store the key, pretty key,
+format, and a short string value inline, longer strings are allocated.
+Released nodes are kept on a per-thread free list and reused, in steady
+state making and releasing data does not allocate.
+*/
+
+#define DATA_NODE_MEM 192 // inline string storage per element
+#define DATA_POOL_MAX 512 // released elements to keep per thread
+
+#if defined(_MSC_VER)
+#define DATA_THREAD_LOCAL __declspec(thread)
+#else
+#define DATA_THREAD_LOCAL __thread
+#endif
+
+typedef struct data_node {
+    data_t data; // first member, a data_t pointer is a node pointer
+    unsigned used;
+    char mem[DATA_NODE_MEM];
+} data_node_t;
+
+static DATA_THREAD_LOCAL data_t *data_pool;
+static DATA_THREAD_LOCAL unsigned data_pool_len;
+
+static data_t *data_node_get(void)
+{
+    data_node_t *node;
+    if (data_pool) {
+        node = (data_node_t *)data_pool;
+        data_pool = node->data.next;
+        data_pool_len--;
+    }
+    else {
+        node = malloc(sizeof(*node));
+        if (!node) {
+            WARN_MALLOC("data_node_get()");
+            return NULL;
+        }
+    }
+    memset(&node->data, 0, sizeof(node->data));
+    node->used = 0;
+    return &node->data;
+}
+
+static void data_node_put(data_t *data)
+{
+    if (data_pool_len >= DATA_POOL_MAX) {
+        free(data);
+        return;
+    }
+    data->next = data_pool;
+    data_pool  = data;
+    data_pool_len++;
+}
+
+static int data_node_owns(data_t const *data, void const *ptr)
+{
+    data_node_t const *node = (data_node_t const *)data;
+    return (char const *)ptr >= node->mem && (char const *)ptr < node->mem + DATA_NODE_MEM;
+}
+
+/// Copy a string to the node, falls back to strdup if there is no room.
+static char *data_node_copy(data_t *data, char const *str)
+{
+    data_node_t *node = (data_node_t *)data;
+    size_t size       = strlen(str) + 1;
+    if (node->used + size > DATA_NODE_MEM) {
+        char *copy = strdup(str);
+        if (!copy)
+            WARN_STRDUP("data_node_copy()");
+        return copy;
+    }
+    char *ptr = memcpy(node->mem + node->used, str, size);
+    node->used += (unsigned)size;
+    return ptr;
+}
+
+static void data_node_release(data_t *data, void *ptr)
+{
+    if (!data_node_owns(data, ptr)) {
+        free(ptr);
+    }
+}
+
+R_API void data_pool_clear(void)
+{
+    while (data_pool) {
+        data_t *next = data_pool->next;
+        free(data_pool);
+        data_pool = next;
+    }
+    data_pool_len = 0;
+}
+
+/// Replace a string of the element, in place if the new string is not longer.
+static int data_node_replace(data_t *data, char **field, char const *str)
+{
+    if (*field && strlen(str) <= strlen(*field)) {
+        strcpy(*field, str);
+        return 0;
+    }
+    char *copy = data_node_copy(data, str);
+    if (!copy) {
+        return -1;
+    }
+    if (*field)
+        data_node_release(data, *field);
+    *field = copy;
+    return 0;
+}
+
+R_API int data_set_key(data_t *data, char const *key)
+{
+    return data_node_replace(data, &data->key, key);
+}
+
+R_API int data_set_format(data_t *data, char const *format)
+{
+    return data_node_replace(data, &data->format, format);
+}
+
 static data_t *vdata_make(data_t *first, const char *key, const char *pretty_key, va_list ap)
 {
     data_type_t type;
     data_t *prev = first;
     while (prev && prev->next)
         prev = prev->next;
-    char *format = NULL;
+    char const *format = NULL;
     int skip = 0; // skip the data item if this is set
     type = va_arg(ap, data_type_t);
     do {
         data_t *current;
         data_value_t value = {0};
+        char const *str = NULL; // string value, copied to the element
         // store explicit release function, CSA checker gets confused without this
         value_release_fn value_release = NULL; // appease CSA checker
 
@@ -176,11 +301,7 @@ static data_t *vdata_make(data_t *first, const char *key, const char *pretty_key
                 fprintf(stderr, "vdata_make() format type used twice\n");
                 goto alloc_error;
             }
-            format = strdup(va_arg(ap, char *));
-            if (!format) {
-                WARN_STRDUP("vdata_make()");
-                goto alloc_error;
-            }
+            format = va_arg(ap, char const *);
             type = va_arg(ap, data_type_t);
             continue;
         case DATA_COUNT:
@@ -197,10 +318,7 @@ static data_t *vdata_make(data_t *first, const char *key, const char *pretty_key
             value.v_dbl = va_arg(ap, double);
             break;
         case DATA_STRING:
-            value_release = (value_release_fn)free; // appease CSA checker
-            value.v_ptr = strdup(va_arg(ap, char *));
-            if (!value.v_ptr)
-                WARN_STRDUP("vdata_make()");
+            str = va_arg(ap, char const *);
             break;
         case DATA_ARRAY:
             value_release = (value_release_fn)data_array_free; // appease CSA checker
@@ -214,21 +332,17 @@ static data_t *vdata_make(data_t *first, const char *key, const char *pretty_key
         if (skip) {
             if (value_release) // could use dmt[type].value_release
                 value_release(value.v_ptr);
-            free(format);
             format = NULL;
             skip = 0;
         }
         else {
-            current = calloc(1, sizeof(*current));
+            current = data_node_get();
             if (!current) {
-                WARN_CALLOC("vdata_make()");
                 if (value_release) // could use dmt[type].value_release
                     value_release(value.v_ptr);
                 goto alloc_error;
             }
             current->type   = type;
-            current->format = format;
-            format          = NULL; // consumed
             current->value  = value;
             current->next   = NULL;
 
@@ -238,15 +352,20 @@ static data_t *vdata_make(data_t *first, const char *key, const char *pretty_key
             if (!first)
                 first = current;
 
-            current->key = strdup(key);
-            if (!current->key) {
-                WARN_STRDUP("vdata_make()");
+            current->key = data_node_copy(current, key);
+            if (!current->key)
                 goto alloc_error;
-            }
-            current->pretty_key = strdup(pretty_key ? pretty_key : key);
-            if (!current->pretty_key) {
-                WARN_STRDUP("vdata_make()");
+            current->pretty_key = data_node_copy(current, pretty_key ? pretty_key : key);
+            if (!current->pretty_key)
                 goto alloc_error;
+            if (format) {
+                current->format = data_node_copy(current, format);
+                if (!current->format)
+                    goto alloc_error;
+                format = NULL; // consumed
+            }
+            if (str) {
+                current->value.v_ptr = data_node_copy(current, str);
             }
         }
 
@@ -266,7 +385,6 @@ static data_t *vdata_make(data_t *first, const char *key, const char *pretty_key
     return first;
 
 alloc_error:
-    free(format); // if not consumed
     data_free(first);
     return NULL;
 }
@@ -334,14 +452,174 @@ R_API void data_free(data_t *data)
     }
     while (data) {
         data_t *prev_data = data;
-        if (dmt[data->type].value_release)
+        if (data->type == DATA_STRING)
+            data_node_release(data, data->value.v_ptr);
+        else if (dmt[data->type].value_release)
             dmt[data->type].value_release(data->value.v_ptr);
-        free(data->format);
-        free(data->pretty_key);
-        free(data->key);
+        data_node_release(data, data->format);
+        data_node_release(data, data->pretty_key);
+        data_node_release(data, data->key);
         data = data->next;
-        free(prev_data);
+        data_node_put(prev_data);
+    }
+}
+
+/* data schema */
+
+struct data_schema {
+    int num_keys;
+    unsigned mask;   ///< hash table size minus one
+    char **keys;     ///< keys by field id
+    int *slots;      ///< open addressing hash table of field ids, -1 is empty
+};
+
+static unsigned schema_hash(char const *key)
+{
+    // FNV-1a
+    unsigned h = 2166136261U;
+    for (; *key; ++key) {
+        h ^= (unsigned char)*key;
+        h *= 16777619U;
+    }
+    return h;
+}
+
+R_API data_schema_t *data_schema_create(char const *const *keys, int num_keys)
+{
+    data_schema_t *schema = calloc(1, sizeof(*schema));
+    if (!schema) {
+        WARN_CALLOC("data_schema_create()");
+        return NULL;
+    }
+
+    unsigned size = 8;
+    while (size < 2 * (unsigned)num_keys)
+        size *= 2;
+    schema->mask  = size - 1;
+    schema->slots = malloc(size * sizeof(*schema->slots));
+    if (!schema->slots) {
+        WARN_MALLOC("data_schema_create()");
+        data_schema_free(schema);
+        return NULL;
+    }
+    for (unsigned i = 0; i < size; ++i)
+        schema->slots[i] = -1;
+    schema->keys = calloc(num_keys > 0 ? num_keys : 1, sizeof(*schema->keys));
+    if (!schema->keys) {
+        WARN_CALLOC("data_schema_create()");
+        data_schema_free(schema);
+        return NULL;
+    }
+
+    for (int i = 0; i < num_keys; ++i) {
+        if (!keys[i] || data_schema_id(schema, keys[i]) >= 0)
+            continue;
+        char *key = strdup(keys[i]);
+        if (!key) {
+            WARN_STRDUP("data_schema_create()");
+            data_schema_free(schema);
+            return NULL;
+        }
+        unsigned slot = schema_hash(key) & schema->mask;
+        while (schema->slots[slot] >= 0)
+            slot = (slot + 1) & schema->mask;
+        schema->slots[slot]              = schema->num_keys;
+        schema->keys[schema->num_keys++] = key;
+    }
+
+    return schema;
+}
+
+R_API void data_schema_free(data_schema_t *schema)
+{
+    if (!schema)
+        return;
+    if (schema->keys) {
+        for (int i = 0; i < schema->num_keys; ++i)
+            free(schema->keys[i]);
+    }
+    free(schema->keys);
+    free(schema->slots);
+    free(schema);
+}
+
+R_API int data_schema_count(data_schema_t const *schema)
+{
+    return schema ? schema->num_keys : 0;
+}
+
+R_API int data_schema_id(data_schema_t const *schema, char const *key)
+{
+    if (!schema || !key)
+        return -1;
+    unsigned slot = schema_hash(key) & schema->mask;
+    for (int id; (id = schema->slots[slot]) >= 0; slot = (slot + 1) & schema->mask) {
+        if (!strcmp(schema->keys[id], key))
+            return id;
+    }
+    return -1;
+}
+
+R_API char const *data_schema_key(data_schema_t const *schema, int id)
+{
+    if (!schema || id < 0 || id >= schema->num_keys)
+        return NULL;
+    return schema->keys[id];
+}
+
+/* data record */
+
+#define RECORD_BITS (8 * sizeof(unsigned))
+
+static size_t record_present_size(data_schema_t const *schema)
+{
+    return (data_schema_count(schema) + RECORD_BITS - 1) / RECORD_BITS * sizeof(unsigned);
+}
+
+R_API int data_record_init(data_record_t *record, data_schema_t const *schema)
+{
+    int num_keys = data_schema_count(schema);
+
+    record->schema  = schema;
+    record->present = calloc(1, record_present_size(schema) + sizeof(unsigned));
+    if (!record->present) {
+        WARN_CALLOC("data_record_init()");
+        record->values = NULL;
+        return -1;
+    }
+    record->values = calloc(num_keys > 0 ? num_keys : 1, sizeof(*record->values));
+    if (!record->values) {
+        WARN_CALLOC("data_record_init()");
+        free(record->present);
+        record->present = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+R_API void data_record_release(data_record_t *record)
+{
+    free(record->present);
+    free(record->values);
+    record->present = NULL;
+    record->values  = NULL;
+}
+
+R_API int data_record_fill(data_record_t *record, data_t *data)
+{
+    // only the bitmap needs clearing, stale values are never read
+    memset(record->present, 0, record_present_size(record->schema));
+
+    int found = 0;
+    for (; data; data = data->next) {
+        int id = data_schema_id(record->schema, data->key);
+        if (id < 0 || (record->present[id / RECORD_BITS] & (1U << (id % RECORD_BITS))))
+            continue;
+        record->present[id / RECORD_BITS] |= 1U << (id % RECORD_BITS);
+        record->values[id] = data;
+        found++;
     }
+    return found;
 }
 
 /* data output */
@@ -10,6 +10,7 @@
 */
 
 #include "decoder_util.h"
+#include "frame_table.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include "fatal.h"
@@ -29,6 +30,44 @@ r_device *create_device(r_device const *dev_template)
     return r_dev;
 }
 
+// partial frame functions
+
+void *decoder_frame_state(r_device *decoder, uint64_t key, size_t size, int *found)
+{
+    if (!decoder->frame_table) {
+        decoder->frame_table = frame_table_create(FRAME_TABLE_SLOTS, size);
+        if (!decoder->frame_table) {
+            decoder_logf(decoder, 0, __func__, "can't keep partial frames of %u bytes", (unsigned)size);
+            return NULL;
+        }
+    }
+    if (frame_table_state_size(decoder->frame_table) != size) {
+        decoder_logf(decoder, 0, __func__, "partial frame size %u differs", (unsigned)size);
+        return NULL;
+    }
+
+    unsigned ttl_ms = decoder->frame_ttl_ms ? decoder->frame_ttl_ms : FRAME_DEFAULT_TTL_MS;
+    int lookup;
+    void *state = frame_table_get(decoder->frame_table, key, decoder->frame_time_ms, ttl_ms, &lookup);
+    if (lookup == FRAME_FOUND)
+        decoder->frame_hits++;
+    else
+        decoder->frame_misses++;
+    if (lookup == FRAME_EXPIRED)
+        decoder->frame_expired++;
+    if (lookup == FRAME_EVICTED)
+        decoder->frame_evicted++;
+    if (found)
+        *found = lookup == FRAME_FOUND;
+    return state;
+}
+
+void decoder_frame_done(r_device *decoder, uint64_t key)
+{
+    if (decoder->frame_table)
+        frame_table_remove(decoder->frame_table, key);
+}
+
 // output functions
 
 void decoder_output_log(r_device *decoder, int level, data_t *data)
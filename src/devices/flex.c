@@ -449,42 +449,41 @@ static unsigned parse_modulation(char const *str)
         return FSK_PULSE_MANCHESTER_ZEROBIT;
     else {
         fprintf(stderr, "Bad flex spec, unknown modulation!\n");
-        usage();
+        return 0;
     }
-    return 0;
 }
 
-// used for match, preamble, getter, limited to 1024 bits (128 byte).
-static unsigned parse_bits(const char *code, uint8_t *bitrow)
+// used for match, preamble, getter, limited to 1024 bits (128 byte), returns -1 on error.
+static int parse_bits(const char *code, uint8_t *bitrow)
 {
     bitbuffer_t bits = {0};
     bitbuffer_parse(&bits, code);
     if (bits.num_rows != 1) {
         fprintf(stderr, "Bad flex spec, \"match\", \"preamble\", and getter mask need exactly one bit row (%d found)!\n", bits.num_rows);
-        usage();
+        return -1;
     }
-    unsigned len = bits.bits_per_row[0];
+    int len = bits.bits_per_row[0];
     if (len > 1024) {
-        fprintf(stderr, "Bad flex spec, \"match\", \"preamble\", and getter mask may have up to 1024 bits (%u found)!\n", len);
-        usage();
+        fprintf(stderr, "Bad flex spec, \"match\", \"preamble\", and getter mask may have up to 1024 bits (%d found)!\n", len);
+        return -1;
     }
     memcpy(bitrow, bits.bb[0], (len + 7) / 8);
     return len;
 }
 
-// used for symbol decode, limited to 27 bits (32 - 5).
+// used for symbol decode, limited to 27 bits (32 - 5), returns 0 on error.
 static uint32_t parse_symbol(const char *code)
 {
     bitbuffer_t bits = {0};
     bitbuffer_parse(&bits, code);
     if (bits.num_rows != 1) {
         fprintf(stderr, "Bad flex spec, \"symbol\" needs exactly one bit row (%d found)!\n", bits.num_rows);
-        usage();
+        return 0;
     }
     unsigned len = bits.bits_per_row[0];
     if (len > 27) {
         fprintf(stderr, "Bad flex spec, \"symbol\" may have up to 27 bits (%u found)!\n", len);
-        usage();
+        return 0;
     }
     uint8_t *b = bits.bb[0];
     return ((uint32_t)b[0] << 24) | (b[1] << 16) | (b[2] << 8) | (b[3] << 0) | len;
@@ -532,7 +531,8 @@ static const char *parse_map(const char *arg, struct flex_get *getter)
     return c;
 }
 
-static void parse_getter(const char *arg, struct flex_get *getter)
+// returns -1 on error.
+static int parse_getter(const char *arg, struct flex_get *getter)
 {
     uint8_t bitrow[128];
     while (arg && *arg) {
@@ -546,7 +546,10 @@ static void parse_getter(const char *arg, struct flex_get *getter)
         if (*arg == '@')
             getter->bit_offset = strtol(++arg, NULL, 0);
         else if (*arg == '{' || (*arg >= '0' && *arg <= '9')) {
-            getter->bit_count = parse_bits(arg, bitrow);
+            int bit_count = parse_bits(arg, bitrow);
+            if (bit_count < 0)
+                return -1;
+            getter->bit_count = bit_count;
             getter->mask = extract_number(bitrow, 0, getter->bit_count);
         }
         else if (*arg == '%') {
@@ -563,17 +566,36 @@ static void parse_getter(const char *arg, struct flex_get *getter)
     }
     if (!getter->name) {
         fprintf(stderr, "Bad flex spec, \"get\" missing name!\n");
-        usage();
+        return -1;
     }
     /*
     if (decoder->verbose)
         fprintf(stderr, "parse_getter() bit_offset: %d bit_count: %d mask: %lx name: %s\n",
                 getter->bit_offset, getter->bit_count, getter->mask, getter->name);
     */
+    return 0;
+}
+
+static void free_device(r_device *dev)
+{
+    struct flex_params *params = dev->decode_ctx;
+    if (params) {
+        for (int g = 0; g < GETTER_SLOTS; ++g) {
+            free((void *)params->getter[g].name);
+            free((void *)params->getter[g].format);
+            for (int m = 0; m < GETTER_MAP_SLOTS; ++m)
+                free((void *)params->getter[g].map[m].val);
+        }
+        free(params->name);
+        free(params);
+    }
+    free((void *)dev->name);
+    free(dev);
 }
 
 // NOTE: this is declared in rtl_433.c also.
 r_device *flex_create_device(char *spec);
+r_device *flex_try_create_device(char *spec);
 
 r_device *flex_create_device(char *spec)
 {
@@ -581,6 +603,19 @@ r_device *flex_create_device(char *spec)
         help();
     }
 
+    r_device *dev = flex_try_create_device(spec);
+    if (!dev)
+        usage();
+    return dev;
+}
+
+r_device *flex_try_create_device(char *spec)
+{
+    if (!spec || !*spec) {
+        fprintf(stderr, "Bad flex spec, empty!\n");
+        return NULL;
+    }
+
     struct flex_params *params = calloc(1, sizeof(*params));
     if (!params) {
         WARN_CALLOC("flex_create_device()");
@@ -598,6 +633,7 @@ r_device *flex_create_device(char *spec)
     spec = strdup(spec);
     if (!spec)
         FATAL_STRDUP("flex_create_device()");
+    char *spec_buf = spec; // getkwargs() advances the spec
 
     dev->decode_fn = flex_callback;
     dev->fields = output_fields;
@@ -664,11 +700,19 @@ r_device *flex_create_device(char *spec)
         else if (!strcasecmp(key, "reflect"))
             params->reflect = val ? atoi(val) : 1;
 
-        else if (!strcasecmp(key, "match"))
-            params->match_len = parse_bits(val, params->match_bits);
+        else if (!strcasecmp(key, "match")) {
+            int len = parse_bits(val, params->match_bits);
+            if (len < 0)
+                goto spec_error;
+            params->match_len = len;
+        }
 
-        else if (!strcasecmp(key, "preamble"))
-            params->preamble_len = parse_bits(val, params->preamble_bits);
+        else if (!strcasecmp(key, "preamble")) {
+            int len = parse_bits(val, params->preamble_bits);
+            if (len < 0)
+                goto spec_error;
+            params->preamble_len = len;
+        }
 
         else if (!strcasecmp(key, "countonly"))
             params->count_only = val ? atoi(val) : 1;
@@ -681,24 +725,32 @@ r_device *flex_create_device(char *spec)
         else if (!strcasecmp(key, "decode_dm"))
             params->decode_dm = val ? atoi(val) : 1;
 
-        else if (!strcasecmp(key, "symbol_zero"))
-            params->symbol_zero = parse_symbol(val);
-        else if (!strcasecmp(key, "symbol_one"))
-            params->symbol_one = parse_symbol(val);
-        else if (!strcasecmp(key, "symbol_sync"))
-            params->symbol_sync = parse_symbol(val);
+        else if (!strcasecmp(key, "symbol_zero")) {
+            if (!(params->symbol_zero = parse_symbol(val)))
+                goto spec_error;
+        }
+        else if (!strcasecmp(key, "symbol_one")) {
+            if (!(params->symbol_one = parse_symbol(val)))
+                goto spec_error;
+        }
+        else if (!strcasecmp(key, "symbol_sync")) {
+            if (!(params->symbol_sync = parse_symbol(val)))
+                goto spec_error;
+        }
 
         else if (!strcasecmp(key, "get")) {
-            if (get_count < GETTER_SLOTS)
-                parse_getter(val, &params->getter[get_count++]);
+            if (get_count < GETTER_SLOTS) {
+                if (parse_getter(val, &params->getter[get_count++]))
+                    goto spec_error;
+            }
             else {
                 fprintf(stderr, "Maximum getter slots exceeded (%d)!\n", GETTER_SLOTS);
-                usage();
+                goto spec_error;
             }
 
         } else {
             fprintf(stderr, "Bad flex spec, unknown keyword (%s)!\n", key);
-            usage();
+            goto spec_error;
         }
     }
 
@@ -726,30 +778,30 @@ r_device *flex_create_device(char *spec)
 
     if (!params->name || !*params->name) {
         fprintf(stderr, "Bad flex spec, missing name!\n");
-        usage();
+        goto spec_error;
     }
 
     if (!dev->modulation) {
         fprintf(stderr, "Bad flex spec, missing modulation!\n");
-        usage();
+        goto spec_error;
     }
 
     if (!dev->short_width) {
         fprintf(stderr, "Bad flex spec, missing short width!\n");
-        usage();
+        goto spec_error;
     }
 
     if (dev->modulation != OOK_PULSE_MANCHESTER_ZEROBIT
             && dev->modulation != FSK_PULSE_MANCHESTER_ZEROBIT) {
         if (!dev->long_width) {
             fprintf(stderr, "Bad flex spec, missing long width!\n");
-            usage();
+            goto spec_error;
         }
     }
 
     if (!dev->reset_limit) {
         fprintf(stderr, "Bad flex spec, missing reset limit!\n");
-        usage();
+        goto spec_error;
     }
 
     if (dev->modulation == OOK_PULSE_DMC
@@ -757,17 +809,17 @@ r_device *flex_create_device(char *spec)
             || dev->modulation == OOK_PULSE_PIWM_DC) {
         if (!dev->tolerance) {
             fprintf(stderr, "Bad flex spec, missing tolerance limit!\n");
-            usage();
+            goto spec_error;
         }
     }
 
     if (params->symbol_zero && !params->symbol_one) {
         fprintf(stderr, "Bad flex spec, symbol-one missing!\n");
-        usage();
+        goto spec_error;
     }
     if (params->symbol_one && !params->symbol_zero) {
         fprintf(stderr, "Bad flex spec, symbol-zero missing!\n");
-        usage();
+        goto spec_error;
     }
 
     /*
@@ -780,6 +832,11 @@ r_device *flex_create_device(char *spec)
     }
     */
 
-    free(spec);
+    free(spec_buf);
     return dev;
+
+spec_error:
+    free(spec_buf);
+    free_device(dev);
+    return NULL;
 }
@@ -594,6 +594,30 @@ static int oregon_scientific_v2_1_decode(r_device *decoder, bitbuffer_t *bitbuff
 // ceil((335 + 11) / 8)
 #define EXPECTED_NUM_BYTES 44
 
+/// Find the first position of each 16 bit preamble in row 0 in a single pass,
+/// same as a bitbuffer_search() for each preamble, not found is the row length.
+static void find_preambles(bitbuffer_t *bitbuffer, uint16_t const *preambles, unsigned *pos, unsigned count)
+{
+    uint8_t const *b = bitbuffer->bb[0];
+    unsigned len     = bitbuffer->bits_per_row[0];
+    unsigned missing = count;
+    for (unsigned k = 0; k < count; ++k)
+        pos[k] = len;
+
+    uint16_t window = 0;
+    for (unsigned i = 0; i < len && missing; ++i) {
+        window = (uint16_t)(window << 1) | ((b[i >> 3] >> (7 - (i & 7))) & 1);
+        if (i < 15)
+            continue;
+        for (unsigned k = 0; k < count; ++k) {
+            if (pos[k] == len && window == preambles[k]) {
+                pos[k] = i - 15;
+                missing--;
+            }
+        }
+    }
+}
+
 /**
 Various Oregon Scientific protocols.
 
@@ -621,19 +645,19 @@ static int oregon_scientific_v3_decode(r_device *decoder, bitbuffer_t *bitbuffer
     // aligned (at 11) and reflected that's 3 packets:
     // {324} 00 0a 19 84 00 e0 00 c0 00 00 00 3d 70   00 00 0a 19 84 00 e0 00 c0 00 00 00 3d 70   00 00 0a 19 84 00 e0 00 c0 00 00 00 3d 70
 
-    // full preamble is 00 00 00 5 (shorter for WGR800X)
-    uint8_t const os_pattern[] = {0x00, 0x05};
-    // CM180 preamble is 00 00 00 46, with 0x46 already data
-    uint8_t const cm180_pattern[] = {0x00, 0x46};
-    uint8_t const cm180i_pattern[] = {0x00, 0x4A};
-    // workaround for a broken manchester demod
-    // CM160 preamble might look like 7f ff ff aa, i.e. ff ff f5
-    uint8_t const alt_pattern[] = {0xff, 0xf5};
-
-    int os_pos    = bitbuffer_search(bitbuffer, 0, 0, os_pattern, 16) + 16;
-    int cm180_pos = bitbuffer_search(bitbuffer, 0, 0, cm180_pattern, 16) + 8; // keep the 0x46
-    int cm180i_pos = bitbuffer_search(bitbuffer, 0, 0, cm180i_pattern, 16) + 8; // keep the 0x46
-    int alt_pos   = bitbuffer_search(bitbuffer, 0, 0, alt_pattern, 16) + 16;
+    uint16_t const preambles[] = {
+            0x0005, // full preamble is 00 00 00 5 (shorter for WGR800X)
+            0x0046, // CM180 preamble is 00 00 00 46, with 0x46 already data
+            0x004A, // CM180i preamble
+            0xfff5, // workaround for a broken manchester demod, CM160 preamble might look like 7f ff ff aa, i.e. ff ff f5
+    };
+    unsigned pos[4];
+    find_preambles(bitbuffer, preambles, pos, 4);
+
+    int os_pos     = pos[0] + 16;
+    int cm180_pos  = pos[1] + 8; // keep the 0x46
+    int cm180i_pos = pos[2] + 8; // keep the 0x4A
+    int alt_pos    = pos[3] + 16;
 
     if (bitbuffer->bits_per_row[0] - os_pos >= 7 * 8) {
         msg_pos = os_pos;
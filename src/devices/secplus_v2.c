@@ -234,6 +234,16 @@ static int secplus_v2_decode_v2_half(r_device *decoder, bitbuffer_t *bits, uint8
     return 0;
 }
 
+/// A single half, until the other half arrives.
+typedef struct {
+    uint8_t rolling_1[16];
+    uint8_t rolling_2[16];
+    uint8_t fixed_1[3];
+    uint8_t fixed_2[3];
+    uint8_t have_1;
+    uint8_t have_2;
+} secplus_v2_frame_t;
+
 static const uint8_t _preamble[] = {0xaa, 0xaa, 0x95, 0x60};
 unsigned _preamble_len           = 28;
 
@@ -297,11 +307,45 @@ static int secplus_v2_callback(r_device *decoder, bitbuffer_t *bitbuffer)
         }
     }
 
-    // Do we have what we need ??
-    if (fixed_1.bits_per_row[0] == 0 || fixed_2.bits_per_row[0] == 0) {
+    if (fixed_1.bits_per_row[0] == 0 && fixed_2.bits_per_row[0] == 0) {
         return DECODE_FAIL_SANITY;
     }
 
+    // The halves usually come in separate bursts, keep a single half until the other one arrives.
+    // Each half carries different fixed bits (the upper and lower 20 bits), there is no common
+    // id to key on, but a half with other fixed bits than the one kept is from another remote or
+    // button and starts a new frame.
+    if (fixed_1.bits_per_row[0] == 0 || fixed_2.bits_per_row[0] == 0) {
+        secplus_v2_frame_t *frame = decoder_frame_state(decoder, 0, sizeof(*frame), NULL);
+        if (!frame) {
+            return DECODE_FAIL_SANITY;
+        }
+        if (fixed_1.bits_per_row[0]) {
+            if (frame->have_1 && memcmp(frame->fixed_1, fixed_1.bb[0], sizeof(frame->fixed_1))) {
+                memset(frame, 0, sizeof(*frame));
+            }
+            memcpy(frame->rolling_1, rolling_1, sizeof(frame->rolling_1));
+            memcpy(frame->fixed_1, fixed_1.bb[0], sizeof(frame->fixed_1));
+            frame->have_1 = 1;
+        }
+        else {
+            if (frame->have_2 && memcmp(frame->fixed_2, fixed_2.bb[0], sizeof(frame->fixed_2))) {
+                memset(frame, 0, sizeof(*frame));
+            }
+            memcpy(frame->rolling_2, rolling_2, sizeof(frame->rolling_2));
+            memcpy(frame->fixed_2, fixed_2.bb[0], sizeof(frame->fixed_2));
+            frame->have_2 = 1;
+        }
+        if (!frame->have_1 || !frame->have_2) {
+            return DECODE_PARTIAL;
+        }
+        memcpy(rolling_1, frame->rolling_1, sizeof(frame->rolling_1));
+        memcpy(fixed_1.bb[0], frame->fixed_1, sizeof(frame->fixed_1));
+        memcpy(rolling_2, frame->rolling_2, sizeof(frame->rolling_2));
+        memcpy(fixed_2.bb[0], frame->fixed_2, sizeof(frame->fixed_2));
+        decoder_frame_done(decoder, 0);
+    }
+
     // Assemble rolling_1[] and rolling_2[] into rolling_digits[]
     uint8_t rolling_digits[24] = {0};
     uint8_t *r;
@@ -395,13 +439,14 @@ static char const *const output_fields[] = {
 //  -X "n=vI3,m=OOK_PCM,s=230,l=230,t=40,r=10000,g=7400,match={24}0xaaaa9560"
 
 r_device const secplus_v2 = {
-        .name        = "Security+ 2.0 (Keyfob)",
-        .modulation  = OOK_PULSE_PCM,
-        .short_width = 250,
-        .long_width  = 250,
-        .tolerance   = 50,
-        .gap_limit   = 1500,
-        .reset_limit = 9000,
-        .decode_fn   = &secplus_v2_callback,
-        .fields      = output_fields,
+        .name         = "Security+ 2.0 (Keyfob)",
+        .modulation   = OOK_PULSE_PCM,
+        .short_width  = 250,
+        .long_width   = 250,
+        .tolerance    = 50,
+        .gap_limit    = 1500,
+        .reset_limit  = 9000,
+        .decode_fn    = &secplus_v2_callback,
+        .fields       = output_fields,
+        .frame_ttl_ms = 1000,
 };
@@ -0,0 +1,530 @@
+/** @file
+    On-disk event history ring with a sparse time and sequence index.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+/*
+The history file is a header, an index table, and a ring of records:
+
+    [header (4096 bytes)] [index (index_size * 24 bytes)] [data ring (data_size bytes)]
+
+Records are 8-byte aligned, a record header is followed by the model name and
+the serialized event. If a record does not fit before the end of the ring a
+wrap marker (or less than a record header of slack) sends readers to offset 0.
+
+Appends first drop the oldest records in the way, then write the record, then
+commit the new tail and sequence in the header. On open the records are walked
+from the head and checked for magic, sequence, and checksum, which drops a torn
+append and recovers an uncommitted one.
+
+Every data_size / index_size appended bytes an index entry (sequence, offset, time)
+is added, so lookups by time or sequence only need a short scan.
+*/
+
+#include "event_history.h"
+#include "fatal.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define HISTORY_MAGIC "R433EVH1"
+#define HISTORY_VERSION 1
+#define HISTORY_HEADER_SIZE 4096
+#define HISTORY_INDEX_SIZE 4096
+#define RECORD_MAGIC 0x52454331 // "REC1"
+#define WRAP_MAGIC   0x57524150 // "WRAP"
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t index_size;   ///< number of index entries
+    uint64_t data_size;    ///< size of the data ring
+    uint64_t head;         ///< offset of the oldest record
+    uint64_t tail;         ///< offset of the next record
+    uint64_t head_seq;     ///< sequence number of the oldest record
+    uint64_t next_seq;     ///< sequence number of the next record
+    uint64_t count;        ///< number of records
+    uint64_t index_bytes;  ///< bytes appended since the last index entry
+    uint32_t index_head;   ///< oldest index entry
+    uint32_t index_count;  ///< number of index entries
+} history_header_t;
+
+typedef struct {
+    uint64_t seq;
+    uint64_t offset;
+    double time;
+} history_index_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t checksum; ///< over the rest of the header and the payload
+    uint64_t seq;
+    double time;
+    uint16_t model_len;
+    uint16_t reserved;
+    uint32_t json_len;
+} history_record_t;
+
+struct event_history {
+    int fd;
+    size_t map_size;
+    unsigned char *map;
+    history_header_t *hdr;
+    history_index_t *index;
+    unsigned char *data;
+};
+
+#define RECORD_SIZE(model_len, json_len) ((sizeof(history_record_t) + (model_len) + (json_len) + 7) & ~(size_t)7)
+
+static uint32_t fnv1a(uint32_t hash, void const *buf, size_t len)
+{
+    unsigned char const *p = buf;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= p[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t record_checksum(history_record_t const *rec)
+{
+    uint32_t hash = 2166136261u;
+    hash = fnv1a(hash, &rec->seq, sizeof(*rec) - offsetof(history_record_t, seq));
+    return fnv1a(hash, rec + 1, (size_t)rec->model_len + rec->json_len);
+}
+
+/// Return the record at the offset, NULL on a wrap.
+static history_record_t *record_at(event_history_t *h, uint64_t offset)
+{
+    if (offset + sizeof(history_record_t) > h->hdr->data_size)
+        return NULL;
+    history_record_t *rec = (history_record_t *)(h->data + offset);
+    if (rec->magic == WRAP_MAGIC)
+        return NULL;
+    return rec;
+}
+
+/// Return the offset of the record following the one at the offset, wrapping to 0.
+static uint64_t record_next(event_history_t *h, uint64_t offset)
+{
+    history_record_t *rec = record_at(h, offset);
+    if (!rec)
+        return 0;
+    offset += RECORD_SIZE(rec->model_len, rec->json_len);
+    if (!record_at(h, offset))
+        return 0;
+    return offset;
+}
+
+/// Check if a valid record with the sequence number is at the offset (or after a wrap).
+static history_record_t *record_valid(event_history_t *h, uint64_t *offset, uint64_t seq)
+{
+    history_record_t *rec = record_at(h, *offset);
+    if (!rec) {
+        *offset = 0;
+        rec     = record_at(h, 0);
+    }
+    if (!rec || rec->magic != RECORD_MAGIC || rec->seq != seq)
+        return NULL;
+    if (*offset + RECORD_SIZE(rec->model_len, rec->json_len) > h->hdr->data_size)
+        return NULL;
+    if (rec->checksum != record_checksum(rec))
+        return NULL;
+    return rec;
+}
+
+static void history_init(event_history_t *h, uint64_t data_size)
+{
+    memset(h->map, 0, HISTORY_HEADER_SIZE + HISTORY_INDEX_SIZE * sizeof(history_index_t));
+    memcpy(h->hdr->magic, HISTORY_MAGIC, sizeof(h->hdr->magic));
+    h->hdr->version    = HISTORY_VERSION;
+    h->hdr->index_size = HISTORY_INDEX_SIZE;
+    h->hdr->data_size  = data_size;
+    h->hdr->head_seq   = 1;
+    h->hdr->next_seq   = 1;
+    // invalidate the first record
+    memset(h->data, 0, sizeof(history_record_t));
+}
+
+/// Walk the records from the head and fix the tail, count, and sequence.
+static void history_recover(event_history_t *h)
+{
+    history_header_t *hdr = h->hdr;
+    uint64_t offset = hdr->head;
+    uint64_t seq    = hdr->head_seq;
+    uint64_t count  = 0;
+    uint64_t max    = hdr->data_size / sizeof(history_record_t);
+    while (count < max && record_valid(h, &offset, seq)) {
+        if (count == 0)
+            hdr->head = offset;
+        offset = record_next(h, offset);
+        seq++;
+        count++;
+    }
+    hdr->tail     = count ? offset : hdr->head;
+    hdr->next_seq = seq;
+    hdr->count    = count;
+}
+
+event_history_t *event_history_open(char const *path, size_t size)
+{
+#ifdef _WIN32
+    (void)path;
+    (void)size;
+    errno = ENOSYS;
+    return NULL;
+#else
+    if (size < 64 * 1024)
+        size = 64 * 1024;
+    size &= ~(size_t)7;
+
+    event_history_t *h = calloc(1, sizeof(*h));
+    if (!h) {
+        WARN_CALLOC("event_history_open()");
+        return NULL;
+    }
+
+    h->map_size = HISTORY_HEADER_SIZE + HISTORY_INDEX_SIZE * sizeof(history_index_t) + size;
+
+    h->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (h->fd < 0) {
+        free(h);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(h->fd, &st) != 0 || ((size_t)st.st_size != h->map_size && ftruncate(h->fd, (off_t)h->map_size) != 0)) {
+        close(h->fd);
+        free(h);
+        return NULL;
+    }
+    int fresh = (size_t)st.st_size != h->map_size;
+
+    h->map = mmap(NULL, h->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, h->fd, 0);
+    if (h->map == MAP_FAILED) {
+        close(h->fd);
+        free(h);
+        return NULL;
+    }
+    h->hdr   = (history_header_t *)h->map;
+    h->index = (history_index_t *)(h->map + HISTORY_HEADER_SIZE);
+    h->data  = h->map + HISTORY_HEADER_SIZE + HISTORY_INDEX_SIZE * sizeof(history_index_t);
+
+    if (fresh
+            || memcmp(h->hdr->magic, HISTORY_MAGIC, sizeof(h->hdr->magic))
+            || h->hdr->version != HISTORY_VERSION
+            || h->hdr->index_size != HISTORY_INDEX_SIZE
+            || h->hdr->data_size != size
+            || h->hdr->head >= size
+            || h->hdr->index_head >= HISTORY_INDEX_SIZE
+            || h->hdr->index_count > HISTORY_INDEX_SIZE) {
+        history_init(h, size);
+    }
+    else {
+        history_recover(h);
+    }
+
+    return h;
+#endif
+}
+
+void event_history_close(event_history_t *h)
+{
+    if (!h)
+        return;
+#ifndef _WIN32
+    msync(h->map, h->map_size, MS_SYNC);
+    munmap(h->map, h->map_size);
+    close(h->fd);
+#endif
+    free(h);
+}
+
+/// Drop the oldest records while the head is within the range.
+static void history_evict(event_history_t *h, uint64_t start, uint64_t end)
+{
+    history_header_t *hdr = h->hdr;
+    while (hdr->count > 0 && hdr->head >= start && hdr->head < end) {
+        hdr->head = record_next(h, hdr->head);
+        hdr->head_seq++;
+        hdr->count--;
+    }
+}
+
+uint64_t event_history_append(event_history_t *h, char const *model, char const *json, size_t len, double time)
+{
+    if (!h || !json)
+        return 0;
+    history_header_t *hdr = h->hdr;
+
+    size_t model_len = model ? strlen(model) : 0;
+    if (model_len > UINT16_MAX)
+        model_len = UINT16_MAX;
+    size_t size = RECORD_SIZE(model_len, len);
+    if (size > hdr->data_size / 2)
+        return 0; // too large
+
+    // wrap if the record does not fit before the end
+    if (hdr->tail + size > hdr->data_size) {
+        history_evict(h, hdr->tail, hdr->data_size);
+        if (hdr->tail + sizeof(history_record_t) <= hdr->data_size)
+            ((history_record_t *)(h->data + hdr->tail))->magic = WRAP_MAGIC;
+        hdr->tail = 0;
+    }
+    history_evict(h, hdr->tail, hdr->tail + size);
+
+    uint64_t offset = hdr->tail;
+    history_record_t *rec = (history_record_t *)(h->data + offset);
+    rec->magic     = RECORD_MAGIC;
+    rec->seq       = hdr->next_seq;
+    rec->time      = time;
+    rec->model_len = (uint16_t)model_len;
+    rec->reserved  = 0;
+    rec->json_len  = (uint32_t)len;
+    if (model_len)
+        memcpy(rec + 1, model, model_len);
+    memcpy((char *)(rec + 1) + model_len, json, len);
+    rec->checksum = record_checksum(rec);
+    // invalidate a stale record after this one
+    uint64_t next = offset + size;
+    if (next + sizeof(history_record_t) <= hdr->data_size && !(hdr->count > 0 && next == hdr->head))
+        ((history_record_t *)(h->data + next))->magic = 0;
+
+    // commit
+    if (hdr->count == 0) {
+        hdr->head     = offset;
+        hdr->head_seq = rec->seq;
+    }
+    hdr->tail = next;
+    hdr->next_seq++;
+    hdr->count++;
+
+    // sparse index, one entry per share of the ring
+    if (hdr->index_count == 0 || hdr->index_bytes >= hdr->data_size / hdr->index_size) {
+        uint32_t slot = (hdr->index_head + hdr->index_count) % hdr->index_size;
+        if (hdr->index_count == hdr->index_size)
+            hdr->index_head = (hdr->index_head + 1) % hdr->index_size;
+        else
+            hdr->index_count++;
+        h->index[slot] = (history_index_t){.seq = rec->seq, .offset = offset, .time = time};
+        hdr->index_bytes = 0;
+    }
+    hdr->index_bytes += size;
+
+    return rec->seq;
+}
+
+/// Find a record to start scanning from, before the time and sequence.
+static void history_seek(event_history_t *h, double since, uint64_t after_seq, uint64_t *offset, uint64_t *seq)
+{
+    history_header_t *hdr = h->hdr;
+    *offset = hdr->head;
+    *seq    = hdr->head_seq;
+    for (uint32_t i = 0; i < hdr->index_count; ++i) {
+        history_index_t const *e = &h->index[(hdr->index_head + i) % hdr->index_size];
+        if (e->seq < hdr->head_seq || e->seq >= hdr->next_seq)
+            continue; // evicted or not committed
+        if ((since > 0.0 && e->time > since) || (after_seq && e->seq > after_seq + 1))
+            break;
+        *offset = e->offset;
+        *seq    = e->seq;
+    }
+}
+
+static int record_matches(history_record_t const *rec, double since, uint64_t after_seq, char const *model, size_t model_len)
+{
+    return rec->time >= since
+            && rec->seq > after_seq
+            && (!model || (rec->model_len == model_len && !memcmp(rec + 1, model, model_len)));
+}
+
+/// Count the matching records from the offset and sequence up to the end sequence.
+static uint64_t count_matches(event_history_t *h, uint64_t offset, uint64_t seq, uint64_t end_seq, char const *model, size_t model_len)
+{
+    uint64_t matches = 0;
+    for (; seq < end_seq; ++seq) {
+        matches += record_matches(record_at(h, offset), 0.0, 0, model, model_len);
+        offset = record_next(h, offset);
+    }
+    return matches;
+}
+
+/// Find a record to start scanning from for the most recent matches and the number of matches to skip.
+///
+/// Counts backward by index segments, so only the tail of the ring is scanned.
+static uint64_t history_seek_tail(event_history_t *h, char const *model, size_t model_len, unsigned limit, uint64_t *offset, uint64_t *seq)
+{
+    history_header_t *hdr = h->hdr;
+    uint64_t end_seq = hdr->next_seq;
+    uint64_t matches = 0;
+    for (uint32_t i = hdr->index_count; i > 0; --i) {
+        history_index_t const *e = &h->index[(hdr->index_head + i - 1) % hdr->index_size];
+        if (e->seq < hdr->head_seq || e->seq >= end_seq)
+            continue; // evicted or not committed
+        matches += count_matches(h, e->offset, e->seq, end_seq, model, model_len);
+        end_seq = e->seq;
+        if (matches >= limit) {
+            *offset = e->offset;
+            *seq    = e->seq;
+            return matches - limit;
+        }
+    }
+    matches += count_matches(h, hdr->head, hdr->head_seq, end_seq, model, model_len);
+    *offset = hdr->head;
+    *seq    = hdr->head_seq;
+    return matches > limit ? matches - limit : 0;
+}
+
+unsigned event_history_query(event_history_t *h, double since, uint64_t after_seq, char const *model, unsigned limit, event_history_fn cb, void *ctx)
+{
+    if (!h || !limit)
+        return 0;
+    history_header_t *hdr = h->hdr;
+    size_t model_len = model ? strlen(model) : 0;
+
+    // without a start point return the most recent events, skipping the older matches
+    uint64_t offset, seq;
+    uint64_t skip = 0;
+    if (since <= 0.0 && !after_seq)
+        skip = history_seek_tail(h, model, model_len, limit, &offset, &seq);
+    else
+        history_seek(h, since, after_seq, &offset, &seq);
+
+    unsigned found = 0;
+    for (; seq < hdr->next_seq && found < limit; ++seq) {
+        history_record_t *rec = record_at(h, offset);
+        if (record_matches(rec, since, after_seq, model, model_len)) {
+            if (skip) {
+                skip--;
+            }
+            else {
+                cb(ctx, rec->seq, (char const *)(rec + 1) + rec->model_len, rec->json_len);
+                found++;
+            }
+        }
+        offset = record_next(h, offset);
+    }
+    return found;
+}
+
+// Unit testing
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+typedef struct {
+    unsigned count;
+    uint64_t first;
+    uint64_t last;
+} collect_t;
+
+static void collect(void *ctx, uint64_t seq, char const *json, size_t len)
+{
+    collect_t *c = ctx;
+    (void)json;
+    (void)len;
+    if (!c->count)
+        c->first = seq;
+    c->last = seq;
+    c->count++;
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+    char const *path = "test_event_history.tmp";
+    char json[200];
+    collect_t c;
+
+    remove(path);
+    event_history_t *h = event_history_open(path, 64 * 1024);
+    if (!h) {
+        fprintf(stderr, "event_history:: skipped (no mmap)\n");
+        return 0;
+    }
+
+    fprintf(stderr, "event_history:: append\n");
+    for (int i = 1; i <= 1000; ++i) {
+        int len = snprintf(json, sizeof(json), "{\"model\" : \"%s\", \"id\" : %d, \"pad\" : \"%080d\"}", i % 2 ? "odd" : "even", i, 0);
+        ASSERT_EQUALS(event_history_append(h, i % 2 ? "odd" : "even", json, len, 1000.0 + i), (uint64_t)i);
+    }
+
+    fprintf(stderr, "event_history:: query\n");
+    c = (collect_t){0};
+    ASSERT_EQUALS(event_history_query(h, 0.0, 0, NULL, 10, collect, &c), 10);
+    ASSERT_EQUALS(c.first, 991);
+    ASSERT_EQUALS(c.last, 1000);
+    c = (collect_t){0};
+    ASSERT_EQUALS(event_history_query(h, 0.0, 0, "even", 3, collect, &c), 3);
+    ASSERT_EQUALS(c.first, 996);
+    ASSERT_EQUALS(c.last, 1000);
+    c = (collect_t){0};
+    ASSERT_EQUALS(event_history_query(h, 1900.0, 0, "odd", 5, collect, &c), 5);
+    ASSERT_EQUALS(c.first, 901);
+    ASSERT_EQUALS(c.last, 909);
+    c = (collect_t){0};
+    ASSERT_EQUALS(event_history_query(h, 0.0, 995, NULL, 100, collect, &c), 5);
+    ASSERT_EQUALS(c.first, 996);
+    // the oldest events were dropped
+    c = (collect_t){0};
+    event_history_query(h, 1.0, 0, NULL, 1000, collect, &c);
+    ASSERT_EQUALS(c.last, 1000);
+    ASSERT_EQUALS(c.first > 1, 1);
+    ASSERT_EQUALS(c.count, 1000 - c.first + 1);
+    uint64_t first = c.first;
+    // the most recent matches span all of the ring
+    c = (collect_t){0};
+    event_history_query(h, 0.0, 0, "odd", 1000, collect, &c);
+    ASSERT_EQUALS(c.first, first | 1);
+    ASSERT_EQUALS(c.last, 999);
+    ASSERT_EQUALS(c.count, (999 - (first | 1)) / 2 + 1);
+
+    fprintf(stderr, "event_history:: reopen\n");
+    event_history_close(h);
+    h = event_history_open(path, 64 * 1024);
+    c = (collect_t){0};
+    event_history_query(h, 1.0, 0, NULL, 1000, collect, &c);
+    ASSERT_EQUALS(c.first, first);
+    ASSERT_EQUALS(c.last, 1000);
+    ASSERT_EQUALS(event_history_append(h, "odd", "{}", 2, 3000.0), 1001);
+
+    fprintf(stderr, "event_history:: torn append\n");
+    // corrupt the last record, it is dropped on open
+    h->data[h->hdr->tail - 8] ^= 0xff;
+    event_history_close(h);
+    h = event_history_open(path, 64 * 1024);
+    c = (collect_t){0};
+    event_history_query(h, 0.0, 0, NULL, 1, collect, &c);
+    ASSERT_EQUALS(c.last, 1000);
+    ASSERT_EQUALS(event_history_append(h, "odd", "{}", 2, 3000.0), 1001);
+
+    event_history_close(h);
+    remove(path);
+
+    fprintf(stderr, "event_history:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+
+    return failed;
+}
+#endif /* _TEST */
@@ -225,6 +225,29 @@ static char const *last_plain_colon(char const *p)
     return found;
 }
 
+static int is_range_key(char const *p)
+{
+    return !strncmp(p, "start=", 6)
+            || !strncmp(p, "end=", 4)
+            || !strncmp(p, "preroll=", 8)
+            || !strncmp(p, "t0=", 3);
+}
+
+char *file_info_split_range(char *filename)
+{
+    if (!filename) {
+        return NULL;
+    }
+
+    for (char *p = strchr(filename, ':'); p; p = strchr(p + 1, ':')) {
+        if (is_range_key(p + 1)) {
+            *p = '\0';
+            return p + 1;
+        }
+    }
+    return NULL;
+}
+
 /**
 This will detect file info and overrides.
 
@@ -298,10 +321,30 @@ static void assert_str_equal(char const *a, char const *b)
     }
 }
 
+static void assert_split_range(char const *spec, char const *path, char const *range)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", spec);
+    char *ret = file_info_split_range(buf);
+    if (strcmp(buf, path) || (ret != range && (!ret || !range || strcmp(ret, range)))) {
+        fprintf(stderr, "\nTEST failed: file_info_split_range(\"%s\") = \"%s\", \"%s\"\n", spec, buf, ret ? ret : "(null)");
+    } else {
+        fprintf(stderr, ".");
+    }
+}
+
 int main(void)
 {
     fprintf(stderr, "Testing:\n");
 
+    assert_split_range("foo.cu8", "foo.cu8", NULL);
+    assert_split_range("cu8:foo", "cu8:foo", NULL);
+    assert_split_range("foo.cu8:start=10s", "foo.cu8", "start=10s");
+    assert_split_range("foo.cu8:start=1:30,end=1:35", "foo.cu8", "start=1:30,end=1:35");
+    assert_split_range("cu8:C:\\foo.bin:end=25000", "cu8:C:\\foo.bin", "end=25000");
+    assert_split_range("am:s16:foo:preroll=2s,t0=@1700000000", "am:s16:foo", "preroll=2s,t0=@1700000000");
+    assert_split_range("foo:starter", "foo:starter", NULL);
+
     assert_str_equal(last_plain_colon("foo:bar:baz"), ":baz");
     assert_str_equal(last_plain_colon("foo"), NULL);
     assert_str_equal(last_plain_colon(":foo"), ":foo");
@@ -0,0 +1,220 @@
+/** @file
+    Bounded table of partial frames, keyed and dropped by age.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+/*
+A decoder that needs multiple packages for a frame, e.g. two halves sent
+in separate bursts, keeps the decoded parts here instead of in its own
+context. The table is small and scanned linearly, it holds a fixed number
+of states of a fixed size, allocated once.
+*/
+
+#include "frame_table.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct frame_slot {
+    uint64_t key;
+    uint64_t time_ms; ///< time of the last part
+    int used;
+} frame_slot_t;
+
+struct frame_table {
+    unsigned slots;
+    size_t state_size;
+    frame_slot_t *slot;
+    unsigned char *states;
+};
+
+frame_table_t *frame_table_create(unsigned slots, size_t state_size)
+{
+    if (!slots || !state_size || state_size > FRAME_STATE_MAX)
+        return NULL;
+
+    frame_table_t *t = calloc(1, sizeof(*t));
+    if (!t)
+        return NULL;
+    t->slots      = slots;
+    t->state_size = state_size;
+
+    t->slot = calloc(slots, sizeof(*t->slot));
+    if (!t->slot) {
+        free(t);
+        return NULL;
+    }
+    t->states = calloc(slots, state_size);
+    if (!t->states) {
+        free(t->slot);
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+void frame_table_free(frame_table_t *t)
+{
+    if (!t)
+        return;
+    free(t->states);
+    free(t->slot);
+    free(t);
+}
+
+size_t frame_table_state_size(frame_table_t const *t)
+{
+    return t->state_size;
+}
+
+static void *reset_slot(frame_table_t *t, unsigned i, uint64_t key, uint64_t now_ms)
+{
+    t->slot[i].key     = key;
+    t->slot[i].time_ms = now_ms;
+    t->slot[i].used    = 1;
+    void *state = &t->states[i * t->state_size];
+    memset(state, 0, t->state_size);
+    return state;
+}
+
+/// A time before the last part, e.g. a new input file, also counts as expired.
+static int slot_expired(frame_slot_t const *s, uint64_t now_ms, unsigned ttl_ms)
+{
+    return now_ms < s->time_ms || now_ms - s->time_ms > ttl_ms;
+}
+
+void *frame_table_get(frame_table_t *t, uint64_t key, uint64_t now_ms, unsigned ttl_ms, int *lookup)
+{
+    unsigned free_slot = t->slots;
+    unsigned oldest    = 0;
+    for (unsigned i = 0; i < t->slots; ++i) {
+        frame_slot_t *s = &t->slot[i];
+        if (s->used && s->key == key) {
+            if (slot_expired(s, now_ms, ttl_ms)) {
+                *lookup = FRAME_EXPIRED;
+                return reset_slot(t, i, key, now_ms);
+            }
+            s->time_ms = now_ms;
+            *lookup    = FRAME_FOUND;
+            return &t->states[i * t->state_size];
+        }
+        if (free_slot == t->slots && (!s->used || slot_expired(s, now_ms, ttl_ms)))
+            free_slot = i;
+        if (s->time_ms < t->slot[oldest].time_ms)
+            oldest = i;
+    }
+
+    if (free_slot < t->slots) {
+        *lookup = FRAME_NEW;
+        return reset_slot(t, free_slot, key, now_ms);
+    }
+    *lookup = FRAME_EVICTED;
+    return reset_slot(t, oldest, key, now_ms);
+}
+
+void frame_table_remove(frame_table_t *t, uint64_t key)
+{
+    for (unsigned i = 0; i < t->slots; ++i) {
+        if (t->slot[i].used && t->slot[i].key == key)
+            t->slot[i].used = 0;
+    }
+}
+
+unsigned frame_table_count(frame_table_t const *t)
+{
+    unsigned count = 0;
+    for (unsigned i = 0; i < t->slots; ++i)
+        count += t->slot[i].used;
+    return count;
+}
+
+#ifdef _TEST
+#include <stdio.h>
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: line %d: %d <> %d\n", __LINE__, (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+typedef struct {
+    int parts;
+    uint8_t half[2][4];
+} test_state_t;
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    fprintf(stderr, "frame_table:: test\n");
+
+    ASSERT_EQUALS(frame_table_create(0, 8) == NULL, 1);
+    ASSERT_EQUALS(frame_table_create(4, FRAME_STATE_MAX + 1) == NULL, 1);
+
+    frame_table_t *t = frame_table_create(2, sizeof(test_state_t));
+    ASSERT_EQUALS(t != NULL, 1);
+    if (!t)
+        return 1;
+    int lookup;
+
+    // a frame in two parts
+    test_state_t *s = frame_table_get(t, 0x1234, 1000, 500, &lookup);
+    ASSERT_EQUALS(lookup, FRAME_NEW);
+    ASSERT_EQUALS(s->parts, 0);
+    s->parts = 1;
+    s = frame_table_get(t, 0x1234, 1400, 500, &lookup);
+    ASSERT_EQUALS(lookup, FRAME_FOUND);
+    ASSERT_EQUALS(s->parts, 1);
+    frame_table_remove(t, 0x1234);
+    ASSERT_EQUALS(frame_table_count(t), 0);
+
+    // the age is reset with each part
+    s = frame_table_get(t, 1, 2000, 500, &lookup);
+    s->parts = 1;
+    s = frame_table_get(t, 1, 2400, 500, &lookup);
+    s = frame_table_get(t, 1, 2800, 500, &lookup);
+    ASSERT_EQUALS(lookup, FRAME_FOUND);
+
+    // too old
+    s = frame_table_get(t, 1, 3400, 500, &lookup);
+    ASSERT_EQUALS(lookup, FRAME_EXPIRED);
+    ASSERT_EQUALS(s->parts, 0);
+
+    // time going backwards, e.g. a new input file
+    s->parts = 1;
+    s = frame_table_get(t, 1, 100, 500, &lookup);
+    ASSERT_EQUALS(lookup, FRAME_EXPIRED);
+
+    // full, the oldest is dropped
+    s = frame_table_get(t, 2, 200, 500, &lookup);
+    ASSERT_EQUALS(lookup, FRAME_NEW);
+    s->parts = 2;
+    s = frame_table_get(t, 3, 300, 500, &lookup);
+    ASSERT_EQUALS(lookup, FRAME_EVICTED);
+    ASSERT_EQUALS(frame_table_count(t), 2);
+    s = frame_table_get(t, 2, 350, 500, &lookup);
+    ASSERT_EQUALS(lookup, FRAME_FOUND);
+    ASSERT_EQUALS(s->parts, 2);
+
+    // an expired slot is reused before evicting
+    s = frame_table_get(t, 4, 900, 500, &lookup);
+    ASSERT_EQUALS(lookup, FRAME_NEW);
+
+    frame_table_free(t);
+
+    fprintf(stderr, "frame_table:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+
+    return failed;
+}
+#endif /* _TEST */
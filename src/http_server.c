@@ -19,6 +19,8 @@ A choice of endpoints are available:
 - "/cmd": simple JSON command API
 - "/events": HTTP (chunked) streaming API, streams JSON events
 - "/stream": HTTP (plain) streaming API, streams JSON events
+- "/spectrum": the averaged power spectrum and noise floor as JSON (needs `-M spectrum`)
+- "/iq": a snapshot of the recent IQ samples (needs `-F http,iq_size=<bytes>` or `-S`)
 - "/api": RESTful API (not implemented)
 - "ws:": Websocket API (similar to cmd/events API)
 
@@ -49,6 +51,32 @@ On Events and Stream endpoints a keep-alive of CRLF will be send every 60 second
 Use e.g. httpie with `http --stream --timeout=70 :8433/events`
 or `(echo "GET /stream HTTP/1.0\n"; sleep 600) | socat - tcp:127.0.0.1:8433`
 
+## HTTP event history
+
+With an on-disk history (`-F http,history=<file>`) the Events endpoint answers queries
+from the history instead of streaming, the stored JSON is sent as is, one per line:
+
+- "since": only events received at or after this Unix time, negative values are relative to now
+- "seq": only events after this sequence number
+- "model": only events with this model
+- "limit": the maximum number of events (default 100), the most recent if no "since" or "seq" is given
+
+The "X-Event-Seq" header has the sequence number of the last event sent, to continue with "seq".
+E.g. `http :8433/events since==-3600 model==Acurite-Tower limit==1000`
+
+## HTTP IQ snapshot
+
+With an in-memory IQ ring (`-F http,iq_size=<bytes>`, or the ring of `-S`) the IQ endpoint
+sends the most recent samples as a file, nothing is written to disk:
+
+- "seconds": the window length (default 5), limited by the ring size
+- "end": the window end as Unix time, negative values are relative to now, e.g. the time of an event
+- "format": "cs8" to convert to signed 8-bit, halves the size of CS16 input, otherwise the input format
+
+The filename in the "Content-Disposition" header has the frequency, sample rate, and format,
+as for `-S` files, to be read back with `-r`.
+E.g. `curl -OJ 'http://127.0.0.1:8433/iq?seconds=2&format=cs8'`
+
 ## Queries
 
 - "registered_protocols"
@@ -64,6 +92,17 @@ or `(echo "GET /stream HTTP/1.0\n"; sleep 600) | socat - tcp:127.0.0.1:8433`
     .reset_limit
     .fields
 
+- "get_spectrum": the averaged power spectrum and noise floor (needs `-M spectrum`)
+    .center_frequency
+    .sample_rate
+    .fft_size
+    .ffts
+    .noise_floor_db
+    .peak_db
+    .peak_freq
+    .fft_load: fraction of the time spent on the FFTs
+    .bins_db: DC centered power bins in dBFS
+
 - "device_info"
     device  0:  Realtek, RTL2838UHIDIR, SN: 00000001
     Found Rafael Micro R820T tuner
@@ -91,6 +130,15 @@ or `(echo "GET /stream HTTP/1.0\n"; sleep 600) | socat - tcp:127.0.0.1:8433`
 - "convert":          "native"|"si"|"customary"
 - "protocol":         1
 
+## Decoder reconfiguration
+
+Decoders can be changed without a restart, the statistics of a decoder are kept.
+
+- "enable_protocol":  1, optional args, e.g. `"params": [1, "v"]`, replaces an enabled decoder
+- "disable_protocol": 1
+- "add_flex":         spec as for "-X", replaces a flex decoder with the same name
+- "remove_flex":      name of a flex decoder
+
 */
 
 #include "http_server.h"
@@ -102,12 +150,16 @@ or `(echo "GET /stream HTTP/1.0\n"; sleep 600) | socat - tcp:127.0.0.1:8433`
 #include "r_util.h"
 #include "optparse.h"
 #include "abuf.h"
+#include "event_history.h"
+#include "spectrum.h"
+#include "samp_grab.h"
 #include "list.h" // used for protocols
 #include "jsmn.h"
 #include "mongoose.h"
 #include "logger.h"
 #include "fatal.h"
 #include <stdbool.h>
+#include <errno.h>
 
 // embed index.html so browsers allow access as local
 #define INDEX_HTML \
@@ -131,6 +183,7 @@ or `(echo "GET /stream HTTP/1.0\n"; sleep 600) | socat - tcp:127.0.0.1:8433`
 // generic ring list
 
 #define DEFAULT_HISTORY_SIZE 100
+#define HISTORY_ENTRY_SIZE 2048 // history entries are allocated at least this size to be reused
 
 typedef struct {
     unsigned size;
@@ -205,6 +258,16 @@ static void *ring_list_push(ring_list_t *ring, void *data)
     return NULL;
 }
 
+// true if the next push will return the oldest data.
+static int ring_list_full(ring_list_t *ring)
+{
+    void **next = ring->tail + 1;
+    if (next >= ring->data + ring->size)
+        next -= ring->size;
+
+    return next == ring->head;
+}
+
 static void **ring_list_iter(ring_list_t *ring)
 {
     return ring->head;
@@ -571,6 +634,18 @@ static void rpc_exec(rpc_t *rpc, r_cfg_t *cfg)
         rpc->response(rpc, 1, buf, 0);
         data_free(data);
     }
+    else if (!strcmp(rpc->method, "get_spectrum")) {
+        char buf[8192]; // we expect the spectrum string to be around 2k bytes.
+        data_t *data = spectrum_data(cfg->spectrum);
+        if (!data) {
+            rpc->response(rpc, -1, "No spectrum", 0);
+        }
+        else {
+            data_print_jsons(data, buf, sizeof(buf));
+            rpc->response(rpc, 1, buf, 0);
+            data_free(data);
+        }
+    }
     else if (!strcmp(rpc->method, "get_protocols")) {
         char buf[65536]; // we expect the protocol string to be around 60k bytes.
         data_t *data = protocols_data(cfg);
@@ -629,6 +704,34 @@ static void rpc_exec(rpc_t *rpc, r_cfg_t *cfg)
         // set_protocol(rpc->val);
         rpc->response(rpc, 0, "Ok", 0);
     }
+    else if (!strcmp(rpc->method, "enable_protocol")) {
+        if (enable_protocol(cfg, rpc->val, rpc->arg))
+            rpc->response(rpc, -1, "Unknown or unavailable protocol", 0);
+        else
+            rpc->response(rpc, 0, "Ok", 0);
+    }
+    else if (!strcmp(rpc->method, "disable_protocol")) {
+        if (disable_protocol(cfg, rpc->val))
+            rpc->response(rpc, -1, "Protocol not enabled", 0);
+        else
+            rpc->response(rpc, 0, "Ok", 0);
+    }
+    else if (!strcmp(rpc->method, "add_flex")) {
+        if (!rpc->arg)
+            rpc->response(rpc, -1, "Missing arg", 0);
+        else if (add_flex_protocol(cfg, rpc->arg))
+            rpc->response(rpc, -1, "Bad flex spec", 0);
+        else
+            rpc->response(rpc, 0, "Ok", 0);
+    }
+    else if (!strcmp(rpc->method, "remove_flex")) {
+        if (!rpc->arg)
+            rpc->response(rpc, -1, "Missing arg", 0);
+        else if (remove_flex_protocol(cfg, rpc->arg))
+            rpc->response(rpc, -1, "Flex decoder not found", 0);
+        else
+            rpc->response(rpc, 0, "Ok", 0);
+    }
 
     // Apply
     else if (!strcmp(rpc->method, "device")) {
@@ -679,6 +782,7 @@ struct http_server_context {
     r_cfg_t *cfg;
     struct data_output *output;
     ring_list_t *history;
+    event_history_t *disk_history;
 };
 
 struct nc_context {
@@ -858,6 +962,240 @@ static void handle_json_events(struct mg_connection *nc, struct http_message *hm
     mg_set_timer(nc, mg_time() + KEEP_ALIVE); // set keep alive timer
 }
 
+#define IQ_DEFAULT_SECONDS 5
+#define IQ_SEND_CHUNK (16 * 1024) /* bytes queued per send event */
+
+#define HISTORY_DEFAULT_LIMIT 100
+#define HISTORY_MAX_LIMIT 10000
+
+typedef struct {
+    char const *json;
+    size_t len;
+} history_hit_t;
+
+typedef struct {
+    history_hit_t *hits;
+    unsigned count;
+    uint64_t last_seq;
+} history_hits_t;
+
+static void collect_history(void *ctx, uint64_t seq, char const *json, size_t len)
+{
+    history_hits_t *hits = ctx;
+    hits->hits[hits->count].json = json;
+    hits->hits[hits->count].len  = len;
+    hits->count++;
+    hits->last_seq = seq;
+}
+
+// http :8433/events since==-3600 model==Acurite-Tower limit==1000
+static void handle_history_query(struct mg_connection *nc, struct http_message *hm, event_history_t *disk_history)
+{
+    char since[32] = {0}, seq[32] = {0}, model[100] = {0}, limit[16] = {0};
+    mg_get_http_var(&hm->query_string, "since", since, sizeof(since));
+    mg_get_http_var(&hm->query_string, "seq", seq, sizeof(seq));
+    mg_get_http_var(&hm->query_string, "model", model, sizeof(model));
+    mg_get_http_var(&hm->query_string, "limit", limit, sizeof(limit));
+
+    double since_time = strtod(since, NULL);
+    if (since_time < 0.0) {
+        since_time += mg_time();
+    }
+    uint64_t after_seq = strtoull(seq, NULL, 10);
+    unsigned max_hits = *limit ? (unsigned)strtoul(limit, NULL, 10) : HISTORY_DEFAULT_LIMIT;
+    if (max_hits > HISTORY_MAX_LIMIT) {
+        max_hits = HISTORY_MAX_LIMIT;
+    }
+
+    history_hits_t hits = {0};
+    if (max_hits) {
+        hits.hits = calloc(max_hits, sizeof(*hits.hits));
+        if (!hits.hits) {
+            WARN_CALLOC("handle_history_query()");
+            mg_printf(nc, "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n");
+            return;
+        }
+    }
+    // the events are sent straight from the mapped file
+    event_history_query(disk_history, since_time, after_seq, *model ? model : NULL, max_hits, collect_history, &hits);
+
+    /* Send headers */
+    mg_printf(nc, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n");
+    if (hits.count) {
+        mg_printf(nc, "X-Event-Seq: %llu\r\n", (unsigned long long)hits.last_seq);
+    }
+    mg_printf(nc, "\r\n");
+
+    for (unsigned i = 0; i < hits.count; ++i) {
+        mg_send_http_chunk(nc, hits.hits[i].json, hits.hits[i].len);
+        mg_send_http_chunk(nc, "\r\n", 2);
+    }
+    mg_send_http_chunk(nc, "", 0); /* Send empty chunk, the end of response */
+
+    free(hits.hits);
+}
+
+// http :8433/spectrum
+static void handle_spectrum(struct mg_connection *nc, struct http_message *hm)
+{
+    UNUSED(hm);
+    struct http_server_context *ctx = nc->user_data;
+    r_cfg_t *cfg = ctx->cfg;
+
+    data_t *data = spectrum_data(cfg->spectrum);
+    if (!data) {
+        mg_printf(nc, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+        return;
+    }
+    char buf[8192]; // we expect the spectrum string to be around 2k bytes.
+    size_t len = data_print_jsons(data, buf, sizeof(buf));
+    data_free(data);
+
+    mg_printf(nc, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %u\r\n\r\n", (unsigned)len);
+    mg_send(nc, buf, (int)len);
+}
+
+/// A snapshot of the IQ ring, sent as the socket drains.
+typedef struct iq_transfer {
+    unsigned char *buf;
+    unsigned len;
+    unsigned pos;
+    int to_cs8;      ///< convert to CS8 while sending
+    int sample_size; ///< input bytes per sample, 2 for CU8, 4 for CS16
+} iq_transfer_t;
+
+static void iq_send_more(struct mg_connection *nc, iq_transfer_t *t)
+{
+    // queue a chunk at a time to bound the send buffer
+    while (t->pos < t->len && nc->send_mbuf.len < IQ_SEND_CHUNK) {
+        unsigned char *chunk = &t->buf[t->pos];
+        unsigned len = t->len - t->pos;
+        if (len > IQ_SEND_CHUNK)
+            len = IQ_SEND_CHUNK;
+        t->pos += len;
+
+        if (t->to_cs8 && t->sample_size == 2) {
+            // CU8 to CS8: flip the sign bit
+            for (unsigned i = 0; i < len; ++i)
+                chunk[i] ^= 0x80;
+        }
+        else if (t->to_cs8) {
+            // CS16 (little endian) to CS8: keep the high byte, in place
+            for (unsigned i = 0; i < len / 2; ++i)
+                chunk[i] = chunk[2 * i + 1];
+            len /= 2;
+        }
+        mg_send(nc, chunk, (int)len);
+    }
+    if (t->pos >= t->len) {
+        nc->flags |= MG_F_SEND_AND_CLOSE;
+    }
+}
+
+static void iq_ev_handler(struct mg_connection *nc, int ev, void *ev_data)
+{
+    UNUSED(ev_data);
+    iq_transfer_t *t = nc->user_data;
+    if (!t)
+        return;
+
+    if (ev == MG_EV_SEND) {
+        iq_send_more(nc, t);
+    }
+    else if (ev == MG_EV_CLOSE) {
+        free(t->buf);
+        free(t);
+        nc->user_data = NULL;
+    }
+}
+
+// curl -OJ 'http://127.0.0.1:8433/iq?seconds=2&end=-10&format=cs8'
+static void handle_iq_snapshot(struct mg_connection *nc, struct http_message *hm)
+{
+    struct http_server_context *ctx = nc->user_data;
+    r_cfg_t *cfg = ctx->cfg;
+    samp_grab_t *g = cfg->demod->samp_grab;
+    int sample_size = cfg->demod->sample_size;
+
+    if (!g || !g->sg_len || !cfg->samp_rate || !sample_size) {
+        mg_printf(nc, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+        return;
+    }
+
+    char seconds[32] = {0}, end[32] = {0}, format[16] = {0};
+    mg_get_http_var(&hm->query_string, "seconds", seconds, sizeof(seconds));
+    mg_get_http_var(&hm->query_string, "end", end, sizeof(end));
+    mg_get_http_var(&hm->query_string, "format", format, sizeof(format));
+
+    int to_cs8 = !strcasecmp(format, "cs8");
+    if (*format && !to_cs8 && strcasecmp(format, sample_size == 2 ? "cu8" : "cs16")) {
+        mg_printf(nc, "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n");
+        return;
+    }
+
+    // the newest sample in the ring is from the current frame
+    double bytes_per_sec = (double)cfg->samp_rate * sample_size;
+    double window_secs   = *seconds ? strtod(seconds, NULL) : IQ_DEFAULT_SECONDS;
+    double end_ago       = 0.0;
+    if (*end) {
+        double end_time = strtod(end, NULL);
+        if (end_time < 0.0) {
+            end_time += mg_time();
+        }
+        end_ago = cfg->demod->now.tv_sec + cfg->demod->now.tv_usec / 1e6 - end_time;
+    }
+    if (window_secs <= 0.0 || end_ago < 0.0) {
+        mg_printf(nc, "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n");
+        return;
+    }
+    // whole samples, limited to the ring
+    double window_len = window_secs * bytes_per_sec;
+    double end_ago_len = end_ago * bytes_per_sec;
+    unsigned len     = window_len < g->sg_len ? (unsigned)window_len : g->sg_len;
+    unsigned end_len = end_ago_len < g->sg_len ? (unsigned)end_ago_len : g->sg_len;
+    len -= len % sample_size;
+    end_len -= end_len % sample_size;
+
+    iq_transfer_t *t = calloc(1, sizeof(*t));
+    if (!t) {
+        WARN_CALLOC("handle_iq_snapshot()");
+        mg_printf(nc, "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n");
+        return;
+    }
+    t->buf = malloc(len ? len : 1);
+    if (!t->buf) {
+        WARN_MALLOC("handle_iq_snapshot()");
+        free(t);
+        mg_printf(nc, "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n");
+        return;
+    }
+    // a copy, the ring keeps being overwritten while the snapshot is sent
+    t->len         = samp_grab_copy(g, t->buf, len, end_len);
+    t->to_cs8      = to_cs8;
+    t->sample_size = sample_size;
+    if (!t->len) {
+        free(t->buf);
+        free(t);
+        mg_printf(nc, "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Length: 0\r\n\r\n");
+        return;
+    }
+
+    unsigned out_len = to_cs8 && sample_size == 4 ? t->len / 2 : t->len;
+    mg_printf(nc, "HTTP/1.1 200 OK\r\n"
+                  "Content-Type: application/octet-stream\r\n"
+                  "Content-Disposition: attachment; filename=\"iq_%gM_%gk.%s\"\r\n"
+                  "Content-Length: %u\r\n"
+                  "Access-Control-Allow-Origin: *\r\n"
+                  "\r\n",
+            cfg->center_frequency / 1000000.0, cfg->samp_rate / 1000.0,
+            to_cs8 ? "cs8" : sample_size == 2 ? "cu8" : "cs16", out_len);
+
+    // the connection is now only sending the snapshot
+    nc->handler   = iq_ev_handler;
+    nc->user_data = t;
+    iq_send_more(nc, t);
+}
+
 // (echo "GET /stream HTTP/1.0\n"; sleep 600) | socat - tcp:127.0.0.1:8433
 static void handle_json_stream(struct mg_connection *nc, struct http_message *hm)
 {
@@ -1034,11 +1372,23 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data)
             handle_cmd_rpc(nc, hm);
         }
         else if (mg_vcmp(&hm->uri, "/events") == 0) {
-            handle_json_events(nc, hm);
+            struct http_server_context *ctx = nc->user_data;
+            if (ctx && ctx->disk_history && hm->query_string.len) {
+                handle_history_query(nc, hm, ctx->disk_history);
+            }
+            else {
+                handle_json_events(nc, hm);
+            }
         }
         else if (mg_vcmp(&hm->uri, "/stream") == 0) {
             handle_json_stream(nc, hm);
         }
+        else if (mg_vcmp(&hm->uri, "/spectrum") == 0) {
+            handle_spectrum(nc, hm);
+        }
+        else if (mg_vcmp(&hm->uri, "/iq") == 0) {
+            handle_iq_snapshot(nc, hm);
+        }
         else if (mg_vcmp(&hm->uri, "/api") == 0) {
             //handle_api_query(nc, hm);
         }
@@ -1069,12 +1419,21 @@ static void http_broadcast_send(struct http_server_context *ctx, char const *msg
     struct mg_connection *nc;
     struct mg_mgr *mgr = ctx->conn->mgr;
 
-    char *dup = strdup(msg);
-    if (!dup) {
-        WARN_STRDUP("http_broadcast_send()");
+    // reuse the oldest history entry if the message fits
+    size_t size = strlen(msg) + 1;
+    char *entry = ring_list_full(ctx->history) ? ring_list_shift(ctx->history) : NULL;
+    if (entry && size > HISTORY_ENTRY_SIZE) {
+        free(entry);
+        entry = NULL;
     }
-    else {
-        free(ring_list_push(ctx->history, dup));
+    if (!entry) {
+        entry = malloc(size > HISTORY_ENTRY_SIZE ? size : HISTORY_ENTRY_SIZE);
+        if (!entry)
+            WARN_MALLOC("http_broadcast_send()");
+    }
+    if (entry) {
+        memcpy(entry, msg, size);
+        free(ring_list_push(ctx->history, entry));
     }
 
     for (nc = mg_next(mgr, NULL); nc != NULL; nc = mg_next(mgr, nc)) {
@@ -1179,6 +1538,7 @@ static int http_server_stop(struct http_server_context *ctx)
     for (void **iter = ring_list_iter(ctx->history); iter; iter = ring_list_next(ctx->history, iter))
         free((data_t *)*iter);
     ring_list_free(ctx->history);
+    event_history_close(ctx->disk_history);
 
     free(ctx);
 
@@ -1209,6 +1569,10 @@ static void R_API_CALLCONV print_http_data(data_output_t *output, data_t *data,
         char buf[2048]; // we expect the biggest strings to be around 500 bytes.
         size_t len = data_print_jsons(data, buf, sizeof(buf));
         http_broadcast_send(http->server, buf, len);
+        if (http->server->disk_history) {
+            char const *model = data_model->type == DATA_STRING ? data_model->value.v_ptr : NULL;
+            event_history_append(http->server->disk_history, model, buf, len, mg_time());
+        }
     }
     else {
         // "states"
@@ -1236,8 +1600,30 @@ static void R_API_CALLCONV data_output_http_free(data_output_t *output)
     free(http);
 }
 
-struct data_output *data_output_http_create(struct mg_mgr *mgr, char const *host, char const *port, r_cfg_t *cfg)
+struct data_output *data_output_http_create(struct mg_mgr *mgr, char const *host, char const *port, char *opts, r_cfg_t *cfg)
 {
+    char const *history_path = NULL;
+    size_t history_size = EVENT_HISTORY_DEFAULT_SIZE;
+    unsigned iq_size = 0;
+
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "history"))
+            history_path = val;
+        else if (!strcasecmp(key, "history_size"))
+            history_size = atouint32_metric(val, "history_size= ");
+        else if (!strcasecmp(key, "iq_size"))
+            iq_size = atouint32_metric(val, "iq_size= ") & ~3u; // whole CU8 and CS16 samples
+        else {
+            print_logf(LOG_FATAL, __func__, "Invalid key \"%s\" option.", key);
+            exit(1);
+        }
+    }
+
     data_output_http_t *http = calloc(1, sizeof(data_output_http_t));
     if (!http) {
         WARN_CALLOC("data_output_http_create()");
@@ -1253,5 +1639,27 @@ struct data_output *data_output_http_create(struct mg_mgr *mgr, char const *host
         exit(1);
     }
 
+    if (history_path) {
+        http->server->disk_history = event_history_open(history_path, history_size);
+        if (!http->server->disk_history) {
+            print_logf(LOG_FATAL, "HTTP server", "Can't open event history \"%s\" (%s)", history_path, strerror(errno));
+            exit(1);
+        }
+        print_logf(LOG_NOTICE, "HTTP server", "Keeping event history in \"%s\"", history_path);
+    }
+
+    // the IQ ring is shared with the signal grabber, keep the larger
+    samp_grab_t *g = cfg->demod->samp_grab;
+    if (iq_size && (!g || g->sg_size < iq_size)) {
+        cfg->demod->samp_grab = samp_grab_create(iq_size);
+        if (!cfg->demod->samp_grab) {
+            print_logf(LOG_FATAL, "HTTP server", "Can't allocate an IQ ring of %u bytes", iq_size);
+            exit(1);
+        }
+        if (g)
+            samp_grab_free(g);
+        print_logf(LOG_NOTICE, "HTTP server", "Keeping %u bytes of IQ samples for \"/iq\"", iq_size);
+    }
+
     return &http->output;
 }
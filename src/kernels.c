@@ -0,0 +1,329 @@
+/** @file
+    Registry of kernel variants selected by CPU features.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+/*
+A kernel is a hot function, e.g. the envelope detector, with one or more
+implementations. Variants are listed reference first, then in order of
+preference; the last variant the CPU supports is selected on registering.
+The benchmark instead selects the fastest variant, and the user can force
+any supported variant. The public function of a kernel calls the selected
+variant, so this costs one indirect call per block of samples.
+
+All variants of a kernel need to have the exact same output, kernels_check()
+compares them to the reference on random input.
+*/
+
+#include "kernels.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNELS_X86_BUILTIN
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define KERNELS_X86_CPUID
+#elif defined(__arm__) && defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)
+#endif
+#endif
+
+#define KERNELS_MAX 32
+
+static kernel_t *registry[KERNELS_MAX];
+static unsigned registry_len;
+
+unsigned kernels_cpu_features(void)
+{
+    static int detected;
+    static unsigned features;
+    if (detected)
+        return features;
+    detected = 1;
+
+#if defined(KERNELS_X86_BUILTIN)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+        features |= KERNEL_SSE2;
+    if (__builtin_cpu_supports("avx2"))
+        features |= KERNEL_AVX2;
+#elif defined(KERNELS_X86_CPUID)
+    int regs[4];
+    __cpuid(regs, 1);
+    if (regs[3] & (1 << 26))
+        features |= KERNEL_SSE2;
+    int osxsave = regs[2] & (1 << 27);
+    __cpuidex(regs, 7, 0);
+    // AVX2 also needs the OS to save the YMM registers
+    if (osxsave && (regs[1] & (1 << 5)) && (_xgetbv(0) & 6) == 6)
+        features |= KERNEL_AVX2;
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    features |= KERNEL_NEON; // always available on AArch64
+#elif defined(__arm__) && defined(__linux__)
+    if (getauxval(AT_HWCAP) & HWCAP_NEON)
+        features |= KERNEL_NEON;
+#endif
+
+    return features;
+}
+
+static void feature_names(unsigned features, char *buf, size_t size)
+{
+    snprintf(buf, size, "%s%s%s%s",
+            features & KERNEL_SSE2 ? " sse2" : "",
+            features & KERNEL_AVX2 ? " avx2" : "",
+            features & KERNEL_NEON ? " neon" : "",
+            features ? "" : " none");
+}
+
+static int variant_supported(kernel_variant_t const *v)
+{
+    return (v->features & ~kernels_cpu_features()) == 0;
+}
+
+static void select_variant(kernel_t *k, int i)
+{
+    k->selected = i;
+    k->fn       = k->variants[i].fn;
+}
+
+void kernels_register(kernel_t *k)
+{
+    for (unsigned i = 0; i < registry_len; ++i) {
+        if (registry[i] == k)
+            return; // already registered
+    }
+    if (registry_len >= KERNELS_MAX) {
+        fprintf(stderr, "Too many kernels, %s not registered\n", k->name);
+        return;
+    }
+    registry[registry_len++] = k;
+
+    // the reference needs no features
+    int best = 0;
+    for (int i = 1; i < KERNEL_MAX_VARIANTS && k->variants[i].name; ++i) {
+        if (variant_supported(&k->variants[i]))
+            best = i;
+    }
+    select_variant(k, best);
+    k->forced = 0;
+}
+
+int kernels_force(char const *kernel, char const *variant)
+{
+    for (unsigned j = 0; j < registry_len; ++j) {
+        kernel_t *k = registry[j];
+        if (strcmp(k->name, kernel))
+            continue;
+        for (int i = 0; i < KERNEL_MAX_VARIANTS && k->variants[i].name; ++i) {
+            if (strcmp(k->variants[i].name, variant))
+                continue;
+            if (!variant_supported(&k->variants[i]))
+                return -3;
+            select_variant(k, i);
+            k->forced = 1;
+            return 0;
+        }
+        return -2;
+    }
+    return -1;
+}
+
+/// Deterministic random samples, the same input for all variants.
+static void *bench_input(kernel_t const *k, unsigned len)
+{
+    unsigned char *buf = malloc((size_t)len * k->in_size);
+    if (!buf) {
+        fprintf(stderr, "malloc() failed\n");
+        return NULL;
+    }
+    unsigned seed = 1;
+    for (size_t i = 0; i < (size_t)len * k->in_size; ++i) {
+        seed   = seed * 1103515245 + 12345;
+        buf[i] = (unsigned char)(seed >> 16);
+    }
+    return buf;
+}
+
+/// Best of three, each long enough for the clock resolution.
+static double bench_variant(kernel_t const *k, kernel_fn fn, void const *in, void *out, unsigned len)
+{
+    double best = 0.0;
+    for (int round = 0; round < 3; ++round) {
+        unsigned reps = 1;
+        clock_t elapsed;
+        for (;;) {
+            clock_t start = clock();
+            for (unsigned r = 0; r < reps; ++r)
+                k->run(fn, in, out, len);
+            elapsed = clock() - start;
+            if (elapsed >= CLOCKS_PER_SEC / 500 || reps >= 1u << 20)
+                break;
+            reps *= 2;
+        }
+        double ns = (double)elapsed * 1e9 / CLOCKS_PER_SEC / reps / len;
+        if (round == 0 || ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+void kernels_bench(unsigned len)
+{
+    for (unsigned j = 0; j < registry_len; ++j) {
+        kernel_t *k = registry[j];
+        void *in    = bench_input(k, len);
+        void *out   = malloc((size_t)len * k->out_size);
+        if (!in || !out) {
+            fprintf(stderr, "malloc() failed\n");
+            free(in);
+            return;
+        }
+        int fastest = 0; // the reference is always supported
+        for (int i = 0; i < KERNEL_MAX_VARIANTS && k->variants[i].name; ++i) {
+            k->ns[i] = 0.0;
+            if (!variant_supported(&k->variants[i]))
+                continue;
+            k->ns[i] = bench_variant(k, k->variants[i].fn, in, out, len);
+            if (k->ns[i] < k->ns[fastest])
+                fastest = i;
+        }
+        if (!k->forced)
+            select_variant(k, fastest);
+        free(out);
+        free(in);
+    }
+}
+
+int kernels_check(unsigned len)
+{
+    int mismatches = 0;
+    for (unsigned j = 0; j < registry_len; ++j) {
+        kernel_t *k = registry[j];
+        size_t out_len = (size_t)len * k->out_size;
+        void *in       = bench_input(k, len);
+        void *ref      = malloc(out_len);
+        if (!ref) {
+            fprintf(stderr, "malloc() failed\n");
+            free(in);
+            return -1;
+        }
+        void *out = malloc(out_len);
+        if (!in || !out) {
+            fprintf(stderr, "malloc() failed\n");
+            free(ref);
+            free(in);
+            return -1;
+        }
+        k->run(k->variants[0].fn, in, ref, len);
+        for (int i = 1; i < KERNEL_MAX_VARIANTS && k->variants[i].name; ++i) {
+            if (!variant_supported(&k->variants[i]))
+                continue;
+            memset(out, 0, out_len);
+            k->run(k->variants[i].fn, in, out, len);
+            if (memcmp(ref, out, out_len)) {
+                fprintf(stderr, "Kernel %s variant %s differs from %s\n", k->name, k->variants[i].name, k->variants[0].name);
+                mismatches++;
+            }
+        }
+        free(out);
+        free(ref);
+        free(in);
+    }
+    return mismatches;
+}
+
+void kernels_report(void)
+{
+    char features[64];
+    feature_names(kernels_cpu_features(), features, sizeof(features));
+    fprintf(stderr, "CPU features:%s\n", features);
+    fprintf(stderr, "Kernel variants, [selected] or {forced}, with ns per sample:\n");
+    for (unsigned j = 0; j < registry_len; ++j) {
+        kernel_t *k = registry[j];
+        fprintf(stderr, "  %-28s", k->name);
+        for (int i = 0; i < KERNEL_MAX_VARIANTS && k->variants[i].name; ++i) {
+            char open  = i != k->selected ? ' ' : k->forced ? '{' : '[';
+            char close = i != k->selected ? ' ' : k->forced ? '}' : ']';
+            if (!variant_supported(&k->variants[i]))
+                fprintf(stderr, "  %c%s%c (unsupported)", open, k->variants[i].name, close);
+            else if (k->ns[i] > 0.0)
+                fprintf(stderr, "  %c%s%c %.3f", open, k->variants[i].name, close, k->ns[i]);
+            else
+                fprintf(stderr, "  %c%s%c", open, k->variants[i].name, close);
+        }
+        fprintf(stderr, "\n");
+    }
+}
+
+#ifdef _TEST
+#include "baseband.h"
+
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    fprintf(stderr, "kernels:: test\n");
+
+    baseband_init();
+    baseband_init(); // registers only once
+    ASSERT_EQUALS(registry_len, 9);
+
+    // all supported variants match the reference
+    ASSERT_EQUALS(kernels_check(4099), 0);
+
+    ASSERT_EQUALS(kernels_force("nonexistent", "generic"), -1);
+    ASSERT_EQUALS(kernels_force("envelope_detect", "nonexistent"), -2);
+
+    // forcing changes the public function, the output stays the same
+    unsigned const len = 1000;
+    uint8_t iq_buf[2 * 1000];
+    uint16_t y_lut[1000];
+    uint16_t y_generic[1000];
+    for (unsigned i = 0; i < 2 * len; ++i)
+        iq_buf[i] = (uint8_t)(i * 37 + i / 7);
+    ASSERT_EQUALS(kernels_force("envelope_detect", "lut"), 0);
+    float db_lut = envelope_detect(iq_buf, y_lut, len);
+    ASSERT_EQUALS(kernels_force("envelope_detect", "generic"), 0);
+    float db_generic = envelope_detect(iq_buf, y_generic, len);
+    ASSERT_EQUALS(memcmp(y_lut, y_generic, sizeof(y_lut)), 0);
+    ASSERT_EQUALS(db_lut == db_generic, 1);
+
+    // the benchmark keeps forced variants and selects supported variants
+    kernels_bench(1024);
+    for (unsigned j = 0; j < registry_len; ++j) {
+        kernel_t *k = registry[j];
+        ASSERT_EQUALS(variant_supported(&k->variants[k->selected]), 1);
+        ASSERT_EQUALS(k->fn == k->variants[k->selected].fn, 1);
+        if (!strcmp(k->name, "envelope_detect"))
+            ASSERT_EQUALS(strcmp(k->variants[k->selected].name, "generic"), 0);
+    }
+
+    fprintf(stderr, "kernels:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+
+    return failed;
+}
+#endif /* _TEST */
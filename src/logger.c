@@ -29,6 +29,14 @@ void r_logger_set_log_handler(r_logger_handler const handler, void *userdata)
     logger_handler_userdata = userdata;
 }
 
+void r_logger_reset_log_handler(void *userdata)
+{
+    if (logger_handler_userdata == userdata) {
+        logger_handler          = NULL;
+        logger_handler_userdata = NULL;
+    }
+}
+
 void print_log(log_level_t level, char const *src, char const *msg)
 {
     if (logger_handler) {
@@ -0,0 +1,556 @@
+/** @file
+    Time-window aggregation output stage for rtl_433 events.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "output_aggregate.h"
+
+#include "data.h"
+#include "r_util.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Accumulators */
+
+typedef struct {
+    char *key;
+    int is_int;
+    unsigned count;
+    double min;
+    double max;
+    double sum;
+} aggregate_field_t;
+
+typedef struct {
+    uint32_t hash;
+    char *dev_key;       ///< "model/id/channel" identity
+    data_t *last;        ///< retained last event of this device
+    unsigned count;      ///< events in this window
+    unsigned num_fields;
+    unsigned max_fields;
+    aggregate_field_t *fields;
+} aggregate_entry_t;
+
+/// Open addressing slot, the hash is kept inline to probe without dereferencing.
+typedef struct {
+    uint32_t hash;
+    aggregate_entry_t *entry;
+} aggregate_slot_t;
+
+/* Aggregate printer */
+
+typedef struct {
+    struct data_output output;
+    struct data_output *inner;
+    int window_secs;
+    time_t now;        ///< the stream time of the last poll, 0 before the first poll
+    time_t window_end; ///< 0 before the first poll
+    unsigned num_entries;
+    unsigned num_slots; ///< always a power of two
+    aggregate_slot_t *slots;
+} data_output_aggregate_t;
+
+/// FNV-1a hash of a string.
+static uint32_t aggregate_hash(char const *str)
+{
+    uint32_t hash = 2166136261u;
+    for (; *str; ++str) {
+        hash ^= (uint8_t)*str;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/// Identity keys are not aggregated but used to select the accumulator.
+static int aggregate_is_ident(char const *key)
+{
+    return !strcmp(key, "time")
+            || !strcmp(key, "model")
+            || !strcmp(key, "id")
+            || !strcmp(key, "channel")
+            || !strcmp(key, "protocol");
+}
+
+static char *append_ident(char *p, char *end, data_t *d)
+{
+    if (!d)
+        return p + snprintf(p, end - p, "/");
+    else if (d->type == DATA_STRING)
+        return p + snprintf(p, end - p, "/%s", (char const *)d->value.v_ptr);
+    else if (d->type == DATA_INT)
+        return p + snprintf(p, end - p, "/%d", d->value.v_int);
+    else
+        return p + snprintf(p, end - p, "/?");
+}
+
+static void aggregate_entry_free(aggregate_entry_t *entry)
+{
+    for (unsigned i = 0; i < entry->num_fields; ++i)
+        free(entry->fields[i].key);
+    free(entry->fields);
+    data_free(entry->last);
+    free(entry->dev_key);
+    free(entry);
+}
+
+static aggregate_field_t *aggregate_find_field(aggregate_entry_t *entry, char const *key)
+{
+    for (unsigned i = 0; i < entry->num_fields; ++i)
+        if (!strcmp(entry->fields[i].key, key))
+            return &entry->fields[i];
+    return NULL;
+}
+
+static aggregate_field_t *aggregate_add_field(aggregate_entry_t *entry, char const *key, int is_int)
+{
+    if (entry->num_fields >= entry->max_fields) {
+        unsigned max_fields = entry->max_fields ? entry->max_fields * 2 : 16;
+        aggregate_field_t *fields = realloc(entry->fields, max_fields * sizeof(*fields));
+        if (!fields) {
+            WARN_REALLOC("aggregate_add_field()");
+            return NULL; // NOTE: skip field on alloc failure.
+        }
+        entry->fields     = fields;
+        entry->max_fields = max_fields;
+    }
+    aggregate_field_t *f = &entry->fields[entry->num_fields];
+    memset(f, 0, sizeof(*f));
+    f->key = strdup(key);
+    if (!f->key) {
+        WARN_STRDUP("aggregate_add_field()");
+        return NULL; // NOTE: skip field on alloc failure.
+    }
+    f->is_int = is_int;
+    entry->num_fields++;
+    return f;
+}
+
+static void aggregate_grow(data_output_aggregate_t *agg)
+{
+    unsigned num_slots = agg->num_slots ? agg->num_slots * 2 : 64;
+    aggregate_slot_t *slots = calloc(num_slots, sizeof(*slots));
+    if (!slots) {
+        WARN_CALLOC("aggregate_grow()");
+        return; // NOTE: keep the old table on alloc failure.
+    }
+    for (unsigned i = 0; i < agg->num_slots; ++i) {
+        aggregate_entry_t *entry = agg->slots[i].entry;
+        if (!entry)
+            continue;
+        unsigned j = entry->hash & (num_slots - 1);
+        while (slots[j].entry)
+            j = (j + 1) & (num_slots - 1);
+        slots[j].hash  = entry->hash;
+        slots[j].entry = entry;
+    }
+    free(agg->slots);
+    agg->slots     = slots;
+    agg->num_slots = num_slots;
+}
+
+static aggregate_entry_t *aggregate_lookup(data_output_aggregate_t *agg, char const *dev_key)
+{
+    // keep the load factor below 3/4
+    if ((agg->num_entries + 1) * 4 > agg->num_slots * 3)
+        aggregate_grow(agg);
+    if (!agg->num_slots || agg->num_entries + 1 >= agg->num_slots)
+        return NULL;
+
+    uint32_t hash = aggregate_hash(dev_key);
+    unsigned mask = agg->num_slots - 1;
+    unsigned i    = hash & mask;
+    while (agg->slots[i].entry) {
+        if (agg->slots[i].hash == hash && !strcmp(agg->slots[i].entry->dev_key, dev_key))
+            return agg->slots[i].entry;
+        i = (i + 1) & mask;
+    }
+
+    aggregate_entry_t *entry = calloc(1, sizeof(*entry));
+    if (!entry) {
+        WARN_CALLOC("aggregate_lookup()");
+        return NULL; // NOTE: skip event on alloc failure.
+    }
+    entry->hash    = hash;
+    entry->dev_key = strdup(dev_key);
+    if (!entry->dev_key) {
+        WARN_STRDUP("aggregate_lookup()");
+        free(entry);
+        return NULL; // NOTE: skip event on alloc failure.
+    }
+    agg->slots[i].hash  = hash;
+    agg->slots[i].entry = entry;
+    agg->num_entries++;
+    return entry;
+}
+
+static void aggregate_accumulate(aggregate_entry_t *entry, data_t *data)
+{
+    entry->count++;
+    for (data_t *d = data; d; d = d->next) {
+        if (d->type != DATA_INT && d->type != DATA_DOUBLE)
+            continue;
+        if (aggregate_is_ident(d->key))
+            continue;
+        double val = d->type == DATA_INT ? d->value.v_int : d->value.v_dbl;
+        aggregate_field_t *f = aggregate_find_field(entry, d->key);
+        if (!f)
+            f = aggregate_add_field(entry, d->key, d->type == DATA_INT);
+        if (!f)
+            continue;
+        if (!f->count || val < f->min)
+            f->min = val;
+        if (!f->count || val > f->max)
+            f->max = val;
+        f->sum += val;
+        f->count++;
+    }
+
+    data_free(entry->last);
+    entry->last = data_retain(data);
+}
+
+/// Appends a copy of a plain value, nested data and arrays are skipped.
+static data_t *append_value(data_t *out, char const *key, char const *pretty_key, char const *format, data_type_t type, double val, char const *str)
+{
+    if (type == DATA_STRING && format)
+        return data_append(out, key, pretty_key, DATA_FORMAT, format, DATA_STRING, str, NULL);
+    else if (type == DATA_STRING)
+        return data_append(out, key, pretty_key, DATA_STRING, str, NULL);
+    else if (type == DATA_INT && format)
+        return data_append(out, key, pretty_key, DATA_FORMAT, format, DATA_INT, (int)val, NULL);
+    else if (type == DATA_INT)
+        return data_append(out, key, pretty_key, DATA_INT, (int)val, NULL);
+    else if (type == DATA_DOUBLE && format)
+        return data_append(out, key, pretty_key, DATA_FORMAT, format, DATA_DOUBLE, val, NULL);
+    else if (type == DATA_DOUBLE)
+        return data_append(out, key, pretty_key, DATA_DOUBLE, val, NULL);
+    return out;
+}
+
+static data_t *aggregate_summary(data_output_aggregate_t *agg, aggregate_entry_t *entry)
+{
+    data_t *out = NULL;
+    char key[64];
+    char pretty_key[64];
+
+    for (data_t *d = entry->last; d; d = d->next) {
+        double val = d->type == DATA_INT ? d->value.v_int : d->type == DATA_DOUBLE ? d->value.v_dbl : 0.0;
+        aggregate_field_t *f = aggregate_is_ident(d->key) ? NULL : aggregate_find_field(entry, d->key);
+
+        // the last value keeps the original key, non-numeric fields are passed as is
+        out = append_value(out, d->key, d->pretty_key, d->format, d->type, val, d->value.v_ptr);
+        if (!f)
+            continue;
+
+        data_type_t type = f->is_int ? DATA_INT : DATA_DOUBLE;
+        int pretty = *d->pretty_key != '\0'; // keep hidden labels hidden
+        snprintf(key, sizeof(key), "%s_min", d->key);
+        snprintf(pretty_key, sizeof(pretty_key), "%s%s", d->pretty_key, pretty ? " min" : "");
+        out = append_value(out, key, pretty_key, d->format, type, f->min, NULL);
+        snprintf(key, sizeof(key), "%s_max", d->key);
+        snprintf(pretty_key, sizeof(pretty_key), "%s%s", d->pretty_key, pretty ? " max" : "");
+        out = append_value(out, key, pretty_key, d->format, type, f->max, NULL);
+        snprintf(key, sizeof(key), "%s_avg", d->key);
+        snprintf(pretty_key, sizeof(pretty_key), "%s%s", d->pretty_key, pretty ? " avg" : "");
+        // int formats don't apply to the mean
+        out = append_value(out, key, pretty_key, f->is_int ? NULL : d->format, DATA_DOUBLE, f->sum / f->count, NULL);
+    }
+
+    out = data_append(out,
+            "count",    "Count",    DATA_INT, entry->count,
+            "window",   "Window",   DATA_FORMAT, "%d s", DATA_INT, agg->window_secs,
+            NULL);
+
+    return out;
+}
+
+/// Emit all summaries and clear the table for the next window.
+static void aggregate_flush(data_output_aggregate_t *agg)
+{
+    for (unsigned i = 0; i < agg->num_slots; ++i) {
+        aggregate_entry_t *entry = agg->slots[i].entry;
+        if (!entry)
+            continue;
+        data_t *summary = aggregate_summary(agg, entry);
+        if (summary)
+            data_output_print(agg->inner, summary);
+        data_free(summary);
+        aggregate_entry_free(entry);
+        agg->slots[i].entry = NULL;
+    }
+    agg->num_entries = 0;
+}
+
+static void aggregate_check_window(data_output_aggregate_t *agg, time_t now)
+{
+    if (now < agg->window_end)
+        return;
+    if (agg->window_end)
+        aggregate_flush(agg); // the first poll only opens a window
+    // align windows to multiples of the window length
+    agg->window_end = now - now % agg->window_secs + agg->window_secs;
+}
+
+static void R_API_CALLCONV data_output_aggregate_print(data_output_t *output, data_t *data)
+{
+    data_output_aggregate_t *agg = (data_output_aggregate_t *)output;
+
+    // windows follow the stream time of the polls, not the wall clock
+    if (agg->now)
+        aggregate_check_window(agg, agg->now);
+
+    // collect well-known top level keys
+    data_t *data_model   = NULL;
+    data_t *data_id      = NULL;
+    data_t *data_channel = NULL;
+    for (data_t *d = data; d; d = d->next) {
+        if (!strcmp(d->key, "model"))
+            data_model = d;
+        else if (!strcmp(d->key, "id"))
+            data_id = d;
+        else if (!strcmp(d->key, "channel"))
+            data_channel = d;
+    }
+
+    // data isn't from a device (maybe log or report), pass through
+    if (!data_model) {
+        data_output_print(agg->inner, data);
+        return;
+    }
+
+    char dev_key[256];
+    char *end = dev_key + sizeof(dev_key);
+    char *p   = dev_key;
+    p = append_ident(p, end, data_model);
+    if (p < end)
+        p = append_ident(p, end, data_id);
+    if (p < end)
+        append_ident(p, end, data_channel);
+
+    aggregate_entry_t *entry = aggregate_lookup(agg, dev_key);
+    if (!entry) {
+        data_output_print(agg->inner, data); // NOTE: pass through on alloc failure.
+        return;
+    }
+    aggregate_accumulate(entry, data);
+}
+
+static void R_API_CALLCONV data_output_aggregate_start(data_output_t *output, char const *const *fields, int num_fields)
+{
+    data_output_aggregate_t *agg = (data_output_aggregate_t *)output;
+
+    data_output_start(agg->inner, fields, num_fields);
+}
+
+static void R_API_CALLCONV data_output_aggregate_free(data_output_t *output)
+{
+    data_output_aggregate_t *agg = (data_output_aggregate_t *)output;
+
+    if (!agg)
+        return;
+
+    // emit the partial last window
+    aggregate_flush(agg);
+    free(agg->slots);
+    data_output_free(agg->inner);
+    free(agg);
+}
+
+void data_output_aggregate_poll(struct data_output *output, time_t now)
+{
+    data_output_aggregate_t *agg = (data_output_aggregate_t *)output;
+
+    if (!agg)
+        return;
+
+    agg->now = now;
+    aggregate_check_window(agg, now);
+}
+
+struct data_output *data_output_aggregate_create(struct data_output *inner, int window_secs)
+{
+    data_output_aggregate_t *agg = calloc(1, sizeof(data_output_aggregate_t));
+    if (!agg)
+        FATAL_CALLOC("data_output_aggregate_create()");
+
+    agg->output.output_print = data_output_aggregate_print;
+    agg->output.output_start = data_output_aggregate_start;
+    agg->output.output_free  = data_output_aggregate_free;
+    agg->output.log_level    = inner ? inner->log_level : 0;
+    agg->inner               = inner;
+    agg->window_secs         = window_secs > 0 ? window_secs : 60;
+    // the first window opens with the first poll
+
+    return &agg->output;
+}
+
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: line %d: %d <> %d\n", __LINE__, (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+#define ASSERT_DOUBLE(a, b) ASSERT_EQUALS((int)((a) * 1000 + 0.5), (int)((b) * 1000 + 0.5))
+
+/// Keeps the events printed.
+typedef struct {
+    struct data_output output;
+    data_t *events[16];
+    unsigned len;
+} test_output_t;
+
+static void R_API_CALLCONV test_output_print(data_output_t *output, data_t *data)
+{
+    test_output_t *out = (test_output_t *)output;
+    if (out->len < 16)
+        out->events[out->len++] = data_retain(data);
+}
+
+static void R_API_CALLCONV test_output_free(data_output_t *output)
+{
+    (void)output; // on the stack
+}
+
+static void test_output_clear(test_output_t *out)
+{
+    for (unsigned i = 0; i < out->len; ++i)
+        data_free(out->events[i]);
+    out->len = 0;
+}
+
+static data_t *test_field(data_t *data, char const *key)
+{
+    for (data_t *d = data; d; d = d->next) {
+        if (!strcmp(d->key, key))
+            return d;
+    }
+    return NULL;
+}
+
+/// The summary of a device, NULL if there is none.
+static data_t *test_summary(test_output_t *out, int id, int channel)
+{
+    for (unsigned i = 0; i < out->len; ++i) {
+        data_t *d_id = test_field(out->events[i], "id");
+        data_t *d_ch = test_field(out->events[i], "channel");
+        if (d_id && d_ch && d_id->value.v_int == id && d_ch->value.v_int == channel)
+            return out->events[i];
+    }
+    return NULL;
+}
+
+static void test_event(data_output_t *agg, int id, int channel, int battery, double temp)
+{
+    data_t *data = data_make(
+            "model",         "",            DATA_STRING, "Test-Sensor",
+            "id",            "",            DATA_INT,    id,
+            "channel",       "Channel",     DATA_INT,    channel,
+            "battery_ok",    "Battery",     DATA_INT,    battery,
+            "temperature_C", "Temperature", DATA_FORMAT, "%.1f C", DATA_DOUBLE, temp,
+            NULL);
+    data_output_print(agg, data);
+    data_free(data);
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    fprintf(stderr, "output_aggregate:: test\n");
+
+    test_output_t out = {0};
+    out.output.output_print = test_output_print;
+    out.output.output_free  = test_output_free;
+    data_output_t *agg = data_output_aggregate_create(&out.output, 60);
+
+    // the first poll opens the window [1200, 1260) on the stream time
+    data_output_aggregate_poll(agg, 1230);
+    test_event(agg, 7, 1, 1, 20.0);
+    test_event(agg, 7, 1, 0, 22.0);
+    test_event(agg, 7, 1, 1, 24.5);
+    test_event(agg, 7, 2, 1, 10.0); // another channel, another device
+    test_event(agg, 8, 1, 1, 30.0); // another id, another device
+
+    // not from a device, passed through
+    data_t *log = data_make("msg", "", DATA_STRING, "log", NULL);
+    data_output_print(agg, log);
+    data_free(log);
+    ASSERT_EQUALS(out.len, 1);
+    ASSERT_EQUALS(test_field(out.events[0], "msg") != NULL, 1);
+    test_output_clear(&out);
+
+    data_output_aggregate_poll(agg, 1259);
+    ASSERT_EQUALS(out.len, 0);
+
+    // the first window closes
+    data_output_aggregate_poll(agg, 1260);
+    ASSERT_EQUALS(out.len, 3);
+    data_t *s = test_summary(&out, 7, 1);
+    ASSERT_EQUALS(s != NULL, 1);
+    if (s) {
+        ASSERT_EQUALS(test_field(s, "count")->value.v_int, 3);
+        // identity keys are kept, not aggregated
+        ASSERT_EQUALS(test_field(s, "id_min") == NULL, 1);
+        ASSERT_EQUALS(test_field(s, "channel_avg") == NULL, 1);
+        // an int field, the last value and the aggregates
+        ASSERT_EQUALS(test_field(s, "battery_ok")->value.v_int, 1);
+        ASSERT_EQUALS(test_field(s, "battery_ok_min")->type, DATA_INT);
+        ASSERT_EQUALS(test_field(s, "battery_ok_min")->value.v_int, 0);
+        ASSERT_EQUALS(test_field(s, "battery_ok_max")->value.v_int, 1);
+        ASSERT_EQUALS(test_field(s, "battery_ok_avg")->type, DATA_DOUBLE);
+        ASSERT_DOUBLE(test_field(s, "battery_ok_avg")->value.v_dbl, 2.0 / 3.0);
+        // a double field
+        ASSERT_DOUBLE(test_field(s, "temperature_C")->value.v_dbl, 24.5);
+        ASSERT_DOUBLE(test_field(s, "temperature_C_min")->value.v_dbl, 20.0);
+        ASSERT_DOUBLE(test_field(s, "temperature_C_max")->value.v_dbl, 24.5);
+        ASSERT_DOUBLE(test_field(s, "temperature_C_avg")->value.v_dbl, 22.166667);
+    }
+    s = test_summary(&out, 7, 2);
+    ASSERT_EQUALS(s && test_field(s, "count")->value.v_int == 1, 1);
+    s = test_summary(&out, 8, 1);
+    ASSERT_EQUALS(s && test_field(s, "count")->value.v_int == 1, 1);
+    test_output_clear(&out);
+
+    // the second window starts empty
+    test_event(agg, 7, 1, 1, 18.0);
+    data_output_aggregate_poll(agg, 1319);
+    ASSERT_EQUALS(out.len, 0);
+    data_output_aggregate_poll(agg, 1320);
+    ASSERT_EQUALS(out.len, 1);
+    s = test_summary(&out, 7, 1);
+    ASSERT_EQUALS(s != NULL, 1);
+    if (s) {
+        ASSERT_EQUALS(test_field(s, "count")->value.v_int, 1);
+        ASSERT_DOUBLE(test_field(s, "temperature_C_min")->value.v_dbl, 18.0);
+        ASSERT_DOUBLE(test_field(s, "temperature_C_avg")->value.v_dbl, 18.0);
+    }
+    test_output_clear(&out);
+
+    // the partial last window is emitted on free
+    test_event(agg, 9, 3, 1, 5.0);
+    data_output_free(agg);
+    ASSERT_EQUALS(out.len, 1);
+    ASSERT_EQUALS(test_summary(&out, 9, 3) != NULL, 1);
+    test_output_clear(&out);
+
+    fprintf(stderr, "output_aggregate:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+
+    return failed;
+}
+#endif /* _TEST */
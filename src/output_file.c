@@ -434,6 +434,9 @@ typedef struct {
     FILE *file;
     const char **fields;
     const char *separator;
+    data_schema_t *schema; ///< field ids are the column index, followed by the regular keys
+    data_record_t record;
+    int regular_ids[3];
 } data_output_csv_t;
 
 static void R_API_CALLCONV print_csv_data(data_output_t *output, data_t *data, char const *format)
@@ -547,6 +550,24 @@ static void R_API_CALLCONV data_output_csv_start(struct data_output *output, cha
     free((void *)allowed);
     free(use_count);
 
+    // index the columns, the regular keys might not be columns
+    static char const *const regular_keys[] = {"msg", "codes", "model"};
+    allowed = calloc(csv_fields + 3, sizeof(const char *));
+    if (!allowed) {
+        WARN_CALLOC("data_output_csv_start()");
+        return;
+    }
+    memcpy((void *)allowed, csv->fields, sizeof(const char *) * csv_fields);
+    memcpy((void *)(allowed + csv_fields), regular_keys, sizeof(regular_keys));
+    csv->schema = data_schema_create(allowed, csv_fields + 3);
+    free((void *)allowed);
+    if (!csv->schema || data_record_init(&csv->record, csv->schema)) {
+        return;
+    }
+    for (i = 0; i < 3; ++i) {
+        csv->regular_ids[i] = data_schema_id(csv->schema, regular_keys[i]);
+    }
+
     // Output the CSV header
     for (i = 0; csv->fields[i]; ++i) {
         fprintf(csv->file, "%s%s", i > 0 ? csv->separator : "", csv->fields[i]);
@@ -584,9 +605,14 @@ static void R_API_CALLCONV data_output_csv_print(data_output_t *output, data_t *
 
     const char **fields = csv->fields;
 
+    if (!csv->record.values)
+        return; // start failed
+
+    data_record_fill(&csv->record, data);
+
     int regular = 0; // skip "states" output
-    for (data_t *d = data; d; d = d->next) {
-        if (!strcmp(d->key, "msg") || !strcmp(d->key, "codes") || !strcmp(d->key, "model")) {
+    for (int i = 0; i < 3; ++i) {
+        if (data_record_get(&csv->record, csv->regular_ids[i])) {
             regular = 1;
             break;
         }
@@ -595,14 +621,9 @@ static void R_API_CALLCONV data_output_csv_print(data_output_t *output, data_t *
         return;
 
     for (int i = 0; fields[i]; ++i) {
-        const char *key = fields[i];
-        data_t *found   = NULL;
         if (i)
             fprintf(csv->file, "%s", csv->separator);
-        for (data_t *iter = data; !found && iter; iter = iter->next)
-            if (strcmp(iter->key, key) == 0)
-                found = iter;
-
+        data_t *found = data_record_get(&csv->record, i);
         if (found)
             print_value(output, found->type, found->value, found->format);
     }
@@ -615,6 +636,8 @@ static void R_API_CALLCONV data_output_csv_free(data_output_t *output)
 {
     data_output_csv_t *csv = (data_output_csv_t *)output;
 
+    data_record_release(&csv->record);
+    data_schema_free(csv->schema);
     free((void *)csv->fields);
     free(csv);
 }
@@ -209,8 +209,23 @@ typedef struct {
     char *states;
     //char *homie;
     //char *hass;
+    data_schema_t *schema; ///< well-known top level keys
+    data_record_t record;
 } data_output_mqtt_t;
 
+// well-known top level keys, in order of the field ids
+enum {
+    MQTT_FIELD_TYPE,
+    MQTT_FIELD_MODEL,
+    MQTT_FIELD_SUBTYPE,
+    MQTT_FIELD_CHANNEL,
+    MQTT_FIELD_ID,
+    MQTT_FIELD_PROTOCOL, // NOTE: needs "-M protocol"
+    MQTT_FIELD_COUNT,
+};
+
+static char const *const mqtt_fields[MQTT_FIELD_COUNT] = {"type", "model", "subtype", "channel", "id", "protocol"};
+
 static void R_API_CALLCONV print_mqtt_array(data_output_t *output, data_array_t *array, char const *format)
 {
     data_output_mqtt_t *mqtt = (data_output_mqtt_t *)output;
@@ -241,30 +256,9 @@ static char *append_topic(char *topic, data_t *data)
     return topic;
 }
 
-static char *expand_topic(char *topic, char const *format, data_t *data, char const *hostname)
+/// Expand a topic format, the record holds the well-known top level keys.
+static char *expand_topic(char *topic, char const *format, data_record_t const *record, char const *hostname)
 {
-    // collect well-known top level keys
-    data_t *data_type    = NULL;
-    data_t *data_model   = NULL;
-    data_t *data_subtype = NULL;
-    data_t *data_channel = NULL;
-    data_t *data_id      = NULL;
-    data_t *data_protocol = NULL;
-    for (data_t *d = data; d; d = d->next) {
-        if (!strcmp(d->key, "type"))
-            data_type = d;
-        else if (!strcmp(d->key, "model"))
-            data_model = d;
-        else if (!strcmp(d->key, "subtype"))
-            data_subtype = d;
-        else if (!strcmp(d->key, "channel"))
-            data_channel = d;
-        else if (!strcmp(d->key, "id"))
-            data_id = d;
-        else if (!strcmp(d->key, "protocol")) // NOTE: needs "-M protocol"
-            data_protocol = d;
-    }
-
     // consume entire format string
     while (format && *format) {
         data_t *data_token  = NULL;
@@ -304,20 +298,13 @@ static char *expand_topic(char *topic, char const *format, data_t *data, char co
         ++format;
 
         // resolve token
+        int field = 0;
+        while (field < MQTT_FIELD_COUNT && strncmp(t_start, mqtt_fields[field], t_end - t_start))
+            ++field;
         if (!strncmp(t_start, "hostname", t_end - t_start))
             string_token = hostname;
-        else if (!strncmp(t_start, "type", t_end - t_start))
-            data_token = data_type;
-        else if (!strncmp(t_start, "model", t_end - t_start))
-            data_token = data_model;
-        else if (!strncmp(t_start, "subtype", t_end - t_start))
-            data_token = data_subtype;
-        else if (!strncmp(t_start, "channel", t_end - t_start))
-            data_token = data_channel;
-        else if (!strncmp(t_start, "id", t_end - t_start))
-            data_token = data_id;
-        else if (!strncmp(t_start, "protocol", t_end - t_start))
-            data_token = data_protocol;
+        else if (field < MQTT_FIELD_COUNT)
+            data_token = data_record_get(record, field);
         else {
             print_logf(LOG_FATAL, __func__, "unknown token \"%.*s\"", (int)(t_end - t_start), t_start);
             exit(1);
@@ -352,11 +339,8 @@ static void R_API_CALLCONV print_mqtt_data(data_output_t *output, data_t *data,
     // top-level only
     if (!*mqtt->topic) {
         // collect well-known top level keys
-        data_t *data_model = NULL;
-        for (data_t *d = data; d; d = d->next) {
-            if (!strcmp(d->key, "model"))
-                data_model = d;
-        }
+        data_record_fill(&mqtt->record, data);
+        data_t *data_model = data_record_get(&mqtt->record, MQTT_FIELD_MODEL);
 
         // "states" topic
         if (!data_model) {
@@ -368,7 +352,7 @@ static void R_API_CALLCONV print_mqtt_data(data_output_t *output, data_t *data,
                     return; // NOTE: skip output on alloc failure.
                 }
                 data_print_jsons(data, message, message_size);
-                expand_topic(mqtt->topic, mqtt->states, data, mqtt->hostname);
+                expand_topic(mqtt->topic, mqtt->states, &mqtt->record, mqtt->hostname);
                 mqtt_client_publish(mqtt->mqc, mqtt->topic, message);
                 *mqtt->topic = '\0'; // clear topic
                 free(message);
@@ -380,7 +364,7 @@ static void R_API_CALLCONV print_mqtt_data(data_output_t *output, data_t *data,
         if (mqtt->events) {
             char message[2048]; // we expect the biggest strings to be around 500 bytes.
             data_print_jsons(data, message, sizeof(message));
-            expand_topic(mqtt->topic, mqtt->events, data, mqtt->hostname);
+            expand_topic(mqtt->topic, mqtt->events, &mqtt->record, mqtt->hostname);
             mqtt_client_publish(mqtt->mqc, mqtt->topic, message);
             *mqtt->topic = '\0'; // clear topic
         }
@@ -390,13 +374,14 @@ static void R_API_CALLCONV print_mqtt_data(data_output_t *output, data_t *data,
             return;
         }
 
-        end = expand_topic(mqtt->topic, mqtt->devices, data, mqtt->hostname);
+        end = expand_topic(mqtt->topic, mqtt->devices, &mqtt->record, mqtt->hostname);
     }
 
     while (data) {
-        if (!strcmp(data->key, "type")
-                || !strcmp(data->key, "model")
-                || !strcmp(data->key, "subtype")) {
+        int field = data_schema_id(mqtt->schema, data->key);
+        if (field == MQTT_FIELD_TYPE
+                || field == MQTT_FIELD_MODEL
+                || field == MQTT_FIELD_SUBTYPE) {
             // skip, except "id", "channel"
         }
         else {
@@ -457,6 +442,9 @@ static void R_API_CALLCONV data_output_mqtt_free(data_output_t *output)
     //free(mqtt->homie);
     //free(mqtt->hass);
 
+    data_record_release(&mqtt->record);
+    data_schema_free(mqtt->schema);
+
     mqtt_client_free(mqtt->mqc);
 
     free(mqtt);
@@ -589,6 +577,10 @@ struct data_output *data_output_mqtt_create(struct mg_mgr *mgr, char *param, cha
     if (mqtt->states)
         print_logf(LOG_NOTICE, "MQTT", "Publishing states info to MQTT topic \"%s\".", mqtt->states);
 
+    mqtt->schema = data_schema_create(mqtt_fields, MQTT_FIELD_COUNT);
+    if (!mqtt->schema || data_record_init(&mqtt->record, mqtt->schema))
+        FATAL_CALLOC("data_output_mqtt_create()");
+
     mqtt->output.print_data   = print_mqtt_data;
     mqtt->output.print_array  = print_mqtt_array;
     mqtt->output.print_string = print_mqtt_string;
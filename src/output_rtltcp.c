@@ -13,10 +13,14 @@
 
 #include "rtl_433.h"
 #include "r_api.h"
+#include "r_private.h"
 #include "r_util.h"
 #include "optparse.h"
+#include "baseband.h"
 #include "logger.h"
 #include "fatal.h"
+#include "data.h"
+#include "list.h"
 #include "compat_pthread.h"
 
 #include <string.h>
@@ -43,6 +47,8 @@
 
     #include <winsock2.h>
     #include <ws2tcpip.h>
+
+    #define SHUT_RDWR SD_BOTH
 #else
     #include <sys/types.h>
     #include <sys/socket.h>
@@ -87,29 +93,72 @@ typedef SSIZE_T ssize_t;
 /* rtl_tcp server */
 
 // Only available if Threads are enabled.
-// Currently serves a maximum of 1 client connection.
+// Serves a maximum of RTLTCP_MAX_CLIENTS client connections, each on its own thread.
 // The data backing from the SDR is assumed to be persistent, which is the case
 // since we never restart the SDR with different parameters or close it while active.
 // Should use shared memory for sendfile() someday.
 
+// Each client can negotiate a reduced bandwidth output mode:
+// - decimation by an integer factor with a low pass FIR (CU8 input only, CS16 is sent at full rate),
+// - requantization to 4 or 2 bits per component, packed MSB first (CU8 input only),
+// - PackBits block compression, each block prefixed with its 32-bit big-endian length.
+// The processing runs on the client thread, the SDR thread only publishes the buffer.
+// Client threads only read the server state, e.g. the sample rate, under the server lock.
+
 #ifdef THREADS
 
+#define RTLTCP_MAX_CLIENTS 8
+
+struct rtltcp_server;
+
+typedef struct rtltcp_client {
+    struct rtltcp_server *srv;
+    SOCKET sock;
+    int active;   ///< slot in use, client thread running
+    int joinable; ///< client thread ended but was not joined yet
+    pthread_t thread;
+    char host[INET6_ADDRSTRLEN];
+    char port[NI_MAXSERV];
+
+    unsigned decimate; ///< decimation factor, 1 is full rate
+    unsigned bits;     ///< bits per component, 8, 4, or 2
+    int compress;      ///< PackBits block compression
+    decimator_state_t decimator;
+    uint32_t pack_acc;  ///< requantization bit accumulator
+    unsigned pack_bits; ///< number of bits in the accumulator
+
+    uint8_t *work_buf; ///< processed data
+    uint8_t *pack_buf; ///< compressed data, shares the work buffer allocation
+    uint32_t buf_size; ///< size of each of work and pack buffers
+
+    time_t since;       ///< connection time
+    uint64_t bytes_in;  ///< input data bytes before processing
+    uint64_t bytes_out; ///< bytes sent to client
+} rtltcp_client_t;
+
 typedef struct rtltcp_server {
     struct sockaddr_storage addr;
     socklen_t addr_len;
     SOCKET sock;
     int client_count; ///< number of connected clients
     int control;      ///< are clients allowed to change SDR parameters
+    int stopping;     ///< server is shutting down, guarded by the lock
+    unsigned decimate; ///< default decimation factor for new clients
+    unsigned bits;     ///< default bits per component for new clients
+    int compress;      ///< default compression for new clients
 
     uint8_t const *data_buf; ///< data buffer with most recent data, NULL otherwise
     uint32_t data_len;       ///< data buffer length in bytes, 0 otherwise
     unsigned data_cnt;       ///< data buffer update counter
+    uint32_t samp_rate;      ///< sample rate of the data buffer
+    unsigned sample_size;    ///< sample size of the data buffer, 2 for CU8, 4 for CS16
 
     pthread_t thread;
-    pthread_mutex_t lock; ///< lock for data buffer
+    pthread_mutex_t lock; ///< lock for data buffer and clients
     pthread_cond_t cond;  ///< wait for data buffer
     r_cfg_t *cfg;
     struct raw_output *output;
+    rtltcp_client_t clients[RTLTCP_MAX_CLIENTS];
 } rtltcp_server_t;
 
 static ssize_t send_all(int sockfd, void const *buf, size_t len, int flags)
@@ -144,6 +193,10 @@ static void send_header(SOCKET sock)
 #define RTLTCP_SET_TUNER_XTAL 0x0c
 #define RTLTCP_SET_TUNER_GAIN_BY_ID 0x0d
 #define RTLTCP_SET_BIAS_TEE 0x0e
+// rtl_433 extensions to negotiate a reduced bandwidth output mode
+#define RTLTCP_SET_DECIMATION 0xd0
+#define RTLTCP_SET_BITS 0xd1
+#define RTLTCP_SET_COMPRESSION 0xd2
 
 /*
 E.g. initialization from Gqrx:
@@ -159,9 +212,43 @@ E.g. initialization from Gqrx:
 - RTLTCP_SET_FREQ  with 433968000
 */
 
-static int parse_command(r_cfg_t *cfg, int control, uint8_t const *buf, int len)
+static void client_set_mode(rtltcp_client_t *client, unsigned decimate, unsigned bits, int compress)
 {
-    UNUSED(cfg);
+    if (decimate < 1 || decimate > DECIMATOR_MAX_FACTOR) {
+        print_logf(LOG_WARNING, "rtl_tcp", "unsupported decimation %u for %s port %s", decimate, client->host, client->port);
+        decimate = client->decimate;
+    }
+    if (bits != 8 && bits != 4 && bits != 2) {
+        print_logf(LOG_WARNING, "rtl_tcp", "unsupported bits %u for %s port %s", bits, client->host, client->port);
+        bits = client->bits;
+    }
+
+    pthread_mutex_lock(&client->srv->lock);
+    if (decimate > 1 && client->srv->sample_size && client->srv->sample_size != 2) {
+        print_logf(LOG_WARNING, "rtl_tcp", "decimation needs CU8 input, full rate for %s port %s", client->host, client->port);
+        decimate = 1;
+    }
+    if (bits < 8 && client->srv->sample_size && client->srv->sample_size != 2) {
+        print_logf(LOG_WARNING, "rtl_tcp", "requantization needs CU8 input, 8 bits for %s port %s", client->host, client->port);
+        bits = 8;
+    }
+    if (decimate != client->decimate)
+        baseband_decimator_init(&client->decimator, decimate);
+    client->decimate  = decimate;
+    client->bits      = bits;
+    client->compress  = compress;
+    client->pack_acc  = 0;
+    client->pack_bits = 0;
+    pthread_mutex_unlock(&client->srv->lock);
+
+    print_logf(LOG_NOTICE, "rtl_tcp", "client %s port %s mode: decimate %u, %u bits, %s",
+            client->host, client->port, decimate, bits, compress ? "compressed" : "uncompressed");
+}
+
+static int parse_command(rtltcp_client_t *client, uint8_t const *buf, int len)
+{
+    r_cfg_t *cfg = client->srv->cfg;
+    int control  = client->srv->control;
 
     if (len < 5)
         return 0;
@@ -180,6 +267,14 @@ static int parse_command(r_cfg_t *cfg, int control, uint8_t const *buf, int len)
         print_logf(LOG_DEBUG, "rtl_tcp", "received command SET_SAMPLE_RATE with %u", arg);
         if (control)
             set_sample_rate(cfg, arg);
+        // otherwise an integer fraction of our sample rate selects decimation
+        else {
+            pthread_mutex_lock(&client->srv->lock);
+            uint32_t samp_rate = client->srv->samp_rate;
+            pthread_mutex_unlock(&client->srv->lock);
+            if (arg > 0 && arg <= samp_rate && samp_rate % arg == 0)
+                client_set_mode(client, samp_rate / arg, client->bits, client->compress);
+        }
         break;
     case RTLTCP_SET_GAIN_MODE:
         print_logf(LOG_DEBUG, "rtl_tcp", "received command SET_GAIN_MODE with %u", arg);
@@ -224,6 +319,18 @@ static int parse_command(r_cfg_t *cfg, int control, uint8_t const *buf, int len)
     case RTLTCP_SET_BIAS_TEE:
         print_logf(LOG_DEBUG, "rtl_tcp", "received command SET_BIAS_TEE with %u", arg);
         break;
+    case RTLTCP_SET_DECIMATION:
+        print_logf(LOG_DEBUG, "rtl_tcp", "received command SET_DECIMATION with %u", arg);
+        client_set_mode(client, arg, client->bits, client->compress);
+        break;
+    case RTLTCP_SET_BITS:
+        print_logf(LOG_DEBUG, "rtl_tcp", "received command SET_BITS with %u", arg);
+        client_set_mode(client, client->decimate, arg, client->compress);
+        break;
+    case RTLTCP_SET_COMPRESSION:
+        print_logf(LOG_DEBUG, "rtl_tcp", "received command SET_COMPRESSION with %u", arg);
+        client_set_mode(client, client->decimate, client->bits, arg != 0);
+        break;
     default:
         print_logf(LOG_WARNING, "rtl_tcp", "received unknown command %d with %u", cmd, arg);
         break;
@@ -242,11 +349,221 @@ static void rtltcp_broadcast_send(rtltcp_server_t *srv, uint8_t const *data, uin
     srv->data_buf = data;
     srv->data_len = len;
     srv->data_cnt += 1;
+    // snapshot the input format for the client threads
+    srv->samp_rate   = srv->cfg->samp_rate;
+    srv->sample_size = srv->cfg->demod->sample_size;
 
     pthread_mutex_unlock(&srv->lock);
-    pthread_cond_signal(&srv->cond);
-    // perhaps broadcast if we want to support multiple clients
-    //int pthread_cond_broadcast(&srv->cond);
+    pthread_cond_broadcast(&srv->cond);
+}
+
+/// Requantize CU8 components to fewer bits, packed MSB first, returns the output length.
+static uint32_t requantize(rtltcp_client_t *client, uint8_t *buf, uint32_t len)
+{
+    unsigned const bits  = client->bits;
+    unsigned const shift = 8 - bits;
+    unsigned const round = 1 << (shift - 1);
+    uint32_t acc   = client->pack_acc;
+    unsigned nbits = client->pack_bits;
+    uint32_t out   = 0;
+
+    for (uint32_t i = 0; i < len; ++i) {
+        unsigned v = buf[i] + round;
+        acc   = acc << bits | (v > 255 ? 255 : v) >> shift;
+        nbits += bits;
+        if (nbits == 8) {
+            buf[out++] = (uint8_t)acc;
+            acc   = 0;
+            nbits = 0;
+        }
+    }
+
+    client->pack_acc  = acc;
+    client->pack_bits = nbits;
+    return out;
+}
+
+/// PackBits compress a block with a 32-bit big-endian length prefix, returns the output length.
+/// The output buffer needs to hold at least `4 + len + (len + 127) / 128` bytes.
+static uint32_t packbits(uint8_t const *src, uint32_t len, uint8_t *dst)
+{
+    uint32_t out = 4;
+    uint32_t pos = 0;
+    while (pos < len) {
+        // measure the run at pos
+        uint32_t run = 1;
+        while (pos + run < len && run < 128 && src[pos + run] == src[pos])
+            run++;
+        if (run >= 3) {
+            dst[out++] = (uint8_t)(257 - run);
+            dst[out++] = src[pos];
+            pos += run;
+            continue;
+        }
+        // literals up to the next run of 3
+        uint32_t lit = 0;
+        while (pos + lit < len && lit < 128) {
+            if (pos + lit + 2 < len && src[pos + lit] == src[pos + lit + 1] && src[pos + lit] == src[pos + lit + 2])
+                break;
+            lit++;
+        }
+        dst[out++] = (uint8_t)(lit - 1);
+        memcpy(&dst[out], &src[pos], lit);
+        out += lit;
+        pos += lit;
+    }
+    uint32_t block = out - 4;
+    dst[0] = (uint8_t)(block >> 24);
+    dst[1] = (uint8_t)(block >> 16);
+    dst[2] = (uint8_t)(block >> 8);
+    dst[3] = (uint8_t)(block);
+    return out;
+}
+
+/// Apply the negotiated output mode, returns the data to send.
+static uint8_t const *client_process(rtltcp_client_t *client, int cu8, uint8_t const *data, uint32_t *len)
+{
+    if ((client->decimate <= 1 || !cu8) && (client->bits == 8 || !cu8) && !client->compress)
+        return data; // pass-through
+
+    uint32_t size = *len + (*len + 127) / 128 + 4;
+    if (client->buf_size < size) {
+        free(client->work_buf);
+        client->work_buf = malloc(2 * size);
+        if (!client->work_buf) {
+            WARN_MALLOC("client_process()");
+            client->buf_size = 0;
+            *len = 0;
+            return data;
+        }
+        client->pack_buf = client->work_buf + size;
+        client->buf_size = size;
+    }
+
+    uint8_t *buf = client->work_buf;
+    uint32_t n   = *len;
+    if (client->decimate > 1 && cu8)
+        n = (uint32_t)baseband_decimate_cu8(data, buf, n / 2, &client->decimator) * 2;
+    else
+        memcpy(buf, data, n);
+
+    if (client->bits < 8 && cu8)
+        n = requantize(client, buf, n);
+
+    if (client->compress) {
+        n   = packbits(buf, n, client->pack_buf);
+        buf = client->pack_buf;
+    }
+
+    *len = n;
+    return buf;
+}
+
+static THREAD_RETURN THREAD_CALL client_thread(void *arg)
+{
+    rtltcp_client_t *client = arg;
+    rtltcp_server_t *srv    = client->srv;
+    SOCKET sock             = client->sock;
+
+    pthread_mutex_lock(&srv->lock);
+    unsigned prev_cnt = srv->data_cnt + 9; // data sent in previous loop, random value to get the current buffer
+    pthread_mutex_unlock(&srv->lock);
+
+    send_header(sock);
+
+    // Client loop
+    for (;;) {
+        pthread_mutex_lock(&srv->lock);
+        int stopping = srv->stopping;
+        pthread_mutex_unlock(&srv->lock);
+        if (stopping)
+            break;
+
+        // Read available commands
+        int abort = 0;
+        for (;;) {
+            fd_set fds;
+            FD_ZERO(&fds);
+            FD_SET(sock, &fds);
+            struct timeval timeout = {0};
+
+            int ready = select(sock + 1, &fds, NULL, NULL, &timeout);
+            if (ready <= 0)
+                break;
+
+            uint8_t buf[128] = {0};
+            ssize_t len = recv(sock, buf, sizeof(buf), 0);
+            //print_logf(LOG_TRACE, "rtl_tcp", "recv %zd bytes (%d)", len, ready);
+            if (len <= 0) {
+                abort = 1;
+                break;
+            }
+            int pos = 0;
+            while (pos + 5 <= len) {
+                pos += parse_command(client, & buf[pos], (int)len - pos);
+            }
+        }
+        if (abort) {
+            break;
+        }
+
+        // Wait for send buffer to clear
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(sock, &fds);
+        struct timeval timeout = {.tv_usec = 100000}; // Wait at most 100 ms
+
+        int ready = select(sock + 1, NULL, &fds, NULL, &timeout);
+        if (ready <= 0) {
+            print_log(LOG_ERROR, "rtl_tcp", "send not ready for write?");
+            break; // Cancel the connection on network problems
+        }
+
+        // Wait for next frame
+        pthread_mutex_lock(&srv->lock);
+        while (!srv->stopping && (srv->data_cnt == prev_cnt || srv->data_buf == NULL))
+            pthread_cond_wait(&srv->cond, &srv->lock);
+        // Maybe timeout to check recv()
+        // pthread_cond_timedwait(&srv->cond, &srv->lock, const struct timespec *abstime);
+
+        // Get data buffer reference
+        uint8_t const *data = srv->data_buf;
+        uint32_t data_len   = srv->data_len;
+        prev_cnt            = srv->data_cnt;
+        int cu8             = srv->sample_size == 2;
+        stopping            = srv->stopping;
+
+        pthread_mutex_unlock(&srv->lock);
+        if (stopping)
+            break;
+
+        // Process and send frame
+        uint32_t out_len = data_len;
+        uint8_t const *out = client_process(client, cu8, data, &out_len);
+        ssize_t sent = send_all(sock, out, out_len, MSG_NOSIGNAL); // ignore SIGPIPE
+
+        pthread_mutex_lock(&srv->lock);
+        client->bytes_in += data_len;
+        if (sent > 0)
+            client->bytes_out += (uint64_t)sent;
+        pthread_mutex_unlock(&srv->lock);
+    }
+
+    print_logf(LOG_NOTICE, "rtl_tcp", "client disconnected from %s port %s", client->host, client->port);
+    closesocket(sock);
+
+    pthread_mutex_lock(&srv->lock);
+    free(client->work_buf);
+    client->work_buf = NULL;
+    client->pack_buf = NULL;
+    client->buf_size = 0;
+    client->sock     = INVALID_SOCKET;
+    client->active   = 0;
+    client->joinable = 1;
+    srv->client_count -= 1;
+    pthread_mutex_unlock(&srv->lock);
+
+    return 0;
 }
 
 static THREAD_RETURN THREAD_CALL accept_thread(void *arg)
@@ -254,7 +571,7 @@ static THREAD_RETURN THREAD_CALL accept_thread(void *arg)
     rtltcp_server_t *srv = arg;
 
     // Start listening for clients, waits for an incoming connection
-    listen(srv->sock, 1);
+    listen(srv->sock, RTLTCP_MAX_CLIENTS);
     // print_log(LOG_DEBUG, "rtl_tcp", "rtl_tcp listening...");
 
     for (;;) {
@@ -274,6 +591,7 @@ static THREAD_RETURN THREAD_CALL accept_thread(void *arg)
         int opt = 1;
         if (setsockopt(sock, SOL_SOCKET, SO_NOSIGPIPE, &opt, sizeof(opt)) == -1) {
             perror("setsockopt");
+            closesocket(sock);
             continue;
         }
 #endif
@@ -285,83 +603,57 @@ static THREAD_RETURN THREAD_CALL accept_thread(void *arg)
                 host, sizeof(host), port, sizeof(port), NI_NUMERICHOST | NI_NUMERICSERV);
         if (err != 0) {
             print_logf(LOG_ERROR, __func__, "failed to convert address to string (code=%d)", err);
+            closesocket(sock);
             continue;
         }
-        print_logf(LOG_NOTICE, "rtl_tcp", "client connected from %s port %s", host, port);
 
+        // Find a free client slot, reap an ended client thread
         pthread_mutex_lock(&srv->lock);
-        srv->client_count += 1;
-        unsigned prev_cnt = srv->data_cnt + 9; // data sent in previous loop, random value to get the current buffer
-        pthread_mutex_unlock(&srv->lock);
-
-        send_header(sock);
-
-        // Client loop
-        for (;;) {
-            // Read available commands
-            int abort = 0;
-            for (;;) {
-                fd_set fds;
-                FD_ZERO(&fds);
-                FD_SET(sock, &fds);
-                struct timeval timeout = {0};
-
-                int ready = select(sock + 1, &fds, NULL, NULL, &timeout);
-                if (ready <= 0)
-                    break;
-
-                uint8_t buf[128] = {0};
-                ssize_t len = recv(sock, buf, sizeof(buf), 0);
-                //print_logf(LOG_TRACE, "rtl_tcp", "recv %zd bytes (%d)", len, ready);
-                if (len <= 0) {
-                    abort = 1;
-                    break;
-                }
-                int pos = 0;
-                while (pos + 5 <= len) {
-                    pos += parse_command(srv->cfg, srv->control, & buf[pos], (int)len - pos);
-                }
-            }
-            if (abort) {
+        rtltcp_client_t *client = NULL;
+        for (int i = 0; i < RTLTCP_MAX_CLIENTS; ++i) {
+            if (!srv->clients[i].active) {
+                client = &srv->clients[i];
                 break;
             }
+        }
+        int joinable = client && client->joinable;
+        pthread_mutex_unlock(&srv->lock);
 
-            // Wait for send buffer to clear
-            fd_set fds;
-            FD_ZERO(&fds);
-            FD_SET(sock, &fds);
-            struct timeval timeout = {.tv_usec = 100000}; // Wait at most 100 ms
-
-            int ready = select(sock + 1, NULL, &fds, NULL, &timeout);
-            if (ready <= 0) {
-                print_log(LOG_ERROR, "rtl_tcp", "send not ready for write?");
-                break; // Cancel the connection on network problems
-            }
-
-            // Wait for next frame
-            pthread_mutex_lock(&srv->lock);
-            while (srv->data_cnt == prev_cnt || srv->data_buf == NULL)
-                pthread_cond_wait(&srv->cond, &srv->lock);
-            // Maybe timeout to check recv()
-            // pthread_cond_timedwait(&srv->cond, &srv->lock, const struct timespec *abstime);
-
-            // Get data buffer reference
-            void const *data = srv->data_buf;
-            int data_len     = srv->data_len;
-            prev_cnt         = srv->data_cnt;
-
-            pthread_mutex_unlock(&srv->lock);
-
-            // Send frame
-            send_all(sock, data, data_len, MSG_NOSIGNAL); // ignore SIGPIPE
+        if (!client) {
+            print_logf(LOG_WARNING, "rtl_tcp", "client from %s port %s rejected, too many clients", host, port);
+            closesocket(sock);
+            continue;
         }
+        if (joinable)
+            pthread_join(client->thread, NULL);
+
+        print_logf(LOG_NOTICE, "rtl_tcp", "client connected from %s port %s", host, port);
 
         pthread_mutex_lock(&srv->lock);
-        srv->client_count -= 1;
+        memset(client, 0, sizeof(*client));
+        client->srv      = srv;
+        client->sock     = sock;
+        client->active   = 1;
+        client->decimate = srv->sample_size && srv->sample_size != 2 ? 1 : srv->decimate; // CU8 input only
+        client->bits     = srv->sample_size && srv->sample_size != 2 ? 8 : srv->bits; // CU8 input only
+        client->compress = srv->compress;
+        baseband_decimator_init(&client->decimator, client->decimate);
+        snprintf(client->host, sizeof(client->host), "%s", host);
+        snprintf(client->port, sizeof(client->port), "%s", port);
+        time(&client->since);
+        srv->client_count += 1;
         pthread_mutex_unlock(&srv->lock);
 
-        print_logf(LOG_NOTICE, "rtl_tcp", "client disconnected from %s port %s", host, port);
-        closesocket(sock);
+        int r = pthread_create(&client->thread, NULL, client_thread, client);
+        if (r) {
+            fprintf(stderr, "%s: error in pthread_create, rc: %d\n", __func__, r);
+            closesocket(sock);
+            pthread_mutex_lock(&srv->lock);
+            client->sock   = INVALID_SOCKET;
+            client->active = 0;
+            srv->client_count -= 1;
+            pthread_mutex_unlock(&srv->lock);
+        }
     }
     return 0;
 }
@@ -408,6 +700,9 @@ static int rtltcp_server_start(rtltcp_server_t *srv, char const *host, char cons
 
     srv->cfg     = cfg;
     srv->output  = output;
+    // updated with each data buffer
+    srv->samp_rate   = cfg->samp_rate;
+    srv->sample_size = cfg->demod->sample_size;
 
     char address[INET6_ADDRSTRLEN] = {0};
     char portstr[NI_MAXSERV] = {0};
@@ -448,11 +743,29 @@ static int rtltcp_server_stop(rtltcp_server_t *srv)
 
     print_logf(LOG_NOTICE, "rtl_tcp server", "Stopping rtl_tcp server...");
 
-    // thread is likely blocking in accept, recv, or send
+    // thread is likely blocking in accept
     int r = pthread_cancel(srv->thread);
     if (r) {
         fprintf(stderr, "%s: error in pthread_cancel, rc: %d\n", __func__, r);
     }
+    else {
+        pthread_join(srv->thread, NULL);
+    }
+
+    // client threads are waiting for data or blocking in send
+    pthread_mutex_lock(&srv->lock);
+    srv->stopping = 1;
+    for (int i = 0; i < RTLTCP_MAX_CLIENTS; ++i) {
+        if (srv->clients[i].active)
+            shutdown(srv->clients[i].sock, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&srv->lock);
+    pthread_cond_broadcast(&srv->cond);
+    for (int i = 0; i < RTLTCP_MAX_CLIENTS; ++i) {
+        if (srv->clients[i].active || srv->clients[i].joinable)
+            pthread_join(srv->clients[i].thread, NULL);
+    }
+
     pthread_mutex_destroy(&srv->lock);
     pthread_cond_destroy(&srv->cond);
 
@@ -486,6 +799,45 @@ static void raw_output_rtltcp_frame(raw_output_t *output, uint8_t const *data, u
     rtltcp_broadcast_send(&rtltcp->server, data, len);
 }
 
+static data_t *raw_output_rtltcp_stats(raw_output_t *output)
+{
+    raw_output_rtltcp_t *rtltcp = (raw_output_rtltcp_t *)output;
+    rtltcp_server_t *srv        = &rtltcp->server;
+
+    list_t client_list = {0};
+    time_t now;
+    time(&now);
+
+    pthread_mutex_lock(&srv->lock);
+    for (int i = 0; i < RTLTCP_MAX_CLIENTS; ++i) {
+        rtltcp_client_t *client = &srv->clients[i];
+        if (!client->active)
+            continue;
+        double secs = now > client->since ? (double)(now - client->since) : 1.0;
+        data_t *data = data_make(
+                "host",         "", DATA_STRING, client->host,
+                "port",         "", DATA_STRING, client->port,
+                "decimate",     "", DATA_INT, srv->sample_size == 2 ? client->decimate : 1, // the effective factor
+                "bits",         "", DATA_INT, srv->sample_size == 2 ? client->bits : 8, // the effective bits
+                "compress",     "", DATA_INT, client->compress,
+                "bytes_in",     "", DATA_FORMAT, "%.0f", DATA_DOUBLE, (double)client->bytes_in,
+                "bytes_out",    "", DATA_FORMAT, "%.0f", DATA_DOUBLE, (double)client->bytes_out,
+                "kbps_in",      "", DATA_FORMAT, "%.1f", DATA_DOUBLE, client->bytes_in * 8.0 / 1000.0 / secs,
+                "kbps_out",     "", DATA_FORMAT, "%.1f", DATA_DOUBLE, client->bytes_out * 8.0 / 1000.0 / secs,
+                NULL);
+        list_push(&client_list, data);
+    }
+    pthread_mutex_unlock(&srv->lock);
+
+    data_t *data = data_make(
+            "output",       "", DATA_STRING, "rtl_tcp",
+            "clients",      "", DATA_ARRAY, data_array(client_list.len, DATA_DATA, client_list.elems),
+            NULL);
+
+    list_free_elems(&client_list, NULL);
+    return data;
+}
+
 static void raw_output_rtltcp_free(raw_output_t *output)
 {
     raw_output_rtltcp_t *rtltcp = (raw_output_rtltcp_t *)output;
@@ -498,7 +850,7 @@ static void raw_output_rtltcp_free(raw_output_t *output)
     free(rtltcp);
 }
 
-struct raw_output *raw_output_rtltcp_create(const char *host, const char *port, char const *opts, r_cfg_t *cfg)
+struct raw_output *raw_output_rtltcp_create(char const *host, char const *port, char *opts, r_cfg_t *cfg)
 {
     raw_output_rtltcp_t *rtltcp = calloc(1, sizeof(raw_output_rtltcp_t));
     if (!rtltcp) {
@@ -515,15 +867,40 @@ struct raw_output *raw_output_rtltcp_create(const char *host, const char *port,
     }
 #endif
 
-    // If clients allowed to change SDR parameters
-    if (opts && !strcasecmp(opts, "control"))
-        rtltcp->server.control = 1;
-    else if (opts && *opts) {
-        print_logf(LOG_FATAL, __func__, "Invalid \"%s\" option.", opts);
+    rtltcp->server.decimate = 1;
+    rtltcp->server.bits     = 8;
+
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        // If clients allowed to change SDR parameters
+        else if (!strcasecmp(key, "control"))
+            rtltcp->server.control = atobv(val, 1);
+        else if (!strcasecmp(key, "decimate"))
+            rtltcp->server.decimate = atoiv(val, 1);
+        else if (!strcasecmp(key, "bits"))
+            rtltcp->server.bits = atoiv(val, 8);
+        else if (!strcasecmp(key, "compress"))
+            rtltcp->server.compress = atobv(val, 1);
+        else {
+            print_logf(LOG_FATAL, __func__, "Invalid key \"%s\" option.", key);
+            exit(1);
+        }
+    }
+    if (rtltcp->server.decimate < 1 || rtltcp->server.decimate > DECIMATOR_MAX_FACTOR) {
+        print_logf(LOG_FATAL, __func__, "Invalid decimation %u, use 1 to %d.", rtltcp->server.decimate, DECIMATOR_MAX_FACTOR);
+        exit(1);
+    }
+    if (rtltcp->server.bits != 8 && rtltcp->server.bits != 4 && rtltcp->server.bits != 2) {
+        print_logf(LOG_FATAL, __func__, "Invalid bits %u, use 8, 4, or 2.", rtltcp->server.bits);
         exit(1);
     }
 
     rtltcp->output.output_frame  = raw_output_rtltcp_frame;
+    rtltcp->output.output_stats  = raw_output_rtltcp_stats;
     rtltcp->output.output_free   = raw_output_rtltcp_free;
 
     int ret = rtltcp_server_start(&rtltcp->server, host, port, cfg, &rtltcp->output);
@@ -536,10 +913,11 @@ struct raw_output *raw_output_rtltcp_create(const char *host, const char *port,
 
 #else
 
-struct raw_output *raw_output_rtltcp_create(const char *host, const char *port, r_cfg_t *cfg)
+struct raw_output *raw_output_rtltcp_create(char const *host, char const *port, char *opts, r_cfg_t *cfg)
 {
     UNUSED(host);
     UNUSED(port);
+    UNUSED(opts);
     UNUSED(cfg);
     print_log(LOG_ERROR, "rtl_tcp server", "rtl_tcp output not available in this build!");
     return NULL;
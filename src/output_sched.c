@@ -0,0 +1,467 @@
+/** @file
+    Rate-limited output stage with priority classes for rtl_433 events.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+/*
+A token bucket per output: each event takes a token, tokens are refilled at
+the configured rate up to the burst size. Events without a token wait in a
+FIFO per priority class, the queues are drained highest class first as the
+tokens are refilled. A burst of events, e.g. many TPMS sensors at once, then
+reaches a slow output, e.g. MQTT over a cellular link, at a bounded rate with
+alarms first, instead of backing up the event loop.
+*/
+
+#include "output_sched.h"
+
+#include "data.h"
+#include "list.h"
+#include "r_util.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char const *const priority_names[SCHED_CLASSES] = {"alarm", "high", "normal", "low"};
+
+/* Priority rules */
+
+int sched_priority_parse(char const *name)
+{
+    if (!name || !*name)
+        return -1;
+    for (int i = 0; i < SCHED_CLASSES; ++i) {
+        if (!strcasecmp(name, priority_names[i]))
+            return i;
+    }
+    char *endptr;
+    long val = strtol(name, &endptr, 10);
+    if (*endptr || val < 0 || val >= SCHED_CLASSES)
+        return -1;
+    return (int)val;
+}
+
+int sched_rules_add(list_t *rules, char const *spec)
+{
+    char const *models = spec ? strchr(spec, '=') : NULL;
+    if (!models || !models[1])
+        return -1;
+
+    char class_str[16] = {0};
+    size_t class_len = (size_t)(models - spec);
+    if (class_len >= sizeof(class_str))
+        return -1;
+    memcpy(class_str, spec, class_len);
+    int priority = sched_priority_parse(class_str);
+    if (priority < 0)
+        return -1;
+
+    int count = 0;
+    for (char const *p = models + 1; *p;) {
+        char const *end = strchr(p, ',');
+        size_t len      = end ? (size_t)(end - p) : strlen(p);
+        if (len) {
+            sched_rule_t *rule = calloc(1, sizeof(*rule));
+            if (!rule)
+                FATAL_CALLOC("sched_rules_add()");
+            rule->model = malloc(len + 1);
+            if (!rule->model)
+                FATAL_MALLOC("sched_rules_add()");
+            memcpy(rule->model, p, len);
+            rule->model[len] = '\0';
+            rule->priority   = priority;
+            list_push(rules, rule);
+            count++;
+        }
+        p += len;
+        if (*p)
+            p++; // skip the comma
+    }
+    return count;
+}
+
+void sched_rule_free(sched_rule_t *rule)
+{
+    if (!rule)
+        return;
+    free(rule->model);
+    free(rule);
+}
+
+static int rule_matches(sched_rule_t const *rule, char const *model)
+{
+    size_t len = strlen(rule->model);
+    if (len && rule->model[len - 1] == '*')
+        return !strncmp(rule->model, model, len - 1);
+    return !strcmp(rule->model, model);
+}
+
+/* Scheduling printer */
+
+/// A FIFO of retained events, a ring of the backlog size.
+typedef struct {
+    data_t **ring;
+    unsigned head;
+    unsigned len;
+} sched_queue_t;
+
+typedef struct {
+    struct data_output output;
+    struct data_output *inner;
+    char *name;
+    list_t const *rules;
+    double rate;  ///< tokens per second
+    double burst; ///< maximum tokens
+    double tokens;
+    double last;  ///< time of the last refill in seconds
+    unsigned backlog;
+    unsigned queued;
+    sched_queue_t queue[SCHED_CLASSES];
+    // stats
+    unsigned sent;
+    unsigned delayed;
+    unsigned max_queued;
+    unsigned dropped[SCHED_CLASSES];
+} data_output_sched_t;
+
+static int sched_classify(data_output_sched_t *sched, data_t *data)
+{
+    char const *model = NULL;
+    for (data_t *d = data; d; d = d->next) {
+        if (d->type == DATA_STRING && !strcmp(d->key, "model")) {
+            model = d->value.v_ptr;
+            break;
+        }
+    }
+    if (!model)
+        return SCHED_HIGH; // logs and reports
+    if (!sched->rules)
+        return SCHED_NORMAL;
+
+    for (void **iter = sched->rules->elems; iter && *iter; ++iter) {
+        sched_rule_t const *rule = *iter;
+        if (rule_matches(rule, model))
+            return rule->priority;
+    }
+    return SCHED_NORMAL;
+}
+
+static void sched_push(data_output_sched_t *sched, int priority, data_t *data)
+{
+    sched_queue_t *q = &sched->queue[priority];
+    q->ring[(q->head + q->len) % sched->backlog] = data_retain(data);
+    q->len++;
+    sched->queued++;
+    if (sched->queued > sched->max_queued)
+        sched->max_queued = sched->queued;
+}
+
+/// Remove the oldest event of a class, the caller must release it.
+static data_t *sched_pop(data_output_sched_t *sched, int priority)
+{
+    sched_queue_t *q = &sched->queue[priority];
+    data_t *data     = q->ring[q->head];
+    q->head          = (q->head + 1) % sched->backlog;
+    q->len--;
+    sched->queued--;
+    return data;
+}
+
+static void sched_refill(data_output_sched_t *sched, double now)
+{
+    if (now < sched->last)
+        sched->last = now; // the clock was set back
+    sched->tokens += (now - sched->last) * sched->rate;
+    if (sched->tokens > sched->burst)
+        sched->tokens = sched->burst;
+    sched->last = now;
+}
+
+/// Send queued events, highest class first, while tokens are available.
+static void sched_drain(data_output_sched_t *sched)
+{
+    for (int i = 0; i < SCHED_CLASSES && sched->tokens >= 1.0; ++i) {
+        while (sched->queue[i].len && sched->tokens >= 1.0) {
+            data_t *data = sched_pop(sched, i);
+            sched->tokens -= 1.0;
+            sched->sent++;
+            data_output_print(sched->inner, data);
+            data_free(data);
+        }
+    }
+}
+
+static void sched_print_at(data_output_sched_t *sched, data_t *data, double now)
+{
+    sched_refill(sched, now);
+    sched_drain(sched);
+
+    if (!sched->queued && sched->tokens >= 1.0) {
+        sched->tokens -= 1.0;
+        sched->sent++;
+        data_output_print(sched->inner, data);
+        return;
+    }
+
+    int priority = sched_classify(sched, data);
+    if (sched->queued >= sched->backlog) {
+        int lowest = SCHED_CLASSES - 1;
+        while (!sched->queue[lowest].len)
+            lowest--;
+        if (priority > lowest) {
+            sched->dropped[priority]++;
+            return;
+        }
+        // drop the oldest, a newer event of the same class is likely more useful
+        data_free(sched_pop(sched, lowest));
+        sched->dropped[lowest]++;
+    }
+    sched_push(sched, priority, data);
+    sched->delayed++;
+}
+
+static double sched_now(void)
+{
+    struct timeval now;
+    get_time_now(&now);
+    return now.tv_sec + now.tv_usec * 1e-6;
+}
+
+static void R_API_CALLCONV data_output_sched_print(data_output_t *output, data_t *data)
+{
+    data_output_sched_t *sched = (data_output_sched_t *)output;
+
+    sched_print_at(sched, data, sched_now());
+}
+
+static void R_API_CALLCONV data_output_sched_start(data_output_t *output, char const *const *fields, int num_fields)
+{
+    data_output_sched_t *sched = (data_output_sched_t *)output;
+
+    data_output_start(sched->inner, fields, num_fields);
+}
+
+static void R_API_CALLCONV data_output_sched_free(data_output_t *output)
+{
+    data_output_sched_t *sched = (data_output_sched_t *)output;
+
+    if (!sched)
+        return;
+
+    // send the backlog on exit, regardless of the rate
+    sched->tokens = sched->queued;
+    sched_drain(sched);
+    for (int i = 0; i < SCHED_CLASSES; ++i)
+        free(sched->queue[i].ring);
+    data_output_free(sched->inner);
+    free(sched->name);
+    free(sched);
+}
+
+void data_output_sched_poll(struct data_output *output)
+{
+    data_output_sched_t *sched = (data_output_sched_t *)output;
+
+    if (!sched || !sched->queued)
+        return;
+
+    sched_refill(sched, sched_now());
+    sched_drain(sched);
+}
+
+data_t *data_output_sched_stats(struct data_output *output, int reset)
+{
+    data_output_sched_t *sched = (data_output_sched_t *)output;
+
+    if (!sched)
+        return NULL;
+
+    /* clang-format off */
+    data_t *dropped = data_make(
+            "alarm",        "", DATA_INT, sched->dropped[SCHED_ALARM],
+            "high",         "", DATA_INT, sched->dropped[SCHED_HIGH],
+            "normal",       "", DATA_INT, sched->dropped[SCHED_NORMAL],
+            "low",          "", DATA_INT, sched->dropped[SCHED_LOW],
+            NULL);
+    data_t *data = data_make(
+            "output",       "", DATA_STRING, sched->name,
+            "rate",         "", DATA_FORMAT, "%.3f", DATA_DOUBLE, sched->rate,
+            "sent",         "", DATA_INT, sched->sent,
+            "delayed",      "", DATA_INT, sched->delayed,
+            "backlog",      "", DATA_INT, sched->queued,
+            "max_backlog",  "", DATA_INT, sched->max_queued,
+            "dropped",      "", DATA_DATA, dropped,
+            NULL);
+    /* clang-format on */
+
+    if (reset) {
+        sched->sent       = 0;
+        sched->delayed    = 0;
+        sched->max_queued = sched->queued;
+        memset(sched->dropped, 0, sizeof(sched->dropped));
+    }
+    return data;
+}
+
+struct data_output *data_output_sched_create(struct data_output *inner, char const *name, double rate, unsigned burst, unsigned backlog, list_t const *rules)
+{
+    data_output_sched_t *sched = calloc(1, sizeof(data_output_sched_t));
+    if (!sched)
+        FATAL_CALLOC("data_output_sched_create()");
+
+    sched->output.output_print = data_output_sched_print;
+    sched->output.output_start = data_output_sched_start;
+    sched->output.output_free  = data_output_sched_free;
+    sched->output.log_level    = inner ? inner->log_level : 0;
+    sched->inner               = inner;
+    sched->rules               = rules;
+    sched->rate                = rate > 0.0 ? rate : 1.0;
+    // one second of events, but at least one
+    sched->burst               = burst ? burst : sched->rate < 1.0 ? 1.0 : (unsigned)sched->rate;
+    sched->tokens              = sched->burst;
+    sched->last                = sched_now();
+    sched->backlog             = backlog ? backlog : SCHED_DEFAULT_BACKLOG;
+
+    sched->name = strdup(name ? name : "");
+    if (!sched->name)
+        FATAL_STRDUP("data_output_sched_create()");
+    for (int i = 0; i < SCHED_CLASSES; ++i) {
+        sched->queue[i].ring = calloc(sched->backlog, sizeof(data_t *));
+        if (!sched->queue[i].ring)
+            FATAL_CALLOC("data_output_sched_create()");
+    }
+
+    return &sched->output;
+}
+
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: line %d: %d <> %d\n", __LINE__, (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+/// Records the id of each event printed.
+typedef struct {
+    struct data_output output;
+    int ids[64];
+    unsigned len;
+} test_output_t;
+
+static void R_API_CALLCONV test_output_print(data_output_t *output, data_t *data)
+{
+    test_output_t *out = (test_output_t *)output;
+    for (data_t *d = data; d; d = d->next) {
+        if (!strcmp(d->key, "id") && out->len < 64)
+            out->ids[out->len++] = d->value.v_int;
+    }
+}
+
+static void R_API_CALLCONV test_output_free(data_output_t *output)
+{
+    (void)output; // on the stack
+}
+
+static void test_event(data_output_sched_t *sched, char const *model, int id, double now)
+{
+    data_t *data = data_make(
+            "model", "", DATA_STRING, model,
+            "id",    "", DATA_INT, id,
+            NULL);
+    sched_print_at(sched, data, now);
+    data_free(data);
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    fprintf(stderr, "output_sched:: test\n");
+
+    ASSERT_EQUALS(sched_priority_parse("alarm"), SCHED_ALARM);
+    ASSERT_EQUALS(sched_priority_parse("Low"), SCHED_LOW);
+    ASSERT_EQUALS(sched_priority_parse("1"), SCHED_HIGH);
+    ASSERT_EQUALS(sched_priority_parse("4"), -1);
+    ASSERT_EQUALS(sched_priority_parse("urgent"), -1);
+
+    list_t rules = {0};
+    ASSERT_EQUALS(sched_rules_add(&rules, "alarm=Smoke*,Secplus-v2"), 2);
+    ASSERT_EQUALS(sched_rules_add(&rules, "low=Acurite-*"), 1);
+    ASSERT_EQUALS(sched_rules_add(&rules, "urgent=TPMS"), -1);
+    ASSERT_EQUALS(sched_rules_add(&rules, "low"), -1);
+
+    test_output_t out = {0};
+    out.output.output_print = test_output_print;
+    out.output.output_free  = test_output_free;
+
+    // 2 events per second, a burst of 2, a backlog of 3
+    data_output_sched_t *sched = (data_output_sched_t *)data_output_sched_create(&out.output, "test", 2.0, 2, 3, &rules);
+    sched->last = 100.0;
+
+    // the burst passes, the rest is queued
+    test_event(sched, "Acurite-Tower", 1, 100.0);
+    test_event(sched, "Acurite-Tower", 2, 100.0);
+    test_event(sched, "Acurite-Tower", 3, 100.0);
+    test_event(sched, "TPMS", 4, 100.0);
+    ASSERT_EQUALS(out.len, 2);
+    ASSERT_EQUALS(sched->queued, 2);
+
+    // full: drops the oldest low event for an alarm, then a new low event
+    test_event(sched, "Smoke-GS558", 5, 100.0);
+    ASSERT_EQUALS(sched->queued, 3);
+    test_event(sched, "Acurite-Tower", 6, 100.0);
+    ASSERT_EQUALS(sched->dropped[SCHED_LOW], 1);
+    test_event(sched, "Acurite-Tower", 7, 100.0);
+    ASSERT_EQUALS(sched->dropped[SCHED_LOW], 2);
+    ASSERT_EQUALS(sched->queued, 3);
+    test_event(sched, "Acurite-Tower", 8, 100.0);
+    ASSERT_EQUALS(sched->dropped[SCHED_LOW], 3);
+
+    // refilled, the alarm goes first
+    sched_refill(sched, 100.5);
+    sched_drain(sched);
+    ASSERT_EQUALS(out.len, 3);
+    ASSERT_EQUALS(out.ids[2], 5);
+    sched_refill(sched, 101.5);
+    sched_drain(sched);
+    ASSERT_EQUALS(out.len, 5);
+    ASSERT_EQUALS(out.ids[3], 4);
+    ASSERT_EQUALS(out.ids[4], 8);
+    ASSERT_EQUALS(sched->queued, 0);
+
+    // the bucket is capped at the burst size
+    sched_refill(sched, 200.0);
+    ASSERT_EQUALS(sched->tokens == 2.0, 1);
+
+    // the backlog is sent on exit
+    test_event(sched, "TPMS", 9, 200.0);
+    test_event(sched, "TPMS", 10, 200.0);
+    test_event(sched, "TPMS", 11, 200.0);
+    ASSERT_EQUALS(sched->queued, 1);
+    ASSERT_EQUALS(sched->sent, 7);
+    ASSERT_EQUALS(sched->delayed, 7);
+    ASSERT_EQUALS(sched->max_queued, 3);
+
+    data_output_free(&sched->output);
+    ASSERT_EQUALS(out.len, 8);
+    ASSERT_EQUALS(out.ids[7], 11);
+
+    list_free_elems(&rules, (list_elem_free_fn)sched_rule_free);
+
+    fprintf(stderr, "output_sched:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+
+    return failed;
+}
+#endif /* _TEST */
@@ -17,25 +17,8 @@
 #include <string.h>
 #include <limits.h>
 
-#define MAX_HIST_BINS 16
-
-/// Histogram data for single bin
-typedef struct {
-    unsigned count;
-    int sum;
-    int mean;
-    int min;
-    int max;
-} hist_bin_t;
-
-/// Histogram data for all bins
-typedef struct {
-    unsigned bins_count;
-    hist_bin_t bins[MAX_HIST_BINS];
-} histogram_t;
-
 /// Generate a histogram (unsorted)
-static void histogram_sum(histogram_t *hist, int const *data, unsigned len, float tolerance)
+void histogram_sum(histogram_t *hist, int const *data, unsigned len, float tolerance)
 {
     unsigned bin;    // Iterator will be used outside for!
 
@@ -92,7 +75,7 @@ static void histogram_swap_bins(histogram_t *hist, unsigned index1, unsigned ind
 
 
 /// Sort histogram with mean value (order lowest to highest)
-static void histogram_sort_mean(histogram_t *hist)
+void histogram_sort_mean(histogram_t *hist)
 {
     if (hist->bins_count < 2) return;        // Avoid underflow
     // Compare all bins (bubble sort)
@@ -122,7 +105,7 @@ static void histogram_sort_count(histogram_t *hist)
 
 
 /// Fuse histogram bins with means within tolerance
-static void histogram_fuse_bins(histogram_t *hist, float tolerance)
+void histogram_fuse_bins(histogram_t *hist, float tolerance)
 {
     if (hist->bins_count < 2) return;        // Avoid underflow
     // Compare all bins
@@ -201,6 +184,161 @@ static void hexstr_print(hexstr_t *h, FILE *out)
 
 #define TOLERANCE (0.2f) // 20% tolerance should still discern between the pulse widths: 0.33, 0.66, 1.0
 
+/// Guess the modulation from the histograms, sorts the pulse and gap histograms.
+static char const *guess_modulation(pulse_data_t const *data, int package_type, histogram_t *hist_pulses, histogram_t *hist_gaps, histogram_t const *hist_periods, r_device *device)
+{
+    double to_us     = 1e6 / data->sample_rate;
+    char const *desc;
+
+    histogram_sort_mean(hist_pulses); // Easier to work with sorted data
+    histogram_sort_mean(hist_gaps);
+    if (hist_pulses->bins[0].mean == 0) {
+        histogram_delete_bin(hist_pulses, 0);
+    } // Remove FSK initial zero-bin
+
+    // Attempt to find a matching modulation
+    if (data->num_pulses == 1) {
+        desc = "Single pulse detected. Probably Frequency Shift Keying or just noise...";
+    }
+    else if (hist_pulses->bins_count == 1 && hist_gaps->bins_count == 1) {
+        desc = "Un-modulated signal. Maybe a preamble...";
+    }
+    else if (hist_pulses->bins_count == 1 && hist_gaps->bins_count > 1) {
+        desc = "Pulse Position Modulation with fixed pulse width";
+        device->modulation  = OOK_PULSE_PPM; // TODO: there is not FSK_PULSE_PPM
+        device->short_width = to_us * hist_gaps->bins[0].mean;
+        device->long_width  = to_us * hist_gaps->bins[1].mean;
+        device->gap_limit   = to_us * (hist_gaps->bins[1].max + 1);                        // Set limit above next lower gap
+        device->reset_limit = to_us * (hist_gaps->bins[hist_gaps->bins_count - 1].max + 1); // Set limit above biggest gap
+    }
+    else if (hist_pulses->bins_count == 2 && hist_gaps->bins_count == 1) {
+        desc = "Pulse Width Modulation with fixed gap";
+        device->modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PWM : OOK_PULSE_PWM;
+        device->short_width = to_us * hist_pulses->bins[0].mean;
+        device->long_width  = to_us * hist_pulses->bins[1].mean;
+        device->tolerance   = (device->long_width - device->short_width) * 0.4;
+        device->reset_limit = to_us * (hist_gaps->bins[hist_gaps->bins_count - 1].max + 1); // Set limit above biggest gap
+    }
+    else if (hist_pulses->bins_count == 2 && hist_gaps->bins_count == 2 && hist_periods->bins_count == 1) {
+        desc = "Pulse Width Modulation with fixed period";
+        device->modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PWM : OOK_PULSE_PWM;
+        device->short_width = to_us * hist_pulses->bins[0].mean;
+        device->long_width  = to_us * hist_pulses->bins[1].mean;
+        device->tolerance   = (device->long_width - device->short_width) * 0.4;
+        device->reset_limit = to_us * (hist_gaps->bins[hist_gaps->bins_count - 1].max + 1); // Set limit above biggest gap
+    }
+    else if (hist_pulses->bins_count == 2 && hist_gaps->bins_count == 2 && hist_periods->bins_count == 3) {
+        desc = "Manchester coding";
+        device->modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_MANCHESTER_ZEROBIT : OOK_PULSE_MANCHESTER_ZEROBIT;
+        device->short_width = to_us * MIN(hist_pulses->bins[0].mean, hist_pulses->bins[1].mean); // Assume shortest pulse is half period
+        device->long_width  = 0;                                                               // Not used
+        device->reset_limit = to_us * (hist_gaps->bins[hist_gaps->bins_count - 1].max + 1);      // Set limit above biggest gap
+    }
+    else if (hist_pulses->bins_count == 2 && hist_gaps->bins_count >= 3) {
+        desc = "Pulse Width Modulation with multiple packets";
+        device->modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PWM : OOK_PULSE_PWM;
+        device->short_width = to_us * hist_pulses->bins[0].mean;
+        device->long_width  = to_us * hist_pulses->bins[1].mean;
+        device->gap_limit   = to_us * (hist_gaps->bins[1].max + 1); // Set limit above second gap
+        device->tolerance   = (device->long_width - device->short_width) * 0.4;
+        device->reset_limit = to_us * (hist_gaps->bins[hist_gaps->bins_count - 1].max + 1); // Set limit above biggest gap
+    }
+    else if ((hist_pulses->bins_count >= 3 && hist_gaps->bins_count >= 3)
+            && (abs(hist_pulses->bins[1].mean - 2*hist_pulses->bins[0].mean) <= hist_pulses->bins[0].mean/8)    // Pulses are multiples of shortest pulse
+            && (abs(hist_pulses->bins[2].mean - 3*hist_pulses->bins[0].mean) <= hist_pulses->bins[0].mean/8)
+            && (abs(hist_gaps->bins[0].mean   -   hist_pulses->bins[0].mean) <= hist_pulses->bins[0].mean/8)    // Gaps are multiples of shortest pulse
+            && (abs(hist_gaps->bins[1].mean   - 2*hist_pulses->bins[0].mean) <= hist_pulses->bins[0].mean/8)
+            && (abs(hist_gaps->bins[2].mean   - 3*hist_pulses->bins[0].mean) <= hist_pulses->bins[0].mean/8)) {
+        desc = "Non Return to Zero coding (Pulse Code)";
+        device->modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PCM : OOK_PULSE_PCM;
+        device->short_width = to_us * hist_pulses->bins[0].mean;        // Shortest pulse is bit width
+        device->long_width  = to_us * hist_pulses->bins[0].mean;        // Bit period equal to pulse length (NRZ)
+        device->reset_limit = to_us * hist_pulses->bins[0].mean * 1024; // No limit to run of zeros...
+    }
+    else if (hist_pulses->bins_count == 3) {
+        desc = "Pulse Width Modulation with sync/delimiter";
+        // Re-sort to find lowest pulse count index (is probably delimiter)
+        histogram_sort_count(hist_pulses);
+        int p1 = hist_pulses->bins[1].mean;
+        int p2 = hist_pulses->bins[2].mean;
+        device->modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PWM : OOK_PULSE_PWM;
+        device->short_width = to_us * (p1 < p2 ? p1 : p2);                                // Set to shorter pulse width
+        device->long_width  = to_us * (p1 < p2 ? p2 : p1);                                // Set to longer pulse width
+        device->sync_width  = to_us * hist_pulses->bins[0].mean;                           // Set to lowest count pulse width
+        device->reset_limit = to_us * (hist_gaps->bins[hist_gaps->bins_count - 1].max + 1); // Set limit above biggest gap
+    }
+    else {
+        desc = "No clue...";
+    }
+
+    return desc;
+}
+
+char const *pulse_analyzer_guess(pulse_data_t const *data, int package_type, r_device *device)
+{
+    if (data->num_pulses == 0) {
+        return "No pulses detected.";
+    }
+
+    int periods[PD_MAX_PULSES];
+    for (unsigned n = 0; n < data->num_pulses; ++n) {
+        periods[n] = data->pulse[n] + data->gap[n];
+    }
+
+    histogram_t hist_pulses  = {0};
+    histogram_t hist_gaps    = {0};
+    histogram_t hist_periods = {0};
+
+    histogram_sum(&hist_pulses, data->pulse, data->num_pulses, TOLERANCE);
+    histogram_sum(&hist_gaps, data->gap, data->num_pulses - 1, TOLERANCE); // Leave out last gap (end)
+    histogram_sum(&hist_periods, periods, data->num_pulses - 1, TOLERANCE); // Leave out last gap (end)
+
+    histogram_fuse_bins(&hist_pulses, TOLERANCE);
+    histogram_fuse_bins(&hist_gaps, TOLERANCE);
+    histogram_fuse_bins(&hist_periods, TOLERANCE);
+
+    return guess_modulation(data, package_type, &hist_pulses, &hist_gaps, &hist_periods, device);
+}
+
+int pulse_analyzer_flex_spec(r_device const *device, char const *name, char *buf, size_t size)
+{
+    int len;
+    switch (device->modulation) {
+    case FSK_PULSE_PCM:
+        len = snprintf(buf, size, "n=%s,m=FSK_PCM,s=%.0f,l=%.0f,r=%.0f",
+                name, device->short_width, device->long_width, device->reset_limit);
+        break;
+    case OOK_PULSE_PPM:
+        len = snprintf(buf, size, "n=%s,m=OOK_PPM,s=%.0f,l=%.0f,g=%.0f,r=%.0f",
+                name, device->short_width, device->long_width,
+                device->gap_limit, device->reset_limit);
+        break;
+    case OOK_PULSE_PWM:
+        len = snprintf(buf, size, "n=%s,m=OOK_PWM,s=%.0f,l=%.0f,r=%.0f,g=%.0f,t=%.0f,y=%.0f",
+                name, device->short_width, device->long_width, device->reset_limit,
+                device->gap_limit, device->tolerance, device->sync_width);
+        break;
+    case FSK_PULSE_PWM:
+        len = snprintf(buf, size, "n=%s,m=FSK_PWM,s=%.0f,l=%.0f,r=%.0f,g=%.0f,t=%.0f,y=%.0f",
+                name, device->short_width, device->long_width, device->reset_limit,
+                device->gap_limit, device->tolerance, device->sync_width);
+        break;
+    case OOK_PULSE_MANCHESTER_ZEROBIT:
+        len = snprintf(buf, size, "n=%s,m=OOK_MC_ZEROBIT,s=%.0f,l=%.0f,r=%.0f",
+                name, device->short_width, device->long_width, device->reset_limit);
+        break;
+    default:
+        len = 0;
+    }
+    if (len < 0 || (size_t)len >= size) {
+        len = 0;
+    }
+    if (!len && size) {
+        buf[0] = '\0';
+    }
+    return len;
+}
+
 /// Analyze the statistics of a pulse data structure and print result
 void pulse_analyzer(pulse_data_t *data, int package_type)
 {
@@ -259,88 +397,9 @@ void pulse_analyzer(pulse_data_t *data, int package_type)
             (float)data->fsk_f1_est / INT16_MAX * data->sample_rate / 2.0 / 1000.0,
             (float)data->fsk_f2_est / INT16_MAX * data->sample_rate / 2.0 / 1000.0);
 
-    fprintf(stderr, "Guessing modulation: ");
     r_device device = {.name = "Analyzer Device", 0};
-    histogram_sort_mean(&hist_pulses); // Easier to work with sorted data
-    histogram_sort_mean(&hist_gaps);
-    if (hist_pulses.bins[0].mean == 0) {
-        histogram_delete_bin(&hist_pulses, 0);
-    } // Remove FSK initial zero-bin
-
-    // Attempt to find a matching modulation
-    if (data->num_pulses == 1) {
-        fprintf(stderr, "Single pulse detected. Probably Frequency Shift Keying or just noise...\n");
-    }
-    else if (hist_pulses.bins_count == 1 && hist_gaps.bins_count == 1) {
-        fprintf(stderr, "Un-modulated signal. Maybe a preamble...\n");
-    }
-    else if (hist_pulses.bins_count == 1 && hist_gaps.bins_count > 1) {
-        fprintf(stderr, "Pulse Position Modulation with fixed pulse width\n");
-        device.modulation  = OOK_PULSE_PPM; // TODO: there is not FSK_PULSE_PPM
-        device.short_width = to_us * hist_gaps.bins[0].mean;
-        device.long_width  = to_us * hist_gaps.bins[1].mean;
-        device.gap_limit   = to_us * (hist_gaps.bins[1].max + 1);                        // Set limit above next lower gap
-        device.reset_limit = to_us * (hist_gaps.bins[hist_gaps.bins_count - 1].max + 1); // Set limit above biggest gap
-    }
-    else if (hist_pulses.bins_count == 2 && hist_gaps.bins_count == 1) {
-        fprintf(stderr, "Pulse Width Modulation with fixed gap\n");
-        device.modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PWM : OOK_PULSE_PWM;
-        device.short_width = to_us * hist_pulses.bins[0].mean;
-        device.long_width  = to_us * hist_pulses.bins[1].mean;
-        device.tolerance   = (device.long_width - device.short_width) * 0.4;
-        device.reset_limit = to_us * (hist_gaps.bins[hist_gaps.bins_count - 1].max + 1); // Set limit above biggest gap
-    }
-    else if (hist_pulses.bins_count == 2 && hist_gaps.bins_count == 2 && hist_periods.bins_count == 1) {
-        fprintf(stderr, "Pulse Width Modulation with fixed period\n");
-        device.modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PWM : OOK_PULSE_PWM;
-        device.short_width = to_us * hist_pulses.bins[0].mean;
-        device.long_width  = to_us * hist_pulses.bins[1].mean;
-        device.tolerance   = (device.long_width - device.short_width) * 0.4;
-        device.reset_limit = to_us * (hist_gaps.bins[hist_gaps.bins_count - 1].max + 1); // Set limit above biggest gap
-    }
-    else if (hist_pulses.bins_count == 2 && hist_gaps.bins_count == 2 && hist_periods.bins_count == 3) {
-        fprintf(stderr, "Manchester coding\n");
-        device.modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_MANCHESTER_ZEROBIT : OOK_PULSE_MANCHESTER_ZEROBIT;
-        device.short_width = to_us * MIN(hist_pulses.bins[0].mean, hist_pulses.bins[1].mean); // Assume shortest pulse is half period
-        device.long_width  = 0;                                                               // Not used
-        device.reset_limit = to_us * (hist_gaps.bins[hist_gaps.bins_count - 1].max + 1);      // Set limit above biggest gap
-    }
-    else if (hist_pulses.bins_count == 2 && hist_gaps.bins_count >= 3) {
-        fprintf(stderr, "Pulse Width Modulation with multiple packets\n");
-        device.modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PWM : OOK_PULSE_PWM;
-        device.short_width = to_us * hist_pulses.bins[0].mean;
-        device.long_width  = to_us * hist_pulses.bins[1].mean;
-        device.gap_limit   = to_us * (hist_gaps.bins[1].max + 1); // Set limit above second gap
-        device.tolerance   = (device.long_width - device.short_width) * 0.4;
-        device.reset_limit = to_us * (hist_gaps.bins[hist_gaps.bins_count - 1].max + 1); // Set limit above biggest gap
-    }
-    else if ((hist_pulses.bins_count >= 3 && hist_gaps.bins_count >= 3)
-            && (abs(hist_pulses.bins[1].mean - 2*hist_pulses.bins[0].mean) <= hist_pulses.bins[0].mean/8)    // Pulses are multiples of shortest pulse
-            && (abs(hist_pulses.bins[2].mean - 3*hist_pulses.bins[0].mean) <= hist_pulses.bins[0].mean/8)
-            && (abs(hist_gaps.bins[0].mean   -   hist_pulses.bins[0].mean) <= hist_pulses.bins[0].mean/8)    // Gaps are multiples of shortest pulse
-            && (abs(hist_gaps.bins[1].mean   - 2*hist_pulses.bins[0].mean) <= hist_pulses.bins[0].mean/8)
-            && (abs(hist_gaps.bins[2].mean   - 3*hist_pulses.bins[0].mean) <= hist_pulses.bins[0].mean/8)) {
-        fprintf(stderr, "Non Return to Zero coding (Pulse Code)\n");
-        device.modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PCM : OOK_PULSE_PCM;
-        device.short_width = to_us * hist_pulses.bins[0].mean;        // Shortest pulse is bit width
-        device.long_width  = to_us * hist_pulses.bins[0].mean;        // Bit period equal to pulse length (NRZ)
-        device.reset_limit = to_us * hist_pulses.bins[0].mean * 1024; // No limit to run of zeros...
-    }
-    else if (hist_pulses.bins_count == 3) {
-        fprintf(stderr, "Pulse Width Modulation with sync/delimiter\n");
-        // Re-sort to find lowest pulse count index (is probably delimiter)
-        histogram_sort_count(&hist_pulses);
-        int p1 = hist_pulses.bins[1].mean;
-        int p2 = hist_pulses.bins[2].mean;
-        device.modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PWM : OOK_PULSE_PWM;
-        device.short_width = to_us * (p1 < p2 ? p1 : p2);                                // Set to shorter pulse width
-        device.long_width  = to_us * (p1 < p2 ? p2 : p1);                                // Set to longer pulse width
-        device.sync_width  = to_us * hist_pulses.bins[0].mean;                           // Set to lowest count pulse width
-        device.reset_limit = to_us * (hist_gaps.bins[hist_gaps.bins_count - 1].max + 1); // Set limit above biggest gap
-    }
-    else {
-        fprintf(stderr, "No clue...\n");
-    }
+    char const *guess = guess_modulation(data, package_type, &hist_pulses, &hist_gaps, &hist_periods, &device);
+    fprintf(stderr, "Guessing modulation: %s\n", guess);
 
     // Output RfRaw line (if possible)
     if (hist_timings.bins_count <= 8) {
@@ -429,36 +488,24 @@ void pulse_analyzer(pulse_data_t *data, int package_type)
         fprintf(stderr, "Attempting demodulation... short_width: %.0f, long_width: %.0f, reset_limit: %.0f, sync_width: %.0f\n",
                 device.short_width, device.long_width,
                 device.reset_limit, device.sync_width);
+        char spec[256];
+        if (pulse_analyzer_flex_spec(&device, "name", spec, sizeof(spec))) {
+            fprintf(stderr, "Use a flex decoder with -X '%s'\n", spec);
+        }
         switch (device.modulation) {
         case FSK_PULSE_PCM:
-            fprintf(stderr, "Use a flex decoder with -X 'n=name,m=FSK_PCM,s=%.0f,l=%.0f,r=%.0f'\n",
-                    device.short_width, device.long_width, device.reset_limit);
             pulse_slicer_pcm(data, &device);
             break;
         case OOK_PULSE_PPM:
-            fprintf(stderr, "Use a flex decoder with -X 'n=name,m=OOK_PPM,s=%.0f,l=%.0f,g=%.0f,r=%.0f'\n",
-                    device.short_width, device.long_width,
-                    device.gap_limit, device.reset_limit);
             data->gap[data->num_pulses - 1] = device.reset_limit / to_us + 1; // Be sure to terminate package
             pulse_slicer_ppm(data, &device);
             break;
         case OOK_PULSE_PWM:
-            fprintf(stderr, "Use a flex decoder with -X 'n=name,m=OOK_PWM,s=%.0f,l=%.0f,r=%.0f,g=%.0f,t=%.0f,y=%.0f'\n",
-                    device.short_width, device.long_width, device.reset_limit,
-                    device.gap_limit, device.tolerance, device.sync_width);
-            data->gap[data->num_pulses - 1] = device.reset_limit / to_us + 1; // Be sure to terminate package
-            pulse_slicer_pwm(data, &device);
-            break;
         case FSK_PULSE_PWM:
-            fprintf(stderr, "Use a flex decoder with -X 'n=name,m=FSK_PWM,s=%.0f,l=%.0f,r=%.0f,g=%.0f,t=%.0f,y=%.0f'\n",
-                    device.short_width, device.long_width, device.reset_limit,
-                    device.gap_limit, device.tolerance, device.sync_width);
             data->gap[data->num_pulses - 1] = device.reset_limit / to_us + 1; // Be sure to terminate package
             pulse_slicer_pwm(data, &device);
             break;
         case OOK_PULSE_MANCHESTER_ZEROBIT:
-            fprintf(stderr, "Use a flex decoder with -X 'n=name,m=OOK_MC_ZEROBIT,s=%.0f,l=%.0f,r=%.0f'\n",
-                    device.short_width, device.long_width, device.reset_limit);
             data->gap[data->num_pulses - 1] = device.reset_limit / to_us + 1; // Be sure to terminate package
             pulse_slicer_manchester_zerobit(data, &device);
             break;
@@ -0,0 +1,418 @@
+/** @file
+    Background clustering of undecoded pulse packages.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "pulse_cluster.h"
+
+#include "pulse_analyzer.h"
+#include "pulse_detect.h"
+#include "util.h"
+#include "logger.h"
+#include "fatal.h"
+#include "compat_pthread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CLUSTER_TOLERANCE        (0.2f) // same as the pulse analyzer
+#define CLUSTER_SIG_BINS         4      // bin means compared per signature
+#define CLUSTER_MAX_CLUSTERS     64
+#define CLUSTER_QUEUE_LEN        8
+#define CLUSTER_MAX_WEIGHT       16     // packages in the running signature mean
+#define CLUSTER_EXPIRE_INTERVALS 10     // intervals without packages before a cluster is dropped
+
+/// Quantized timing signature of a package.
+typedef struct {
+    int package_type;
+    unsigned pulse_bins;          ///< number of distinct pulse widths
+    unsigned gap_bins;            ///< number of distinct gap widths
+    int pulse[CLUSTER_SIG_BINS];  ///< shortest pulse widths in samples
+    int gap[CLUSTER_SIG_BINS];    ///< shortest gap widths in samples
+} cluster_sig_t;
+
+typedef struct {
+    unsigned id;
+    cluster_sig_t sig;
+    unsigned weight;
+    unsigned count;       ///< packages in the current interval
+    unsigned total;       ///< packages since the cluster was created
+    unsigned min_pulses;
+    unsigned max_pulses;
+    float rssi_sum;
+    float snr_max;
+    unsigned idle;        ///< intervals without packages
+    unsigned last_seq;    ///< sequence number of the last package
+    pulse_data_t *exemplar; ///< package with the best SNR
+} cluster_t;
+
+struct pulse_cluster {
+    int interval_secs;
+    time_t report_time;
+    unsigned next_id;
+    unsigned seq;
+    unsigned dropped;     ///< packages dropped since the last report
+    unsigned num_clusters;
+    cluster_t clusters[CLUSTER_MAX_CLUSTERS];
+#ifdef THREADS
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int stop;
+    unsigned queue_head;
+    unsigned queue_len;
+    int queue_type[CLUSTER_QUEUE_LEN];
+    pulse_data_t queue[CLUSTER_QUEUE_LEN];
+#endif
+};
+
+/* Signatures */
+
+static int within_tolerance(int a, int b)
+{
+    return abs(a - b) <= CLUSTER_TOLERANCE * MAX(a, b);
+}
+
+static void cluster_signature(pulse_data_t const *data, int package_type, cluster_sig_t *sig)
+{
+    histogram_t hist_pulses = {0};
+    histogram_t hist_gaps   = {0};
+
+    histogram_sum(&hist_pulses, data->pulse, data->num_pulses, CLUSTER_TOLERANCE);
+    if (data->num_pulses > 1) {
+        histogram_sum(&hist_gaps, data->gap, data->num_pulses - 1, CLUSTER_TOLERANCE); // Leave out last gap (end)
+    }
+    histogram_fuse_bins(&hist_pulses, CLUSTER_TOLERANCE);
+    histogram_fuse_bins(&hist_gaps, CLUSTER_TOLERANCE);
+    histogram_sort_mean(&hist_pulses);
+    histogram_sort_mean(&hist_gaps);
+
+    unsigned first = hist_pulses.bins_count > 1 && hist_pulses.bins[0].mean == 0; // Skip FSK initial zero-bin
+
+    memset(sig, 0, sizeof(*sig));
+    sig->package_type = package_type;
+    sig->pulse_bins   = hist_pulses.bins_count - first;
+    sig->gap_bins     = hist_gaps.bins_count;
+    for (unsigned i = 0; i < CLUSTER_SIG_BINS && i < sig->pulse_bins; ++i) {
+        sig->pulse[i] = hist_pulses.bins[i + first].mean;
+    }
+    for (unsigned i = 0; i < CLUSTER_SIG_BINS && i < sig->gap_bins; ++i) {
+        sig->gap[i] = hist_gaps.bins[i].mean;
+    }
+}
+
+static int cluster_match(cluster_sig_t const *a, cluster_sig_t const *b)
+{
+    if (a->package_type != b->package_type
+            || a->pulse_bins != b->pulse_bins
+            || a->gap_bins != b->gap_bins)
+        return 0;
+    for (unsigned i = 0; i < CLUSTER_SIG_BINS; ++i) {
+        if (!within_tolerance(a->pulse[i], b->pulse[i])
+                || !within_tolerance(a->gap[i], b->gap[i]))
+            return 0;
+    }
+    return 1;
+}
+
+/* Clusters */
+
+static void cluster_clear(cluster_t *cluster)
+{
+    free(cluster->exemplar);
+    memset(cluster, 0, sizeof(*cluster));
+}
+
+/// Find or create the cluster for a signature, evicts the least recently seen if full.
+static cluster_t *cluster_find(pulse_cluster_t *pc, cluster_sig_t const *sig)
+{
+    for (unsigned i = 0; i < pc->num_clusters; ++i) {
+        if (cluster_match(&pc->clusters[i].sig, sig)) {
+            return &pc->clusters[i];
+        }
+    }
+
+    cluster_t *cluster;
+    if (pc->num_clusters < CLUSTER_MAX_CLUSTERS) {
+        cluster = &pc->clusters[pc->num_clusters++];
+    }
+    else {
+        cluster = &pc->clusters[0];
+        for (unsigned i = 1; i < pc->num_clusters; ++i) {
+            if (pc->clusters[i].last_seq < cluster->last_seq) {
+                cluster = &pc->clusters[i];
+            }
+        }
+        cluster_clear(cluster);
+    }
+    cluster->id  = ++pc->next_id;
+    cluster->sig = *sig;
+    return cluster;
+}
+
+static void cluster_merge(pulse_cluster_t *pc, cluster_sig_t const *sig, pulse_data_t const *data)
+{
+    cluster_t *cluster = cluster_find(pc, sig);
+
+    // Running mean of the signature, limited so the cluster can follow drift
+    if (cluster->weight < CLUSTER_MAX_WEIGHT) {
+        cluster->weight++;
+    }
+    unsigned w = cluster->weight;
+    for (unsigned i = 0; i < CLUSTER_SIG_BINS; ++i) {
+        cluster->sig.pulse[i] = (cluster->sig.pulse[i] * (int)(w - 1) + sig->pulse[i]) / (int)w;
+        cluster->sig.gap[i]   = (cluster->sig.gap[i] * (int)(w - 1) + sig->gap[i]) / (int)w;
+    }
+
+    if (!cluster->total || data->num_pulses < cluster->min_pulses) {
+        cluster->min_pulses = data->num_pulses;
+    }
+    if (data->num_pulses > cluster->max_pulses) {
+        cluster->max_pulses = data->num_pulses;
+    }
+    cluster->count++;
+    cluster->total++;
+    cluster->rssi_sum += data->rssi_db;
+    cluster->idle     = 0;
+    cluster->last_seq = ++pc->seq;
+
+    if (!cluster->exemplar || data->snr_db > cluster->snr_max) {
+        cluster->snr_max = data->snr_db;
+        if (!cluster->exemplar) {
+            cluster->exemplar = malloc(sizeof(*cluster->exemplar));
+            if (!cluster->exemplar) {
+                WARN_MALLOC("cluster_merge()");
+                return; // NOTE: no exemplar on alloc failure.
+            }
+        }
+        *cluster->exemplar = *data;
+    }
+}
+
+static data_t *cluster_summary(cluster_t const *cluster)
+{
+    cluster_sig_t const *sig = &cluster->sig;
+    pulse_data_t const *data = cluster->exemplar;
+    double to_us             = 1e6 / data->sample_rate;
+
+    int pulse_us[CLUSTER_SIG_BINS];
+    int gap_us[CLUSTER_SIG_BINS];
+    unsigned pulse_bins = MIN(sig->pulse_bins, CLUSTER_SIG_BINS);
+    unsigned gap_bins   = MIN(sig->gap_bins, CLUSTER_SIG_BINS);
+    for (unsigned i = 0; i < pulse_bins; ++i) {
+        pulse_us[i] = sig->pulse[i] * to_us;
+    }
+    for (unsigned i = 0; i < gap_bins; ++i) {
+        gap_us[i] = sig->gap[i] * to_us;
+    }
+
+    int pulses[2 * PD_MAX_PULSES];
+    for (unsigned i = 0; i < data->num_pulses; ++i) {
+        pulses[i * 2 + 0] = data->pulse[i] * to_us;
+        pulses[i * 2 + 1] = data->gap[i] * to_us;
+    }
+
+    r_device device = {.name = "Cluster", 0};
+    char const *guess = pulse_analyzer_guess(data, sig->package_type, &device);
+    char name[16];
+    snprintf(name, sizeof(name), "cluster%u", cluster->id);
+    char spec[256];
+    int has_spec = pulse_analyzer_flex_spec(&device, name, spec, sizeof(spec));
+
+    /* clang-format off */
+    return data_make(
+            "cluster",          "", DATA_INT,    cluster->id,
+            "mod",              "", DATA_STRING, sig->package_type == PULSE_DATA_FSK ? "FSK" : "OOK",
+            "count",            "", DATA_INT,    cluster->count,
+            "total",            "", DATA_INT,    cluster->total,
+            "len_min",          "", DATA_INT,    cluster->min_pulses,
+            "len_max",          "", DATA_INT,    cluster->max_pulses,
+            "pulse_us",         "", DATA_ARRAY,  data_array(pulse_bins, DATA_INT, pulse_us),
+            "gap_us",           "", DATA_ARRAY,  data_array(gap_bins, DATA_INT, gap_us),
+            "freq_Hz",          "", DATA_INT,    (unsigned)data->centerfreq_hz,
+            "rssi_dB",          "", DATA_FORMAT, "%.1f dB", DATA_DOUBLE, cluster->rssi_sum / cluster->count,
+            "snr_dB",           "", DATA_FORMAT, "%.1f dB", DATA_DOUBLE, cluster->snr_max,
+            "guess",            "", DATA_STRING, guess,
+            "flex",             "", DATA_COND,   has_spec, DATA_STRING, spec,
+            "pulses",           "", DATA_ARRAY,  data_array(2 * data->num_pulses, DATA_INT, pulses),
+            NULL);
+    /* clang-format on */
+}
+
+/* Worker */
+
+#ifdef THREADS
+static THREAD_RETURN THREAD_CALL cluster_worker(void *arg)
+{
+    pulse_cluster_t *pc = arg;
+
+    pthread_mutex_lock(&pc->lock);
+    while (1) {
+        while (!pc->stop && !pc->queue_len) {
+            pthread_cond_wait(&pc->cond, &pc->lock);
+        }
+        if (!pc->queue_len) {
+            break; // stopped and drained
+        }
+        // the head slot stays owned by the worker until queue_len is decremented
+        pulse_data_t const *data = &pc->queue[pc->queue_head];
+        int package_type         = pc->queue_type[pc->queue_head];
+        pthread_mutex_unlock(&pc->lock);
+
+        cluster_sig_t sig;
+        cluster_signature(data, package_type, &sig);
+
+        pthread_mutex_lock(&pc->lock);
+        cluster_merge(pc, &sig, data);
+        pc->queue_head = (pc->queue_head + 1) % CLUSTER_QUEUE_LEN;
+        pc->queue_len--;
+        pthread_cond_broadcast(&pc->cond);
+    }
+    pthread_mutex_unlock(&pc->lock);
+
+    data_pool_clear(); // the data elements kept by this thread
+    return 0;
+}
+#endif
+
+/* API */
+
+pulse_cluster_t *pulse_cluster_create(int interval_secs)
+{
+    pulse_cluster_t *pc = calloc(1, sizeof(*pc));
+    if (!pc) {
+        WARN_CALLOC("pulse_cluster_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    pc->interval_secs = interval_secs > 0 ? interval_secs : 600;
+
+#ifdef THREADS
+    pthread_mutex_init(&pc->lock, NULL);
+    pthread_cond_init(&pc->cond, NULL);
+    if (pthread_create(&pc->thread, NULL, cluster_worker, pc)) {
+        print_log(LOG_ERROR, __func__, "Unable to create the clustering thread");
+        pthread_cond_destroy(&pc->cond);
+        pthread_mutex_destroy(&pc->lock);
+        free(pc);
+        return NULL;
+    }
+#endif
+
+    return pc;
+}
+
+void pulse_cluster_free(pulse_cluster_t *pc)
+{
+    if (!pc)
+        return;
+
+#ifdef THREADS
+    pthread_mutex_lock(&pc->lock);
+    pc->stop = 1;
+    pthread_cond_broadcast(&pc->cond);
+    pthread_mutex_unlock(&pc->lock);
+    pthread_join(pc->thread, NULL);
+    pthread_cond_destroy(&pc->cond);
+    pthread_mutex_destroy(&pc->lock);
+#endif
+
+    for (unsigned i = 0; i < pc->num_clusters; ++i) {
+        free(pc->clusters[i].exemplar);
+    }
+    free(pc);
+}
+
+void pulse_cluster_add(pulse_cluster_t *pc, pulse_data_t const *data, int package_type, int wait)
+{
+    if (!data->num_pulses)
+        return;
+
+#ifdef THREADS
+    pthread_mutex_lock(&pc->lock);
+    while (wait && pc->queue_len >= CLUSTER_QUEUE_LEN) {
+        pthread_cond_wait(&pc->cond, &pc->lock);
+    }
+    if (pc->queue_len >= CLUSTER_QUEUE_LEN) {
+        pc->dropped++;
+    }
+    else {
+        unsigned tail            = (pc->queue_head + pc->queue_len) % CLUSTER_QUEUE_LEN;
+        pc->queue[tail]          = *data;
+        pc->queue_type[tail]     = package_type;
+        pc->queue_len++;
+        pthread_cond_broadcast(&pc->cond);
+    }
+    pthread_mutex_unlock(&pc->lock);
+#else
+    (void)wait; // always inline
+    cluster_sig_t sig;
+    cluster_signature(data, package_type, &sig);
+    cluster_merge(pc, &sig, data);
+#endif
+}
+
+int pulse_cluster_poll(pulse_cluster_t *pc, time_t now, pulse_cluster_report_fn report, void *ctx)
+{
+    if (now && !pc->report_time) {
+        pc->report_time = now + pc->interval_secs; // first poll starts the interval
+        return 0;
+    }
+    if (now && now < pc->report_time) {
+        return 0;
+    }
+    pc->report_time = now + pc->interval_secs;
+
+    data_t *summaries[CLUSTER_MAX_CLUSTERS];
+    unsigned num_summaries = 0;
+
+#ifdef THREADS
+    pthread_mutex_lock(&pc->lock);
+    while (!now && pc->queue_len) {
+        pthread_cond_wait(&pc->cond, &pc->lock);
+    }
+#endif
+
+    unsigned dropped = pc->dropped;
+    pc->dropped      = 0;
+
+    for (unsigned i = 0; i < pc->num_clusters; ++i) {
+        cluster_t *cluster = &pc->clusters[i];
+        if (cluster->count && cluster->exemplar) {
+            data_t *data = cluster_summary(cluster);
+            if (data) {
+                summaries[num_summaries++] = data;
+            }
+        }
+        if (cluster->count) {
+            cluster->count    = 0;
+            cluster->rssi_sum = 0.0f;
+            cluster->idle     = 0;
+        }
+        else if (++cluster->idle >= CLUSTER_EXPIRE_INTERVALS) {
+            cluster_clear(cluster);
+            pc->clusters[i] = pc->clusters[--pc->num_clusters];
+            memset(&pc->clusters[pc->num_clusters], 0, sizeof(cluster_t));
+            --i; // check the moved cluster
+        }
+    }
+
+#ifdef THREADS
+    pthread_mutex_unlock(&pc->lock);
+#endif
+
+    if (dropped) {
+        print_logf(LOG_WARNING, "Cluster", "Dropped %u undecoded packages, the analysis can't keep up", dropped);
+    }
+    for (unsigned i = 0; i < num_summaries; ++i) {
+        report(ctx, summaries[i]);
+    }
+
+    return num_summaries;
+}
@@ -92,6 +92,23 @@ void pulse_detect_set_levels(pulse_detect_t *pulse_detect, int use_mag_est, floa
     //        high_low_ratio, pulse_detect->ook_high_low_ratio);
 }
 
+int pulse_detect_get_levels(pulse_detect_t const *pulse_detect, pulse_detect_levels_t *levels)
+{
+    levels->ook_low_estimate  = pulse_detect->ook_low_estimate;
+    levels->ook_high_estimate = pulse_detect->ook_high_estimate;
+    levels->lead_in_counter   = pulse_detect->lead_in_counter;
+    return pulse_detect->ook_state == PD_OOK_STATE_IDLE && pulse_detect->data_counter == 0;
+}
+
+void pulse_detect_put_levels(pulse_detect_t *pulse_detect, pulse_detect_levels_t const *levels)
+{
+    pulse_detect->ook_low_estimate  = levels->ook_low_estimate;
+    pulse_detect->ook_high_estimate = levels->ook_high_estimate;
+    pulse_detect->lead_in_counter   = levels->lead_in_counter;
+    pulse_detect->ook_state         = PD_OOK_STATE_IDLE;
+    pulse_detect->data_counter      = 0;
+}
+
 /// convert amplitude (16384 FS) to attenuation in (integer) dB, offset by 3.
 static inline int amp_to_att(int a)
 {
@@ -188,6 +205,8 @@ int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_d
 {
     int att_hist[37] = {0};
     int const samples_per_ms = samp_rate / 1000;
+    int const min_gap        = PD_MIN_GAP_MS * samples_per_ms; // EOP limits, fixed for the call
+    int const max_gap        = PD_MAX_GAP_MS * samples_per_ms;
     pulse_detect_t *s = pulse_detect;
     s->ook_high_estimate = MAX(s->ook_high_estimate, pulse_detect->ook_min_high_level);    // Be sure to set initial minimum level
 
@@ -356,8 +375,8 @@ int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_d
                 // EOP if gap is too long
                 if (eop_on_spurious
                         || (s->pulse_length > (PD_MAX_GAP_RATIO * s->max_pulse)    // gap/pulse ratio exceeded
-                            && s->pulse_length > (PD_MIN_GAP_MS * samples_per_ms)) // Minimum gap exceeded
-                        || s->pulse_length > (PD_MAX_GAP_MS * samples_per_ms)) {   // maximum gap exceeded
+                            && s->pulse_length > min_gap)                          // Minimum gap exceeded
+                        || s->pulse_length > max_gap) {                            // maximum gap exceeded
                     pulses->gap[pulses->num_pulses] = s->pulse_length;    // Store gap width
                     pulses->num_pulses += 1;    // Store last pulse
                     s->ook_state = PD_OOK_STATE_IDLE;
@@ -16,6 +16,7 @@
 #include "bitbuffer.h"
 #include "util.h"
 #include "logger.h"
+#include "fatal.h"
 #include "decoder_util.h" // TODO: this should be refactored
 #include <stdio.h>
 #include <stdlib.h>
@@ -37,7 +38,7 @@ static int account_event(r_device *device, bitbuffer_t *bits, char const *demod_
         device->decode_ok += 1;
         device->decode_messages += ret;
     }
-    else if (ret >= DECODE_FAIL_SANITY) {
+    else if (ret >= DECODE_PARTIAL) {
         device->decode_fails[-ret] += 1;
         ret = 0;
     }
@@ -62,30 +63,149 @@ static int account_event(r_device *device, bitbuffer_t *bits, char const *demod_
     return ret;
 }
 
-int pulse_slicer_pcm(pulse_data_t const *pulses, r_device *device)
+/// Decoder timings in samples, converted once for each sample rate.
+static r_device_timing_t const *slicer_timing(pulse_data_t const *pulses, r_device *device, char const *func)
 {
+    r_device_timing_t *t = &device->timing;
+    if (t->sample_rate == pulses->sample_rate)
+        return t->valid ? t : NULL;
+
     float samples_per_us = pulses->sample_rate / 1.0e6;
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
+    t->sample_rate = pulses->sample_rate;
+    t->s_short     = device->short_width * samples_per_us;
+    t->s_long      = device->long_width * samples_per_us;
+    t->s_reset     = device->reset_limit * samples_per_us;
+    t->s_gap       = device->gap_limit * samples_per_us;
+    t->s_sync      = device->sync_width * samples_per_us;
+    t->s_tolerance = device->tolerance * samples_per_us;
+
+    // precision reciprocals
+    t->f_short = device->short_width > 0.0 ? 1.0 / (device->short_width * samples_per_us) : 0;
+    t->f_long  = device->long_width > 0.0 ? 1.0 / (device->long_width * samples_per_us) : 0;
 
     // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        print_logf(LOG_WARNING, __func__, "sample rate too low for protocol %u \"%s\"", device->protocol_num, device->name);
-        return 0;
+    t->valid = !((device->short_width > 0 && t->s_short <= 0)
+            || (device->long_width > 0 && t->s_long <= 0)
+            || (device->reset_limit > 0 && t->s_reset <= 0)
+            || (device->gap_limit > 0 && t->s_gap <= 0)
+            || (device->sync_width > 0 && t->s_sync <= 0)
+            || (device->tolerance > 0 && t->s_tolerance <= 0));
+    if (!t->valid) {
+        print_logf(LOG_WARNING, func, "sample rate too low for protocol %u \"%s\"", device->protocol_num, device->name);
+        return NULL;
     }
+    return t;
+}
+
+/* pulse width quantization */
+
+/*
+The PPM and PWM slicers quantize each pulse or gap width into a small symbol
+class, for the timing of a decoder, then switch on the symbol. Runs of data
+symbols are packed into the bitbuffer row as they are quantized, a width that
+is not a data symbol ends the run right away, so noise costs no extra pass.
+*/
+
+#define SYMBOL_RANGES 4
+
+/// Symbol classes, the slicers map ranges of widths to these.
+enum symbol_class {
+    SYMBOL_ZERO  = 0,
+    SYMBOL_ONE   = 1,
+    SYMBOL_SYNC  = 2,
+    SYMBOL_SKIP  = 3,
+    SYMBOL_OTHER = 4, ///< in none of the ranges
+};
+
+#define SYMBOL_CLASS 0x0f ///< mask of the symbol class
+#define SYMBOL_END   0x80 ///< flag, width is above the end limit
+
+/// Width ranges of the symbol classes for one timing, all bounds are non inclusive.
+typedef struct symbol_ranges {
+    int lower[SYMBOL_RANGES]; ///< earlier ranges take precedence
+    int upper[SYMBOL_RANGES];
+    uint8_t symbol[SYMBOL_RANGES];
+    int end_limit;
+} symbol_ranges_t;
+
+/// Ranges with no classes and no flags, add ranges with symbol_range().
+static void symbol_ranges_init(symbol_ranges_t *r)
+{
+    for (int k = 0; k < SYMBOL_RANGES; ++k) {
+        r->lower[k]  = INT_MAX; // never matches
+        r->upper[k]  = INT_MIN;
+        r->symbol[k] = SYMBOL_OTHER;
+    }
+    r->end_limit = INT_MAX;
+}
+
+static void symbol_range(symbol_ranges_t *r, int k, int lower, int upper, int symbol)
+{
+    r->lower[k]  = lower;
+    r->upper[k]  = upper;
+    r->symbol[k] = (uint8_t)symbol;
+}
+
+/// Quantize a width to a symbol, the class of the first matching range and the flags.
+static inline int quantize_width(int w, symbol_ranges_t const *r)
+{
+    int s = SYMBOL_OTHER;
+    for (int k = 0; k < SYMBOL_RANGES; ++k) {
+        if (w > r->lower[k] && w < r->upper[k]) {
+            s = r->symbol[k];
+            break;
+        }
+    }
+    return w > r->end_limit ? s | SYMBOL_END : s;
+}
+
+/// Add a run of 0 and 1 symbols from @p n as bits, the same as bitbuffer_add_bit() for each, but packed in one pass.
+///
+/// The run ends before @p end, at a width that is not a data symbol, at a gap over the limit if gaps are given,
+/// or at the end of the row, i.e. where the bitbuffer would spill.
+/// @return the number of bits added
+static unsigned add_symbol_run(bitbuffer_t *bits, int const *widths, symbol_ranges_t const *r, int const *gaps, int gap_limit, unsigned n, unsigned end)
+{
+    if (bits->num_rows == 0)
+        bits->free_row = bits->num_rows = 1; // Add first row automatically
+
+    unsigned row = bits->num_rows - 1;
+    unsigned pos = bits->bits_per_row[row];
+    uint8_t *b   = bits->bb[row];
+    unsigned i   = n;
+    for (; i < end && pos < BITBUF_COLS * 8; ++i, ++pos) {
+        int s = quantize_width(widths[i], r);
+        if (s > SYMBOL_ONE || (gaps && gaps[i] > gap_limit))
+            break;
+        b[pos / 8] |= s << (7 - pos % 8);
+    }
+    bits->bits_per_row[row] = (uint16_t)pos;
+    return i - n;
+}
+
+/// Emits a sliced bitbuffer, usually to the decoder.
+typedef int (*slice_emit_fn)(void *ctx, r_device *device, bitbuffer_t *bits, char const *demod_name);
+
+static int slice_emit_event(void *ctx, r_device *device, bitbuffer_t *bits, char const *demod_name)
+{
+    (void)ctx;
+    return account_event(device, bits, demod_name);
+}
+
+/// Slices a package with the converted timings, the emitted bitbuffers only depend on the timings.
+typedef int (*slice_fn)(pulse_data_t const *pulses, r_device *device, r_device_timing_t const *t, slice_emit_fn emit, void *ctx);
+
+static int pcm_slice(pulse_data_t const *pulses, r_device *device, r_device_timing_t const *t, slice_emit_fn emit, void *ctx)
+{
+    int s_short = t->s_short;
+    int s_long  = t->s_long;
+    int s_reset = t->s_reset;
+    int s_gap   = t->s_gap;
+    int s_tolerance = t->s_tolerance;
 
     // precision reciprocals
-    float f_short = device->short_width > 0.0 ? 1.0 / (device->short_width * samples_per_us) : 0;
-    float f_long  = device->long_width > 0.0 ? 1.0 / (device->long_width * samples_per_us) : 0;
+    float f_short = t->f_short;
+    float f_long  = t->f_long;
 
     int events = 0;
     bitbuffer_t bits = {0};
@@ -121,7 +241,7 @@ int pulse_slicer_pcm(pulse_data_t const *pulses, r_device *device)
             preamble_len = count;
             if (device->verbose > 1) {
                 float to_us = 1e6 / pulses->sample_rate;
-                print_logf(LOG_INFO, __func__, "Exact bit width (in us) is %.2f vs %.2f (pulse width %.2f vs %.2f), %d bit preamble",
+                print_logf(LOG_INFO, "pulse_slicer_pcm", "Exact bit width (in us) is %.2f vs %.2f (pulse width %.2f vs %.2f), %d bit preamble",
                         to_us / f_long, to_us * s_long,
                         to_us / f_short, to_us * s_short, count);
             }
@@ -147,7 +267,7 @@ int pulse_slicer_pcm(pulse_data_t const *pulses, r_device *device)
         f_short = (float)rz_count / rzs_width;
         if (device->verbose > 1) {
             float to_us = 1e6 / pulses->sample_rate;
-            print_logf(LOG_INFO, __func__, "Exact bit width (in us) is %.2f vs %.2f (pulse width %.2f vs %.2f), %d bit measured",
+            print_logf(LOG_INFO, "pulse_slicer_pcm", "Exact bit width (in us) is %.2f vs %.2f (pulse width %.2f vs %.2f), %d bit measured",
                     to_us / f_long, to_us * s_long,
                     to_us / f_short, to_us * s_short, rz_count);
         }
@@ -170,7 +290,7 @@ int pulse_slicer_pcm(pulse_data_t const *pulses, r_device *device)
             preamble_len = count;
             if (device->verbose > 1) {
                 float to_us = 1e6 / pulses->sample_rate;
-                print_logf(LOG_INFO, __func__, "Exact bit width (in us) is %.2f vs %.2f, %d bit preamble",
+                print_logf(LOG_INFO, "pulse_slicer_pcm", "Exact bit width (in us) is %.2f vs %.2f, %d bit preamble",
                         to_us / f_short, to_us * s_short, count);
             }
         }
@@ -205,7 +325,7 @@ int pulse_slicer_pcm(pulse_data_t const *pulses, r_device *device)
         f_short = f_long = (float)nrz_count / nrz_width;
         if (device->verbose > 1) {
             float to_us = 1e6 / pulses->sample_rate;
-            print_logf(LOG_INFO, __func__, "%s: Exact bit width (in us) is %.2f vs %.2f, %d bit measured", device->name,
+            print_logf(LOG_INFO, "pulse_slicer_pcm", "%s: Exact bit width (in us) is %.2f vs %.2f, %d bit measured", device->name,
                     to_us / f_short, to_us * s_short, nrz_count);
         }
     }
@@ -233,7 +353,7 @@ int pulse_slicer_pcm(pulse_data_t const *pulses, r_device *device)
 
             // Data is corrupt
             if (device->verbose > 3) {
-                print_logf(LOG_TRACE, __func__, "bitbuffer cleared at %u: pulse %d, gap %d, period %d",
+                print_logf(LOG_TRACE, "pulse_slicer_pcm", "bitbuffer cleared at %u: pulse %d, gap %d, period %d",
                         n, pulses->pulse[n], pulses->gap[n],
                         pulses->pulse[n] + pulses->gap[n]);
             }
@@ -249,34 +369,29 @@ int pulse_slicer_pcm(pulse_data_t const *pulses, r_device *device)
                     || (pulses->gap[n] > s_reset))      // Long silence (OOK)
                 && (bits.bits_per_row[0] > 0 || bits.num_rows > 1)) { // Only if data has been accumulated
 
-            events += account_event(device, &bits, __func__);
+            events += emit(ctx, device, &bits, "pulse_slicer_pcm");
             bitbuffer_clear(&bits);
         }
     } // for
     return events;
 }
 
-int pulse_slicer_ppm(pulse_data_t const *pulses, r_device *device)
+int pulse_slicer_pcm(pulse_data_t const *pulses, r_device *device)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6;
-
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
-
-    // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        print_logf(LOG_WARNING, __func__, "sample rate too low for protocol %u \"%s\"", device->protocol_num, device->name);
+    r_device_timing_t const *t = slicer_timing(pulses, device, __func__);
+    if (!t)
         return 0;
-    }
+    return pcm_slice(pulses, device, t, slice_emit_event, NULL);
+}
+
+static int ppm_slice(pulse_data_t const *pulses, r_device *device, r_device_timing_t const *t, slice_emit_fn emit, void *ctx)
+{
+    int s_short = t->s_short;
+    int s_long  = t->s_long;
+    int s_reset = t->s_reset;
+    int s_gap   = t->s_gap;
+    int s_sync  = t->s_sync;
+    int s_tolerance = t->s_tolerance;
 
     int events = 0;
     bitbuffer_t bits = {0};
@@ -305,57 +420,66 @@ int pulse_slicer_ppm(pulse_data_t const *pulses, r_device *device)
         one_u  = s_gap ? s_gap : s_reset;
     }
 
+    symbol_ranges_t ranges;
+    symbol_ranges_init(&ranges);
+    symbol_range(&ranges, 0, zero_l, zero_u, SYMBOL_ZERO);
+    symbol_range(&ranges, 1, one_l, one_u, SYMBOL_ONE);
+    symbol_range(&ranges, 2, sync_l, sync_u, SYMBOL_SYNC);
+    ranges.end_limit = s_reset - 1; // at least the reset limit
+
     for (unsigned n = 0; n < pulses->num_pulses; ++n) {
-        if (pulses->gap[n] > zero_l && pulses->gap[n] < zero_u) {
-            // Short gap
-            bitbuffer_add_bit(&bits, 0);
-        }
-        else if (pulses->gap[n] > one_l && pulses->gap[n] < one_u) {
-            // Long gap
-            bitbuffer_add_bit(&bits, 1);
-        }
-        else if (pulses->gap[n] > sync_l && pulses->gap[n] < sync_u) {
-            // Sync gap
-            bitbuffer_add_sync(&bits);
+        int symbol = quantize_width(pulses->gap[n], &ranges);
+        // a run of data bits, there is no end of message before the last
+        if (symbol <= SYMBOL_ONE) {
+            unsigned run = add_symbol_run(&bits, pulses->gap, &ranges, NULL, 0, n, pulses->num_pulses - 1);
+            if (run > 0) {
+                n += run - 1;
+                continue;
+            }
         }
 
-        // Check for new packet in multipacket
-        else if (pulses->gap[n] < s_reset) {
-            bitbuffer_add_row(&bits);
+        switch (symbol & SYMBOL_CLASS) {
+        case SYMBOL_ZERO: // Short gap
+        case SYMBOL_ONE:  // Long gap
+            bitbuffer_add_bit(&bits, symbol & SYMBOL_CLASS);
+            break;
+        case SYMBOL_SYNC: // Sync gap
+            bitbuffer_add_sync(&bits);
+            break;
+        default:
+            // Check for new packet in multipacket
+            if (!(symbol & SYMBOL_END))
+                bitbuffer_add_row(&bits);
+            break;
         }
         // End of Message?
         if (((n == pulses->num_pulses - 1)                            // No more pulses? (FSK)
-                    || (pulses->gap[n] >= s_reset))     // Long silence (OOK)
+                    || (symbol & SYMBOL_END))                         // Long silence (OOK)
                 && (bits.bits_per_row[0] > 0 || bits.num_rows > 1)) { // Only if data has been accumulated
 
-            events += account_event(device, &bits, __func__);
+            events += emit(ctx, device, &bits, "pulse_slicer_ppm");
             bitbuffer_clear(&bits);
         }
     } // for pulses
     return events;
 }
 
-int pulse_slicer_pwm(pulse_data_t const *pulses, r_device *device)
+int pulse_slicer_ppm(pulse_data_t const *pulses, r_device *device)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6;
-
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
-
-    // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        print_logf(LOG_WARNING, __func__, "sample rate too low for protocol %u \"%s\"", device->protocol_num, device->name);
+    r_device_timing_t const *t = slicer_timing(pulses, device, __func__);
+    if (!t)
         return 0;
-    }
+    return ppm_slice(pulses, device, t, slice_emit_event, NULL);
+}
+
+static int pwm_slice(pulse_data_t const *pulses, r_device *device, r_device_timing_t const *t, slice_emit_fn emit, void *ctx)
+{
+    int s_short = t->s_short;
+    int s_long  = t->s_long;
+    int s_reset = t->s_reset;
+    int s_gap   = t->s_gap;
+    int s_sync  = t->s_sync;
+    int s_tolerance = t->s_tolerance;
 
     int events = 0;
     bitbuffer_t bits = {0};
@@ -411,32 +535,47 @@ int pulse_slicer_pwm(pulse_data_t const *pulses, r_device *device)
         sync_u = INT_MAX;
     }
 
+    symbol_ranges_t pulse_ranges;
+    symbol_ranges_init(&pulse_ranges);
+    symbol_range(&pulse_ranges, 0, one_l, one_u, SYMBOL_ONE);
+    symbol_range(&pulse_ranges, 1, zero_l, zero_u, SYMBOL_ZERO);
+    symbol_range(&pulse_ranges, 2, sync_l, sync_u, SYMBOL_SYNC);
+    symbol_range(&pulse_ranges, 3, INT_MIN, one_l + 1, SYMBOL_SKIP); // at most the lower bound of a 1
+
+    // gaps up to this limit don't end a message or a row
+    int run_gap = s_gap > 0 && s_gap < s_reset ? s_gap : s_reset;
+
     for (unsigned n = 0; n < pulses->num_pulses; ++n) {
-        if (pulses->pulse[n] > one_l && pulses->pulse[n] < one_u) {
-            // 'Short' 1 pulse
-            bitbuffer_add_bit(&bits, 1);
-        }
-        else if (pulses->pulse[n] > zero_l && pulses->pulse[n] < zero_u) {
-            // 'Long' 0 pulse
-            bitbuffer_add_bit(&bits, 0);
+        int symbol = quantize_width(pulses->pulse[n], &pulse_ranges);
+        // a run of data bits, with no end of message or new row before the last
+        if (symbol <= SYMBOL_ONE) {
+            unsigned run = add_symbol_run(&bits, pulses->pulse, &pulse_ranges, pulses->gap, run_gap, n, pulses->num_pulses - 1);
+            if (run > 0) {
+                n += run - 1;
+                continue;
+            }
         }
-        else if (pulses->pulse[n] > sync_l && pulses->pulse[n] < sync_u) {
-            // Sync pulse
+
+        switch (symbol) {
+        case SYMBOL_ONE:  // 'Short' 1 pulse
+        case SYMBOL_ZERO: // 'Long' 0 pulse
+            bitbuffer_add_bit(&bits, symbol);
+            break;
+        case SYMBOL_SYNC: // Sync pulse
             bitbuffer_add_sync(&bits);
-        }
-        else if (pulses->pulse[n] <= one_l) {
-            // Ignore spurious short pulses
-        }
-        else {
-            // Pulse outside specified timing
+            break;
+        case SYMBOL_SKIP: // Ignore spurious short pulses
+            break;
+        default: // Pulse outside specified timing
             bitbuffer_add_row(&bits);
+            break;
         }
 
         // End of Message?
         if (((n == pulses->num_pulses - 1)                       // No more pulses? (FSK)
                     || (pulses->gap[n] > s_reset)) // Long silence (OOK)
                 && (bits.num_rows > 0)) {                        // Only if data has been accumulated
-            events += account_event(device, &bits, __func__);
+            events += emit(ctx, device, &bits, "pulse_slicer_pwm");
             bitbuffer_clear(&bits);
         }
         else if (s_gap > 0 && pulses->gap[n] > s_gap
@@ -448,28 +587,147 @@ int pulse_slicer_pwm(pulse_data_t const *pulses, r_device *device)
     return events;
 }
 
-int pulse_slicer_manchester_zerobit(pulse_data_t const *pulses, r_device *device)
+int pulse_slicer_pwm(pulse_data_t const *pulses, r_device *device)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6;
+    r_device_timing_t const *t = slicer_timing(pulses, device, __func__);
+    if (!t)
+        return 0;
+    return pwm_slice(pulses, device, t, slice_emit_event, NULL);
+}
 
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
+/* batched slicing */
 
-    // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        print_logf(LOG_WARNING, __func__, "sample rate too low for protocol %u \"%s\"", device->protocol_num, device->name);
+#define SLICE_BATCH_TIMINGS 32 // distinct decoder timings shared per package
+#define SLICE_BATCH_EMITS   4  // bitbuffers recorded per timing, packages with more are sliced per decoder
+
+typedef struct slice_batch_entry {
+    slice_fn slice;
+    r_device_timing_t timing;
+    unsigned num_emits;                    ///< bitbuffers emitted by the slicer
+    bitbuffer_t *emits[SLICE_BATCH_EMITS]; ///< recorded bitbuffers, allocated on first use and kept
+} slice_batch_entry_t;
+
+struct slice_batch {
+    unsigned num_entries;
+    slice_batch_entry_t entries[SLICE_BATCH_TIMINGS];
+};
+
+slice_batch_t *slice_batch_create(void)
+{
+    slice_batch_t *batch = calloc(1, sizeof(*batch));
+    if (!batch) {
+        WARN_CALLOC("slice_batch_create()");
+        return NULL;
+    }
+    return batch;
+}
+
+void slice_batch_free(slice_batch_t *batch)
+{
+    if (!batch)
+        return;
+    for (unsigned i = 0; i < SLICE_BATCH_TIMINGS; ++i) {
+        for (unsigned j = 0; j < SLICE_BATCH_EMITS; ++j) {
+            free(batch->entries[i].emits[j]);
+        }
+    }
+    free(batch);
+}
+
+void slice_batch_reset(slice_batch_t *batch)
+{
+    if (batch)
+        batch->num_entries = 0;
+}
+
+static int slice_same_timing(r_device_timing_t const *a, r_device_timing_t const *b)
+{
+    return a->s_short == b->s_short
+            && a->s_long == b->s_long
+            && a->s_reset == b->s_reset
+            && a->s_gap == b->s_gap
+            && a->s_sync == b->s_sync
+            && a->s_tolerance == b->s_tolerance
+            && a->f_short == b->f_short
+            && a->f_long == b->f_long;
+}
+
+static int slice_emit_record(void *ctx, r_device *device, bitbuffer_t *bits, char const *demod_name)
+{
+    slice_batch_entry_t *entry = ctx;
+    unsigned n                 = entry->num_emits++;
+    if (n < SLICE_BATCH_EMITS && !entry->emits[n]) {
+        entry->emits[n] = malloc(sizeof(*entry->emits[n]));
+        if (!entry->emits[n]) {
+            WARN_MALLOC("slice_emit_record()");
+            entry->num_emits = SLICE_BATCH_EMITS + 1; // not shared
+        }
+    }
+    if (n < SLICE_BATCH_EMITS && entry->emits[n]) {
+        *entry->emits[n] = *bits; // before the decoder might change it
+    }
+    return account_event(device, bits, demod_name);
+}
+
+static int slice_batched(pulse_data_t const *pulses, r_device *device, slice_batch_t *batch, slice_fn slice, char const *demod_name)
+{
+    r_device_timing_t const *t = slicer_timing(pulses, device, demod_name);
+    if (!t)
         return 0;
+    // the slicer debug output is per decoder
+    if (!batch || device->verbose > 1)
+        return slice(pulses, device, t, slice_emit_event, NULL);
+
+    for (unsigned i = 0; i < batch->num_entries; ++i) {
+        slice_batch_entry_t *entry = &batch->entries[i];
+        if (entry->slice != slice || !slice_same_timing(&entry->timing, t))
+            continue;
+        if (entry->num_emits > SLICE_BATCH_EMITS)
+            return slice(pulses, device, t, slice_emit_event, NULL); // not recorded
+        // replay the recorded bitbuffers, each decoder gets a copy
+        int events = 0;
+        bitbuffer_t bits;
+        for (unsigned n = 0; n < entry->num_emits; ++n) {
+            bits = *entry->emits[n];
+            events += account_event(device, &bits, demod_name);
+        }
+        return events;
     }
 
+    if (batch->num_entries >= SLICE_BATCH_TIMINGS)
+        return slice(pulses, device, t, slice_emit_event, NULL);
+
+    slice_batch_entry_t *entry = &batch->entries[batch->num_entries++];
+    entry->slice               = slice;
+    entry->timing              = *t;
+    entry->num_emits           = 0;
+    return slice(pulses, device, t, slice_emit_record, entry);
+}
+
+int pulse_slicer_pcm_batch(pulse_data_t const *pulses, r_device *device, slice_batch_t *batch)
+{
+    return slice_batched(pulses, device, batch, pcm_slice, "pulse_slicer_pcm");
+}
+
+int pulse_slicer_ppm_batch(pulse_data_t const *pulses, r_device *device, slice_batch_t *batch)
+{
+    return slice_batched(pulses, device, batch, ppm_slice, "pulse_slicer_ppm");
+}
+
+int pulse_slicer_pwm_batch(pulse_data_t const *pulses, r_device *device, slice_batch_t *batch)
+{
+    return slice_batched(pulses, device, batch, pwm_slice, "pulse_slicer_pwm");
+}
+
+int pulse_slicer_manchester_zerobit(pulse_data_t const *pulses, r_device *device)
+{
+    r_device_timing_t const *t = slicer_timing(pulses, device, __func__);
+    if (!t)
+        return 0;
+    int s_short = t->s_short;
+    int s_reset = t->s_reset;
+    int s_tolerance = t->s_tolerance;
+
     int events = 0;
     int time_since_last = 0;
     bitbuffer_t bits = {0};
@@ -537,25 +795,13 @@ static inline int pulse_slicer_get_symbol(pulse_data_t const *pulses, unsigned i
 
 int pulse_slicer_dmc(pulse_data_t const *pulses, r_device *device)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6;
-
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
-
-    // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        print_logf(LOG_WARNING, __func__, "sample rate too low for protocol %u \"%s\"", device->protocol_num, device->name);
+    r_device_timing_t const *t = slicer_timing(pulses, device, __func__);
+    if (!t)
         return 0;
-    }
+    int s_short = t->s_short;
+    int s_long  = t->s_long;
+    int s_reset = t->s_reset;
+    int s_tolerance = t->s_tolerance;
 
     bitbuffer_t bits = {0};
     int events = 0;
@@ -36,6 +36,15 @@
 #include "output_influx.h"
 #include "output_trigger.h"
 #include "output_rtltcp.h"
+#include "raw_output.h"
+#include "output_aggregate.h"
+#include "output_sched.h"
+#include "pulse_cluster.h"
+#include "rx_merge.h"
+#include "spectrum.h"
+#include "frame_table.h"
+#include "samp_grab.h"
+#include "alloc_stats.h"
 #include "write_sigrok.h"
 #include "mongoose.h"
 #include "compat_time.h"
@@ -60,6 +69,8 @@
 #include "getopt/getopt.h"
 #endif
 
+r_device *flex_try_create_device(char *spec); // maybe put this in some header file?
+
 char const *version_string(void)
 {
     return "rtl_433"
@@ -142,6 +153,16 @@ void set_gain_str(struct r_cfg *cfg, char const *gain_str)
 
 /* general */
 
+#ifdef R_DEVICES_SELECTED
+#include "rtl_433_devices_selected.h"
+
+/// Placeholder for decoders not selected at build time, keeps the protocol numbers stable.
+static r_device const unselected_device = {
+        .name     = "Decoder not built",
+        .disabled = 3, // disabled and hidden
+};
+#endif
+
 void r_init_cfg(r_cfg_t *cfg)
 {
     cfg->out_block_size  = DEFAULT_BUF_LENGTH;
@@ -157,7 +178,11 @@ void r_init_cfg(r_cfg_t *cfg)
 
     // collect devices list, this should be a module
     r_device r_devices[] = {
+#ifdef R_DEVICES_SELECTED
+#define DECL(name) R_DEVICE_##name,
+#else
 #define DECL(name) name,
+#endif
             DEVICES
 #undef DECL
     };
@@ -184,10 +209,12 @@ void r_init_cfg(r_cfg_t *cfg)
 
     // note: this should be optional
     cfg->demod->pulse_detect = pulse_detect_create();
+    cfg->demod->slice_batch = slice_batch_create(); // optional, slicing is not shared without it
     // initialize tables
     baseband_init();
 
     time(&cfg->frames_since);
+    cfg->cpu_since = get_cpu_time();
 
     list_ensure_size(&cfg->demod->r_devs, 100);
     list_ensure_size(&cfg->demod->dumper, 32);
@@ -220,23 +247,58 @@ void r_free_cfg(r_cfg_t *cfg)
     }
     list_free_elems(&cfg->demod->dumper, free);
 
+    reclaim_protocols(cfg);
+    list_free_elems(&cfg->demod->r_devs_retired, NULL);
     list_free_elems(&cfg->demod->r_devs, (list_elem_free_fn)free_protocol);
 
     if (cfg->demod->am_analyze)
         am_analyze_free(cfg->demod->am_analyze);
 
+    if (cfg->demod->samp_grab)
+        samp_grab_free(cfg->demod->samp_grab);
+
     pulse_detect_free(cfg->demod->pulse_detect);
+    slice_batch_free(cfg->demod->slice_batch);
 
     list_free_elems(&cfg->raw_handler, (list_elem_free_fn)raw_output_free);
 
-    r_logger_set_log_handler(NULL, NULL);
+    r_logger_reset_log_handler(cfg); // other instances may own the log handler
+
+    if (cfg->pulse_cluster) {
+        poll_pulse_cluster(cfg, 0); // report what was collected so far
+        pulse_cluster_free(cfg->pulse_cluster);
+    }
+
+    if (cfg->rx_merge) {
+        poll_rx_merge(cfg, 0); // output the pending events
+        data_t *stats = rx_merge_stats(cfg->rx_merge);
+        if (stats) {
+            char buf[256];
+            data_print_jsons(stats, buf, sizeof(buf));
+            print_logf(LOG_NOTICE, "Merge", "Merge stats %s", buf);
+            data_free(stats);
+        }
+        rx_merge_free(cfg->rx_merge);
+    }
+
+    free(cfg->coalesce_buf);
+
+    spectrum_free(cfg->spectrum);
+
+    list_free_elems(&cfg->aggregate_outputs, NULL); // owned by output_handler
+
+    list_free_elems(&cfg->sched_outputs, NULL); // owned by output_handler
 
     list_free_elems(&cfg->output_handler, (list_elem_free_fn)data_output_free);
 
+    list_free_elems(&cfg->sched_rules, (list_elem_free_fn)sched_rule_free);
+
     list_free_elems(&cfg->data_tags, (list_elem_free_fn)data_tag_free);
 
     list_free_elems(&cfg->in_files, NULL);
 
+    free(cfg->checkpoint_file);
+
     free(cfg->demod);
 
     free(cfg->devices);
@@ -244,12 +306,14 @@ void r_free_cfg(r_cfg_t *cfg)
     mg_mgr_free(cfg->mgr);
     free(cfg->mgr);
 
+    data_pool_clear();
+
     //free(cfg);
 }
 
 /* device decoder protocols */
 
-void register_protocol(r_cfg_t *cfg, r_device *r_dev, char *arg)
+static r_device *create_protocol(r_cfg_t *cfg, r_device *r_dev, char *arg)
 {
     // use arg of 'v', 'vv', 'vvv' as device verbosity
     int dev_verbose = 0;
@@ -266,6 +330,7 @@ void register_protocol(r_cfg_t *cfg, r_device *r_dev, char *arg)
     r_device *p;
     if (r_dev->create_fn) {
         p = r_dev->create_fn(arg);
+        p->protocol_num = r_dev->protocol_num; // the decoder template has no number
     }
     else {
         if (arg && *arg) {
@@ -284,17 +349,32 @@ void register_protocol(r_cfg_t *cfg, r_device *r_dev, char *arg)
     p->output_fn  = data_acquired_handler;
     p->output_ctx = cfg;
 
-    list_push(&cfg->demod->r_devs, p);
+    int num_fields = 0;
+    while (p->fields && p->fields[num_fields])
+        num_fields++;
+    p->schema = data_schema_create(p->fields, num_fields);
+    if (!p->schema)
+        FATAL_CALLOC("register_protocol()");
 
     if (cfg->verbosity >= LOG_INFO) {
         fprintf(stderr, "Registering protocol [%u] \"%s\"\n", r_dev->protocol_num, r_dev->name);
     }
+
+    return p;
+}
+
+void register_protocol(r_cfg_t *cfg, r_device *r_dev, char *arg)
+{
+    r_device *p = create_protocol(cfg, r_dev, arg);
+    list_push(&cfg->demod->r_devs, p);
 }
 
 void free_protocol(r_device *r_dev)
 {
     // free(r_dev->name);
+    data_schema_free(r_dev->schema);
     free(r_dev->decode_ctx);
+    frame_table_free(r_dev->frame_table);
     free(r_dev);
 }
 
@@ -309,6 +389,179 @@ void unregister_protocol(r_cfg_t *cfg, r_device *r_dev)
     }
 }
 
+/* hot reconfiguration */
+
+// The demod path iterates the decoder list without a lock: a reconfiguration
+// builds a new list and swaps it in, the old list and the removed decoders stay
+// valid and are retired until the next quiescent point of the demod path.
+// Both the demod path and the RPC handlers run on the main loop, so the start
+// of the next input block (see reclaim_protocols()) ends the grace period.
+
+static void add_protocol_stats(r_device *dst, r_device const *src)
+{
+    dst->decode_events += src->decode_events;
+    dst->decode_ok += src->decode_ok;
+    dst->decode_messages += src->decode_messages;
+    for (unsigned i = 0; i < sizeof(dst->decode_fails) / sizeof(*dst->decode_fails); ++i)
+        dst->decode_fails[i] += src->decode_fails[i];
+    dst->decode_allocs += src->decode_allocs;
+    dst->decode_alloc_bytes += src->decode_alloc_bytes;
+    dst->frame_hits += src->frame_hits;
+    dst->frame_misses += src->frame_misses;
+    dst->frame_expired += src->frame_expired;
+    dst->frame_evicted += src->frame_evicted;
+}
+
+static void clear_protocol_stats(r_device *dev)
+{
+    dev->decode_events   = 0;
+    dev->decode_ok       = 0;
+    dev->decode_messages = 0;
+    memset(dev->decode_fails, 0, sizeof(dev->decode_fails));
+    dev->decode_allocs      = 0;
+    dev->decode_alloc_bytes = 0;
+    dev->frame_hits         = 0;
+    dev->frame_misses       = 0;
+    dev->frame_expired      = 0;
+    dev->frame_evicted      = 0;
+}
+
+/// Swap in a new decoder list, replacing the decoders matched by the filter with an optional new decoder.
+/// The new decoder inherits the statistics of the replaced decoders.
+static int swap_protocols(r_cfg_t *cfg, int (*match)(r_device *, void const *), void const *ctx, r_device *added)
+{
+    struct dm_state *demod = cfg->demod;
+
+    list_t r_devs = {0};
+    list_ensure_size(&r_devs, demod->r_devs.len + 2);
+    int removed = 0;
+    for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        if (match(r_dev, ctx)) {
+            if (added)
+                add_protocol_stats(added, r_dev);
+            else if (r_dev->protocol_num)
+                add_protocol_stats(&cfg->devices[r_dev->protocol_num - 1], r_dev); // keep for re-enabling
+            list_push(&demod->r_devs_retired, r_dev);
+            removed++;
+        }
+        else {
+            list_push(&r_devs, r_dev);
+        }
+    }
+    if (added) {
+        // keep the protocol number order of the command line registration
+        size_t pos = r_devs.len;
+        while (added->protocol_num && pos > 0
+                && (((r_device *)r_devs.elems[pos - 1])->protocol_num > added->protocol_num
+                        || !((r_device *)r_devs.elems[pos - 1])->protocol_num))
+            pos--;
+        list_push(&r_devs, NULL);
+        memmove(&r_devs.elems[pos + 1], &r_devs.elems[pos], (r_devs.len - 1 - pos) * sizeof(*r_devs.elems));
+        r_devs.elems[pos] = added;
+    }
+
+    // publish, the old list is retired with its decoders
+    list_t old_devs = demod->r_devs;
+    demod->r_devs   = r_devs;
+    // the elems array is retired after the decoders, tagged with a NULL to tell it apart
+    list_push(&demod->r_devs_retired, NULL);
+    list_push(&demod->r_devs_retired, old_devs.elems);
+
+    demod->enable_FM_demod = 0;
+    for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        if (r_dev->modulation >= FSK_DEMOD_MIN_VAL) {
+            demod->enable_FM_demod = 1;
+            break;
+        }
+    }
+
+    return removed;
+}
+
+static int match_protocol_num(r_device *r_dev, void const *ctx)
+{
+    return r_dev->protocol_num == *(unsigned const *)ctx;
+}
+
+static int match_flex_name(r_device *r_dev, void const *ctx)
+{
+    return !r_dev->protocol_num && r_dev->name && !strcmp(r_dev->name, ctx);
+}
+
+/// Enable a protocol or replace an enabled protocol, e.g. with new arguments.
+/// @return 0 on success, -1 if the protocol number is unknown or not available
+int enable_protocol(r_cfg_t *cfg, unsigned num, char *arg)
+{
+    if (num < 1 || num > cfg->num_r_devices)
+        return -1;
+    // hidden, templates, and protocols not in the build, as for -R
+    if (cfg->devices[num - 1].disabled > 2)
+        return -1;
+
+    r_device *tmpl = &cfg->devices[num - 1];
+    r_device *p    = create_protocol(cfg, tmpl, arg);
+    clear_protocol_stats(p);
+    int removed = swap_protocols(cfg, match_protocol_num, &num, p);
+    if (!removed) {
+        // statistics kept from a previous disable
+        add_protocol_stats(p, tmpl);
+        clear_protocol_stats(tmpl);
+    }
+    return 0;
+}
+
+/// Disable a protocol, the statistics are kept for re-enabling.
+/// @return 0 on success, -1 if the protocol is not enabled
+int disable_protocol(r_cfg_t *cfg, unsigned num)
+{
+    if (num < 1 || num > cfg->num_r_devices)
+        return -1;
+
+    int removed = swap_protocols(cfg, match_protocol_num, &num, NULL);
+    return removed ? 0 : -1;
+}
+
+/// Add a flex decoder or replace a flex decoder with the same name.
+/// @return 0 on success, -1 on a bad spec
+int add_flex_protocol(r_cfg_t *cfg, char *spec)
+{
+    r_device *flex_device = flex_try_create_device(spec);
+    if (!flex_device)
+        return -1;
+    r_device *p = create_protocol(cfg, flex_device, "");
+    free(flex_device); // the registered copy owns the decode_ctx
+    swap_protocols(cfg, match_flex_name, p->name, p);
+    return 0;
+}
+
+/// Remove a flex decoder by the name given in the spec.
+/// @return 0 on success, -1 if there is no such flex decoder
+int remove_flex_protocol(r_cfg_t *cfg, char const *name)
+{
+    char flex_name[256];
+    snprintf(flex_name, sizeof(flex_name), "General purpose decoder '%s'", name);
+    int removed = swap_protocols(cfg, match_flex_name, flex_name, NULL);
+    return removed ? 0 : -1;
+}
+
+/// Free the retired decoders and lists, call only at a quiescent point of the demod path.
+void reclaim_protocols(r_cfg_t *cfg)
+{
+    list_t *retired = &cfg->demod->r_devs_retired;
+    if (!retired->len)
+        return;
+
+    for (size_t i = 0; i < retired->len; ++i) {
+        if (retired->elems[i])
+            free_protocol(retired->elems[i]);
+        else
+            free(retired->elems[++i]); // a retired list
+    }
+    list_clear(retired, NULL);
+}
+
 void register_all_protocols(r_cfg_t *cfg, unsigned disabled)
 {
     for (int i = 0; i < cfg->num_r_devices; i++) {
@@ -385,6 +638,7 @@ char *time_pos_str(r_cfg_t *cfg, unsigned samples_ago, char *buf)
 // well-known field "protocol" is only used when model protocol is requested
 // well-known field "description" is only used when model description is requested
 // well-known fields "mod", "freq", "freq1", "freq2", "rssi", "snr", "noise" are used by meta report option
+// well-known fields "rssi", "snr", "rx_best", "rx_count", "rx" are used by merged events from other receivers
 char const **well_known_output_fields(r_cfg_t *cfg)
 {
     list_t field_list = {0};
@@ -420,6 +674,15 @@ char const **well_known_output_fields(r_cfg_t *cfg)
         list_push(&field_list, "snr");
         list_push(&field_list, "noise");
     }
+    if (cfg->rx_merge) {
+        if (!cfg->report_meta) {
+            list_push(&field_list, "rssi");
+            list_push(&field_list, "snr");
+        }
+        list_push(&field_list, "rx_best");
+        list_push(&field_list, "rx_count");
+        list_push(&field_list, "rx");
+    }
 
     return (char const **)field_list.elems;
 }
@@ -480,10 +743,15 @@ char const **determine_csv_fields(r_cfg_t *cfg, char const *const *well_known, i
     return (char const **)field_list.elems;
 }
 
-int run_ook_demods(list_t *r_devs, pulse_data_t *pulse_data)
+int run_ook_demods(list_t *r_devs, pulse_data_t *pulse_data, slice_batch_t *slice_batch)
 {
     int p_events = 0;
 
+    slice_batch_reset(slice_batch);
+
+    // the stream time for the partial frames of the decoders
+    uint64_t time_ms = pulse_data->sample_rate ? pulse_data->offset * 1000 / pulse_data->sample_rate : 0;
+
     unsigned next_priority = 0; // next smallest on each loop through decoders
     // run all decoders of each priority, stop if an event is produced
     for (unsigned priority = 0; !p_events && priority < UINT_MAX; priority = next_priority) {
@@ -498,16 +766,18 @@ int run_ook_demods(list_t *r_devs, pulse_data_t *pulse_data)
             if (r_dev->priority != priority)
                 continue;
 
+            r_dev->frame_time_ms = time_ms;
+            alloc_scope_t alloc_scope = alloc_stats_enter(ALLOC_STAGE_DECODE, r_dev);
             switch (r_dev->modulation) {
             case OOK_PULSE_PCM:
             // case OOK_PULSE_RZ:
-                p_events += pulse_slicer_pcm(pulse_data, r_dev);
+                p_events += pulse_slicer_pcm_batch(pulse_data, r_dev, slice_batch);
                 break;
             case OOK_PULSE_PPM:
-                p_events += pulse_slicer_ppm(pulse_data, r_dev);
+                p_events += pulse_slicer_ppm_batch(pulse_data, r_dev, slice_batch);
                 break;
             case OOK_PULSE_PWM:
-                p_events += pulse_slicer_pwm(pulse_data, r_dev);
+                p_events += pulse_slicer_pwm_batch(pulse_data, r_dev, slice_batch);
                 break;
             case OOK_PULSE_MANCHESTER_ZEROBIT:
                 p_events += pulse_slicer_manchester_zerobit(pulse_data, r_dev);
@@ -535,16 +805,22 @@ int run_ook_demods(list_t *r_devs, pulse_data_t *pulse_data)
             default:
                 fprintf(stderr, "Unknown modulation %u in protocol!\n", r_dev->modulation);
             }
+            alloc_stats_leave(alloc_scope);
         }
     }
 
     return p_events;
 }
 
-int run_fsk_demods(list_t *r_devs, pulse_data_t *fsk_pulse_data)
+int run_fsk_demods(list_t *r_devs, pulse_data_t *fsk_pulse_data, slice_batch_t *slice_batch)
 {
     int p_events = 0;
 
+    slice_batch_reset(slice_batch);
+
+    // the stream time for the partial frames of the decoders
+    uint64_t time_ms = fsk_pulse_data->sample_rate ? fsk_pulse_data->offset * 1000 / fsk_pulse_data->sample_rate : 0;
+
     unsigned next_priority = 0; // next smallest on each loop through decoders
     // run all decoders of each priority, stop if an event is produced
     for (unsigned priority = 0; !p_events && priority < UINT_MAX; priority = next_priority) {
@@ -559,6 +835,8 @@ int run_fsk_demods(list_t *r_devs, pulse_data_t *fsk_pulse_data)
             if (r_dev->priority != priority)
                 continue;
 
+            r_dev->frame_time_ms = time_ms;
+            alloc_scope_t alloc_scope = alloc_stats_enter(ALLOC_STAGE_DECODE, r_dev);
             switch (r_dev->modulation) {
             // OOK decoders
             case OOK_PULSE_PCM:
@@ -573,10 +851,10 @@ int run_fsk_demods(list_t *r_devs, pulse_data_t *fsk_pulse_data)
             case OOK_PULSE_NRZS:
                 break;
             case FSK_PULSE_PCM:
-                p_events += pulse_slicer_pcm(fsk_pulse_data, r_dev);
+                p_events += pulse_slicer_pcm_batch(fsk_pulse_data, r_dev, slice_batch);
                 break;
             case FSK_PULSE_PWM:
-                p_events += pulse_slicer_pwm(fsk_pulse_data, r_dev);
+                p_events += pulse_slicer_pwm_batch(fsk_pulse_data, r_dev, slice_batch);
                 break;
             case FSK_PULSE_MANCHESTER_ZEROBIT:
                 p_events += pulse_slicer_manchester_zerobit(fsk_pulse_data, r_dev);
@@ -584,6 +862,7 @@ int run_fsk_demods(list_t *r_devs, pulse_data_t *fsk_pulse_data)
             default:
                 fprintf(stderr, "Unknown modulation %u in protocol!\n", r_dev->modulation);
             }
+            alloc_stats_leave(alloc_scope);
         }
     }
 
@@ -672,35 +951,57 @@ void log_device_handler(r_device *r_dev, int level, data_t *data)
     data_free(data);
 }
 
-/** Pass the data structure to all output handlers. Frees data afterwards. */
-void data_acquired_handler(r_device *r_dev, data_t *data)
+/// The package of the current event, FSK packages are detected with a second frequency estimate.
+static pulse_data_t const *event_package(struct dm_state const *demod)
 {
-    r_cfg_t *cfg = r_dev->output_ctx;
+    return demod->fsk_pulse_data.fsk_f2_est ? &demod->fsk_pulse_data : &demod->pulse_data;
+}
 
-#ifndef NDEBUG
-    // check for undeclared csv fields
-    for (data_t *d = data; d; d = d->next) {
-        int found = 0;
-        for (char const *const *p = r_dev->fields; *p; ++p) {
-            if (!strcmp(d->key, *p)) {
-                found = 1;
-                break;
-            }
-        }
-        if (!found) {
-            fprintf(stderr, "WARNING: Undeclared field \"%s\" in [%u] \"%s\"\n", d->key, r_dev->protocol_num, r_dev->name);
-        }
+/// Measure the air-to-output latency in ms of the current package and add it to the stats.
+static double measure_latency(r_cfg_t *cfg)
+{
+    struct dm_state *demod = cfg->demod;
+    if (!demod->now.tv_sec || (cfg->in_filename && !cfg->in_replay)) {
+        return 0.0; // not a live or realtime input
     }
-#endif
 
+    struct timeval now;
+    get_time_now(&now);
+    // the end of the current buffer was received at buf_arrival, or when processing started
+    struct timeval const *ref = demod->buf_arrival.tv_sec ? &demod->buf_arrival : &demod->now;
+    double latency_ms = (now.tv_sec - ref->tv_sec) * 1e3 + (now.tv_usec - ref->tv_usec) * 1e-3;
+    // the package ended this many samples before the end of the buffer
+    if (cfg->samp_rate) {
+        latency_ms += event_package(demod)->end_ago * 1e3 / cfg->samp_rate;
+    }
+
+    unsigned bin = latency_ms < 0.0 ? 0 : latency_ms < LATENCY_HIST_BINS - 1 ? (unsigned)latency_ms : LATENCY_HIST_BINS - 1;
+    cfg->latency_hist[bin]++;
+    cfg->latency_count++;
+    return latency_ms;
+}
+
+/// Replace the unit in the key and format of a converted field, without allocating.
+static void convert_field(data_t *d, char const *key_rep, char const *key_with, char const *format_rep, char const *format_with)
+{
+    char buf[256]; // longer keys and formats are not converted
+    if (str_replace_buf(buf, sizeof(buf), d->key, key_rep, key_with) >= 0) {
+        data_set_key(d, buf);
+    }
+    if (format_rep && d->format && str_replace_buf(buf, sizeof(buf), d->format, format_rep, format_with) >= 0) {
+        data_set_format(d, buf);
+    }
+}
+
+/// Convert the unit fields of an event according to the selected conversion mode.
+static void convert_units(r_cfg_t *cfg, data_t *data)
+{
     if (cfg->conversion_mode == CONVERT_SI) {
         for (data_t *d = data; d; d = d->next) {
             // Convert double type fields ending in _F to _C
             if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_F")) {
                 d->value.v_dbl = fahrenheit2celsius(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_F", "_C");
-                free(d->key);
-                d->key = new_label;
+                convert_field(d, "_F", "_C", NULL, NULL);
                 char *pos;
                 if (d->format && (pos = strrchr(d->format, 'F'))) {
                     *pos = 'C';
@@ -709,63 +1010,34 @@ void data_acquired_handler(r_device *r_dev, data_t *data)
             // Convert double type fields ending in _mph to _kph
             else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_mph")) {
                 d->value.v_dbl = mph2kmph(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_mph", "_kph");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "mi/h", "km/h");
-                free(d->format);
-                d->format = new_format_label;
+                convert_field(d, "_mph", "_kph", "mi/h", "km/h");
             }
             // Convert double type fields ending in _mi_h to _km_h
             else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_mi_h")) {
                 d->value.v_dbl = mph2kmph(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_mi_h", "_km_h");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "mi/h", "km/h");
-                free(d->format);
-                d->format = new_format_label;
+                convert_field(d, "_mi_h", "_km_h", "mi/h", "km/h");
             }
             // Convert double type fields ending in _in to _mm
             else if ((d->type == DATA_DOUBLE) &&
                      (str_endswith(d->key, "_in") || str_endswith(d->key, "_inch"))) {
                 d->value.v_dbl = inch2mm(d->value.v_dbl);
-                char *new_label = str_replace(str_replace(d->key, "_inch", "_in"), "_in", "_mm");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "in", "mm");
-                free(d->format);
-                d->format = new_format_label;
+                convert_field(d, "_inch", "_in", NULL, NULL);
+                convert_field(d, "_in", "_mm", "in", "mm");
             }
             // Convert double type fields ending in _in_h to _mm_h
             else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_in_h")) {
                 d->value.v_dbl = inch2mm(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_in_h", "_mm_h");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "in/h", "mm/h");
-                free(d->format);
-                d->format = new_format_label;
+                convert_field(d, "_in_h", "_mm_h", "in/h", "mm/h");
             }
             // Convert double type fields ending in _inHg to _hPa
             else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_inHg")) {
                 d->value.v_dbl = inhg2hpa(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_inHg", "_hPa");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "inHg", "hPa");
-                free(d->format);
-                d->format = new_format_label;
+                convert_field(d, "_inHg", "_hPa", "inHg", "hPa");
             }
             // Convert double type fields ending in _PSI to _kPa
             else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_PSI")) {
                 d->value.v_dbl = psi2kpa(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_PSI", "_kPa");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "PSI", "kPa");
-                free(d->format);
-                d->format = new_format_label;
+                convert_field(d, "_PSI", "_kPa", "PSI", "kPa");
             }
         }
     }
@@ -774,9 +1046,7 @@ void data_acquired_handler(r_device *r_dev, data_t *data)
             // Convert double type fields ending in _C to _F
             if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_C")) {
                 d->value.v_dbl = celsius2fahrenheit(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_C", "_F");
-                free(d->key);
-                d->key = new_label;
+                convert_field(d, "_C", "_F", NULL, NULL);
                 char *pos;
                 if (d->format && (pos = strrchr(d->format, 'C'))) {
                     *pos = 'F';
@@ -785,65 +1055,53 @@ void data_acquired_handler(r_device *r_dev, data_t *data)
             // Convert double type fields ending in _kph to _mph
             else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_kph")) {
                 d->value.v_dbl = kmph2mph(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_kph", "_mph");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "km/h", "mi/h");
-                free(d->format);
-                d->format = new_format_label;
+                convert_field(d, "_kph", "_mph", "km/h", "mi/h");
             }
             // Convert double type fields ending in _km_h to _mi_h
             else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_km_h")) {
                 d->value.v_dbl = kmph2mph(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_km_h", "_mi_h");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "km/h", "mi/h");
-                free(d->format);
-                d->format = new_format_label;
+                convert_field(d, "_km_h", "_mi_h", "km/h", "mi/h");
             }
             // Convert double type fields ending in _mm to _inch
             else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_mm")) {
                 d->value.v_dbl = mm2inch(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_mm", "_in");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "mm", "in");
-                free(d->format);
-                d->format = new_format_label;
+                convert_field(d, "_mm", "_in", "mm", "in");
             }
             // Convert double type fields ending in _mm_h to _in_h
             else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_mm_h")) {
                 d->value.v_dbl = mm2inch(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_mm_h", "_in_h");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "mm/h", "in/h");
-                free(d->format);
-                d->format = new_format_label;
+                convert_field(d, "_mm_h", "_in_h", "mm/h", "in/h");
             }
             // Convert double type fields ending in _hPa to _inHg
             else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_hPa")) {
                 d->value.v_dbl = hpa2inhg(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_hPa", "_inHg");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "hPa", "inHg");
-                free(d->format);
-                d->format = new_format_label;
+                convert_field(d, "_hPa", "_inHg", "hPa", "inHg");
             }
             // Convert double type fields ending in _kPa to _PSI
             else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_kPa")) {
                 d->value.v_dbl = kpa2psi(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_kPa", "_PSI");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "kPa", "PSI");
-                free(d->format);
-                d->format = new_format_label;
+                convert_field(d, "_kPa", "_PSI", "kPa", "PSI");
             }
         }
     }
+}
+
+/** Pass the data structure to all output handlers. Frees data afterwards. */
+void data_acquired_handler(r_device *r_dev, data_t *data)
+{
+    r_cfg_t *cfg = r_dev->output_ctx;
+    alloc_scope_t alloc_scope = alloc_stats_enter(ALLOC_STAGE_OUTPUT, NULL);
+
+#ifndef NDEBUG
+    // check for undeclared csv fields
+    for (data_t *d = data; d; d = d->next) {
+        if (data_schema_id(r_dev->schema, d->key) < 0) {
+            fprintf(stderr, "WARNING: Undeclared field \"%s\" in [%u] \"%s\"\n", d->key, r_dev->protocol_num, r_dev->name);
+        }
+    }
+#endif
+
+    convert_units(cfg, data);
 
     // prepend "description" if requested
     if (cfg->report_description) {
@@ -879,6 +1137,13 @@ void data_acquired_handler(r_device *r_dev, data_t *data)
                 NULL);
     }
 
+    double latency_ms = measure_latency(cfg);
+    if (cfg->report_latency) {
+        data_append(data,
+                "latency", "Latency",   DATA_FORMAT, "%.1f ms", DATA_DOUBLE, latency_ms,
+                NULL);
+    }
+
     // prepend "time" if requested
     if (cfg->report_time != REPORT_TIME_OFF) {
         char time_str[LOCAL_TIME_BUFLEN];
@@ -899,6 +1164,20 @@ void data_acquired_handler(r_device *r_dev, data_t *data)
         data_output_print(output, data);
     }
     data_free(data);
+    alloc_stats_leave(alloc_scope);
+}
+
+/// Latency percentile in ms from the stats histogram.
+static int latency_percentile(r_cfg_t const *cfg, unsigned percent)
+{
+    unsigned target = (cfg->latency_count * percent + 99) / 100;
+    unsigned sum    = 0;
+    for (int i = 0; i < LATENCY_HIST_BINS; ++i) {
+        sum += cfg->latency_hist[i];
+        if (sum >= target && sum > 0)
+            return i;
+    }
+    return LATENCY_HIST_BINS - 1;
 }
 
 // level 0: do not report (don't call this), 1: report successful devices, 2: report active devices, 3: report all
@@ -946,6 +1225,22 @@ data_t *create_report_data(r_cfg_t *cfg, int level)
             data_append(data,
                     "fail_sanity",  "", DATA_INT, r_dev->decode_fails[-DECODE_FAIL_SANITY],
                     NULL);
+        if (r_dev->decode_fails[-DECODE_PARTIAL])
+            data_append(data,
+                    "partial",      "", DATA_INT, r_dev->decode_fails[-DECODE_PARTIAL],
+                    NULL);
+        if (r_dev->frame_hits || r_dev->frame_misses)
+            data_append(data,
+                    "frame_hits",   "", DATA_INT, r_dev->frame_hits,
+                    "frame_misses", "", DATA_INT, r_dev->frame_misses,
+                    "frame_expired", "", DATA_INT, r_dev->frame_expired,
+                    "frame_evicted", "", DATA_INT, r_dev->frame_evicted,
+                    NULL);
+        if (r_dev->decode_allocs)
+            data_append(data,
+                    "allocs",       "", DATA_INT, r_dev->decode_allocs,
+                    "alloc_bytes",  "", DATA_INT, (int)r_dev->decode_alloc_bytes,
+                    NULL);
 
         list_push(&dev_data_list, data);
     }
@@ -956,6 +1251,42 @@ data_t *create_report_data(r_cfg_t *cfg, int level)
             "events",           "", DATA_INT, cfg->frames_events,
             NULL);
 
+    if (cfg->latency_count) {
+        data_t *latency = data_make(
+                "count",            "", DATA_INT, cfg->latency_count,
+                "p50_ms",           "", DATA_INT, latency_percentile(cfg, 50),
+                "p90_ms",           "", DATA_INT, latency_percentile(cfg, 90),
+                "p99_ms",           "", DATA_INT, latency_percentile(cfg, 99),
+                "max_ms",           "", DATA_INT, latency_percentile(cfg, 100),
+                NULL);
+        data = data_append(data,
+                "latency",          "", DATA_DATA, latency,
+                NULL);
+    }
+
+    // wakeups and CPU time per hour in the low-power mode
+    if (cfg->low_power) {
+        double hours = (time(NULL) - cfg->frames_since) / 3600.0;
+        double cpu_s = get_cpu_time() - cfg->cpu_since;
+        data_t *power = data_make(
+                "low_power",        "", DATA_INT, cfg->low_power,
+                "loop_wakeups",     "", DATA_INT, cfg->loop_wakeups,
+                "input_wakeups",    "", DATA_INT, cfg->input_wakeups,
+                "input_blocks",     "", DATA_INT, cfg->input_blocks,
+                "frames_quiet",     "", DATA_INT, cfg->frames_quiet,
+                "cpu_s",            "", DATA_FORMAT, "%.3f", DATA_DOUBLE, cpu_s,
+                NULL);
+        if (hours > 0.0) {
+            power = data_append(power,
+                    "wakeups_per_h",    "", DATA_INT, (int)((cfg->loop_wakeups + cfg->input_wakeups) / hours),
+                    "cpu_s_per_h",      "", DATA_FORMAT, "%.3f", DATA_DOUBLE, cpu_s / hours,
+                    NULL);
+        }
+        data = data_append(data,
+                "power",            "", DATA_DATA, power,
+                NULL);
+    }
+
     char since_str[LOCAL_TIME_BUFLEN];
     format_time_str(since_str, "%Y-%m-%dT%H:%M:%S", cfg->report_time_tz, cfg->frames_since);
 
@@ -967,6 +1298,47 @@ data_t *create_report_data(r_cfg_t *cfg, int level)
             NULL);
 
     list_free_elems(&dev_data_list, NULL);
+
+    list_t raw_data_list = {0};
+    for (void **iter = cfg->raw_handler.elems; iter && *iter; ++iter) {
+        data_t *raw_data = raw_output_stats(*iter);
+        if (raw_data)
+            list_push(&raw_data_list, raw_data);
+    }
+    if (raw_data_list.len) {
+        data = data_append(data,
+                "raw_outputs",  "", DATA_ARRAY, data_array(raw_data_list.len, DATA_DATA, raw_data_list.elems),
+                NULL);
+    }
+    list_free_elems(&raw_data_list, NULL);
+
+    list_t sched_data_list = {0};
+    for (void **iter = cfg->sched_outputs.elems; iter && *iter; ++iter) {
+        data_t *sched_data = data_output_sched_stats(*iter, 0);
+        if (sched_data)
+            list_push(&sched_data_list, sched_data);
+    }
+    if (sched_data_list.len) {
+        data = data_append(data,
+                "rate_limits",  "", DATA_ARRAY, data_array(sched_data_list.len, DATA_DATA, sched_data_list.elems),
+                NULL);
+    }
+    list_free_elems(&sched_data_list, NULL);
+
+    data_t *spectrum = spectrum_data(cfg->spectrum);
+    if (spectrum) {
+        data = data_append(data,
+                "spectrum",     "", DATA_DATA, spectrum,
+                NULL);
+    }
+
+    data_t *allocs = alloc_stats_data();
+    if (allocs) {
+        data = data_append(data,
+                "allocs",       "", DATA_DATA, allocs,
+                NULL);
+    }
+
     return data;
 }
 
@@ -978,6 +1350,16 @@ void flush_report_data(r_cfg_t *cfg)
     cfg->frames_count = 0;
     cfg->frames_fsk = 0;
     cfg->frames_events = 0;
+    cfg->latency_count = 0;
+    memset(cfg->latency_hist, 0, sizeof(cfg->latency_hist));
+    cfg->loop_wakeups = 0;
+    cfg->input_wakeups = 0;
+    cfg->input_blocks = 0;
+    cfg->frames_quiet = 0;
+    cfg->cpu_since = get_cpu_time();
+    for (void **iter = cfg->sched_outputs.elems; iter && *iter; ++iter) {
+        data_free(data_output_sched_stats(*iter, 1)); // only reset
+    }
 
     for (void **iter = r_devs->elems; iter && *iter; ++iter) {
         r_device *r_dev = *iter;
@@ -990,7 +1372,15 @@ void flush_report_data(r_cfg_t *cfg)
         r_dev->decode_fails[2] = 0;
         r_dev->decode_fails[3] = 0;
         r_dev->decode_fails[4] = 0;
-    }
+        r_dev->decode_fails[5] = 0;
+        r_dev->frame_hits = 0;
+        r_dev->frame_misses = 0;
+        r_dev->frame_expired = 0;
+        r_dev->frame_evicted = 0;
+        r_dev->decode_allocs = 0;
+        r_dev->decode_alloc_bytes = 0;
+    }
+    alloc_stats_reset();
 }
 
 /* setup */
@@ -1121,13 +1511,10 @@ void add_http_output(r_cfg_t *cfg, char *param)
     // Note: no log_level, the HTTP-API consumes all log levels.
     char const *host = "0.0.0.0";
     char const *port = "8433";
-    char const *extra = hostport_param(param, &host, &port);
-    if (extra && *extra) {
-        print_logf(LOG_FATAL, "HTTP server", "Unknown parameters \"%s\"", extra);
-    }
+    char *extra = hostport_param(param, &host, &port);
     print_logf(LOG_CRITICAL, "HTTP server", "Starting HTTP server at %s port %s", host, port);
 
-    list_push(&cfg->output_handler, data_output_http_create(get_mgr(cfg), host, port, cfg));
+    list_push(&cfg->output_handler, data_output_http_create(get_mgr(cfg), host, port, extra, cfg));
 }
 
 void add_trigger_output(r_cfg_t *cfg, char *param)
@@ -1146,15 +1533,210 @@ void add_rtltcp_output(r_cfg_t *cfg, char *param)
 {
     char const *host = "localhost";
     char const *port = "1234";
-    char const *extra = hostport_param(param, &host, &port);
-    if (extra && *extra) {
-        print_logf(LOG_FATAL, "rtl_tcp server", "Unknown parameters \"%s\"", extra);
-    }
+    char *extra = hostport_param(param, &host, &port);
     print_logf(LOG_CRITICAL, "rtl_tcp server", "Starting rtl_tcp server at %s port %s", host, port);
 
     list_push(&cfg->raw_handler, raw_output_rtltcp_create(host, port, extra, cfg));
 }
 
+/// Find a generic ",<name>=<value>" option anywhere in the output params, copy the value and cut the option.
+static int cut_output_option(char *param, char const *name, char *val_buf, size_t val_size)
+{
+    if (!param)
+        return 0;
+    size_t name_len = strlen(name);
+    char *p = param;
+    while ((p = strchr(p, ','))) {
+        if (strncasecmp(p + 1, name, name_len) || p[1 + name_len] != '=') {
+            p++;
+            continue;
+        }
+        char *val = p + 1 + name_len + 1;
+        char *end = strchr(val, ',');
+        size_t val_len = end ? (size_t)(end - val) : strlen(val);
+        if (val_len >= val_size) {
+            fprintf(stderr, "Invalid %s option \"%s\"\n", name, p);
+            exit(1);
+        }
+        memcpy(val_buf, val, val_len);
+        val_buf[val_len] = '\0';
+        memmove(p, val + val_len, strlen(val + val_len) + 1);
+        return 1;
+    }
+    return 0;
+}
+
+int aggregate_param(char *param)
+{
+    // find ",aggregate=<time>" or ",agg=<time>" anywhere in the options
+    char time_str[32];
+    if (!cut_output_option(param, "aggregate", time_str, sizeof(time_str))
+            && !cut_output_option(param, "agg", time_str, sizeof(time_str)))
+        return 0;
+    int window_secs = atoi_time(time_str, "aggregate: ");
+    if (window_secs <= 0) {
+        fprintf(stderr, "Invalid aggregate window \"%s\"\n", time_str);
+        exit(1);
+    }
+    return window_secs;
+}
+
+double rate_param(char *param, unsigned *burst, unsigned *backlog)
+{
+    char val[32];
+    double rate = 0.0;
+    *burst      = 0;
+    *backlog    = 0;
+    if (cut_output_option(param, "rate", val, sizeof(val))) {
+        // "<events/s>[:<burst>]", or "<events>/<time>" e.g. "10/1m"
+        char *burst_str = strchr(val, ':');
+        if (burst_str) {
+            *burst_str++ = '\0';
+            *burst       = atouint32_metric(burst_str, "rate burst: ");
+        }
+        char *per = strchr(val, '/');
+        if (per)
+            *per++ = '\0';
+        rate = atof(val);
+        if (per)
+            rate /= atoi_time(per, "rate: ");
+        if (rate <= 0.0) {
+            fprintf(stderr, "Invalid rate \"%s\"\n", val);
+            exit(1);
+        }
+    }
+    if (cut_output_option(param, "backlog", val, sizeof(val))) {
+        *backlog = atouint32_metric(val, "backlog: ");
+        if (rate <= 0.0) {
+            fprintf(stderr, "The backlog option needs a rate option\n");
+            exit(1);
+        }
+    }
+    return rate;
+}
+
+void add_aggregate_output(r_cfg_t *cfg, int window_secs)
+{
+    if (!cfg->output_handler.len || !cfg->output_handler.elems[cfg->output_handler.len - 1]) {
+        return; // nothing to wrap, e.g. a null output
+    }
+    data_output_t *output = data_output_aggregate_create(cfg->output_handler.elems[cfg->output_handler.len - 1], window_secs);
+    cfg->output_handler.elems[cfg->output_handler.len - 1] = output;
+    list_push(&cfg->aggregate_outputs, output);
+    print_logf(LOG_NOTICE, "Aggregate", "Aggregating device events over %d seconds", window_secs);
+}
+
+void add_sched_output(r_cfg_t *cfg, char const *name, double rate, unsigned burst, unsigned backlog)
+{
+    if (!cfg->output_handler.len || !cfg->output_handler.elems[cfg->output_handler.len - 1]) {
+        return; // nothing to wrap, e.g. a null output
+    }
+    data_output_t *output = data_output_sched_create(cfg->output_handler.elems[cfg->output_handler.len - 1], name, rate, burst, backlog, &cfg->sched_rules);
+    cfg->output_handler.elems[cfg->output_handler.len - 1] = output;
+    list_push(&cfg->sched_outputs, output);
+    print_logf(LOG_NOTICE, "Rate limit", "Limiting %s output to %.3f events per second", name, rate);
+}
+
+void add_sched_rules(r_cfg_t *cfg, char const *spec)
+{
+    if (sched_rules_add(&cfg->sched_rules, spec) <= 0) {
+        fprintf(stderr, "Invalid priority \"%s\", use <class>=<model>[,<model>...] with class alarm, high, normal, or low\n", spec);
+        exit(1);
+    }
+}
+
+void poll_sched_outputs(r_cfg_t *cfg)
+{
+    for (void **iter = cfg->sched_outputs.elems; iter && *iter; ++iter) {
+        data_output_sched_poll(*iter);
+    }
+}
+
+static void pulse_cluster_handler(void *ctx, data_t *data)
+{
+    event_occurred_handler(ctx, data);
+}
+
+void add_pulse_cluster(r_cfg_t *cfg, int interval_secs)
+{
+    pulse_cluster_free(cfg->pulse_cluster);
+    cfg->pulse_cluster = NULL;
+    if (interval_secs <= 0) {
+        return;
+    }
+    cfg->pulse_cluster = pulse_cluster_create(interval_secs);
+    if (!cfg->pulse_cluster) {
+        FATAL("pulse_cluster_create()");
+    }
+    print_logf(LOG_NOTICE, "Cluster", "Clustering undecoded signals, reporting every %d seconds", interval_secs);
+}
+
+void poll_pulse_cluster(r_cfg_t *cfg, time_t now)
+{
+    if (cfg->pulse_cluster) {
+        pulse_cluster_poll(cfg->pulse_cluster, now, pulse_cluster_handler, cfg);
+    }
+}
+
+/// Merged events carry the earliest time of the receivers, don't add the local time.
+/// Units are converted here, receivers might not use the same conversion mode.
+static void rx_merge_handler(void *ctx, data_t *data)
+{
+    r_cfg_t *cfg = ctx;
+    convert_units(cfg, data);
+    for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
+        data_output_t *output = cfg->output_handler.elems[i];
+        data_output_print(output, data);
+    }
+    data_free(data);
+}
+
+void add_rx_merge(r_cfg_t *cfg, char *param)
+{
+    char const *host = "0.0.0.0";
+    char const *port = "514";
+    char *opts       = hostport_param(param, &host, &port);
+    int window_ms    = 1000;
+    int threads      = 1;
+
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "window"))
+            window_ms = atoiv(val, 1000);
+        else if (!strcasecmp(key, "threads"))
+            threads = atoiv(val, 1);
+        else {
+            print_logf(LOG_FATAL, "Merge", "Invalid key \"%s\" option.", key);
+            exit(1);
+        }
+    }
+    if (window_ms < 1) {
+        print_logf(LOG_FATAL, "Merge", "Invalid window %d ms.", window_ms);
+        exit(1);
+    }
+
+    rx_merge_free(cfg->rx_merge);
+    cfg->rx_merge = rx_merge_create(window_ms);
+    if (!cfg->rx_merge) {
+        FATAL("rx_merge_create()");
+    }
+    if (rx_merge_listen(cfg->rx_merge, host, port, threads) < 0) {
+        exit(1);
+    }
+    print_logf(LOG_CRITICAL, "Merge", "Merging events received at %s port %s over %d ms (%d threads)", host, port, window_ms, threads);
+}
+
+void poll_rx_merge(r_cfg_t *cfg, uint64_t now_ms)
+{
+    if (cfg->rx_merge) {
+        rx_merge_poll(cfg->rx_merge, now_ms, rx_merge_handler, cfg);
+    }
+}
+
 void add_sr_dumper(r_cfg_t *cfg, char const *spec, int overwrite)
 {
     // create channels
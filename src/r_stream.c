@@ -0,0 +1,314 @@
+/** @file
+    Embeddable streaming decoder API for rtl_433.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "r_stream.h"
+
+#include "rtl_433.h"
+#include "r_private.h"
+#include "r_api.h"
+#include "r_device.h"
+#include "baseband.h"
+#include "pulse_detect.h"
+#include "pulse_data.h"
+#include "data.h"
+#include "list.h"
+#include "logger.h"
+#include "fatal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+r_device *flex_try_create_device(char *spec); // maybe put this in some header file?
+
+/// Samples per processing chunk, the demod buffers hold MAXIMAL_BUF_LENGTH samples.
+#define R_STREAM_CHUNK (DEFAULT_BUF_LENGTH / 2)
+
+struct r_stream {
+    r_cfg_t *cfg;
+    r_stream_event_fn callback;
+    void *callback_ctx;
+    list_t queue;       ///< queued r_stream_event_t, oldest first
+    size_t queue_head;  ///< index of the next event to pull
+    uint64_t package_pos; ///< sample position of the package being decoded
+};
+
+/* capture output */
+
+typedef struct stream_output {
+    struct data_output output;
+    r_stream_t *stream;
+} stream_output_t;
+
+static void R_API_CALLCONV stream_output_print(data_output_t *output, data_t *data)
+{
+    stream_output_t *so = (stream_output_t *)output;
+    r_stream_t *stream  = so->stream;
+
+    r_stream_event_t event = {0};
+    event.sample_pos = stream->package_pos;
+    event.data       = data;
+    for (data_t *d = data; d; d = d->next) {
+        if (d->type == DATA_STRING && !strcmp(d->key, "model")) {
+            event.model = d->value.v_ptr;
+            break;
+        }
+    }
+
+    if (stream->callback) {
+        stream->callback(stream->callback_ctx, &event);
+        return;
+    }
+
+    r_stream_event_t *queued = malloc(sizeof(*queued));
+    if (!queued) {
+        WARN_MALLOC("stream_output_print()");
+        return; // NOTE: event dropped on alloc failure.
+    }
+    *queued = event;
+    queued->data = data_retain(data);
+    list_push(&stream->queue, queued);
+}
+
+static void R_API_CALLCONV stream_output_free(data_output_t *output)
+{
+    free(output);
+}
+
+static void free_event(r_stream_event_t *event)
+{
+    data_free(event->data);
+    free(event);
+}
+
+/* API */
+
+static void update_fm_demod(r_stream_t *stream)
+{
+    struct dm_state *demod = stream->cfg->demod;
+
+    demod->enable_FM_demod = 0;
+    for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        if (r_dev->modulation >= FSK_DEMOD_MIN_VAL) {
+            demod->enable_FM_demod = 1;
+            break;
+        }
+    }
+}
+
+r_stream_t *r_stream_create(uint32_t sample_rate, enum r_stream_format format)
+{
+    if (format != R_STREAM_CU8 && format != R_STREAM_CS16) {
+        print_logf(LOG_ERROR, __func__, "Invalid sample format %d", format);
+        return NULL;
+    }
+
+    r_stream_t *stream = calloc(1, sizeof(*stream));
+    if (!stream) {
+        WARN_CALLOC("r_stream_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    stream_output_t *so = calloc(1, sizeof(*so));
+    if (!so) {
+        WARN_CALLOC("r_stream_create()");
+        free(stream);
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+
+    r_cfg_t *cfg = r_create_cfg();
+    stream->cfg  = cfg;
+
+    cfg->samp_rate           = sample_rate;
+    cfg->report_time         = REPORT_TIME_OFF; // the host adds timestamps, see sample_pos
+    cfg->demod->sample_size  = format;
+    cfg->demod->min_level_auto = cfg->demod->min_level;
+
+    so->output.output_print = stream_output_print;
+    so->output.output_free  = stream_output_free;
+    so->output.log_level    = 0; // no decoder log messages
+    so->stream              = stream;
+    list_push(&cfg->output_handler, so);
+
+    register_all_protocols(cfg, 0);
+    update_fm_demod(stream);
+
+    return stream;
+}
+
+void r_stream_free(r_stream_t *stream)
+{
+    if (!stream)
+        return;
+
+    for (size_t i = stream->queue_head; i < stream->queue.len; ++i) {
+        free_event(stream->queue.elems[i]);
+    }
+    list_free_elems(&stream->queue, NULL);
+
+    r_free_cfg(stream->cfg);
+    free(stream->cfg);
+    free(stream);
+}
+
+int r_stream_protocol(r_stream_t *stream, int protocol_num, char *arg)
+{
+    r_cfg_t *cfg = stream->cfg;
+    int n        = protocol_num;
+
+    if (n > cfg->num_r_devices || -n > cfg->num_r_devices)
+        return -1;
+    if ((n > 0 && cfg->devices[n - 1].disabled > 2) || (n < 0 && cfg->devices[-n - 1].disabled > 2))
+        return -1;
+
+    if (n >= 1) {
+        unregister_protocol(cfg, &cfg->devices[n - 1]); // no duplicates
+        register_protocol(cfg, &cfg->devices[n - 1], arg);
+    }
+    else if (n <= -1) {
+        unregister_protocol(cfg, &cfg->devices[-n - 1]);
+    }
+    else {
+        list_clear(&cfg->demod->r_devs, (list_elem_free_fn)free_protocol);
+    }
+
+    update_fm_demod(stream);
+    return 0;
+}
+
+int r_stream_flex(r_stream_t *stream, char *spec)
+{
+    if (!spec || !*spec)
+        return -1;
+
+    r_device *flex_device = flex_try_create_device(spec);
+    if (!flex_device)
+        return -1;
+    register_protocol(stream->cfg, flex_device, "");
+    free(flex_device); // the registered copy owns the decode_ctx
+
+    update_fm_demod(stream);
+    return 0;
+}
+
+void r_stream_set_callback(r_stream_t *stream, r_stream_event_fn callback, void *ctx)
+{
+    stream->callback     = callback;
+    stream->callback_ctx = ctx;
+}
+
+static int stream_process(r_stream_t *stream, uint8_t const *iq_buf, unsigned long n_samples)
+{
+    r_cfg_t *cfg           = stream->cfg;
+    struct dm_state *demod = cfg->demod;
+
+    // AM demodulation
+    if (demod->sample_size == R_STREAM_CU8) {
+        if (demod->use_mag_est)
+            magnitude_est_cu8(iq_buf, demod->buf.temp, n_samples);
+        else
+            envelope_detect(iq_buf, demod->buf.temp, n_samples);
+    }
+    else {
+        magnitude_est_cs16((int16_t const *)iq_buf, demod->buf.temp, n_samples);
+    }
+    baseband_low_pass_filter(demod->buf.temp, demod->am_buf, n_samples, &demod->lowpass_filter_state);
+
+    // FM demodulation
+    unsigned fpdm = cfg->fsk_pulse_detect_mode;
+    if (cfg->fsk_pulse_detect_mode == FSK_PULSE_DETECT_AUTO) {
+        if (cfg->frequency[cfg->frequency_index] > FSK_PULSE_DETECTOR_LIMIT)
+            fpdm = FSK_PULSE_DETECT_NEW;
+        else
+            fpdm = FSK_PULSE_DETECT_OLD;
+    }
+    if (demod->enable_FM_demod) {
+        float low_pass = demod->low_pass != 0.0f ? demod->low_pass : fpdm ? 0.2f : 0.1f;
+        if (demod->sample_size == R_STREAM_CU8)
+            baseband_demod_FM(iq_buf, demod->buf.fm, n_samples, cfg->samp_rate, low_pass, &demod->demod_FM_state);
+        else
+            baseband_demod_FM_cs16((int16_t const *)iq_buf, demod->buf.fm, n_samples, cfg->samp_rate, low_pass, &demod->demod_FM_state);
+    }
+
+    // Detect a package and loop through demodulators with pulse data
+    int events       = 0;
+    int package_type = PULSE_DATA_OOK; // Just to get us started
+    while (package_type && demod->r_devs.len) {
+        package_type = pulse_detect_package(demod->pulse_detect, demod->am_buf, demod->buf.fm, n_samples, cfg->samp_rate, cfg->input_pos, &demod->pulse_data, &demod->fsk_pulse_data, fpdm);
+        if (package_type == PULSE_DATA_OOK) {
+            events += r_stream_push_pulses(stream, &demod->pulse_data, 0);
+        }
+        else if (package_type == PULSE_DATA_FSK) {
+            events += r_stream_push_pulses(stream, &demod->fsk_pulse_data, 1);
+        }
+    }
+
+    cfg->input_pos += n_samples;
+    return events;
+}
+
+int r_stream_push_iq(r_stream_t *stream, void const *iq_buf, uint32_t len)
+{
+    uint8_t const *buf   = iq_buf;
+    unsigned sample_size = stream->cfg->demod->sample_size;
+    unsigned long n_samples = len / sample_size;
+    int events = 0;
+
+    while (n_samples) {
+        unsigned long chunk = n_samples < R_STREAM_CHUNK ? n_samples : R_STREAM_CHUNK;
+        events += stream_process(stream, buf, chunk);
+        buf += chunk * sample_size;
+        n_samples -= chunk;
+    }
+    return events;
+}
+
+int r_stream_push_pulses(r_stream_t *stream, pulse_data_t *pulses, int fsk)
+{
+    r_cfg_t *cfg = stream->cfg;
+    int events;
+
+    stream->package_pos = pulses->offset;
+    calc_rssi_snr(cfg, pulses);
+    if (fsk) {
+        events = run_fsk_demods(&cfg->demod->r_devs, pulses, cfg->demod->slice_batch);
+        cfg->frames_fsk++;
+    }
+    else {
+        events = run_ook_demods(&cfg->demod->r_devs, pulses, cfg->demod->slice_batch);
+        cfg->frames_count++;
+    }
+    cfg->frames_events += events > 0;
+    return events;
+}
+
+int r_stream_pull(r_stream_t *stream, r_stream_event_t *event)
+{
+    if (stream->queue_head >= stream->queue.len) {
+        // reuse the queue storage once drained
+        list_clear(&stream->queue, NULL);
+        stream->queue_head = 0;
+        return 0;
+    }
+
+    r_stream_event_t *queued = stream->queue.elems[stream->queue_head++];
+    *event = *queued;
+    free(queued);
+    return 1;
+}
+
+void r_stream_event_release(r_stream_event_t *event)
+{
+    if (!event)
+        return;
+    data_free(event->data);
+    event->data  = NULL;
+    event->model = NULL;
+}
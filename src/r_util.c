@@ -82,7 +82,7 @@ char *usecs_time_str(char *buf, char const *format, int with_tz, struct timeval
     return buf;
 }
 
-char *sample_pos_str(float sample_file_pos, char *buf)
+char *sample_pos_str(double sample_file_pos, char *buf)
 {
     snprintf(buf, LOCAL_TIME_BUFLEN, "@%fs", sample_file_pos);
     return buf;
@@ -205,6 +205,33 @@ char *str_replace(char const *orig, char const *rep, char const *with)
     return result;
 }
 
+int str_replace_buf(char *dst, size_t size, char const *orig, char const *rep, char const *with)
+{
+    if (!orig || !rep || !*rep || !size)
+        return -1;
+    if (!with)
+        with = "";
+    size_t len_rep  = strlen(rep);
+    size_t len_with = strlen(with);
+
+    size_t len = 0;
+    char const *ins;
+    while ((ins = strstr(orig, rep))) {
+        size_t len_front = ins - orig;
+        if (len + len_front + len_with >= size)
+            return -1;
+        memcpy(dst + len, orig, len_front);
+        memcpy(dst + len + len_front, with, len_with);
+        len += len_front + len_with;
+        orig += len_front + len_rep;
+    }
+    size_t len_tail = strlen(orig);
+    if (len + len_tail >= size)
+        return -1;
+    memcpy(dst + len, orig, len_tail + 1);
+    return (int)(len + len_tail);
+}
+
 // Make a more readable string for a frequency.
 char const *nice_freq (double freq)
 {
@@ -12,6 +12,7 @@
 #include "raw_output.h"
 
 #include <stdint.h>
+#include <stddef.h>
 
 /* generic raw_output */
 
@@ -22,6 +23,13 @@ void raw_output_frame(struct raw_output *output, uint8_t const *data, uint32_t l
     output->output_frame(output, data, len);
 }
 
+struct data *raw_output_stats(struct raw_output *output)
+{
+    if (!output || !output->output_stats)
+        return NULL;
+    return output->output_stats(output);
+}
+
 void raw_output_free(struct raw_output *output)
 {
     if (!output)
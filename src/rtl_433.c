@@ -27,6 +27,8 @@
 #include <string.h>
 #include <errno.h>
 #include <signal.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include "rtl_433.h"
 #include "r_private.h"
@@ -34,6 +36,7 @@
 #include "r_api.h"
 #include "sdr.h"
 #include "baseband.h"
+#include "kernels.h"
 #include "pulse_analyzer.h"
 #include "pulse_detect.h"
 #include "pulse_detect_fsk.h"
@@ -41,6 +44,11 @@
 #include "rfraw.h"
 #include "data.h"
 #include "raw_output.h"
+#include "output_aggregate.h"
+#include "pulse_cluster.h"
+#include "spectrum.h"
+#include "checkpoint.h"
+#include "alloc_stats.h"
 #include "r_util.h"
 #include "optparse.h"
 #include "abuf.h"
@@ -151,6 +159,9 @@ static void usage(int exit_code)
             "  [-H <seconds>] Hop interval for polling of multiple frequencies (default: %i seconds)\n"
             "  [-p <ppm_error>] Correct rtl-sdr tuner frequency offset error (default: 0)\n"
             "  [-s <sample rate>] Set sample rate (default: %i Hz)\n"
+            "  [-b <size> | low | power] Set the input block size in bytes (default: 262144),\n"
+            "       use \"low\" for blocks of about 10 ms to reduce the event latency,\n"
+            "       use \"power\" to coalesce blocks of about 1 s and skip the demodulation of quiet blocks\n"
             "  [-D restart | pause | quit | manual] Input device run mode options.\n"
             "\t\t= Demodulator options =\n"
             "  [-R <device> | help] Enable only the specified device decoding protocol (can be used multiple times)\n"
@@ -166,26 +177,35 @@ static void usage(int exit_code)
             "\t\t= Analyze/Debug options =\n"
             "  [-A] Pulse Analyzer. Enable pulse analysis and decode attempt.\n"
             "       Disable all decoders with -R 0 if you want analyzer output only.\n"
+            "  [-u <time>] Cluster undecoded signals in the background. Reports a summary with\n"
+            "       counts, timings, and a suggested flex decoder per signal cluster every <time>.\n"
             "  [-y <code>] Verify decoding of demodulated test data (e.g. \"{25}fb2dd58\") with enabled devices\n"
+            "  [-k report | bench | <kernel>=<variant>] Report the kernel variants (and exit), select the fastest\n"
+            "       variants with a short benchmark, or force a variant (e.g. -k envelope_detect=generic)\n",
+            DEFAULT_FREQUENCY, DEFAULT_HOP_TIME, DEFAULT_SAMPLE_RATE);
+    term_help_printf(
             "\t\t= File I/O options =\n"
             "  [-S none | all | unknown | known] Signal auto save. Creates one file per signal.\n"
             "       Note: Saves raw I/Q samples (uint8 pcm, 2 channel). Preferred mode for generating test files.\n"
             "  [-r <filename> | help] Read data from input file instead of a receiver\n"
+            "  [-P <filename>[,resume][,interval=<seconds>]] Checkpoint reading input files (see -r help)\n"
+            "  [-J [<host>][:<port>][,window=<ms>][,threads=<n>]] Merge the events of receivers sending \"-F syslog\" or JSON lines, instead of an SDR\n"
             "  [-w <filename> | help] Save data stream to output file (a '-' dumps samples to stdout)\n"
             "  [-W <filename> | help] Save data stream to output file, overwrite existing file\n"
             "\t\t= Data output options =\n"
             "  [-F log | kv | json | csv | mqtt | influx | syslog | trigger | null | help] Produce decoded output in given format.\n"
             "       Append output to file with :<filename> (e.g. -F csv:log.csv), defaults to stdout.\n"
             "       Specify host/port for syslog with e.g. -F syslog:127.0.0.1:1514\n"
-            "  [-M time[:<options>] | protocol | level | noise[:<secs>] | stats | bits | help] Add various meta data to each output.\n"
+            "  [-M time[:<options>] | protocol | level | latency | noise[:<secs>] | spectrum[:<ms>] | stats | bits | help] Add various meta data to each output.\n"
             "  [-K FILE | PATH | <tag> | <key>=<tag>] Add an expanded token or fixed tag to every output line.\n"
             "  [-C native | si | customary] Convert units in decoded output.\n"
+            "  [-Q <class>=<model>[,<model>...]] Priority class alarm, high, normal, or low of models\n"
+            "       for outputs with a rate limit (see -F help), e.g. -Q \"alarm=Secplus-v2,Honeywell-*\"\n"
             "  [-n <value>] Specify number of samples to take (each sample is an I/Q pair)\n"
             "  [-T <seconds>] Specify number of seconds to run, also 12:34 or 1h23m45s\n"
             "  [-E hop | quit] Hop/Quit after outputting successful event(s)\n"
             "  [-h] Output this usage help and exit\n"
-            "       Use -d, -g, -R, -X, -F, -M, -r, -w, or -W without argument for more help\n\n",
-            DEFAULT_FREQUENCY, DEFAULT_HOP_TIME, DEFAULT_SAMPLE_RATE);
+            "       Use -d, -g, -R, -X, -F, -M, -r, -w, or -W without argument for more help\n\n");
     exit(exit_code);
 }
 
@@ -282,7 +302,20 @@ static void help_output(void)
             "\tSpecify InfluxDB 2.0 server with e.g. -F \"influx://localhost:9999/api/v2/write?org=<org>&bucket=<bucket>,token=<authtoken>\"\n"
             "\tSpecify InfluxDB 1.x server with e.g. -F \"influx://localhost:8086/write?db=<db>&p=<password>&u=<user>\"\n"
             "\t  Additional parameter -M time:unix:usec:utc for correct timestamps in InfluxDB recommended\n"
-            "\tSpecify host/port for syslog with e.g. -F syslog:127.0.0.1:1514\n");
+            "\tSpecify host/port for syslog with e.g. -F syslog:127.0.0.1:1514\n"
+            "\tServe raw I/Q data to rtl_tcp clients with e.g. -F rtl_tcp:127.0.0.1:1234\n"
+            "\t  rtl_tcp options are: control, decimate=<n>, bits=8|4|2, compress (defaults for new clients)\n"
+            "\t  Clients get a decimated stream by requesting an integer fraction of the sample rate\n"
+            "\tServe the HTTP API with e.g. -F http:0.0.0.0:8433\n"
+            "\t  HTTP options are: history=<file>, history_size=<bytes> (default 64M) to keep events on disk\n"
+            "\t  and answer queries like /events?since=<unix time>&model=<model>&limit=<n>\n"
+            "\t  iq_size=<bytes> to keep IQ samples in memory for /iq?seconds=<n>&end=<unix time>&format=cs8\n"
+            "\tAdd \",aggregate=<time>\" to any output to only emit one summary per device and time window\n"
+            "\t  with count, min, max, average, and last value of numeric fields, e.g. -F \"mqtt://host:1883,aggregate=1m\"\n"
+            "\tAdd \",rate=<events/s>[:<burst>]\" (or \"rate=<events>/<time>\") to any output to limit the events sent,\n"
+            "\t  others are queued by priority class (see -Q), with \",backlog=<n>\" (default 100) queued at most.\n"
+            "\t  When the backlog is full the oldest event of the lowest class is dropped,\n"
+            "\t  e.g. -F \"influx://host:8086/write?db=rtl433,rate=2:10\" -Q alarm=Secplus-v2 -Q \"low=Acurite-*\"\n");
     exit(0);
 }
 
@@ -312,7 +345,7 @@ static void help_meta(void)
 {
     term_help_printf(
             "\t\t= Meta information option =\n"
-            "  [-M time[:<options>]|protocol|level|noise[:<secs>]|stats|bits] Add various metadata to every output line.\n"
+            "  [-M time[:<options>]|protocol|level|latency|noise[:<secs>]|spectrum[:<ms>]|stats|bits] Add various metadata to every output line.\n"
             "\tUse \"time\" to add current date and time meta data (preset for live inputs).\n"
             "\tUse \"time:rel\" to add sample position meta data (preset for read-file and stdin).\n"
             "\tUse \"time:unix\" to show the seconds since unix epoch as time meta data. This is always UTC.\n"
@@ -326,7 +359,9 @@ static void help_meta(void)
             "\tUse \"replay[:N]\" to replay file inputs at (N-times) realtime.\n"
             "\tUse \"protocol\" / \"noprotocol\" to output the decoder protocol number meta data.\n"
             "\tUse \"level\" to add Modulation, Frequency, RSSI, SNR, and Noise meta data.\n"
+            "\tUse \"latency\" to add the time from the end of the package on air to the output.\n"
             "\tUse \"noise[:<secs>]\" to report estimated noise level at intervals (default: 10 seconds).\n"
+            "\tUse \"spectrum[:<ms>]\" to compute a power spectrum at intervals (default: 100 ms), see the stats and the HTTP API.\n"
             "\tUse \"stats[:[<level>][:<interval>]]\" to report statistics (default: 600 seconds).\n"
             "\t  level 0: no report, 1: report successful devices, 2: report active devices, 3: report all\n"
             "\tUse \"bits\" to add bit representation to code outputs (for debug).\n");
@@ -351,7 +386,21 @@ static void help_read(void)
             "\tE.g. default detection by extension: path/filename.am.s16\n"
             "\tforced overrides: am:s16:path/filename.ext\n\n"
             "\tReading from pipes also support format options.\n"
-            "\tE.g reading complex 32-bit float: CU32:-\n");
+            "\tE.g reading complex 32-bit float: CU32:-\n\n"
+            "\tA range can be appended to read only part of a file, separated by colon (':')\n"
+            "\twith the keys 'start=', 'end=', 'preroll=', and 't0=' separated by commas.\n"
+            "\tPositions are sample offsets, time offsets from the file start (e.g. '1h30m'),\n"
+            "\tor wall times as '@<unix seconds>' or local 'YYYY-MM-DDTHH:MM[:SS]'.\n"
+            "\tThe file start time 't0=' defaults to the file modification time less the duration.\n"
+            "\tDecoding warms up over a 'preroll=' (default 1s) before the start.\n"
+            "\tE.g. path/filename.cu8:start=1h30m,end=1h35m\n"
+            "\tor path/filename.cu8:start=2023-10-17T03:12,end=2023-10-17T03:15\n\n"
+            "  [-P <filename>[,resume][,interval=<seconds>]] Checkpoint the progress of reading input files\n"
+            "\tThe position, detector levels, and decoder statistics are saved every\n"
+            "\t'interval=' seconds (default 10) and after each file, between packages only.\n"
+            "\tWith 'resume' a later run with the same input files continues after the\n"
+            "\tcheckpoint without duplicate events.\n"
+            "\tE.g. -P batch.ckpt,resume -r a.cu8 -r b.cu8\n");
     exit(0);
 }
 
@@ -382,6 +431,9 @@ static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
     char time_str[LOCAL_TIME_BUFLEN];
     unsigned long n_samples;
 
+    // a quiescent point, decoders swapped out by a reconfiguration are no longer in use
+    reclaim_protocols(cfg);
+
     // do this here and not in sdr_handler so realtime replay can use rtl_tcp output
     for (void **iter = cfg->raw_handler.elems; iter && *iter; ++iter) {
         raw_output_t *output = *iter;
@@ -395,7 +447,15 @@ static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
 
     // save last frame time to see if a new second started
     time_t last_frame_sec = demod->now.tv_sec;
-    get_time_now(&demod->now);
+    if (demod->file_t0 > 0.0) {
+        // time of the buffer end in the input file
+        double file_time = demod->file_t0 + demod->sample_file_pos;
+        demod->now.tv_sec  = (time_t)file_time;
+        demod->now.tv_usec = (int)((file_time - (double)demod->now.tv_sec) * 1e6);
+    }
+    else {
+        get_time_now(&demod->now);
+    }
 
     n_samples = len / demod->sample_size;
     if (n_samples * demod->sample_size != len) {
@@ -406,6 +466,8 @@ static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
         return; // keep the watchdog timer running
     }
 
+    alloc_scope_t alloc_scope = alloc_stats_enter(ALLOC_STAGE_DEMOD, NULL);
+
     // age the frame position if there is one
     if (demod->frame_start_ago)
         demod->frame_start_ago += n_samples;
@@ -418,9 +480,32 @@ static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
         samp_grab_push(demod->samp_grab, iq_buf, len);
     }
 
-    // AM demodulation
+    if (cfg->spectrum) {
+        spectrum_push(cfg->spectrum, iq_buf, n_samples, demod->sample_size, cfg->center_frequency, cfg->samp_rate, &demod->now);
+    }
+
+    // always process frames if loader, dumper, or analyzers are in use, otherwise silent frames can be skipped
+    int always_process = demod->load_info.format || demod->analyze_pulses || cfg->pulse_cluster || demod->dumper.len || cfg->grab_mode;
+
+    // Low-power mode: a cheap level estimate first, skip the demodulation if no window is above the noise
     float avg_db;
-    if (demod->sample_size == 2) { // CU8
+    float est_db  = 0.0f;
+    int estimated = cfg->low_power && !always_process;
+    int quiet     = 0;
+    if (estimated) {
+        float peak_db;
+        if (demod->sample_size == 2) // CU8
+            est_db = level_estimate_cu8(iq_buf, n_samples, LOW_POWER_LEVEL_STEP, LOW_POWER_LEVEL_WINDOW, demod->use_mag_est, &peak_db);
+        else // CS16
+            est_db = level_estimate_cs16((int16_t *)iq_buf, n_samples, LOW_POWER_LEVEL_STEP, LOW_POWER_LEVEL_WINDOW, &peak_db);
+        quiet = demod->noise_level != 0.0f && peak_db < demod->noise_level + 3.0f;
+        cfg->frames_quiet += quiet;
+    }
+
+    // AM demodulation
+    if (quiet) {
+        // skip, the level is estimated
+    } else if (demod->sample_size == 2) { // CU8
         if (demod->use_mag_est) {
             //magnitude_true_cu8(iq_buf, demod->buf.temp, n_samples);
             avg_db = magnitude_est_cu8(iq_buf, demod->buf.temp, n_samples);
@@ -432,6 +517,9 @@ static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
         //magnitude_true_cs16((int16_t *)iq_buf, demod->buf.temp, n_samples);
         avg_db = magnitude_est_cs16((int16_t *)iq_buf, demod->buf.temp, n_samples);
     }
+    if (estimated) {
+        avg_db = est_db; // the sum of the demodulator can overflow on coalesced blocks
+    }
 
     //fprintf(stderr, "noise level: %.1f dB current: %.1f dB min level: %.1f dB\n", demod->noise_level, avg_db, demod->min_level_auto);
     if (demod->min_level_auto == 0.0f) {
@@ -441,8 +529,8 @@ static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
         demod->noise_level = demod->min_level_auto - 3.0f;
     }
     int noise_only = avg_db < demod->noise_level + 3.0f; // or demod->min_level_auto?
-    // always process frames if loader, dumper, or analyzers are in use, otherwise skip silent frames
-    int process_frame = demod->squelch_offset <= 0 || !noise_only || demod->load_info.format || demod->analyze_pulses || demod->dumper.len || demod->samp_grab;
+    // in low-power mode only skip quiet frames, the average of a long frame hides short signals
+    int process_frame = always_process || (cfg->low_power ? !quiet : demod->squelch_offset <= 0 || !noise_only);
     if (noise_only) {
         demod->noise_level = (demod->noise_level * 7 + avg_db) / 8; // fast fall over 8 frames
         // If auto_level and noise level well below min_level and significant change in noise level
@@ -456,6 +544,15 @@ static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
     } else {
         demod->noise_level = (demod->noise_level * 31 + avg_db) / 32; // slow rise over 32 frames
     }
+    // Close expired aggregation windows, but only for the first frame that second
+    if (last_frame_sec != demod->now.tv_sec) {
+        for (void **iter = cfg->aggregate_outputs.elems; iter && *iter; ++iter) {
+            data_output_aggregate_poll(*iter, demod->now.tv_sec);
+        }
+        poll_pulse_cluster(cfg, demod->now.tv_sec);
+    }
+    // Send queued events of rate-limited outputs as the rate allows
+    poll_sched_outputs(cfg);
     // Report noise every report_noise seconds, but only for the first frame that second
     if (cfg->report_noise && last_frame_sec != demod->now.tv_sec && demod->now.tv_sec % cfg->report_noise == 0) {
         print_logf(LOG_WARNING, "Auto Level", "Current %s level %.1f dB, estimated noise %.1f dB",
@@ -497,9 +594,11 @@ static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
     }
 
     int d_events = 0; // Sensor events successfully detected
-    if (demod->r_devs.len || demod->analyze_pulses || demod->dumper.len || demod->samp_grab) {
+    if (demod->r_devs.len || demod->analyze_pulses || cfg->pulse_cluster || demod->dumper.len || cfg->grab_mode) {
         // Detect a package and loop through demodulators with pulse data
         int package_type = PULSE_DATA_OOK;  // Just to get us started
+        // input faster than real time waits for the clusterer instead of dropping
+        int cluster_wait = cfg->in_filename && !cfg->in_replay;
         for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
             file_info_t const *dumper = *iter;
             if (dumper->format == U8_LOGIC) {
@@ -510,6 +609,11 @@ static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
         while (package_type && process_frame) {
             int p_events = 0; // Sensor events successfully detected per package
             package_type = pulse_detect_package(demod->pulse_detect, demod->am_buf, demod->buf.fm, n_samples, cfg->samp_rate, cfg->input_pos, &demod->pulse_data, &demod->fsk_pulse_data, fpdm);
+            if (package_type && demod->preroll_pos > 0.0) {
+                pulse_data_t const *package = package_type == PULSE_DATA_FSK ? &demod->fsk_pulse_data : &demod->pulse_data;
+                if (demod->sample_file_pos - (double)package->end_ago / cfg->samp_rate < demod->preroll_pos)
+                    continue; // package ended in the pre-roll, skip
+            }
             if (package_type) {
                 // new package: set a first frame start if we are not tracking one already
                 if (!demod->frame_start_ago)
@@ -521,7 +625,7 @@ static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
                 calc_rssi_snr(cfg, &demod->pulse_data);
                 if (demod->analyze_pulses) fprintf(stderr, "Detected OOK package\t%s\n", time_pos_str(cfg, demod->pulse_data.start_ago, time_str));
 
-                p_events += run_ook_demods(&demod->r_devs, &demod->pulse_data);
+                p_events += run_ook_demods(&demod->r_devs, &demod->pulse_data, demod->slice_batch);
                 cfg->frames_count++;
                 cfg->frames_events += p_events > 0;
 
@@ -533,10 +637,14 @@ static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
                 }
 
                 if (cfg->verbosity >= LOG_TRACE) pulse_data_print(&demod->pulse_data);
-                if (cfg->raw_mode == 1 || (cfg->raw_mode == 2 && p_events == 0) || (cfg->raw_mode == 3 && p_events > 0)) {
+                // unknown packages are summarized by the clusterer instead
+                if (cfg->raw_mode == 1 || (cfg->raw_mode == 2 && p_events == 0 && !cfg->pulse_cluster) || (cfg->raw_mode == 3 && p_events > 0)) {
                     data_t *data = pulse_data_print_data(&demod->pulse_data);
                     event_occurred_handler(cfg, data);
                 }
+                if (cfg->pulse_cluster && p_events == 0) {
+                    pulse_cluster_add(cfg->pulse_cluster, &demod->pulse_data, package_type, cluster_wait);
+                }
                 if (demod->analyze_pulses && (cfg->grab_mode <= 1 || (cfg->grab_mode == 2 && p_events == 0) || (cfg->grab_mode == 3 && p_events > 0)) ) {
                     pulse_analyzer(&demod->pulse_data, package_type);
                 }
@@ -545,7 +653,7 @@ static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
                 calc_rssi_snr(cfg, &demod->fsk_pulse_data);
                 if (demod->analyze_pulses) fprintf(stderr, "Detected FSK package\t%s\n", time_pos_str(cfg, demod->fsk_pulse_data.start_ago, time_str));
 
-                p_events += run_fsk_demods(&demod->r_devs, &demod->fsk_pulse_data);
+                p_events += run_fsk_demods(&demod->r_devs, &demod->fsk_pulse_data, demod->slice_batch);
                 cfg->frames_fsk++;
                 cfg->frames_events += p_events > 0;
 
@@ -557,10 +665,14 @@ static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
                 }
 
                 if (cfg->verbosity >= LOG_TRACE) pulse_data_print(&demod->fsk_pulse_data);
-                if (cfg->raw_mode == 1 || (cfg->raw_mode == 2 && p_events == 0) || (cfg->raw_mode == 3 && p_events > 0)) {
+                // unknown packages are summarized by the clusterer instead
+                if (cfg->raw_mode == 1 || (cfg->raw_mode == 2 && p_events == 0 && !cfg->pulse_cluster) || (cfg->raw_mode == 3 && p_events > 0)) {
                     data_t *data = pulse_data_print_data(&demod->fsk_pulse_data);
                     event_occurred_handler(cfg, data);
                 }
+                if (cfg->pulse_cluster && p_events == 0) {
+                    pulse_cluster_add(cfg->pulse_cluster, &demod->fsk_pulse_data, package_type, cluster_wait);
+                }
                 if (demod->analyze_pulses && (cfg->grab_mode <= 1 || (cfg->grab_mode == 2 && p_events == 0) || (cfg->grab_mode == 3 && p_events > 0))) {
                     pulse_analyzer(&demod->fsk_pulse_data, package_type);
                 }
@@ -642,12 +754,10 @@ static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
         }
         else if (dumper->format == CF32_IQ) {
             if (demod->sample_size == 2) {
-                for (unsigned long n = 0; n < n_samples * 2; ++n)
-                    ((float *)demod->buf.temp)[n] = (iq_buf[n] - 128) / 128.0f;
+                baseband_convert_cu8_cf32(iq_buf, (float *)demod->buf.temp, n_samples);
             }
             else if (demod->sample_size == 4) {
-                for (unsigned long n = 0; n < n_samples * 2; ++n)
-                    ((float *)demod->buf.temp)[n] = ((int16_t *)iq_buf)[n] / 32768.0f;
+                baseband_convert_cs16_cf32((int16_t *)iq_buf, (float *)demod->buf.temp, n_samples);
             }
             out_buf = (uint8_t *)demod->buf.temp; // this buffer is too small if out_block_size is large
             out_len = n_samples * 2 * sizeof(float);
@@ -661,14 +771,12 @@ static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
             out_len = n_samples * sizeof(int16_t);
         }
         else if (dumper->format == F32_AM) {
-            for (unsigned long n = 0; n < n_samples; ++n)
-                demod->f32_buf[n] = demod->am_buf[n] * (1.0f / 0x8000); // scale from Q0.15
+            baseband_convert_s16_f32(demod->am_buf, demod->f32_buf, n_samples);
             out_buf = (uint8_t *)demod->f32_buf;
             out_len = n_samples * sizeof(float);
         }
         else if (dumper->format == F32_FM) {
-            for (unsigned long n = 0; n < n_samples; ++n)
-                demod->f32_buf[n] = demod->buf.fm[n] * (1.0f / 0x8000); // scale from Q0.15
+            baseband_convert_s16_f32(demod->buf.fm, demod->f32_buf, n_samples);
             out_buf = (uint8_t *)demod->f32_buf;
             out_len = n_samples * sizeof(float);
         }
@@ -716,6 +824,8 @@ static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
         }
     }
 
+    alloc_stats_leave(alloc_scope);
+
     time_t rawtime;
     time(&rawtime);
     // choose hop_index as frequency_index, if there are too few hop_times use the last one
@@ -759,7 +869,45 @@ static int hasopt(int test, int argc, char *argv[], char const *optstring)
 
 static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg);
 
-#define OPTSTRING "hVvqD:c:x:z:p:a:AI:S:m:M:r:w:W:l:d:t:f:H:g:s:b:n:R:X:F:K:C:T:UGy:E:Y:"
+static void parse_kernels_option(char const *arg)
+{
+    char *opts = strdup(arg);
+    if (!opts)
+        FATAL_STRDUP("parse_kernels_option()");
+    char *p = opts;
+    for (char *key, *val; getkwargs(&p, &key, &val);) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "bench"))
+            kernels_bench(KERNELS_BENCH_SAMPLES);
+        else if (!strcasecmp(key, "report")) {
+            kernels_bench(KERNELS_BENCH_SAMPLES);
+            int mismatches = kernels_check(KERNELS_BENCH_SAMPLES);
+            kernels_report();
+            exit(mismatches ? 1 : 0);
+        }
+        else if (!val || !*val) {
+            fprintf(stderr, "Missing kernel variant: %s\n", key);
+            usage(1);
+        }
+        else {
+            int ret = kernels_force(key, val);
+            if (ret == -1)
+                fprintf(stderr, "Unknown kernel: %s\n", key);
+            else if (ret == -2)
+                fprintf(stderr, "Unknown variant %s of kernel %s\n", val, key);
+            else if (ret == -3)
+                fprintf(stderr, "Variant %s of kernel %s is not supported by this CPU\n", val, key);
+            if (ret)
+                exit(1);
+        }
+    }
+    free(opts);
+}
+
+#define OPTSTRING "hVvqD:c:x:z:p:a:AI:S:m:M:r:w:W:l:d:t:f:H:g:s:b:n:R:X:F:K:C:T:UGy:E:Y:u:P:J:k:Q:"
 
 // these should match the short options exactly
 static struct conf_keywords const conf_keywords[] = {
@@ -784,8 +932,12 @@ static struct conf_keywords const conf_keywords[] = {
         {"samples_to_read", 'n'},
         {"analyze", 'a'},
         {"analyze_pulses", 'A'},
+        {"cluster_unknown", 'u'},
         {"include_only", 'I'},
         {"read_file", 'r'},
+        {"checkpoint", 'P'},
+        {"merge_receivers", 'J'},
+        {"kernels", 'k'},
         {"write_file", 'w'},
         {"overwrite_file", 'W'},
         {"signal_grabber", 'S'},
@@ -795,6 +947,7 @@ static struct conf_keywords const conf_keywords[] = {
         {"output", 'F'},
         {"output_tag", 'K'},
         {"convert", 'C'},
+        {"output_priority", 'Q'},
         {"duration", 'T'},
         {"test_data", 'y'},
         {"stop_after_successful_events", 'E'},
@@ -852,6 +1005,9 @@ static void parse_conf_args(r_cfg_t *cfg, int argc, char *argv[])
 static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
 {
     int n;
+    double rate;
+    unsigned burst, backlog;
+    size_t outputs_len;
     r_device *flex_device;
 
     if (arg && (!strcmp(arg, "help") || !strcmp(arg, "?"))) {
@@ -947,7 +1103,14 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
         cfg->samp_rate = atouint32_metric(arg, "-s: ");
         break;
     case 'b':
-        cfg->out_block_size = atouint32_metric(arg, "-b: ");
+        cfg->low_latency = 0;
+        cfg->low_power   = 0;
+        if (arg && !strcasecmp(arg, "low"))
+            cfg->low_latency = 1;
+        else if (arg && !strcasecmp(arg, "power"))
+            cfg->low_power = 1;
+        else
+            cfg->out_block_size = atouint32_metric(arg, "-b: ");
         break;
     case 'l':
         n = 1000;
@@ -971,6 +1134,9 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
     case 'A':
         cfg->demod->analyze_pulses = atobv(arg, 1);
         break;
+    case 'u':
+        add_pulse_cluster(cfg, atoi_time(arg, "-u: "));
+        break;
     case 'I':
         fprintf(stderr, "include_only (-I) is deprecated. Use -S none|all|unknown|known\n");
         exit(1);
@@ -982,6 +1148,42 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
         add_infile(cfg, arg);
         // TODO: file_info_check_read()
         break;
+    case 'P':
+        if (!arg)
+            help_read();
+
+        free(cfg->checkpoint_file);
+        cfg->checkpoint_file = strdup(arg);
+        if (!cfg->checkpoint_file)
+            FATAL_STRDUP("parse_conf_option()");
+        cfg->checkpoint_resume   = 0;
+        cfg->checkpoint_interval = CHECKPOINT_DEFAULT_INTERVAL;
+        char *opts = strchr(cfg->checkpoint_file, ',');
+        if (opts)
+            *opts++ = '\0';
+        for (char *key, *val; getkwargs(&opts, &key, &val);) {
+            key = remove_ws(key);
+            val = trim_ws(val);
+            if (!key || !*key)
+                continue;
+            else if (!strcasecmp(key, "resume"))
+                cfg->checkpoint_resume = atobv(val, 1);
+            else if (!strcasecmp(key, "interval"))
+                cfg->checkpoint_interval = atoi_time(val, "-P interval: ");
+            else {
+                fprintf(stderr, "Unknown checkpoint option: %s\n", key);
+                usage(1);
+            }
+        }
+        break;
+    case 'J':
+        add_rx_merge(cfg, arg);
+        break;
+    case 'k':
+        if (!arg)
+            usage(1);
+        parse_kernels_option(arg);
+        break;
     case 'w':
         if (!arg)
             help_write();
@@ -1079,6 +1281,14 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
             cfg->report_meta = 1;
         else if (!strncasecmp(arg, "noise", 5))
             cfg->report_noise = atoiv(arg_param(arg), 10); // atoi_time_default()
+        else if (!strncasecmp(arg, "spectrum", 8)) {
+            spectrum_free(cfg->spectrum);
+            cfg->spectrum = spectrum_create(SPECTRUM_FFT_SIZE, SPECTRUM_BINS, atoiv(arg_param(arg), SPECTRUM_DEFAULT_INTERVAL_MS));
+            if (!cfg->spectrum)
+                FATAL_MALLOC("spectrum_create()");
+        }
+        else if (!strcasecmp(arg, "latency"))
+            cfg->report_latency = 1;
         else if (!strcasecmp(arg, "bits"))
             cfg->verbose_bits = 1;
         else if (!strcasecmp(arg, "description"))
@@ -1160,6 +1370,9 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
         if (!arg)
             help_output();
 
+        n = aggregate_param(arg);
+        rate = rate_param(arg, &burst, &backlog);
+        outputs_len = cfg->output_handler.len;
         if (strncmp(arg, "json", 4) == 0) {
             add_json_output(cfg, arg_param(arg));
         }
@@ -1199,6 +1412,27 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
             fprintf(stderr, "Invalid output format: %s\n", arg);
             usage(1);
         }
+        if ((n > 0 || rate > 0.0) && cfg->output_handler.len == outputs_len) {
+            // e.g. rtl_tcp is a raw output and doesn't receive events
+            fprintf(stderr, "The aggregate and rate options are not supported for this output: %s\n", arg);
+            exit(1);
+        }
+        // rate limit the summaries, not the events that go into the aggregation
+        if (rate > 0.0) {
+            // name the output by its kind, the rest may hold credentials
+            char name[16] = {0};
+            size_t name_len = strcspn(arg, ":,");
+            memcpy(name, arg, name_len < sizeof(name) ? name_len : sizeof(name) - 1);
+            add_sched_output(cfg, name, rate, burst, backlog);
+        }
+        if (n > 0) {
+            add_aggregate_output(cfg, n);
+        }
+        break;
+    case 'Q':
+        if (!arg)
+            help_output();
+        add_sched_rules(cfg, arg);
         break;
     case 'K':
         if (!arg)
@@ -1350,6 +1584,13 @@ static void sighandler(int signum)
 }
 #endif
 
+/// An SDR event with the time it was received in the acquire thread.
+typedef struct {
+    sdr_event_t ev;
+    struct timeval arrival;
+    unsigned blocks; ///< number of input blocks in the data event
+} acquire_event_t;
+
 static void sdr_handler(struct mg_connection *nc, int ev_type, void *ev_data)
 {
     //fprintf(stderr, "%s: %d, %d, %p, %p\n", __func__, nc->sock, ev_type, nc->user_data, ev_data);
@@ -1357,7 +1598,8 @@ static void sdr_handler(struct mg_connection *nc, int ev_type, void *ev_data)
     if (nc->sock != INVALID_SOCKET || ev_type != MG_EV_POLL)
         return;
     r_cfg_t *cfg     = nc->user_data;
-    sdr_event_t *ev = ev_data;
+    acquire_event_t *aev = ev_data;
+    sdr_event_t *ev = &aev->ev;
     //fprintf(stderr, "sdr_handler...\n");
 
     data_t *data = NULL;
@@ -1391,6 +1633,9 @@ static void sdr_handler(struct mg_connection *nc, int ev_type, void *ev_data)
     }
 
     if (ev->ev == SDR_EV_DATA) {
+        cfg->input_wakeups++;
+        cfg->input_blocks += aev->blocks;
+        cfg->demod->buf_arrival = aev->arrival;
         sdr_callback((unsigned char *)ev->buf, ev->len, cfg);
     }
 
@@ -1405,17 +1650,61 @@ static void sdr_handler(struct mg_connection *nc, int ev_type, void *ev_data)
 // note that this function is called in a different thread
 static void acquire_callback(sdr_event_t *ev, void *ctx)
 {
-    //struct timeval now;
-    //get_time_now(&now);
-    //fprintf(stderr, "%ld.%06ld acquire_callback...\n", (long)now.tv_sec, (long)now.tv_usec);
-
-    struct mg_mgr *mgr = ctx;
+    r_cfg_t *cfg = ctx;
+    acquire_event_t aev = {.ev = *ev, .blocks = 1};
+    get_time_now(&aev.arrival); // for the air-to-output latency
+    //fprintf(stderr, "%ld.%06ld acquire_callback...\n", (long)aev.arrival.tv_sec, (long)aev.arrival.tv_usec);
+
+    struct mg_mgr *mgr = cfg->mgr;
+
+    // low-power mode: collect input blocks, the broadcast waits until the block is processed
+    if (cfg->coalesce_buf && ev->ev == SDR_EV_DATA) {
+        if (cfg->coalesce_len + ev->len > cfg->coalesce_size) {
+            // a block that does not fit, pass on what we have first
+            aev.ev.buf = cfg->coalesce_buf;
+            aev.ev.len = cfg->coalesce_len;
+            aev.blocks = cfg->coalesce_blocks;
+            if (cfg->coalesce_len)
+                mg_broadcast(mgr, sdr_handler, (void *)&aev, sizeof(aev));
+            cfg->coalesce_len    = 0;
+            cfg->coalesce_blocks = 0;
+        }
+        if ((uint32_t)ev->len > cfg->coalesce_size) {
+            aev.ev     = *ev;
+            aev.blocks = 1;
+            mg_broadcast(mgr, sdr_handler, (void *)&aev, sizeof(aev));
+            return;
+        }
+        memcpy(&cfg->coalesce_buf[cfg->coalesce_len], ev->buf, ev->len);
+        cfg->coalesce_len += ev->len;
+        cfg->coalesce_blocks++;
+        if (cfg->coalesce_len < cfg->coalesce_target)
+            return; // wait for more blocks
+        aev.ev.buf = cfg->coalesce_buf;
+        aev.ev.len = cfg->coalesce_len;
+        aev.blocks = cfg->coalesce_blocks;
+        mg_broadcast(mgr, sdr_handler, (void *)&aev, sizeof(aev));
+        cfg->coalesce_len    = 0;
+        cfg->coalesce_blocks = 0;
+        return;
+    }
+    if (cfg->coalesce_buf && cfg->coalesce_len) {
+        // pass on the collected blocks first, e.g. the samples before a frequency change
+        acquire_event_t data_aev = aev;
+        data_aev.ev.ev  = SDR_EV_DATA;
+        data_aev.ev.buf = cfg->coalesce_buf;
+        data_aev.ev.len = cfg->coalesce_len;
+        data_aev.blocks = cfg->coalesce_blocks;
+        mg_broadcast(mgr, sdr_handler, (void *)&data_aev, sizeof(data_aev));
+        cfg->coalesce_len    = 0;
+        cfg->coalesce_blocks = 0;
+    }
 
     // TODO: We should run the demod here to unblock the event loop
 
     // thread-safe dispatch, ev_data is the iq buffer pointer and length
     //fprintf(stderr, "acquire_callback bc send...\n");
-    mg_broadcast(mgr, sdr_handler, (void *)ev, sizeof(*ev));
+    mg_broadcast(mgr, sdr_handler, (void *)&aev, sizeof(aev));
     //fprintf(stderr, "acquire_callback bc done...\n");
 }
 
@@ -1458,8 +1747,25 @@ static int start_sdr(r_cfg_t *cfg)
 
     r = sdr_set_center_freq(cfg->dev, cfg->center_frequency, 1); // always verbose
 
-    r = sdr_start(cfg->dev, acquire_callback, (void *)get_mgr(cfg),
-            DEFAULT_ASYNC_BUF_NUMBER, cfg->out_block_size);
+    if (cfg->low_power) {
+        // about LOW_POWER_BUF_MS of samples, the buffer is limited by the demod and format conversion buffers
+        free(cfg->coalesce_buf);
+        uint32_t sample_size = cfg->demod->sample_size;
+        cfg->coalesce_size   = MAXIMAL_BUF_LENGTH / 4 * sample_size;
+        cfg->coalesce_target = (uint32_t)((uint64_t)cfg->samp_rate * sample_size * LOW_POWER_BUF_MS / 1000);
+        if (cfg->coalesce_target > cfg->coalesce_size)
+            cfg->coalesce_target = cfg->coalesce_size;
+        cfg->coalesce_len    = 0;
+        cfg->coalesce_blocks = 0;
+        cfg->coalesce_buf    = malloc(cfg->coalesce_size);
+        if (!cfg->coalesce_buf)
+            FATAL_MALLOC("start_sdr()");
+        print_logf(LOG_NOTICE, "Input", "Low power mode, coalescing input blocks to %u bytes", cfg->coalesce_target);
+    }
+
+    get_mgr(cfg); // the acquire thread uses the event loop
+    r = sdr_start(cfg->dev, acquire_callback, (void *)cfg,
+            cfg->low_latency ? LOW_LATENCY_ASYNC_BUF_NUMBER : DEFAULT_ASYNC_BUF_NUMBER, cfg->out_block_size);
     if (r < 0) {
         print_logf(LOG_ERROR, "Input", "async start failed (%i).", r);
     }
@@ -1476,9 +1782,12 @@ static void timer_handler(struct mg_connection *nc, int ev, void *ev_data)
     case MG_EV_TIMER: {
         double now  = *(double *)ev_data;
         (void) now; // unused
-        double next = mg_time() + 1.5;
+        double next = mg_time() + (cfg->low_power ? LOW_POWER_POLL_MS / 1000.0 : 1.5);
         //fprintf(stderr, "timer event, current time: %.2lf, next timer: %.2lf\n", now, next);
-        mg_set_timer(nc, next); // Send us timer event again after 1.5 seconds
+        mg_set_timer(nc, next); // Send us timer event again after 1.5 seconds (or the low-power interval)
+
+        // Send queued events of rate-limited outputs, also without frames
+        poll_sched_outputs(cfg);
 
         // Did we acquire data frames in the last interval?
         if (cfg->watchdog != 0) {
@@ -1534,6 +1843,139 @@ static void timer_handler(struct mg_connection *nc, int ev, void *ev_data)
     }
 }
 
+/// Read range of an input file, resolved to sample offsets.
+typedef struct file_range {
+    uint64_t start;   ///< first sample to decode
+    uint64_t end;     ///< sample after the last one to decode, 0 to read to the end of file
+    uint64_t preroll; ///< samples before the start to settle the detector levels
+    double t0;        ///< wall time of the first sample in the file, 0 if unknown
+} file_range_t;
+
+/// Parse "@" followed by Unix seconds, or a local "YYYY-MM-DDTHH:MM[:SS]" wall time, returns 0 otherwise.
+static double parse_wall_time(char const *val)
+{
+    if (*val == '@') {
+        return strtod(val + 1, NULL);
+    }
+    struct tm tm = {0};
+    if (sscanf(val, "%d-%d-%dT%d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) < 5) {
+        return 0.0;
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_isdst = -1;
+    return (double)mktime(&tm);
+}
+
+/// Parse a file position: a plain sample offset, a time offset from the file start, or a wall time.
+static uint64_t parse_file_pos(char const *key, char const *val, double t0, uint32_t samp_rate)
+{
+    if (!val || !*val) {
+        print_logf(LOG_FATAL, "Input", "Missing value for range option \"%s\".", key);
+        exit(1);
+    }
+
+    // plain sample offset
+    if (strspn(val, "0123456789") == strlen(val)) {
+        return strtoull(val, NULL, 10);
+    }
+
+    double wall = parse_wall_time(val);
+    if (wall <= 0.0) {
+        // time offset from the file start
+        int secs = atoi_time(val, "-r: ");
+        if (secs < 0) {
+            print_logf(LOG_FATAL, "Input", "Negative range option \"%s=%s\".", key, val);
+            exit(1);
+        }
+        return (uint64_t)secs * samp_rate;
+    }
+
+    if (t0 <= 0.0) {
+        print_logf(LOG_FATAL, "Input", "File start time unknown for range option \"%s=%s\", use \"t0=\".", key, val);
+        exit(1);
+    }
+    if (wall < t0) {
+        print_logf(LOG_FATAL, "Input", "Range option \"%s=%s\" is before the file start.", key, val);
+        exit(1);
+    }
+    return (uint64_t)((wall - t0) * samp_rate);
+}
+
+/// Parse range options "start=", "end=", "preroll=", and "t0=" for an input file.
+///
+/// Without "t0=" the file start is estimated from the modification time less the file duration.
+static void parse_file_range(file_range_t *range, char *opts, char const *path, unsigned file_sample_size, uint32_t samp_rate)
+{
+    *range = (file_range_t){0};
+    range->preroll = samp_rate; // default of 1 s warm-up
+
+    struct stat st;
+    if (path && strcmp(path, "-") != 0 && stat(path, &st) == 0 && file_sample_size && samp_rate) {
+        range->t0 = (double)st.st_mtime - (double)st.st_size / file_sample_size / samp_rate;
+    }
+
+    // the file start time is needed to resolve wall times, look it up first
+    char const *t0_val = NULL;
+    for (char const *p = opts; p && *p; p = kwargs_skip(p)) {
+        if (kwargs_match(p, "t0", &t0_val)) {
+            range->t0 = t0_val ? parse_wall_time(t0_val) : 0.0;
+            if (range->t0 <= 0.0) {
+                print_logf(LOG_FATAL, "Input", "Invalid file start time, use \"t0=@<seconds>\" or \"t0=YYYY-MM-DDTHH:MM[:SS]\".");
+                exit(1);
+            }
+        }
+    }
+
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "start"))
+            range->start = parse_file_pos(key, val, range->t0, samp_rate);
+        else if (!strcasecmp(key, "end"))
+            range->end = parse_file_pos(key, val, range->t0, samp_rate);
+        else if (!strcasecmp(key, "preroll"))
+            range->preroll = parse_file_pos(key, val, 0.0, samp_rate);
+        else if (!strcasecmp(key, "t0"))
+            continue; // already parsed
+        else {
+            print_logf(LOG_FATAL, "Input", "Invalid key \"%s\" option.", key);
+            exit(1);
+        }
+    }
+
+    if (range->end && range->end <= range->start) {
+        print_logf(LOG_FATAL, "Input", "Range end is not after the start.");
+        exit(1);
+    }
+    if (range->preroll > range->start) {
+        range->preroll = range->start;
+    }
+}
+
+/// Skip to the byte offset in the input file, seek if possible, read and discard otherwise.
+static int skip_file(FILE *file, uint64_t offset, unsigned char *buf, unsigned long buf_len)
+{
+#ifdef _WIN32
+    if (_fseeki64(file, (__int64)offset, SEEK_SET) == 0)
+        return 0;
+#else
+    if (fseeko(file, (off_t)offset, SEEK_SET) == 0)
+        return 0;
+#endif
+    // not seekable, e.g. a pipe
+    while (offset > 0) {
+        size_t n_read = fread(buf, 1, offset < buf_len ? offset : buf_len, file);
+        if (n_read == 0)
+            return -1;
+        offset -= n_read;
+    }
+    return 0;
+}
+
 int main(int argc, char **argv) {
     int r = 0;
     struct dm_state *demod;
@@ -1659,6 +2101,12 @@ int main(int argc, char **argv) {
     start_outputs(cfg, well_known);
     free((void *)well_known);
 
+    if (cfg->low_latency) {
+        // a few ms of CU8 samples, in multiples of 512 bytes for USB transfers
+        uint32_t block_size = cfg->samp_rate / (1000 / LOW_LATENCY_BUF_MS) * 2;
+        cfg->out_block_size = (block_size + 511) / 512 * 512;
+        print_logf(LOG_NOTICE, "Block Size", "Low latency mode, using %u byte blocks", cfg->out_block_size);
+    }
     if (cfg->out_block_size < MINIMAL_BUF_LENGTH ||
             cfg->out_block_size > MAXIMAL_BUF_LENGTH) {
         print_logf(LOG_ERROR, "Block Size",
@@ -1720,9 +2168,9 @@ int main(int argc, char **argv) {
                     list_t single_dev = {0};
                     list_push(&single_dev, r_dev);
                     if (!pulse_data.fsk_f2_est)
-                        r += run_ook_demods(&single_dev, &pulse_data);
+                        r += run_ook_demods(&single_dev, &pulse_data, demod->slice_batch);
                     else
-                        r += run_fsk_demods(&single_dev, &pulse_data);
+                        r += run_fsk_demods(&single_dev, &pulse_data, demod->slice_batch);
                     list_free_elems(&single_dev, NULL);
                 } else
                 r += pulse_slicer_string(e, r_dev);
@@ -1733,9 +2181,9 @@ int main(int argc, char **argv) {
                 pulse_data_t pulse_data = {0};
                 rfraw_parse(&pulse_data, line);
                 if (!pulse_data.fsk_f2_est)
-                    r += run_ook_demods(&demod->r_devs, &pulse_data);
+                    r += run_ook_demods(&demod->r_devs, &pulse_data, demod->slice_batch);
                 else
-                    r += run_fsk_demods(&demod->r_devs, &pulse_data);
+                    r += run_fsk_demods(&demod->r_devs, &pulse_data, demod->slice_batch);
             } else
             for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
                 r_device *r_dev = *iter;
@@ -1759,9 +2207,9 @@ int main(int argc, char **argv) {
             pulse_data_t pulse_data = {0};
             rfraw_parse(&pulse_data, cfg->test_data);
             if (!pulse_data.fsk_f2_est)
-                r += run_ook_demods(&demod->r_devs, &pulse_data);
+                r += run_ook_demods(&demod->r_devs, &pulse_data, demod->slice_batch);
             else
-                r += run_fsk_demods(&demod->r_devs, &pulse_data);
+                r += run_fsk_demods(&demod->r_devs, &pulse_data, demod->slice_batch);
         } else
         for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
             r_device *r_dev = *iter;
@@ -1787,8 +2235,23 @@ int main(int argc, char **argv) {
             cfg->stop_time += cfg->duration;
         }
 
+        // continue after the files and the position of a checkpoint
+        checkpoint_pos_t resume = {0};
+        if (cfg->checkpoint_file && cfg->checkpoint_resume) {
+            int loaded = checkpoint_load(cfg, cfg->checkpoint_file, &resume);
+            if (loaded < 0)
+                exit(1);
+            if (loaded == 0)
+                print_logf(LOG_NOTICE, "Input", "Resuming at file %u, sample %llu", resume.file_index + 1, (unsigned long long)resume.sample_pos);
+        }
+        time_t checkpoint_time = time(NULL) + cfg->checkpoint_interval;
+
         for (void **iter = cfg->in_files.elems; iter && *iter; ++iter) {
+            unsigned file_index = (unsigned)(iter - cfg->in_files.elems);
+            if (file_index < resume.file_index)
+                continue; // done by a previous run
             cfg->in_filename = *iter;
+            char *range_opts = file_info_split_range(*iter);
 
             file_info_clear(&demod->load_info); // reset all info
             file_info_parse_filename(&demod->load_info, cfg->in_filename);
@@ -1826,6 +2289,45 @@ int main(int argc, char **argv) {
                 print_logf(LOG_NOTICE, "Input", "Input format \"%s\"", file_info_string(&demod->load_info));
             }
             demod->sample_file_pos = 0.0;
+            demod->file_t0 = 0.0;
+            demod->preroll_pos = 0.0;
+
+            // seek to the pre-roll before the start of the requested range
+            unsigned file_sample_size = demod->load_info.format == CF32_IQ ? demod->sample_size * 2 : demod->sample_size;
+            uint64_t first = 0;
+            file_range_t range = {0};
+            if (range_opts) {
+                if (demod->load_info.format == PULSE_OOK) {
+                    print_logf(LOG_ERROR, "Input", "Range not supported on OOK input \"%s\"", cfg->in_filename);
+                    if (in_file != stdin)
+                        fclose(in_file = stdin);
+                    break;
+                }
+                parse_file_range(&range, range_opts, demod->load_info.path, file_sample_size, cfg->samp_rate);
+                first = range.start - range.preroll;
+                demod->preroll_pos = (double)range.start / cfg->samp_rate;
+                if (!cfg->in_replay)
+                    demod->file_t0 = range.t0;
+                if (cfg->verbosity >= LOG_NOTICE) {
+                    print_logf(LOG_NOTICE, "Input", "Reading samples %llu to %llu with a pre-roll of %llu samples",
+                            (unsigned long long)range.start, (unsigned long long)range.end, (unsigned long long)range.preroll);
+                }
+            }
+            // or seek to the checkpoint, the levels are restored
+            if (file_index == resume.file_index && resume.sample_pos) {
+                if (!resume.file || strcmp(resume.file, cfg->in_filename)) {
+                    print_logf(LOG_FATAL, "Input", "Checkpoint is for file \"%s\" but file %u is \"%s\"", resume.file ? resume.file : "", file_index + 1, cfg->in_filename);
+                    exit(1);
+                }
+                first = resume.sample_pos;
+            }
+            if (first) {
+                if (skip_file(in_file, first * file_sample_size, test_mode_buf, DEFAULT_BUF_LENGTH) != 0) {
+                    print_logf(LOG_ERROR, "Input", "Start position is beyond the end of file \"%s\"", cfg->in_filename);
+                    break;
+                }
+                demod->sample_file_pos = (double)first / cfg->samp_rate;
+            }
 
             // special case for pulse data file-inputs
             if (demod->load_info.format == PULSE_OOK) {
@@ -1847,18 +2349,26 @@ int main(int argc, char **argv) {
                     }
 
                     if (demod->pulse_data.fsk_f2_est) {
-                        run_fsk_demods(&demod->r_devs, &demod->pulse_data);
+                        run_fsk_demods(&demod->r_devs, &demod->pulse_data, demod->slice_batch);
                     }
                     else {
-                        int p_events = run_ook_demods(&demod->r_devs, &demod->pulse_data);
+                        int p_events = run_ook_demods(&demod->r_devs, &demod->pulse_data, demod->slice_batch);
                         if (cfg->verbosity >= LOG_DEBUG)
                             pulse_data_print(&demod->pulse_data);
+                        if (cfg->pulse_cluster && p_events == 0) {
+                            pulse_cluster_add(cfg->pulse_cluster, &demod->pulse_data, PULSE_DATA_OOK, cfg->in_filename && !cfg->in_replay);
+                        }
                         if (demod->analyze_pulses && (cfg->grab_mode <= 1 || (cfg->grab_mode == 2 && p_events == 0) || (cfg->grab_mode == 3 && p_events > 0))) {
                             pulse_analyzer(&demod->pulse_data, PULSE_DATA_OOK);
                         }
                     }
                 }
 
+                if (cfg->checkpoint_file && !cfg->exit_async) {
+                    checkpoint_pos_t pos = {file_index + 1, 0, NULL};
+                    checkpoint_save(cfg, cfg->checkpoint_file, &pos);
+                }
+
                 if (in_file != stdin)
                     fclose(in_file = stdin);
 
@@ -1867,6 +2377,9 @@ int main(int argc, char **argv) {
 
             // default case for file-inputs
             int n_blocks = 0;
+            uint64_t sample_pos = first; // sample position in the file
+            // realtime replay in low latency mode uses small blocks
+            unsigned long block_len = cfg->in_replay && cfg->low_latency && cfg->out_block_size < DEFAULT_BUF_LENGTH ? cfg->out_block_size : DEFAULT_BUF_LENGTH;
             unsigned long n_read;
             delay_timer_t delay_timer;
             delay_timer_init(&delay_timer);
@@ -1874,14 +2387,22 @@ int main(int argc, char **argv) {
                 // Replay in realtime if requested
                 if (cfg->in_replay) {
                     // per block delay
-                    unsigned delay_us = (unsigned)(1000000llu * DEFAULT_BUF_LENGTH / cfg->samp_rate / demod->sample_size / cfg->in_replay);
+                    unsigned delay_us = (unsigned)(1000000llu * block_len / cfg->samp_rate / demod->sample_size / cfg->in_replay);
                     if (demod->load_info.format == CF32_IQ)
                         delay_us /= 2; // adjust for float only reading half as many samples
                     delay_timer_wait(&delay_timer, delay_us);
                 }
+                // Stop at the end of the requested range
+                unsigned long read_len = block_len;
+                if (range.end) {
+                    if (sample_pos >= range.end)
+                        break;
+                    if ((range.end - sample_pos) * demod->sample_size < read_len)
+                        read_len = (unsigned long)(range.end - sample_pos) * demod->sample_size;
+                }
                 // Convert CF32 file to CS16 buffer
                 if (demod->load_info.format == CF32_IQ) {
-                    n_read = fread(test_mode_float_buf, sizeof(float), DEFAULT_BUF_LENGTH / 2, in_file);
+                    n_read = fread(test_mode_float_buf, sizeof(float), read_len / 2, in_file);
                     // clamp float to [-1,1] and scale to Q0.15
                     for (unsigned long n = 0; n < n_read; n++) {
                         int s_tmp = test_mode_float_buf[n] * INT16_MAX;
@@ -1893,7 +2414,7 @@ int main(int argc, char **argv) {
                     }
                     n_read *= 2; // convert to byte count
                 } else {
-                    n_read = fread(test_mode_buf, 1, DEFAULT_BUF_LENGTH, in_file);
+                    n_read = fread(test_mode_buf, 1, read_len, in_file);
 
                     // Convert CS8 file to CU8 buffer
                     if (demod->load_info.format == CS8_IQ) {
@@ -1903,11 +2424,26 @@ int main(int argc, char **argv) {
                     }
                 }
                 if (n_read == 0) break;  // sdr_callback() will Segmentation Fault with len=0
-                demod->sample_file_pos = ((float)n_blocks * DEFAULT_BUF_LENGTH + n_read) / cfg->samp_rate / demod->sample_size;
-                n_blocks++; // this assumes n_read == DEFAULT_BUF_LENGTH
+                sample_pos += n_read / demod->sample_size;
+                demod->sample_file_pos = (double)sample_pos / cfg->samp_rate;
+                n_blocks++;
+                unsigned frames_events = cfg->frames_events;
                 sdr_callback(test_mode_buf, n_read, cfg);
+                // checkpoint right after events and at intervals, retried while a package is in progress
+                if (cfg->checkpoint_file && (cfg->frames_events != frames_events || time(NULL) >= checkpoint_time)) {
+                    checkpoint_pos_t pos = {file_index, sample_pos, (char *)cfg->in_filename};
+                    if (checkpoint_save(cfg, cfg->checkpoint_file, &pos) <= 0)
+                        checkpoint_time = time(NULL) + cfg->checkpoint_interval;
+                }
             } while (n_read != 0 && !cfg->exit_async);
 
+            // an interrupted run continues at the last checkpoint, don't flush a partial package
+            if (cfg->checkpoint_file && cfg->exit_async) {
+                if (in_file != stdin)
+                    fclose(in_file = stdin);
+                break;
+            }
+
             // Call a last time with cleared samples to ensure EOP detection
             if (demod->sample_size == 2) { // CU8
                 memset(test_mode_buf, 128, DEFAULT_BUF_LENGTH); // 128 is 0 in unsigned data
@@ -1918,7 +2454,8 @@ int main(int argc, char **argv) {
             else { // CF32, CS16
                     memset(test_mode_buf, 0, DEFAULT_BUF_LENGTH);
             }
-            demod->sample_file_pos = ((float)n_blocks + 1) * DEFAULT_BUF_LENGTH / cfg->samp_rate / demod->sample_size;
+            sample_pos += DEFAULT_BUF_LENGTH / demod->sample_size;
+            demod->sample_file_pos = (double)sample_pos / cfg->samp_rate;
             sdr_callback(test_mode_buf, DEFAULT_BUF_LENGTH, cfg);
 
             //Always classify a signal at the end of the file
@@ -1928,9 +2465,16 @@ int main(int argc, char **argv) {
                 print_logf(LOG_NOTICE, "Input", "Test mode file issued %d packets", n_blocks);
             }
 
+            if (cfg->checkpoint_file) {
+                checkpoint_pos_t pos = {file_index + 1, 0, NULL};
+                checkpoint_save(cfg, cfg->checkpoint_file, &pos);
+                checkpoint_time = time(NULL) + cfg->checkpoint_interval;
+            }
+
             if (in_file != stdin)
                 fclose(in_file = stdin);
         }
+        checkpoint_pos_clear(&resume);
 
         close_dumpers(cfg);
         free(test_mode_buf);
@@ -1960,6 +2504,29 @@ int main(int argc, char **argv) {
     SetConsoleCtrlHandler((PHANDLER_ROUTINE)console_handler, TRUE);
 #endif
 
+    if (cfg->rx_merge) {
+        // no SDR, output the merged events of other receivers
+        if (cfg->duration > 0) {
+            time(&cfg->stop_time);
+            cfg->stop_time += cfg->duration;
+        }
+        while (!cfg->exit_async) {
+            mg_mgr_poll(get_mgr(cfg), 50);
+            struct timeval now;
+            get_time_now(&now);
+            poll_rx_merge(cfg, (uint64_t)now.tv_sec * 1000 + now.tv_usec / 1000);
+            for (void **iter = cfg->aggregate_outputs.elems; iter && *iter; ++iter) {
+                data_output_aggregate_poll(*iter, now.tv_sec);
+            }
+            poll_sched_outputs(cfg);
+            if (cfg->duration > 0 && now.tv_sec >= cfg->stop_time)
+                cfg->exit_async = 1;
+        }
+        r = cfg->exit_code;
+        r_free_cfg(cfg);
+        return r;
+    }
+
     // TODO: remove this before next release
     print_log(LOG_NOTICE, "Input", "The internals of input handling changed, read about and report problems on PR #1978");
 
@@ -1984,7 +2551,8 @@ int main(int argc, char **argv) {
     mg_set_timer(nc, mg_time() + 2.5);
 
     while (!cfg->exit_async) {
-        mg_mgr_poll(cfg->mgr, 500);
+        mg_mgr_poll(cfg->mgr, cfg->low_power ? LOW_POWER_POLL_MS : 500);
+        cfg->loop_wakeups++;
     }
     if (cfg->verbosity >= LOG_INFO)
         print_log(LOG_INFO, "rtl_433", "stopping...");
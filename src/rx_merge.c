@@ -0,0 +1,832 @@
+/** @file
+    Merge the events of multiple receivers.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+/*
+Each receiver sends its events, e.g. with "-F syslog:<host>:<port> -M level".
+The payload of an event is every field except the receiver specific ones
+(time, frequency, levels, latency). Copies with the same payload hash are
+collected from the first arrival for a time window, then one event is emitted.
+The group is kept for another window to drop late copies.
+
+The table is split in shards by the high bits of the hash, each shard is an
+open addressing table with linear probing and its own lock. Receiving threads
+parse and hash without a lock, then only hold the lock of one shard for the
+insert. Emitting is done by the main thread, which also removes old groups.
+*/
+
+#include "rx_merge.h"
+
+#include "jsmn.h"
+#include "data.h"
+#include "logger.h"
+#include "fatal.h"
+#include "r_util.h"
+#include "compat_time.h"
+#include "compat_pthread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+    #if !defined(_WIN32_WINNT) || (_WIN32_WINNT < 0x0600)
+    #undef _WIN32_WINNT
+    #define _WIN32_WINNT 0x0600   /* Needed to pull in 'struct sockaddr_storage' */
+    #endif
+
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#else
+    #include <sys/types.h>
+    #include <sys/socket.h>
+    #include <netdb.h>
+    #include <netinet/in.h>
+
+    #define SOCKET          int
+    #define INVALID_SOCKET  (-1)
+    #define closesocket(x)  close(x)
+#endif
+
+#ifdef ESP32
+    #include <tcpip_adapter.h>
+    #define gai_strerror strerror
+#endif
+
+#define MERGE_SHARDS        16  // power of two
+#define MERGE_SHARD_SLOTS   256 // power of two
+#define MERGE_SHARD_LOAD    (MERGE_SHARD_SLOTS * 3 / 4)
+#define MERGE_MAX_RECEIVERS 8
+#define MERGE_MAX_THREADS   16
+#define MERGE_MAX_TOKENS    256
+#define MERGE_MSG_MAX       4096
+#define MERGE_NAME_MAX      48
+#define MERGE_TIME_MAX      40
+
+enum merge_state {
+    GROUP_EMPTY,
+    GROUP_PENDING, ///< collecting copies
+    GROUP_DONE,    ///< emitted, dropping late copies
+};
+
+typedef struct merge_rx {
+    char name[MERGE_NAME_MAX];
+    char time[MERGE_TIME_MAX];
+    int has_level;
+    double rssi;
+    double snr;
+    unsigned copies; ///< copies from this receiver, e.g. repeated transmissions
+} merge_rx_t;
+
+typedef struct merge_group {
+    uint64_t hash;
+    int state;
+    uint64_t first_ms;
+    char *json; ///< the first copy, NULL once emitted
+    unsigned num_rx;
+    merge_rx_t rx[MERGE_MAX_RECEIVERS];
+} merge_group_t;
+
+typedef struct merge_shard {
+#ifdef THREADS
+    pthread_mutex_t lock;
+#endif
+    unsigned count;
+    unsigned received;
+    unsigned duplicates;
+    unsigned late;
+    unsigned dropped;
+    unsigned merged;
+    merge_group_t slots[MERGE_SHARD_SLOTS];
+} merge_shard_t;
+
+#ifdef THREADS
+typedef struct merge_listener {
+    struct rx_merge *m;
+    SOCKET sock;
+    pthread_t thread;
+} merge_listener_t;
+#endif
+
+struct rx_merge {
+    int window_ms;
+    volatile int stopping;
+    merge_shard_t shards[MERGE_SHARDS];
+#ifdef THREADS
+    int num_listeners;
+    merge_listener_t listeners[MERGE_MAX_THREADS];
+#endif
+};
+
+#ifdef THREADS
+#define SHARD_LOCK(s)   pthread_mutex_lock(&(s)->lock)
+#define SHARD_UNLOCK(s) pthread_mutex_unlock(&(s)->lock)
+#else
+#define SHARD_LOCK(s)   (void)(s)
+#define SHARD_UNLOCK(s) (void)(s)
+#endif
+
+/* JSON tokens */
+
+static int tok_eq(char const *json, jsmntok_t const *tok, char const *s)
+{
+    size_t len = tok->end - tok->start;
+    return tok->type == JSMN_STRING && strlen(s) == len && !strncmp(json + tok->start, s, len);
+}
+
+static void tok_copy(char *dst, size_t size, char const *json, jsmntok_t const *tok)
+{
+    size_t len = tok->end - tok->start;
+    if (len >= size)
+        len = size - 1;
+    memcpy(dst, json + tok->start, len);
+    dst[len] = '\0';
+}
+
+/// Copy a string token, resolving the simple escapes.
+static void tok_unescape(char *dst, size_t size, char const *json, jsmntok_t const *tok)
+{
+    char const *p   = json + tok->start;
+    char const *end = json + tok->end;
+    char *d         = dst;
+    while (p < end && d < dst + size - 1) {
+        char c = *p++;
+        if (c == '\\' && p < end) {
+            c = *p++;
+            c = c == 'n' ? '\n' : c == 't' ? '\t' : c == 'r' ? '\r' : c == 'b' ? '\b' : c == 'f' ? '\f' : c;
+        }
+        *d++ = c;
+    }
+    *d = '\0';
+}
+
+/// Index of the token following the value at tok[i] and all its children.
+static int tok_next(jsmntok_t const *tok, int toks, int i)
+{
+    int end = tok[i].end;
+    for (++i; i < toks && tok[i].start < end; ++i) {
+    }
+    return i;
+}
+
+/// Receiver specific fields, not part of the payload.
+static int is_receiver_key(char const *json, jsmntok_t const *key)
+{
+    static char const *const receiver_keys[] = {"time", "freq", "freq1", "freq2", "rssi", "snr", "noise", "latency", NULL};
+    for (char const *const *k = receiver_keys; *k; ++k) {
+        if (tok_eq(json, key, *k))
+            return 1;
+    }
+    return 0;
+}
+
+/// FNV-1a
+static uint64_t hash_bytes(uint64_t h, char const *s, size_t len)
+{
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (uint8_t)s[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/// The hostname of a RFC 5424 syslog header, e.g. "<14>1 2023-01-01T00:00:00Z host rtl_433 - - - ".
+static void syslog_hostname(char *dst, size_t size, char const *msg, char const *end)
+{
+    char const *p = msg;
+    for (int field = 0; field < 2 && p; ++field) {
+        p = memchr(p, ' ', end - p);
+        if (p)
+            ++p;
+    }
+    if (!p)
+        return;
+    char const *e = memchr(p, ' ', end - p);
+    if (!e || (e - p == 1 && *p == '-'))
+        return; // no hostname or nil value
+    size_t len = e - p;
+    if (len >= size)
+        len = size - 1;
+    memcpy(dst, p, len);
+    dst[len] = '\0';
+}
+
+/* Groups */
+
+static void group_add_rx(merge_group_t *g, merge_rx_t const *rx)
+{
+    for (unsigned i = 0; i < g->num_rx; ++i) {
+        merge_rx_t *r = &g->rx[i];
+        if (strcmp(r->name, rx->name))
+            continue;
+        // another copy from the same receiver, keep the best level and the earliest time
+        r->copies += 1;
+        if (rx->has_level && (!r->has_level || rx->snr > r->snr)) {
+            r->has_level = 1;
+            r->rssi      = rx->rssi;
+            r->snr       = rx->snr;
+        }
+        if (*rx->time && (!*r->time || strcmp(rx->time, r->time) < 0))
+            memcpy(r->time, rx->time, sizeof(r->time));
+        return;
+    }
+    if (g->num_rx < MERGE_MAX_RECEIVERS)
+        g->rx[g->num_rx++] = *rx;
+}
+
+/// Remove the group in slot i, shifting back the following groups of the probe sequence.
+static void group_remove(merge_shard_t *shard, unsigned i)
+{
+    unsigned const mask = MERGE_SHARD_SLOTS - 1;
+    unsigned j          = i;
+    for (;;) {
+        shard->slots[i].state = GROUP_EMPTY;
+        shard->slots[i].json  = NULL;
+        for (;;) {
+            j = (j + 1) & mask;
+            if (shard->slots[j].state == GROUP_EMPTY) {
+                shard->count -= 1;
+                return;
+            }
+            unsigned home = shard->slots[j].hash & mask;
+            // the group can stay if its home is cyclically in (i, j]
+            if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+                continue;
+            break;
+        }
+        shard->slots[i] = shard->slots[j];
+        i               = j;
+    }
+}
+
+static data_t *group_data(merge_group_t const *g)
+{
+    jsmn_parser parser;
+    jsmn_init(&parser);
+    jsmntok_t tok[MERGE_MAX_TOKENS];
+    char const *json = g->json;
+    int toks         = jsmn_parse(&parser, json, strlen(json), tok, MERGE_MAX_TOKENS);
+    if (toks < 1 || tok[0].type != JSMN_OBJECT)
+        return NULL;
+
+    // the earliest time and the receiver with the best SNR
+    char const *time      = NULL;
+    merge_rx_t const *best = NULL;
+    for (unsigned i = 0; i < g->num_rx; ++i) {
+        merge_rx_t const *r = &g->rx[i];
+        if (*r->time && (!time || strcmp(r->time, time) < 0))
+            time = r->time;
+        if (r->has_level && (!best || r->snr > best->snr))
+            best = r;
+    }
+
+    data_t *data = NULL;
+    if (time) {
+        data = data_append(data,
+                "time", "", DATA_STRING, time,
+                NULL);
+    }
+
+    char key[64];
+    char val[MERGE_MSG_MAX];
+    for (int i = 1; i + 1 < toks; i = tok_next(tok, toks, i + 1)) {
+        jsmntok_t const *k = &tok[i];
+        jsmntok_t const *v = &tok[i + 1];
+        if (is_receiver_key(json, k))
+            continue;
+        tok_copy(key, sizeof(key), json, k);
+        if (v->type == JSMN_STRING) {
+            tok_unescape(val, sizeof(val), json, v);
+            data = data_append(data,
+                    key, "", DATA_STRING, val,
+                    NULL);
+        }
+        else if (v->type == JSMN_PRIMITIVE && (json[v->start] == '-' || (json[v->start] >= '0' && json[v->start] <= '9'))) {
+            tok_copy(val, sizeof(val), json, v);
+            if (strpbrk(val, ".eE")) {
+                data = data_append(data,
+                        key, "", DATA_DOUBLE, strtod(val, NULL),
+                        NULL);
+            }
+            else {
+                data = data_append(data,
+                        key, "", DATA_INT, (int)strtol(val, NULL, 10),
+                        NULL);
+            }
+        }
+        else {
+            // nested objects, arrays, and literals are passed on as text
+            tok_copy(val, sizeof(val), json, v);
+            data = data_append(data,
+                    key, "", DATA_STRING, val,
+                    NULL);
+        }
+    }
+
+    data_t *rx_list[MERGE_MAX_RECEIVERS];
+    for (unsigned i = 0; i < g->num_rx; ++i) {
+        merge_rx_t const *r = &g->rx[i];
+        /* clang-format off */
+        rx_list[i] = data_make(
+                "receiver", "",     DATA_STRING, r->name,
+                "time",     "",     DATA_COND, *r->time, DATA_STRING, r->time,
+                "rssi",     "RSSI", DATA_COND, r->has_level, DATA_FORMAT, "%.1f dB", DATA_DOUBLE, r->rssi,
+                "snr",      "SNR",  DATA_COND, r->has_level, DATA_FORMAT, "%.1f dB", DATA_DOUBLE, r->snr,
+                "copies",   "",     DATA_INT, r->copies,
+                NULL);
+        /* clang-format on */
+    }
+
+    /* clang-format off */
+    data = data_append(data,
+            "rssi",     "RSSI",         DATA_COND, best != NULL, DATA_FORMAT, "%.1f dB", DATA_DOUBLE, best ? best->rssi : 0.0,
+            "snr",      "SNR",          DATA_COND, best != NULL, DATA_FORMAT, "%.1f dB", DATA_DOUBLE, best ? best->snr : 0.0,
+            "rx_best",  "Best receiver", DATA_COND, best != NULL, DATA_STRING, best ? best->name : "",
+            "rx_count", "Receivers",    DATA_INT, g->num_rx,
+            "rx",       "",             DATA_ARRAY, data_array(g->num_rx, DATA_DATA, rx_list),
+            NULL);
+    /* clang-format on */
+    return data;
+}
+
+/* Ingest */
+
+static void ingest_event(rx_merge_t *m, char const *line, char const *end, char const *source, uint64_t now_ms)
+{
+    char const *json = memchr(line, '{', end - line);
+    if (!json)
+        return;
+
+    merge_rx_t rx = {0};
+    if (*line == '<')
+        syslog_hostname(rx.name, sizeof(rx.name), line, json);
+    if (!*rx.name && source)
+        snprintf(rx.name, sizeof(rx.name), "%s", source);
+    rx.copies = 1;
+
+    jsmn_parser parser;
+    jsmn_init(&parser);
+    jsmntok_t tok[MERGE_MAX_TOKENS];
+    int toks = jsmn_parse(&parser, json, end - json, tok, MERGE_MAX_TOKENS);
+    if (toks < 1 || tok[0].type != JSMN_OBJECT)
+        return; // invalid or truncated
+
+    int has_model  = 0;
+    uint64_t hash  = 0xcbf29ce484222325ULL;
+    char const sep = 0;
+    for (int i = 1; i + 1 < toks; i = tok_next(tok, toks, i + 1)) {
+        jsmntok_t const *k = &tok[i];
+        jsmntok_t const *v = &tok[i + 1];
+        if (tok_eq(json, k, "time")) {
+            tok_copy(rx.time, sizeof(rx.time), json, v);
+        }
+        else if (tok_eq(json, k, "rssi")) {
+            rx.rssi      = strtod(json + v->start, NULL);
+            rx.has_level = 1;
+        }
+        else if (tok_eq(json, k, "snr")) {
+            rx.snr       = strtod(json + v->start, NULL);
+            rx.has_level = 1;
+        }
+        else if (!is_receiver_key(json, k)) {
+            has_model |= tok_eq(json, k, "model");
+            char type = (char)v->type;
+            hash      = hash_bytes(hash, json + k->start, k->end - k->start);
+            hash      = hash_bytes(hash, &type, 1);
+            hash      = hash_bytes(hash, json + v->start, v->end - v->start);
+            hash      = hash_bytes(hash, &sep, 1);
+        }
+    }
+    if (!has_model)
+        return; // not a device event
+    size_t json_len = tok[0].end - tok[0].start;
+
+    merge_shard_t *shard = &m->shards[(hash >> 60) & (MERGE_SHARDS - 1)];
+    unsigned const mask  = MERGE_SHARD_SLOTS - 1;
+    SHARD_LOCK(shard);
+    shard->received += 1;
+    unsigned i = hash & mask;
+    while (shard->slots[i].state != GROUP_EMPTY && shard->slots[i].hash != hash) {
+        i = (i + 1) & mask; // the load limit ensures an empty slot
+    }
+    merge_group_t *g = &shard->slots[i];
+    if (g->state == GROUP_DONE) {
+        shard->late += 1;
+    }
+    else if (g->state == GROUP_PENDING) {
+        shard->duplicates += 1;
+        group_add_rx(g, &rx);
+    }
+    else if (shard->count >= MERGE_SHARD_LOAD) {
+        shard->dropped += 1;
+    }
+    else {
+        char *copy = malloc(json_len + 1);
+        if (!copy) {
+            WARN_MALLOC("ingest_event()");
+            shard->dropped += 1;
+        }
+        else {
+            memcpy(copy, json, json_len);
+            copy[json_len] = '\0';
+            g->hash        = hash;
+            g->state       = GROUP_PENDING;
+            g->first_ms    = now_ms;
+            g->json        = copy;
+            g->num_rx      = 1;
+            g->rx[0]       = rx;
+            shard->count += 1;
+        }
+    }
+    SHARD_UNLOCK(shard);
+}
+
+void rx_merge_ingest(rx_merge_t *m, char const *msg, size_t len, char const *source, uint64_t now_ms)
+{
+    char const *end = msg + len;
+    while (msg < end) {
+        char const *eol = memchr(msg, '\n', end - msg);
+        if (!eol)
+            eol = end;
+        ingest_event(m, msg, eol, source, now_ms);
+        msg = eol + 1;
+    }
+}
+
+int rx_merge_poll(rx_merge_t *m, uint64_t now_ms, rx_merge_emit_fn emit, void *ctx)
+{
+    int events          = 0;
+    uint64_t const wait = m->window_ms;
+    for (unsigned s = 0; s < MERGE_SHARDS; ++s) {
+        merge_shard_t *shard = &m->shards[s];
+        SHARD_LOCK(shard);
+        for (unsigned i = 0; i < MERGE_SHARD_SLOTS;) {
+            merge_group_t *g = &shard->slots[i];
+            if (g->state == GROUP_PENDING && (!now_ms || now_ms >= g->first_ms + wait)) {
+                merge_group_t done = *g;
+                g->state           = GROUP_DONE;
+                g->json            = NULL;
+                shard->merged += 1;
+                // inserts only fill empty slots, the group stays in slot i
+                SHARD_UNLOCK(shard);
+                data_t *data = group_data(&done);
+                free(done.json);
+                if (data) {
+                    emit(ctx, data);
+                    events += 1;
+                }
+                SHARD_LOCK(shard);
+            }
+            else if (g->state == GROUP_DONE && (!now_ms || now_ms >= g->first_ms + 2 * wait)) {
+                group_remove(shard, i); // a following group might now be in slot i
+            }
+            else {
+                ++i;
+            }
+        }
+        SHARD_UNLOCK(shard);
+    }
+    return events;
+}
+
+data_t *rx_merge_stats(rx_merge_t *m)
+{
+    unsigned received = 0, duplicates = 0, late = 0, dropped = 0, merged = 0;
+    for (unsigned s = 0; s < MERGE_SHARDS; ++s) {
+        merge_shard_t *shard = &m->shards[s];
+        SHARD_LOCK(shard);
+        received += shard->received;
+        duplicates += shard->duplicates;
+        late += shard->late;
+        dropped += shard->dropped;
+        merged += shard->merged;
+        SHARD_UNLOCK(shard);
+    }
+    /* clang-format off */
+    return data_make(
+            "received",     "", DATA_INT, received,
+            "merged",       "", DATA_INT, merged,
+            "duplicates",   "", DATA_INT, duplicates,
+            "late",         "", DATA_INT, late,
+            "dropped",      "", DATA_INT, dropped,
+            NULL);
+    /* clang-format on */
+}
+
+/* Listeners */
+
+#ifdef THREADS
+static uint64_t now_ms(void)
+{
+    struct timeval now;
+    get_time_now(&now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+static THREAD_RETURN THREAD_CALL listener_thread(void *arg)
+{
+    merge_listener_t *l = arg;
+    rx_merge_t *m       = l->m;
+    char msg[MERGE_MSG_MAX];
+
+    while (!m->stopping) {
+        struct sockaddr_storage addr = {0};
+        socklen_t addr_len           = sizeof(addr);
+        int n                        = (int)recvfrom(l->sock, msg, sizeof(msg), 0, (struct sockaddr *)&addr, &addr_len);
+        if (n <= 0)
+            continue; // receive timeout, check for stop
+        char host[INET6_ADDRSTRLEN] = {0};
+        getnameinfo((struct sockaddr *)&addr, addr_len, host, sizeof(host), NULL, 0, NI_NUMERICHOST);
+        rx_merge_ingest(m, msg, n, host, now_ms());
+    }
+    data_pool_clear(); // the data elements kept by this thread
+    return 0;
+}
+
+static SOCKET listener_socket(char const *host, char const *port)
+{
+    struct addrinfo hints, *res, *res0;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = PF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags    = AI_PASSIVE;
+    int error         = getaddrinfo(host, port, &hints, &res0);
+    if (error) {
+        print_log(LOG_ERROR, __func__, gai_strerror(error));
+        return INVALID_SOCKET;
+    }
+    SOCKET sock = INVALID_SOCKET;
+    for (res = res0; res; res = res->ai_next) {
+        sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        if (sock == INVALID_SOCKET)
+            continue;
+#ifdef SO_REUSEPORT
+        int opt = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, (char const *)&opt, sizeof(opt));
+#endif
+#ifdef _WIN32
+        DWORD timeout = 200;
+#else
+        struct timeval timeout = {0, 200000};
+#endif
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (char const *)&timeout, sizeof(timeout));
+        if (bind(sock, res->ai_addr, (int)res->ai_addrlen) == 0)
+            break; // success
+        closesocket(sock);
+        sock = INVALID_SOCKET;
+    }
+    freeaddrinfo(res0);
+    if (sock == INVALID_SOCKET)
+        print_logf(LOG_ERROR, __func__, "Unable to bind to %s port %s", host, port);
+    return sock;
+}
+#endif
+
+int rx_merge_listen(rx_merge_t *m, char const *host, char const *port, int threads)
+{
+#ifndef THREADS
+    (void)m;
+    (void)host;
+    (void)port;
+    (void)threads;
+    print_log(LOG_ERROR, __func__, "Merging receivers is only available with threads enabled");
+    return -1;
+#else
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        print_log(LOG_ERROR, __func__, "WSAStartup() failed");
+        return -1;
+    }
+#endif
+    if (threads < 1)
+        threads = 1;
+    if (threads > MERGE_MAX_THREADS)
+        threads = MERGE_MAX_THREADS;
+#ifndef SO_REUSEPORT
+    if (threads > 1) {
+        print_log(LOG_WARNING, __func__, "No SO_REUSEPORT, receiving on a single thread");
+        threads = 1;
+    }
+#endif
+
+    for (int t = 0; t < threads; ++t) {
+        merge_listener_t *l = &m->listeners[m->num_listeners];
+        l->m                = m;
+        l->sock             = listener_socket(host, port);
+        if (l->sock == INVALID_SOCKET)
+            return -1;
+
+#ifndef _WIN32
+        // Block all signals from the worker thread
+        sigset_t sigset;
+        sigset_t oldset;
+        sigfillset(&sigset);
+        pthread_sigmask(SIG_SETMASK, &sigset, &oldset);
+#endif
+        int r = pthread_create(&l->thread, NULL, listener_thread, l);
+#ifndef _WIN32
+        pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+#endif
+        if (r) {
+            print_logf(LOG_ERROR, __func__, "error in pthread_create, rc: %d", r);
+            closesocket(l->sock);
+            return -1;
+        }
+        m->num_listeners += 1;
+    }
+    return 0;
+#endif
+}
+
+/* API */
+
+rx_merge_t *rx_merge_create(int window_ms)
+{
+    rx_merge_t *m = calloc(1, sizeof(*m));
+    if (!m) {
+        WARN_CALLOC("rx_merge_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    m->window_ms = window_ms > 0 ? window_ms : 1000;
+
+#ifdef THREADS
+    for (unsigned s = 0; s < MERGE_SHARDS; ++s) {
+        pthread_mutex_init(&m->shards[s].lock, NULL);
+    }
+#endif
+
+    return m;
+}
+
+void rx_merge_free(rx_merge_t *m)
+{
+    if (!m)
+        return;
+
+#ifdef THREADS
+    // listeners notice within the receive timeout
+    m->stopping = 1;
+    for (int t = 0; t < m->num_listeners; ++t) {
+        pthread_join(m->listeners[t].thread, NULL);
+        closesocket(m->listeners[t].sock);
+    }
+#ifdef _WIN32
+    if (m->num_listeners)
+        WSACleanup();
+#endif
+#endif
+
+    for (unsigned s = 0; s < MERGE_SHARDS; ++s) {
+        merge_shard_t *shard = &m->shards[s];
+        for (unsigned i = 0; i < MERGE_SHARD_SLOTS; ++i) {
+            if (shard->slots[i].state == GROUP_PENDING)
+                free(shard->slots[i].json);
+        }
+#ifdef THREADS
+        pthread_mutex_destroy(&shard->lock);
+#endif
+    }
+    free(m);
+}
+
+#ifdef _TEST
+#define ASSERT_EQUALS(a, b) \
+    do { \
+        if ((a) == (b)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %d <> %d\n", (int)(a), (int)(b)); \
+        } \
+    } while (0)
+
+#define TEST_RECEIVERS 4
+#define TEST_SENSORS   50
+#define TEST_ROUNDS    20
+
+typedef struct {
+    rx_merge_t *m;
+    int rx;
+} test_sender_t;
+
+static int test_events;
+static int test_rx_total;
+static int test_best_ok;
+
+static void test_emit(void *ctx, data_t *data)
+{
+    (void)ctx;
+    test_events++;
+    for (data_t *d = data; d; d = d->next) {
+        if (!strcmp(d->key, "rx_count"))
+            test_rx_total += d->value.v_int;
+        // receiver 0 always has the best SNR
+        if (!strcmp(d->key, "rx_best") && !strcmp(d->value.v_ptr, "rx0"))
+            test_best_ok++;
+    }
+    data_free(data);
+}
+
+#ifndef THREADS
+#define THREAD_CALL
+#define THREAD_RETURN void *
+#endif
+
+/// Synthetic receiver, every receiver misses the sensors with id % TEST_RECEIVERS == rx but never receiver 0.
+static THREAD_RETURN THREAD_CALL test_sender(void *arg)
+{
+    test_sender_t *s = arg;
+    char msg[512];
+    char name[16];
+    snprintf(name, sizeof(name), "rx%d", s->rx);
+    for (int round = 0; round < TEST_ROUNDS; ++round) {
+        for (int id = 0; id < TEST_SENSORS; ++id) {
+            if (s->rx && id % TEST_RECEIVERS == s->rx)
+                continue;
+            int len = snprintf(msg, sizeof(msg),
+                    "<14>1 2023-01-01T00:00:00Z %s rtl_433 - - - "
+                    "{\"time\" : \"2023-01-01 00:00:%02d\", \"model\" : \"Test-Sensor\", \"id\" : %d, "
+                    "\"temperature_C\" : %d.5, \"rssi\" : %.1f, \"snr\" : %.1f}",
+                    name, 10 + s->rx, id, round, -10.0 - s->rx, 20.0 - s->rx);
+            rx_merge_ingest(s->m, msg, len, NULL, 1000);
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    fprintf(stderr, "rx_merge:: test\n");
+
+    rx_merge_t *m = rx_merge_create(500);
+    if (!m)
+        return 1;
+
+    test_sender_t senders[TEST_RECEIVERS];
+#ifdef THREADS
+    pthread_t threads[TEST_RECEIVERS];
+    for (int i = 0; i < TEST_RECEIVERS; ++i) {
+        senders[i] = (test_sender_t){m, i};
+        pthread_create(&threads[i], NULL, test_sender, &senders[i]);
+    }
+    for (int i = 0; i < TEST_RECEIVERS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+#else
+    for (int i = 0; i < TEST_RECEIVERS; ++i) {
+        senders[i] = (test_sender_t){m, i};
+        test_sender(&senders[i]);
+    }
+#endif
+
+    // nothing before the window ends
+    ASSERT_EQUALS(rx_merge_poll(m, 1499, test_emit, NULL), 0);
+    ASSERT_EQUALS(rx_merge_poll(m, 1500, test_emit, NULL), TEST_SENSORS * TEST_ROUNDS);
+    ASSERT_EQUALS(test_events, TEST_SENSORS * TEST_ROUNDS);
+    // each sensor is missed by one receiver, except by receiver 0
+    int expected_rx = 0;
+    for (int id = 0; id < TEST_SENSORS; ++id)
+        expected_rx += id % TEST_RECEIVERS ? TEST_RECEIVERS - 1 : TEST_RECEIVERS;
+    ASSERT_EQUALS(test_rx_total, expected_rx * TEST_ROUNDS);
+    ASSERT_EQUALS(test_best_ok, TEST_SENSORS * TEST_ROUNDS);
+
+    // late copies are dropped, then the group expires
+    char const late[] = "{\"model\" : \"Test-Sensor\", \"id\" : 1, \"temperature_C\" : 0.5, \"rssi\" : -1.0}\n";
+    rx_merge_ingest(m, late, sizeof(late) - 1, "rx9", 1600);
+    ASSERT_EQUALS(rx_merge_poll(m, 2000, test_emit, NULL), 0);
+    rx_merge_ingest(m, late, sizeof(late) - 1, "rx9", 2100);
+    ASSERT_EQUALS(rx_merge_poll(m, 2100, test_emit, NULL), 0);
+    ASSERT_EQUALS(rx_merge_poll(m, 2600, test_emit, NULL), 1);
+
+    // events without a model are ignored, JSON lines without a syslog header
+    char const lines[] = "{\"time\" : \"@0s\", \"enabled\" : 1}\n{\"model\" : \"Other\", \"id\" : 2}\n{\"model\" : \"Other\", \"id\" : 2}";
+    rx_merge_ingest(m, lines, sizeof(lines) - 1, "10.0.0.1", 3000);
+    test_rx_total = 0;
+    ASSERT_EQUALS(rx_merge_poll(m, 0, test_emit, NULL), 1);
+    ASSERT_EQUALS(test_rx_total, 1);
+
+    data_t *stats = rx_merge_stats(m);
+    data_free(stats);
+    rx_merge_free(m);
+
+    fprintf(stderr, "rx_merge:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+
+    return failed;
+}
+#endif /* _TEST */
@@ -155,3 +155,33 @@ void samp_grab_write(samp_grab_t *g, unsigned grab_len, unsigned grab_end)
 
     fclose(fp);
 }
+
+unsigned samp_grab_copy(samp_grab_t *g, unsigned char *buf, unsigned len, unsigned end_len)
+{
+    if (!g->sg_buf || end_len >= g->sg_len)
+        return 0;
+
+    if (len > g->sg_len - end_len)
+        len = g->sg_len - end_len;
+
+    // absolute end in sg_buf, sg_index is the next write position
+    unsigned end_pos;
+    if (g->sg_index >= end_len)
+        end_pos = g->sg_index - end_len;
+    else
+        end_pos = g->sg_size - end_len + g->sg_index;
+
+    unsigned start_pos;
+    if (end_pos >= len)
+        start_pos = end_pos - len;
+    else
+        start_pos = g->sg_size - len + end_pos;
+
+    unsigned wlen = len;
+    if (start_pos + len > g->sg_size)
+        wlen = g->sg_size - start_pos;
+    memcpy(buf, &g->sg_buf[start_pos], wlen);
+    memcpy(&buf[wlen], &g->sg_buf[0], len - wlen);
+
+    return len;
+}
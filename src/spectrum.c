@@ -0,0 +1,432 @@
+/** @file
+    Spectrum and noise floor telemetry from the IQ input.
+
+    Copyright (C) 2023 Christian Zuckschwerdt
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "spectrum.h"
+#include "data.h"
+#include "r_util.h"
+#include "compat_time.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* FFT */
+
+/// An in-place complex FFT on split real and imaginary arrays.
+///
+/// The first two stages are a radix-4 pass without multiplications,
+/// the remaining radix-2 stages run contiguous over per-stage twiddle tables
+/// so the butterfly loop vectorizes.
+typedef struct fft_plan {
+    unsigned n;
+    unsigned *rev;  ///< bit reversal permutation
+    float *tw_re;   ///< twiddles of the stage with half size h start at offset h - 1
+    float *tw_im;
+} fft_plan_t;
+
+static int fft_init(fft_plan_t *plan, unsigned n)
+{
+    unsigned bits = 0;
+    while ((1U << bits) < n)
+        bits++;
+    if (n < 4 || (1U << bits) != n)
+        return -1;
+
+    plan->n   = n;
+    plan->rev = malloc(n * sizeof(*plan->rev));
+    if (!plan->rev) {
+        WARN_MALLOC("fft_init()");
+        return -1;
+    }
+    plan->tw_re = malloc(n * sizeof(*plan->tw_re));
+    if (!plan->tw_re) {
+        WARN_MALLOC("fft_init()");
+        return -1;
+    }
+    plan->tw_im = malloc(n * sizeof(*plan->tw_im));
+    if (!plan->tw_im) {
+        WARN_MALLOC("fft_init()");
+        return -1;
+    }
+
+    for (unsigned i = 0; i < n; ++i) {
+        unsigned r = 0;
+        for (unsigned b = 0; b < bits; ++b)
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        plan->rev[i] = r;
+    }
+    for (unsigned h = 1; h < n; h *= 2) {
+        for (unsigned k = 0; k < h; ++k) {
+            double a = -M_PI * k / h;
+            plan->tw_re[h - 1 + k] = (float)cos(a);
+            plan->tw_im[h - 1 + k] = (float)sin(a);
+        }
+    }
+    return 0;
+}
+
+static void fft_free(fft_plan_t *plan)
+{
+    free(plan->rev);
+    free(plan->tw_re);
+    free(plan->tw_im);
+}
+
+/// Transform the bit reversed input in place.
+static void fft_run(fft_plan_t const *plan, float *restrict re, float *restrict im)
+{
+    unsigned n = plan->n;
+
+    // radix-4 pass, twiddles are 1 and -i
+    for (unsigned j = 0; j < n; j += 4) {
+        float s0r = re[j] + re[j + 1], s0i = im[j] + im[j + 1];
+        float d0r = re[j] - re[j + 1], d0i = im[j] - im[j + 1];
+        float s1r = re[j + 2] + re[j + 3], s1i = im[j + 2] + im[j + 3];
+        float d1r = re[j + 2] - re[j + 3], d1i = im[j + 2] - im[j + 3];
+        re[j]     = s0r + s1r;
+        im[j]     = s0i + s1i;
+        re[j + 2] = s0r - s1r;
+        im[j + 2] = s0i - s1i;
+        re[j + 1] = d0r + d1i;
+        im[j + 1] = d0i - d1r;
+        re[j + 3] = d0r - d1i;
+        im[j + 3] = d0i + d1r;
+    }
+
+    // radix-2 stages
+    for (unsigned h = 4; h < n; h *= 2) {
+        float const *wr = &plan->tw_re[h - 1];
+        float const *wi = &plan->tw_im[h - 1];
+        for (unsigned j = 0; j < n; j += 2 * h) {
+            float *ar = &re[j], *ai = &im[j];
+            float *br = &re[j + h], *bi = &im[j + h];
+            for (unsigned k = 0; k < h; ++k) {
+                float tr = br[k] * wr[k] - bi[k] * wi[k];
+                float ti = br[k] * wi[k] + bi[k] * wr[k];
+                br[k]    = ar[k] - tr;
+                bi[k]    = ai[k] - ti;
+                ar[k]    = ar[k] + tr;
+                ai[k]    = ai[k] + ti;
+            }
+        }
+    }
+}
+
+/* spectrum */
+
+struct spectrum {
+    fft_plan_t plan;
+    unsigned bins;
+    double interval;
+    float *window;
+    float *re;
+    float *im;
+    double *avg;         ///< averaged power per output bin, DC centered
+    double norm;         ///< summed bin power of a full scale tone
+    uint32_t center_frequency; ///< tuning of the averaged FFTs
+    uint32_t sample_rate;
+    double last_time;
+    double first_time;
+    unsigned long count; ///< number of FFTs
+    double fft_secs;     ///< time spent on the FFTs
+};
+
+spectrum_t *spectrum_create(unsigned fft_size, unsigned bins, unsigned interval_ms)
+{
+    if (!bins || bins > fft_size || fft_size % bins)
+        return NULL;
+
+    spectrum_t *spec = calloc(1, sizeof(*spec));
+    if (!spec) {
+        WARN_CALLOC("spectrum_create()");
+        return NULL;
+    }
+    if (fft_init(&spec->plan, fft_size)) {
+        spectrum_free(spec);
+        return NULL;
+    }
+    spec->bins     = bins;
+    spec->interval = interval_ms * 1e-3;
+    // one allocation for the window, the FFT buffers, and the averages
+    float *buf = malloc(3 * fft_size * sizeof(float) + bins * sizeof(double));
+    if (!buf) {
+        WARN_MALLOC("spectrum_create()");
+        spectrum_free(spec);
+        return NULL;
+    }
+    spec->avg    = (double *)buf; // keep the doubles aligned
+    spec->window = (float *)(spec->avg + bins);
+    spec->re     = spec->window + fft_size;
+    spec->im     = spec->re + fft_size;
+    memset(spec->avg, 0, bins * sizeof(double));
+
+    // Hann window, the bins sum the power of the main lobe, normalize by Parseval
+    double sum = 0.0;
+    for (unsigned i = 0; i < fft_size; ++i) {
+        spec->window[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * i / fft_size));
+        sum += (double)spec->window[i] * spec->window[i];
+    }
+    spec->norm = sum * fft_size;
+
+    return spec;
+}
+
+void spectrum_free(spectrum_t *spec)
+{
+    if (!spec)
+        return;
+
+    fft_free(&spec->plan);
+    free(spec->avg); // also holds the window and the FFT buffers
+    free(spec);
+}
+
+int spectrum_push(spectrum_t *spec, uint8_t const *iq_buf, unsigned n_samples, int sample_size, uint32_t center_frequency, uint32_t sample_rate, struct timeval const *now)
+{
+    unsigned n = spec->plan.n;
+    if (n_samples < n)
+        return 0; // wait for a long enough block
+
+    // restart the average on a retune, e.g. when hopping
+    if (center_frequency != spec->center_frequency || sample_rate != spec->sample_rate) {
+        spec->center_frequency = center_frequency;
+        spec->sample_rate      = sample_rate;
+        spec->count            = 0;
+        spec->fft_secs         = 0.0;
+    }
+
+    double t = now->tv_sec + now->tv_usec * 1e-6;
+    if (spec->count && t >= spec->last_time && t - spec->last_time < spec->interval)
+        return 0;
+    spec->last_time = t;
+    if (!spec->count)
+        spec->first_time = t;
+
+    struct timeval start, stop, elapsed;
+    get_time_now(&start);
+
+    // window and bit reverse the input, scaled to full scale 1.0
+    float *re = spec->re;
+    float *im = spec->im;
+    unsigned const *rev = spec->plan.rev;
+    float const *w = spec->window;
+    if (sample_size == 2) { // CU8
+        for (unsigned i = 0; i < n; ++i) {
+            re[rev[i]] = (iq_buf[2 * i] - 127.5f) * (1.0f / 128.0f) * w[i];
+            im[rev[i]] = (iq_buf[2 * i + 1] - 127.5f) * (1.0f / 128.0f) * w[i];
+        }
+    }
+    else { // CS16
+        int16_t const *iq = (int16_t const *)iq_buf;
+        for (unsigned i = 0; i < n; ++i) {
+            re[rev[i]] = iq[2 * i] * (1.0f / 32768.0f) * w[i];
+            im[rev[i]] = iq[2 * i + 1] * (1.0f / 32768.0f) * w[i];
+        }
+    }
+
+    fft_run(&spec->plan, re, im);
+
+    // DC centered power bins, averaged over about 8 FFTs
+    unsigned per_bin = n / spec->bins;
+    for (unsigned b = 0; b < spec->bins; ++b) {
+        double p = 0.0;
+        for (unsigned k = b * per_bin; k < (b + 1) * per_bin; ++k) {
+            unsigned i = (k + n / 2) % n;
+            p += (double)re[i] * re[i] + (double)im[i] * im[i];
+        }
+        spec->avg[b] = spec->count ? spec->avg[b] + (p - spec->avg[b]) / 8.0 : p;
+    }
+    spec->count++;
+
+    get_time_now(&stop);
+    timeval_subtract(&elapsed, &stop, &start);
+    spec->fft_secs += elapsed.tv_sec + elapsed.tv_usec * 1e-6;
+
+    return 1;
+}
+
+static int compare_double(void const *a, void const *b)
+{
+    double da = *(double const *)a;
+    double db = *(double const *)b;
+    return (da > db) - (da < db);
+}
+
+struct data *spectrum_data(spectrum_t *spec)
+{
+    if (!spec || !spec->count)
+        return NULL;
+
+    uint32_t center_frequency = spec->center_frequency;
+    uint32_t sample_rate      = spec->sample_rate;
+
+    unsigned bins = spec->bins;
+    double *db    = malloc(2 * bins * sizeof(*db));
+    if (!db) {
+        WARN_MALLOC("spectrum_data()");
+        return NULL;
+    }
+    double *sorted = db + bins;
+
+    unsigned peak = 0;
+    for (unsigned b = 0; b < bins; ++b) {
+        double p = spec->avg[b] / spec->norm;
+        db[b]    = p > 1e-20 ? 10.0 * log10(p) : -200.0;
+        db[b]    = round(db[b] * 10.0) / 10.0;
+        if (db[b] > db[peak])
+            peak = b;
+    }
+    memcpy(sorted, db, bins * sizeof(*db));
+    qsort(sorted, bins, sizeof(*sorted), compare_double);
+
+    double bin_hz    = (double)sample_rate / bins;
+    double peak_freq = center_frequency + (peak + 0.5) * bin_hz - sample_rate / 2.0;
+    double span      = spec->last_time - spec->first_time;
+    double load      = span > 0.0 ? spec->fft_secs / span : 0.0;
+
+    /* clang-format off */
+    data_t *data = data_make(
+            "center_frequency", "", DATA_INT, center_frequency,
+            "sample_rate",      "", DATA_INT, sample_rate,
+            "fft_size",         "", DATA_INT, spec->plan.n,
+            "ffts",             "", DATA_INT, (int)spec->count,
+            "noise_floor_db",   "", DATA_FORMAT, "%.1f", DATA_DOUBLE, sorted[bins / 2],
+            "peak_db",          "", DATA_FORMAT, "%.1f", DATA_DOUBLE, db[peak],
+            "peak_freq",        "", DATA_FORMAT, "%.0f", DATA_DOUBLE, peak_freq,
+            "fft_load",         "", DATA_FORMAT, "%.5f", DATA_DOUBLE, load,
+            "bins_db",          "", DATA_ARRAY, data_array(bins, DATA_DOUBLE, db),
+            NULL);
+    /* clang-format on */
+
+    free(db);
+    return data;
+}
+
+#ifdef _TEST
+
+#define ASSERT_NEAR(a, b, eps) \
+    do { \
+        double a_ = (a), b_ = (b); \
+        if (fabs(a_ - b_) <= (eps)) \
+            ++passed; \
+        else { \
+            ++failed; \
+            fprintf(stderr, "FAIL: %g <> %g\n", a_, b_); \
+        } \
+    } while (0)
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    fprintf(stderr, "spectrum:: test\n");
+
+    fprintf(stderr, "spectrum::fft_run(): compare to a direct DFT\n");
+    for (unsigned n = 4; n <= 256; n *= 2) {
+        fft_plan_t plan;
+        if (fft_init(&plan, n))
+            return 1;
+        float re[256], im[256];
+        double xr[256], xi[256];
+        srand(n);
+        for (unsigned i = 0; i < n; ++i) {
+            xr[i] = rand() / (double)RAND_MAX - 0.5;
+            xi[i] = rand() / (double)RAND_MAX - 0.5;
+            re[plan.rev[i]] = (float)xr[i];
+            im[plan.rev[i]] = (float)xi[i];
+        }
+        fft_run(&plan, re, im);
+        for (unsigned k = 0; k < n; ++k) {
+            double sr = 0.0, si = 0.0;
+            for (unsigned i = 0; i < n; ++i) {
+                double a = -2.0 * M_PI * i * k / n;
+                sr += xr[i] * cos(a) - xi[i] * sin(a);
+                si += xr[i] * sin(a) + xi[i] * cos(a);
+            }
+            ASSERT_NEAR(re[k], sr, 1e-4 * n);
+            ASSERT_NEAR(im[k], si, 1e-4 * n);
+        }
+        fft_free(&plan);
+    }
+
+    fprintf(stderr, "spectrum::spectrum_push(): full scale tone centered in the bin above +1/4 of the sample rate\n");
+    unsigned n = SPECTRUM_FFT_SIZE;
+    double w   = 2.0 * M_PI * (n / 4 + n / SPECTRUM_BINS / 2) / n;
+    uint8_t *iq = malloc(2 * n);
+    if (!iq)
+        return 1;
+    for (unsigned i = 0; i < n; ++i) {
+        iq[2 * i]     = (uint8_t)lrint(127.5 + 127.0 * cos(w * i));
+        iq[2 * i + 1] = (uint8_t)lrint(127.5 + 127.0 * sin(w * i));
+    }
+    spectrum_t *spec = spectrum_create(n, SPECTRUM_BINS, 100);
+    if (!spec)
+        return 1;
+    struct timeval now = {1000, 0};
+    ASSERT_NEAR(spectrum_push(spec, iq, n, 2, 433920000, 250000, &now), 1, 0);
+    now.tv_usec = 50000; // rate limited
+    ASSERT_NEAR(spectrum_push(spec, iq, n, 2, 433920000, 250000, &now), 0, 0);
+    now.tv_usec = 200000;
+    ASSERT_NEAR(spectrum_push(spec, iq, n, 2, 433920000, 250000, &now), 1, 0);
+
+    data_t *data = spectrum_data(spec);
+    for (data_t *d = data; d; d = d->next) {
+        if (!strcmp(d->key, "peak_freq"))
+            ASSERT_NEAR(d->value.v_dbl, 433920000 + 62500 + 250000.0 / SPECTRUM_BINS / 2, 1.0);
+        else if (!strcmp(d->key, "peak_db"))
+            ASSERT_NEAR(d->value.v_dbl, 0.0, 0.5);
+        else if (!strcmp(d->key, "noise_floor_db"))
+            ASSERT_NEAR(d->value.v_dbl < -40.0, 1, 0);
+        else if (!strcmp(d->key, "ffts"))
+            ASSERT_NEAR(d->value.v_int, 2, 0);
+    }
+    data_free(data);
+
+    fprintf(stderr, "spectrum::spectrum_push(): a retune restarts the average\n");
+    now.tv_usec = 210000; // not rate limited after a retune
+    ASSERT_NEAR(spectrum_push(spec, iq, n, 2, 868300000, 250000, &now), 1, 0);
+    data = spectrum_data(spec);
+    for (data_t *d = data; d; d = d->next) {
+        if (!strcmp(d->key, "center_frequency"))
+            ASSERT_NEAR(d->value.v_int, 868300000, 0);
+        else if (!strcmp(d->key, "ffts"))
+            ASSERT_NEAR(d->value.v_int, 1, 0);
+    }
+    data_free(data);
+
+    fprintf(stderr, "spectrum::spectrum_push(): cost\n");
+    struct timeval start, stop, elapsed;
+    get_time_now(&start);
+    unsigned loops = 2000;
+    for (unsigned i = 0; i < loops; ++i) {
+        now.tv_sec++;
+        spectrum_push(spec, iq, n, 2, 433920000, 250000, &now);
+    }
+    get_time_now(&stop);
+    timeval_subtract(&elapsed, &stop, &start);
+    fprintf(stderr, "%u-point FFT with windowing and binning: %.2f us\n", n,
+            (elapsed.tv_sec * 1e6 + elapsed.tv_usec) / loops);
+
+    spectrum_free(spec);
+    free(iq);
+
+    fprintf(stderr, "spectrum:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+
+    return failed;
+}
+#endif /* _TEST */
@@ -130,6 +130,14 @@ int main(int argc, char *argv[])
         magnitude_true_cu8(cu8_buf, y16_buf, n_samples);
     );
     write_buf("bb.am.s16", y16_buf, sizeof(uint16_t) * n_samples);
+    float avg_db, est_db, peak_db;
+    MEASURE("envelope_detect (dB)",
+        avg_db = envelope_detect(cu8_buf, y16_buf, n_samples);
+    );
+    MEASURE("level_estimate_cu8",
+        est_db = level_estimate_cu8(cu8_buf, n_samples, 8, 64, 0, &peak_db);
+    );
+    printf("Level: %.1f dB, estimated %.1f dB, peak %.1f dB\n", avg_db, est_db, peak_db);
     MEASURE("baseband_low_pass_filter",
         baseband_low_pass_filter(y16_buf, (int16_t *)u16_buf, n_samples, &state);
     );
@@ -19,6 +19,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "data.h"
 #include "output_file.h"
@@ -46,9 +47,41 @@ int main(void)
 	data_output_print(kv_output, data);
 	data_output_print(csv_output, data);
 
+	data_schema_t *schema = data_schema_create(fields, sizeof fields / sizeof *fields);
+	if (data_schema_count(schema) != 7
+			|| data_schema_id(schema, "temp") != 2
+			|| data_schema_id(schema, "house_code") != 1
+			|| data_schema_id(schema, "missing") != -1)
+		return 1;
+	data_record_t record;
+	if (data_record_init(&record, schema))
+		return 1;
+	if (data_record_fill(&record, data) != 7
+			|| !data_record_get(&record, 2)
+			|| data_record_get(&record, 2)->value.v_dbl != 99.9
+			|| data_record_fill(&record, data->next) != 6
+			|| data_record_get(&record, 0))
+		return 1;
+	data_record_release(&record);
+	data_schema_free(schema);
+
 	data_output_free(json_output);
 	data_output_free(kv_output);
 	data_output_free(csv_output);
 
 	data_free(data);
+
+	// converted keys and formats, released elements are reused
+	data = data_make("temperature_F", "Temperature", DATA_FORMAT, "%.1f F", DATA_DOUBLE, 68.0, NULL);
+	data_t *elem = data;
+	if (data_set_key(data, "temperature_C") || strcmp(data->key, "temperature_C"))
+		return 1;
+	if (data_set_format(data, "%.1f C and a longer format") || strcmp(data->format, "%.1f C and a longer format"))
+		return 1;
+	data_free(data);
+	data = data_make("model", "", DATA_STRING, "Reused", NULL);
+	if (data != elem || strcmp(data->value.v_ptr, "Reused"))
+		return 1;
+	data_free(data);
+	data_pool_clear();
 }
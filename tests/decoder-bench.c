@@ -0,0 +1,354 @@
+/*
+ * Decoder Benchmark
+ *
+ * Runs decoders directly on stored bitbuffers, without any DSP,
+ * to measure the cost of decode_fn in isolation.
+ *
+ * Copyright (C) 2023 Christian Zuckschwerdt
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <stddef.h>
+
+#include "r_api.h"
+#include "r_device.h"
+#include "rtl_433.h"
+#include "bitbuffer.h"
+#include "data.h"
+#include "list.h"
+#include "compat_time.h"
+#include "r_util.h"
+#include "alloc_stats.h"
+
+/* allocation counting, the build wraps the allocator with "-Wl,--wrap=" where the linker supports it */
+
+#ifdef ALLOC_STATS
+// the allocator is wrapped by alloc_stats.c, use the decoder counts
+#define ALLOC_COUNT(r_dev) ((r_dev)->decode_allocs)
+#else
+static unsigned long alloc_count;
+#define ALLOC_COUNT(r_dev) alloc_count
+#endif
+
+#ifdef BENCH_WRAP_ALLOC
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+char *__real_strdup(char const *s);
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t nmemb, size_t size);
+void *__wrap_realloc(void *ptr, size_t size);
+char *__wrap_strdup(char const *s);
+
+void *__wrap_malloc(size_t size)
+{
+    alloc_count++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    alloc_count++;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    alloc_count++;
+    return __real_realloc(ptr, size);
+}
+
+char *__wrap_strdup(char const *s)
+{
+    alloc_count++;
+    return __real_strdup(s);
+}
+#endif
+
+/* stubbed outputs */
+
+static unsigned long output_count;
+
+static void bench_output(r_device *decoder, data_t *data)
+{
+    (void)decoder; // unused
+    output_count++;
+    data_free(data);
+}
+
+static void bench_log(r_device *decoder, int level, data_t *data)
+{
+    (void)decoder; // unused
+    (void)level; // unused
+    data_free(data);
+}
+
+/* corpus */
+
+typedef struct bench_code {
+    unsigned protocol;
+    size_t rows_len; ///< bytes of the bits buffer in use, rows might spill
+    bitbuffer_t bits;
+} bench_code_t;
+
+typedef struct bench_result {
+    r_device *decoder;
+    unsigned codes;
+    unsigned long calls;
+    unsigned long success;
+    unsigned long outputs;
+    unsigned long allocs;
+    double secs;
+} bench_result_t;
+
+static void usage(void)
+{
+    fprintf(stderr, "decoder-bench [-n iterations] [-F json] corpus...\n"
+                    "Each corpus line is a protocol number or name and a bitbuffer code,\n"
+                    "e.g. \"1 {25}fb2dd58\", use \"-\" to read from stdin, \"#\" starts a comment.\n"
+                    "Rows are separated by \"/\" or a new \"{len}\", text after the code is ignored.\n");
+    exit(1);
+}
+
+static r_device *find_device(r_cfg_t *cfg, char const *name)
+{
+    char *end;
+    unsigned long num = strtoul(name, &end, 10);
+    if (*name && !*end)
+        return num >= 1 && num <= cfg->num_r_devices ? &cfg->devices[num - 1] : NULL;
+
+    for (unsigned i = 0; i < cfg->num_r_devices; ++i) {
+        if (!strcmp(cfg->devices[i].name, name))
+            return &cfg->devices[i];
+    }
+    return NULL;
+}
+
+static int load_corpus(r_cfg_t *cfg, char const *filename, list_t *codes)
+{
+    FILE *fp = strcmp(filename, "-") ? fopen(filename, "r") : stdin;
+    if (!fp) {
+        fprintf(stderr, "Failed to open %s\n", filename);
+        return -1;
+    }
+
+    char line[INPUT_LINE_MAX];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        lineno++;
+        char *p = line;
+        while (isspace((unsigned char)*p))
+            p++;
+        if (!*p || *p == '#')
+            continue;
+
+        char *proto = p;
+        while (*p && !isspace((unsigned char)*p))
+            p++;
+        if (*p)
+            *p++ = '\0';
+        while (isspace((unsigned char)*p))
+            p++;
+        // cut after the last row, e.g. "{36}75b000027 [0.9 mm]"
+        char *code = p;
+        for (char *c = code; *c && *c != '#'; ++c) {
+            if (*c == '{' || *c == '}' || *c == '/' || *c == 'x' || isxdigit((unsigned char)*c))
+                p = c + 1;
+            else if (!isspace((unsigned char)*c))
+                break;
+        }
+        *p = '\0';
+
+        r_device *r_dev = find_device(cfg, proto);
+        if (!r_dev || !*code) {
+            fprintf(stderr, "%s:%d: unknown protocol \"%s\" or missing code\n", filename, lineno, proto);
+            if (fp != stdin)
+                fclose(fp);
+            return -1;
+        }
+
+        bench_code_t *bc = calloc(1, sizeof(*bc));
+        if (!bc) {
+            fprintf(stderr, "calloc() failed\n");
+            exit(1);
+        }
+        bc->protocol = r_dev->protocol_num;
+        bitbuffer_parse(&bc->bits, code);
+        for (unsigned row = 0; row < bc->bits.num_rows; ++row) {
+            size_t end = row * BITBUF_COLS + (bc->bits.bits_per_row[row] + 7) / 8;
+            end        = (end + BITBUF_COLS - 1) / BITBUF_COLS * BITBUF_COLS; // full rows
+            if (bc->rows_len < end)
+                bc->rows_len = end;
+        }
+        list_push(codes, bc);
+    }
+
+    if (fp != stdin)
+        fclose(fp);
+    return 0;
+}
+
+/// Decoders may modify the bitbuffer, restore a fresh copy of the rows in use.
+static void copy_code(bitbuffer_t *bits, bench_code_t const *bc)
+{
+    memcpy(bits, &bc->bits, offsetof(bitbuffer_t, bb));
+    memcpy(bits->bb, bc->bits.bb, bc->rows_len);
+}
+
+static double elapsed_secs(struct timeval *start)
+{
+    struct timeval stop, elapsed;
+    get_time_now(&stop);
+    timeval_subtract(&elapsed, &stop, start);
+    return elapsed.tv_sec + elapsed.tv_usec * 1e-6;
+}
+
+int main(int argc, char *argv[])
+{
+    long iterations = 1000000;
+    int json        = 0;
+    list_t corpora  = {0};
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            iterations = atol(argv[++i]);
+        else if (!strcmp(argv[i], "-F") && i + 1 < argc)
+            json = !strcmp(argv[++i], "json");
+        else if (argv[i][0] == '-' && argv[i][1])
+            usage();
+        else
+            list_push(&corpora, argv[i]);
+    }
+    if (iterations < 1 || !corpora.len)
+        usage();
+
+    r_cfg_t *cfg = r_create_cfg();
+
+    list_t codes = {0};
+    for (size_t i = 0; i < corpora.len; ++i) {
+        if (load_corpus(cfg, corpora.elems[i], &codes))
+            return 1;
+    }
+    if (!codes.len) {
+        fprintf(stderr, "No codes found\n");
+        return 1;
+    }
+
+    // decoders are instantiated as for registration, with outputs stubbed
+    bench_result_t *results = calloc(cfg->num_r_devices, sizeof(*results));
+    if (!results) {
+        fprintf(stderr, "calloc() failed\n");
+        return 1;
+    }
+    for (size_t i = 0; i < codes.len; ++i) {
+        bench_code_t *bc    = codes.elems[i];
+        bench_result_t *res = &results[bc->protocol - 1];
+        res->codes++;
+        if (res->decoder)
+            continue;
+        r_device *tmpl = &cfg->devices[bc->protocol - 1];
+        if (tmpl->create_fn) {
+            res->decoder = tmpl->create_fn(NULL);
+            res->decoder->protocol_num = tmpl->protocol_num;
+        }
+        else {
+            res->decoder = malloc(sizeof(*res->decoder));
+            if (!res->decoder) {
+                fprintf(stderr, "malloc() failed\n");
+                return 1;
+            }
+            *res->decoder = *tmpl; // copy
+        }
+        res->decoder->output_fn = bench_output;
+        res->decoder->log_fn    = bench_log;
+        res->decoder->verbose   = 0;
+    }
+
+    // the calls include a copy of the code, report that as baseline
+    bitbuffer_t bits = {0};
+    struct timeval start;
+    get_time_now(&start);
+    for (long n = 0; n < iterations; ++n) {
+        copy_code(&bits, codes.elems[n % codes.len]);
+#ifdef __GNUC__
+        __asm__ volatile("" : : "r"(&bits) : "memory"); // keep the copy
+#endif
+    }
+    double copy_secs = elapsed_secs(&start);
+    double copy_ns   = copy_secs * 1e9 / iterations;
+
+    // every code in the corpus gets the same number of calls
+    long per_code = (iterations + codes.len - 1) / codes.len;
+    for (size_t i = 0; i < codes.len; ++i) {
+        bench_code_t *bc    = codes.elems[i];
+        bench_result_t *res = &results[bc->protocol - 1];
+        r_device *r_dev     = res->decoder;
+
+        alloc_scope_t alloc_scope = alloc_stats_enter(ALLOC_STAGE_DECODE, r_dev);
+        unsigned long allocs  = ALLOC_COUNT(r_dev);
+        unsigned long outputs = output_count;
+        get_time_now(&start);
+        for (long n = 0; n < per_code; ++n) {
+            copy_code(&bits, bc);
+            int ret = r_dev->decode_fn(r_dev, &bits);
+            if (ret > 0)
+                res->success++;
+        }
+        res->secs += elapsed_secs(&start);
+        alloc_stats_leave(alloc_scope);
+        res->calls += per_code;
+        res->allocs += ALLOC_COUNT(r_dev) - allocs;
+        res->outputs += output_count - outputs;
+    }
+
+    if (json) {
+        printf("{\"iterations\" : %ld, \"codes\" : %u, \"copy_ns\" : %.1f, \"allocs_counted\" : %s, \"decoders\" : [",
+                iterations, (unsigned)codes.len, copy_ns,
+#if defined(BENCH_WRAP_ALLOC) || defined(ALLOC_STATS)
+                "true"
+#else
+                "false"
+#endif
+        );
+    }
+    else {
+        printf("%-5s %-40s %6s %10s %10s %12s %8s\n", "Proto", "Name", "Codes", "Calls", "ns/call", "allocs/call", "success");
+    }
+    int first = 1;
+    for (unsigned i = 0; i < cfg->num_r_devices; ++i) {
+        bench_result_t *res = &results[i];
+        if (!res->decoder)
+            continue;
+        double ns      = res->secs * 1e9 / res->calls;
+        double allocs  = (double)res->allocs / res->calls;
+        double success = (double)res->success / res->calls;
+        if (json) {
+            printf("%s{\"protocol\" : %u, \"name\" : \"%s\", \"codes\" : %u, \"calls\" : %lu, \"ns_per_call\" : %.1f, \"allocs_per_call\" : %.2f, \"success_rate\" : %.3f, \"outputs\" : %lu}",
+                    first ? "" : ", ", res->decoder->protocol_num, res->decoder->name, res->codes, res->calls, ns, allocs, success, res->outputs);
+        }
+        else {
+            printf("%5u %-40.40s %6u %10lu %10.1f %12.2f %7.1f%%\n",
+                    res->decoder->protocol_num, res->decoder->name, res->codes, res->calls, ns, allocs, success * 100.0);
+        }
+        first = 0;
+        free(res->decoder->decode_ctx);
+        free(res->decoder);
+    }
+    if (json)
+        printf("]}\n");
+
+    free(results);
+    list_free_elems(&codes, free);
+    list_free_elems(&corpora, NULL);
+    r_free_cfg(cfg);
+    return 0;
+}
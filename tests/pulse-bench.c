@@ -0,0 +1,176 @@
+/*
+ * Pulse Detector and Slicer Benchmark
+ *
+ * Runs the pulse detector on a synthetic OOK signal and the PCM, PPM, PWM
+ * slicers on the detected package, at the common 250k and 1024k sample rates.
+ * The slicers are timed with the decoder timings converted on each call and
+ * with the timings cached for the sample rate.
+ *
+ * Copyright (C) 2023 Christian Zuckschwerdt
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "pulse_detect.h"
+#include "pulse_slicer.h"
+#include "pulse_data.h"
+#include "r_device.h"
+#include "bitbuffer.h"
+#include "compat_time.h"
+#include "r_util.h"
+
+static void usage(void)
+{
+    fprintf(stderr, "pulse-bench [-n loops]\n"
+                    "Times the pulse detector and slicers at 250k and 1024k sample rate.\n");
+    exit(1);
+}
+
+static double elapsed_secs(struct timeval *start)
+{
+    struct timeval stop, elapsed;
+    get_time_now(&stop);
+    timeval_subtract(&elapsed, &stop, start);
+    return elapsed.tv_sec + elapsed.tv_usec / 1e6;
+}
+
+/// Synthetic OOK PWM signal: 40 bits of 500/1000 us pulses in a 1500 us period, then 20 ms silence.
+static int16_t *make_signal(uint32_t samp_rate, int len)
+{
+    int16_t *buf = malloc(len * sizeof(*buf));
+    if (!buf) {
+        fprintf(stderr, "malloc() failed\n");
+        exit(1);
+    }
+    srand(1);
+    int per_us = samp_rate / 1000000 ? (int)(samp_rate / 1000000) : 1;
+    int n      = 0;
+    while (n < len) {
+        for (int bit = 0; bit < 40 && n < len; ++bit) {
+            int pulse = (bit * 7 % 3 ? 500 : 1000) * samp_rate / 1000000;
+            int gap   = 1500 * samp_rate / 1000000 - pulse;
+            for (int i = 0; i < pulse && n < len; ++i)
+                buf[n++] = 8000 + rand() % 200;
+            for (int i = 0; i < gap && n < len; ++i)
+                buf[n++] = 100 + rand() % 50;
+        }
+        for (int i = 0; i < 20000 * per_us && n < len; ++i)
+            buf[n++] = 100 + rand() % 50;
+    }
+    return buf;
+}
+
+static int run_detect(pulse_detect_t *pd, int16_t const *am, int16_t const *fm, int len, uint32_t samp_rate, pulse_data_t *pulses, pulse_data_t *fsk_pulses)
+{
+    int packages = 0;
+    while (pulse_detect_package(pd, am, fm, len, samp_rate, 0, pulses, fsk_pulses, FSK_PULSE_DETECT_AUTO)) {
+        packages++;
+    }
+    return packages;
+}
+
+static int bench_decode(r_device *decoder, bitbuffer_t *bitbuffer)
+{
+    (void)decoder;
+    return bitbuffer->num_rows > 0;
+}
+
+typedef int (*slicer_fn)(pulse_data_t const *pulses, r_device *device);
+
+static double bench_slicer(slicer_fn slicer, r_device *device, pulse_data_t const *pulses, long loops, int cached)
+{
+    struct timeval start;
+    get_time_now(&start);
+    for (long i = 0; i < loops; ++i) {
+        if (!cached)
+            device->timing.sample_rate = 0; // convert the timings on each call
+        slicer(pulses, device);
+    }
+    return elapsed_secs(&start) * 1e9 / loops;
+}
+
+int main(int argc, char *argv[])
+{
+    long loops = 20000;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            loops = atol(argv[++i]);
+        else
+            usage();
+    }
+    if (loops < 1)
+        usage();
+
+    uint32_t const rates[] = {250000, 1024000};
+    pulse_data_t *pulses     = calloc(1, sizeof(*pulses));
+    pulse_data_t *fsk_pulses = calloc(1, sizeof(*fsk_pulses));
+    if (!pulses || !fsk_pulses) {
+        fprintf(stderr, "calloc() failed\n");
+        return 1;
+    }
+
+    for (unsigned r = 0; r < sizeof(rates) / sizeof(*rates); ++r) {
+        uint32_t samp_rate = rates[r];
+        int len            = samp_rate / 2; // half a second
+        int16_t *am        = make_signal(samp_rate, len);
+        int16_t *fm        = calloc(len, sizeof(*fm));
+        if (!fm) {
+            fprintf(stderr, "calloc() failed\n");
+            return 1;
+        }
+
+        // detector
+        long detect_loops = loops / 1000 + 1;
+        pulse_detect_t *pd = pulse_detect_create();
+        if (!pd) {
+            fprintf(stderr, "pulse_detect_create() failed\n");
+            return 1;
+        }
+        run_detect(pd, am, fm, len, samp_rate, pulses, fsk_pulses); // settle the levels
+        int packages = 0;
+        struct timeval start;
+        get_time_now(&start);
+        for (long i = 0; i < detect_loops; ++i) {
+            packages = run_detect(pd, am, fm, len, samp_rate, pulses, fsk_pulses);
+        }
+        double secs = elapsed_secs(&start);
+        printf("%-8u %-8s %12.2f  ns/sample, %d packages\n", samp_rate, "detect",
+                secs * 1e9 / detect_loops / len, packages);
+
+        // a package to slice
+        pulse_detect_package(pd, am, fm, len, samp_rate, 0, pulses, fsk_pulses, FSK_PULSE_DETECT_AUTO);
+        pulse_detect_free(pd);
+
+        struct {
+            char const *name;
+            slicer_fn fn;
+            r_device device;
+        } slicers[] = {
+                {"pcm", pulse_slicer_pcm, {.name = "PCM", .modulation = OOK_PULSE_PCM, .short_width = 500, .long_width = 1500, .reset_limit = 4000, .tolerance = 200, .decode_fn = bench_decode}},
+                {"ppm", pulse_slicer_ppm, {.name = "PPM", .modulation = OOK_PULSE_PPM, .short_width = 500, .long_width = 1000, .reset_limit = 4000, .decode_fn = bench_decode}},
+                {"pwm", pulse_slicer_pwm, {.name = "PWM", .modulation = OOK_PULSE_PWM, .short_width = 500, .long_width = 1000, .reset_limit = 4000, .decode_fn = bench_decode}},
+        };
+        for (unsigned i = 0; i < sizeof(slicers) / sizeof(*slicers); ++i) {
+            double ns_convert = bench_slicer(slicers[i].fn, &slicers[i].device, pulses, loops, 0);
+            double ns_cached  = bench_slicer(slicers[i].fn, &slicers[i].device, pulses, loops, 1);
+            printf("%-8u %-8s %12.1f  ns/package, %12.1f cached, %u pulses, %u ok\n", samp_rate, slicers[i].name,
+                    ns_convert, ns_cached, pulses->num_pulses, slicers[i].device.decode_ok);
+        }
+
+        free(fm);
+        free(am);
+    }
+
+    free(fsk_pulses);
+    free(pulses);
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * Streaming API Benchmark
+ *
+ * Runs N independent decoder instances on N threads over the same input.
+ *
+ * Copyright (C) 2023 Christian Zuckschwerdt
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "r_stream.h"
+#include "data.h"
+#include "compat_pthread.h"
+#include "compat_time.h"
+#include "r_util.h"
+
+#ifndef THREADS
+#define THREAD_CALL
+#define THREAD_RETURN void *
+#endif
+
+typedef struct bench_instance {
+    uint8_t const *buf;
+    uint32_t len;
+    int loops;
+    unsigned events;
+    unsigned pulled;
+#ifdef THREADS
+    pthread_t thread;
+#endif
+} bench_instance_t;
+
+static void usage(void)
+{
+    fprintf(stderr, "stream-bench [-n instances] [-l loops] [file.cu8]\n"
+                    "Without a file a synthetic noise buffer is used.\n");
+    exit(1);
+}
+
+static THREAD_RETURN THREAD_CALL bench_thread(void *arg)
+{
+    bench_instance_t *inst = arg;
+
+    r_stream_t *stream = r_stream_create(250000, R_STREAM_CU8);
+    if (!stream) {
+        fprintf(stderr, "r_stream_create() failed\n");
+        return 0;
+    }
+
+    for (int i = 0; i < inst->loops; ++i) {
+        inst->events += r_stream_push_iq(stream, inst->buf, inst->len);
+
+        r_stream_event_t event;
+        while (r_stream_pull(stream, &event)) {
+            inst->pulled += 1;
+            r_stream_event_release(&event);
+        }
+    }
+
+    r_stream_free(stream);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int instances = 4;
+    int loops     = 4;
+    char const *filename = NULL;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            instances = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-l") && i + 1 < argc)
+            loops = atoi(argv[++i]);
+        else if (argv[i][0] == '-')
+            usage();
+        else
+            filename = argv[i];
+    }
+    if (instances < 1 || loops < 1)
+        usage();
+
+    uint32_t len = 2 * 1024 * 1024;
+    uint8_t *buf = malloc(len);
+    if (!buf) {
+        fprintf(stderr, "malloc() failed\n");
+        return 1;
+    }
+    if (filename) {
+        FILE *fp = fopen(filename, "rb");
+        if (!fp) {
+            fprintf(stderr, "Failed to open %s\n", filename);
+            free(buf);
+            return 1;
+        }
+        len = (uint32_t)fread(buf, 1, len, fp);
+        fclose(fp);
+    }
+    else {
+        // noise with some OOK bursts
+        srand(1);
+        for (uint32_t i = 0; i < len; ++i) {
+            int burst = (i / 2000) % 8 == 0 && (i / 200) % 2;
+            buf[i] = (uint8_t)(128 + (rand() % 9) - 4 + (burst ? 100 : 0));
+        }
+    }
+
+    bench_instance_t *inst = calloc(instances, sizeof(*inst));
+    if (!inst) {
+        fprintf(stderr, "calloc() failed\n");
+        free(buf);
+        return 1;
+    }
+
+    struct timeval start, stop, elapsed;
+    get_time_now(&start);
+
+    for (int i = 0; i < instances; ++i) {
+        inst[i].buf   = buf;
+        inst[i].len   = len;
+        inst[i].loops = loops;
+#ifdef THREADS
+        if (pthread_create(&inst[i].thread, NULL, bench_thread, &inst[i])) {
+            fprintf(stderr, "pthread_create() failed\n");
+            return 1;
+        }
+#else
+        bench_thread(&inst[i]);
+#endif
+    }
+#ifdef THREADS
+    for (int i = 0; i < instances; ++i) {
+        pthread_join(inst[i].thread, NULL);
+    }
+#endif
+
+    get_time_now(&stop);
+    timeval_subtract(&elapsed, &stop, &start);
+    double secs = elapsed.tv_sec + elapsed.tv_usec * 1e-6;
+
+    unsigned events = 0;
+    unsigned pulled = 0;
+    for (int i = 0; i < instances; ++i) {
+        events += inst[i].events;
+        pulled += inst[i].pulled;
+        if (inst[i].events != inst[0].events) {
+            fprintf(stderr, "Instance %d decoded %u events, instance 0 decoded %u\n", i, inst[i].events, inst[0].events);
+            return 1;
+        }
+    }
+    double msamples = (double)instances * loops * (len / 2) / 1e6;
+    printf("%d instances, %d loops, %.1f MS in %.3f s: %.1f MS/s total, %.1f MS/s per instance, %u events (%u pulled)\n",
+            instances, loops, msamples, secs, msamples / secs, msamples / secs / instances, events, pulled);
+
+    free(inst);
+    free(buf);
+    return events != pulled;
+}